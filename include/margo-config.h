@@ -8,6 +8,7 @@
 #ifndef __MARGO_CONFIG
 #define __MARGO_CONFIG
 
+#include <stdbool.h>
 #include <mercury.h>
 #include <abt.h>
 
@@ -773,6 +774,8 @@ hg_return_t margo_xstream_ref_count_by_index(margo_instance_id mid,
 /**
  * @brief This helper function transfers the ULT from one pool to another.
  * It can be used to move ULTs out of a pool that we wish to remove.
+ * ULTs are moved in batches of 64, yielding between batches if the
+ * caller is a ULT.
  *
  * Note: this function will not remove ULTs that are blocked.
  * The caller can check for any remaining blocked ULTs by calling
@@ -786,6 +789,48 @@ hg_return_t margo_xstream_ref_count_by_index(margo_instance_id mid,
 hg_return_t margo_transfer_pool_content(ABT_pool origin_pool,
                                         ABT_pool target_pool);
 
+/**
+ * @brief Options of margo_rebalance_pools.
+ */
+struct margo_rebalance_options {
+    /* Fraction, in (0, 1], of the origin pool's runnable ULTs to move.
+     * With 1, the origin pool is drained, including the ULTs pushed into
+     * it while the function runs. */
+    double fraction;
+    /* Maximum number of ULTs moved between two yields (0 means 64) */
+    size_t batch_size;
+    /* Move ULTs one at a time in the order in which the origin pool
+     * releases them and, when both pools are "edf_wait" (resp. "wfq_wait")
+     * pools, carry their deadline (resp. provider id key) over, so that
+     * the target pool keeps their relative priorities. */
+    bool preserve_order;
+};
+
+#define MARGO_REBALANCE_OPTIONS_DEFAULT \
+    ((struct margo_rebalance_options){.fraction = 1.0})
+
+/**
+ * @brief Moves part of the runnable ULTs of a pool into another pool of the
+ * margo instance, in bounded batches, so that load can be migrated off a
+ * busy pool while the system runs. The number of ULTs to move is computed
+ * from the size of the origin pool when the function is called. Blocked
+ * ULTs are not moved.
+ *
+ * @param [in] mid Margo instance.
+ * @param [in] origin_pool Origin pool.
+ * @param [in] target_pool Target pool.
+ * @param [in] options Options (NULL for MARGO_REBALANCE_OPTIONS_DEFAULT).
+ * @param [out] num_moved Number of ULTs moved (may be NULL).
+ *
+ * @return HG_SUCCESS or other HG error code (HG_INVALID_ARG).
+ */
+hg_return_t
+margo_rebalance_pools(margo_instance_id                     mid,
+                      ABT_pool                              origin_pool,
+                      ABT_pool                              target_pool,
+                      const struct margo_rebalance_options* options,
+                      size_t*                               num_moved);
+
 #ifdef __cplusplus
 }
 #endif
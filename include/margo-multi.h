@@ -0,0 +1,260 @@
+/**
+ * @file margo-multi.h
+ *
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __MARGO_MULTI_H
+#define __MARGO_MULTI_H
+
+#include <margo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Request for a multi-destination forward.
+ */
+typedef struct margo_multi_request* margo_multi_request_t;
+#define MARGO_MULTI_REQUEST_NULL ((margo_multi_request_t)NULL)
+
+/**
+ * Options of margo_forward_multi and margo_iforward_multi.
+ */
+struct margo_forward_multi_options {
+    /* timeout of the RPC sent to each destination in milliseconds,
+     * 0 for none */
+    double timeout_ms;
+    /* 0 to send the RPC to every destination directly, otherwise number of
+     * destinations to which each process relays the RPC (see below) */
+    unsigned relay_fanout;
+};
+
+/**
+ * @brief Sends the same RPC to a list of destinations without blocking.
+ * The input is serialized only once, and the resulting bytes are sent to
+ * every destination.
+ *
+ * If options->relay_fanout is k > 0, the RPC is not sent by the caller
+ * to every destination. The destinations are split into k groups, the
+ * first destination of each group receives the input along with the
+ * rest of its group, executes the RPC locally, and relays it in the same
+ * manner to the rest of its group. The statuses of the destinations
+ * travel back along the same tree, but their outputs do not:
+ * margo_multi_get_handle returns HG_HANDLE_NULL for all destinations.
+ * Every destination must be a margo server that has called
+ * margo_enable_relay and has the RPC registered with the given provider id
+ * (destinations reached through a server that refuses to relay get
+ * HG_PERMISSION). A
+ * relay does not keep a handler ULT busy while its subtree executes the RPC:
+ * it responds from the completion callback of its last operation.
+ *
+ * @param [in] mid Margo instance.
+ * @param [in] id RPC id, as used with margo_create.
+ * @param [in] count Number of destinations.
+ * @param [in] addrs Addresses of the destinations.
+ * @param [in] provider_ids Provider ids of the destinations (may be NULL,
+ * in which case MARGO_DEFAULT_PROVIDER_ID is used for all of them).
+ * @param [in] in_struct Input of the RPC, which may be modified or freed
+ * as soon as the function returns.
+ * @param [in] options Options (may be NULL).
+ * @param [out] req Request to wait on with margo_multi_wait and to free
+ * with margo_multi_request_free.
+ *
+ * @return 0 on success, hg_return_t values on error. Errors affecting
+ * only some of the destinations are reported by margo_multi_wait.
+ */
+hg_return_t
+margo_iforward_multi(margo_instance_id                         mid,
+                     hg_id_t                                   id,
+                     size_t                                    count,
+                     const hg_addr_t*                          addrs,
+                     const uint16_t*                           provider_ids,
+                     void*                                     in_struct,
+                     const struct margo_forward_multi_options* options,
+                     margo_multi_request_t*                    req);
+
+/**
+ * @brief Blocking version of margo_iforward_multi. The request it returns
+ * has completed: it gives access to the status and output of each
+ * destination and must be freed with margo_multi_request_free.
+ *
+ * @return 0 if the RPC succeeded on every destination, the first error
+ * otherwise (in which case the request is still returned if it could be
+ * issued).
+ */
+hg_return_t
+margo_forward_multi(margo_instance_id                         mid,
+                    hg_id_t                                   id,
+                    size_t                                    count,
+                    const hg_addr_t*                          addrs,
+                    const uint16_t*                           provider_ids,
+                    void*                                     in_struct,
+                    const struct margo_forward_multi_options* options,
+                    margo_multi_request_t*                    req);
+
+/**
+ * @brief Waits for the RPC to complete on every destination of a
+ * multi-destination request.
+ *
+ * @param [in] req Request.
+ *
+ * @return 0 if the RPC succeeded on every destination, the first error
+ * otherwise (see margo_multi_get_status).
+ */
+hg_return_t margo_multi_wait(margo_multi_request_t req);
+
+/**
+ * @brief Returns the result of the RPC sent to the destination at the
+ * given index, once margo_multi_wait has returned.
+ *
+ * @param [in] req Request.
+ * @param [in] index Index of the destination.
+ *
+ * @return the result of the RPC for this destination.
+ */
+hg_return_t margo_multi_get_status(margo_multi_request_t req, size_t index);
+
+/**
+ * @brief Returns the handle used to send the RPC to the destination at
+ * the given index, from which margo_get_output can get its output once
+ * margo_multi_wait has returned. The handle is owned by the request and
+ * must not be destroyed by the caller.
+ *
+ * @param [in] req Request.
+ * @param [in] index Index of the destination.
+ *
+ * @return the handle, or HG_HANDLE_NULL if the RPC was relayed to this
+ * destination or could not be sent to it.
+ */
+hg_handle_t margo_multi_get_handle(margo_multi_request_t req, size_t index);
+
+/**
+ * @brief Frees a multi-destination request, waiting for its completion
+ * if margo_multi_wait was not called.
+ *
+ * @param [in] req Request.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_multi_request_free(margo_multi_request_t req);
+
+/**
+ * @brief Allows the passed Margo instance to relay the RPCs of
+ * margo_iforward_multi calls made with a non-zero relay_fanout. Relaying is
+ * disabled by default, since a relay executes RPCs and forwards them to
+ * addresses chosen by its sender.
+ *
+ * @param [in] mid Margo instance.
+ */
+void margo_enable_relay(margo_instance_id mid);
+
+/**
+ * Latency tracker used by margo_forward_hedged to decide when to send an RPC
+ * to another replica.
+ */
+typedef struct margo_hedge* margo_hedge_t;
+#define MARGO_HEDGE_NULL ((margo_hedge_t)NULL)
+
+/**
+ * Options of margo_hedge_create. Fields left to 0 take their default value.
+ */
+struct margo_hedge_options {
+    /* percentile of the latencies of a replica after which the RPC is sent
+     * to the next replica (default 95) */
+    double percentile;
+    /* delay used for replicas with too few latency samples, in milliseconds
+     * (default 10) */
+    double initial_delay_ms;
+    /* lower bound of the delay, in milliseconds (default 0) */
+    double min_delay_ms;
+    /* number of replicas to which the RPC is sent right away (default 1),
+     * set to the number of replicas for a plain first-of-N forward */
+    unsigned initial_replicas;
+    /* maximum number of replicas to which the RPC is sent (default all) */
+    unsigned max_replicas;
+};
+
+/**
+ * @brief Creates a latency tracker for hedged forwards. The tracker keeps
+ * the latest latencies of each destination it has sent RPCs to (up to 1024
+ * destinations, the least recently used one being forgotten to make room
+ * for a new one), and can be shared by any number of ULTs.
+ *
+ * @param [in] mid Margo instance.
+ * @param [in] options Options (may be NULL).
+ * @param [out] hedge Resulting tracker.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_hedge_create(margo_instance_id                 mid,
+                               const struct margo_hedge_options* options,
+                               margo_hedge_t*                    hedge);
+
+/**
+ * @brief Destroys a latency tracker. No hedged forward may be using it.
+ *
+ * @param [in] hedge Tracker.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_hedge_destroy(margo_hedge_t hedge);
+
+/**
+ * @brief Sends an RPC to the first of a list of replicas and, if it has not
+ * responded after the configured percentile of its past latencies, to the
+ * next one, and so on. The function returns as soon as one replica responds
+ * successfully, after canceling the RPCs sent to the others. A replica that
+ * fails also triggers the sending to the next one without waiting.
+ *
+ * The latencies observed by the call are added to the tracker, so the
+ * delays adapt to each replica without any configuration. Since the RPC
+ * may execute on several replicas, it should be idempotent (e.g. a read).
+ *
+ * @param [in] hedge Latency tracker.
+ * @param [in] id RPC id, as used with margo_create.
+ * @param [in] count Number of replicas.
+ * @param [in] addrs Addresses of the replicas, in order of preference.
+ * @param [in] provider_ids Provider ids of the replicas (may be NULL, in
+ * which case MARGO_DEFAULT_PROVIDER_ID is used for all of them).
+ * @param [in] in_struct Input of the RPC.
+ * @param [in] timeout_ms Timeout of the RPC sent to each replica, 0 for none.
+ * @param [out] handle Handle of the replica that responded, from which to
+ * get the output with margo_get_output, and to destroy with margo_destroy.
+ * @param [out] index Index of the replica that responded (may be NULL).
+ *
+ * @return 0 on success, the last error if every replica failed.
+ */
+hg_return_t margo_forward_hedged(margo_hedge_t    hedge,
+                                 hg_id_t          id,
+                                 size_t           count,
+                                 const hg_addr_t* addrs,
+                                 const uint16_t*  provider_ids,
+                                 void*            in_struct,
+                                 double           timeout_ms,
+                                 hg_handle_t*     handle,
+                                 size_t*          index);
+
+/**
+ * @brief Returns the delay after which margo_forward_hedged sends an RPC to
+ * the next replica when waiting on the given one.
+ *
+ * @param [in] hedge Latency tracker.
+ * @param [in] addr Address of the replica.
+ * @param [in] provider_id Provider id of the replica.
+ * @param [out] delay_ms Delay in milliseconds.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_hedge_get_delay(margo_hedge_t hedge,
+                                  hg_addr_t     addr,
+                                  uint16_t      provider_id,
+                                  double*       delay_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MARGO_MULTI_H */
@@ -46,6 +46,10 @@ typedef struct margo_data*     margo_data_ptr;
  * Request for non-blocking operations.
  */
 typedef struct margo_request_struct* margo_request;
+/**
+ * Completion queue in which requests are placed as they complete.
+ */
+typedef struct margo_cq* margo_cq_t;
 /**
  * Type of callback called during finalization or pre-finalization
  * of Margo.
@@ -62,6 +66,11 @@ typedef void (*margo_finalize_callback_t)(void*);
  */
 #define MARGO_REQUEST_NULL ((margo_request)NULL)
 
+/**
+ * Uninitialized margo_cq_t.
+ */
+#define MARGO_CQ_NULL ((margo_cq_t)NULL)
+
 /**
  * @brief Type of margo_request.
  */
@@ -73,6 +82,17 @@ typedef enum
     MARGO_INVALID_REQUEST  = 8
 } margo_request_type;
 
+/**
+ * @brief How the handler of an RPC is executed
+ * (see margo_registered_set_inline).
+ */
+typedef enum
+{
+    MARGO_INLINE_NONE    = 0, /* in a new ULT in the RPC's pool (default) */
+    MARGO_INLINE_TRIGGER = 1, /* directly in the progress loop */
+    MARGO_INLINE_TASK    = 2  /* as an Argobots tasklet in the RPC's pool */
+} margo_inline_mode_t;
+
 /**
  * Client mode for margo_init.
  */
@@ -910,6 +930,73 @@ hg_return_t margo_registered_disabled_response(margo_instance_id mid,
                                                hg_id_t           id,
                                                int*              disabled_flag);
 
+/**
+ * @brief Select how incoming RPCs of the given ID are executed. By default
+ * (MARGO_INLINE_NONE), each RPC runs in a new ULT created in the RPC's pool.
+ * MARGO_INLINE_TRIGGER runs the handler directly in the progress loop when
+ * the RPC is triggered, and MARGO_INLINE_TASK runs it as a tasklet in the
+ * RPC's pool, both avoiding the creation of a ULT and its stack.
+ *
+ * @note Inline handlers must be short and must never block: they cannot
+ * use blocking calls such as margo_respond, margo_forward or
+ * margo_bulk_transfer (which would wait on the progress loop, or cannot
+ * suspend a tasklet), but should use their callback-based counterparts
+ * such as margo_crespond. Only handlers defined with
+ * DEFINE_MARGO_RPC_HANDLER are affected by this setting.
+ *
+ * @param [in] mid  Margo instance.
+ * @param [in] id   Registered RPC ID.
+ * @param [in] mode Execution mode.
+ *
+ * @return HG_SUCCESS or corresponding HG error code.
+ */
+hg_return_t margo_registered_set_inline(margo_instance_id   mid,
+                                        hg_id_t             id,
+                                        margo_inline_mode_t mode);
+
+/**
+ * @brief Get the execution mode of incoming RPCs of the given ID.
+ *
+ * @param [in] mid   Margo instance.
+ * @param [in] id    Registered RPC ID.
+ * @param [out] mode Execution mode.
+ *
+ * @return HG_SUCCESS or corresponding HG error code.
+ */
+hg_return_t margo_registered_get_inline(margo_instance_id    mid,
+                                        hg_id_t              id,
+                                        margo_inline_mode_t* mode);
+
+/**
+ * @brief Limit the number of incoming RPCs of the given ID that may wait
+ * in their pool for their handler to start. RPCs arriving beyond this limit
+ * are rejected before any ULT is created, and the client's margo_forward
+ * returns HG_BUSY. A limit on all the RPCs of a pool can also be set using
+ * the "max_queue_depth" field of the pool's configuration.
+ *
+ * @param [in] mid       Margo instance.
+ * @param [in] id        Registered RPC ID.
+ * @param [in] max_depth Maximum number of queued RPCs (0 means unlimited).
+ *
+ * @return HG_SUCCESS or corresponding HG error code.
+ */
+hg_return_t margo_registered_set_max_queue_depth(margo_instance_id mid,
+                                                 hg_id_t           id,
+                                                 unsigned          max_depth);
+
+/**
+ * @brief Get the queue depth limit of incoming RPCs of the given ID.
+ *
+ * @param [in] mid        Margo instance.
+ * @param [in] id         Registered RPC ID.
+ * @param [out] max_depth Maximum number of queued RPCs (0 means unlimited).
+ *
+ * @return HG_SUCCESS or corresponding HG error code.
+ */
+hg_return_t margo_registered_get_max_queue_depth(margo_instance_id mid,
+                                                 hg_id_t           id,
+                                                 unsigned*         max_depth);
+
 /**
  * @brief Lookup an addr from a peer address/name.
  *
@@ -1104,6 +1191,22 @@ hg_return_t margo_free_output(hg_handle_t handle, void* out_struct);
  */
 const char* margo_handle_get_name(hg_handle_t handle);
 
+/**
+ * @brief Get the time left before the client of an incoming RPC gives up on
+ * it, as set by the timeout of margo_forward_timed and its variants. The
+ * result may be passed as timeout to RPCs issued on behalf of this one.
+ * RPCs whose deadline has already passed when they arrive are dropped
+ * before their handler is run. The deadline is an absolute time, so the
+ * clocks of the client and the server are assumed to be synchronized.
+ *
+ * @param [in] handle Handle of the incoming RPC.
+ * @param [out] remaining_ms Time left, in milliseconds (negative if the
+ * deadline has passed).
+ *
+ * @return HG_SUCCESS, or HG_NOENTRY if the client did not set a timeout.
+ */
+hg_return_t margo_get_deadline(hg_handle_t handle, double* remaining_ms);
+
 /**
  * @brief Forward an RPC request to a remote provider with a user-defined
  * timeout.
@@ -1364,6 +1467,135 @@ hg_return_t margo_wait(margo_request req);
  */
 hg_return_t margo_wait_any(size_t count, margo_request* req, size_t* index);
 
+/**
+ * @brief Waits for at least one of the provided requests to complete,
+ * then waits on all the requests that have completed by then.
+ *
+ * @note Requests equal to MARGO_REQUEST_NULL are ignored and the
+ * completed requests are set to MARGO_REQUEST_NULL, so that the
+ * function can be called repeatedly on the same array. If all the
+ * requests are equal to MARGO_REQUEST_NULL, this function returns
+ * HG_SUCCESS and sets num_completed to 0.
+ *
+ * @param [in] count Number of requests.
+ * @param [inout] req Array of requests.
+ * @param [out] num_completed Number of requests that completed.
+ * @param [out] indices Indices of the completed requests (array of count
+ * elements).
+ * @param [out] rets Result of each completed request, in the order of
+ * indices (array of count elements, may be NULL).
+ *
+ * @return 0 on success, the first error of the completed requests
+ * otherwise.
+ */
+hg_return_t margo_wait_some(size_t         count,
+                            margo_request* req,
+                            size_t*        num_completed,
+                            size_t*        indices,
+                            hg_return_t*   rets);
+
+/**
+ * @brief Waits for all the provided requests to complete.
+ *
+ * @note Requests equal to MARGO_REQUEST_NULL are ignored (their result
+ * is HG_SUCCESS) and the others are set to MARGO_REQUEST_NULL.
+ *
+ * @param [in] count Number of requests.
+ * @param [inout] req Array of requests.
+ * @param [out] rets Result of each request (array of count elements,
+ * may be NULL).
+ *
+ * @return 0 on success, the first error of the requests otherwise.
+ */
+hg_return_t margo_wait_all(size_t count, margo_request* req, hg_return_t* rets);
+
+/**
+ * @brief Creates a completion queue. Requests added to the queue with
+ * margo_cq_add are placed in it as they complete, from which margo_cq_wait
+ * and margo_cq_poll retrieve them in O(1), regardless of the number of
+ * requests in flight.
+ *
+ * @param [in] mid Margo instance.
+ * @param [out] cq Completion queue.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_cq_create(margo_instance_id mid, margo_cq_t* cq);
+
+/**
+ * @brief Destroys a completion queue.
+ *
+ * @param [in] cq Completion queue.
+ *
+ * @return 0 on success, HG_BUSY if some requests added to the queue
+ * have not been retrieved from it.
+ */
+hg_return_t margo_cq_destroy(margo_cq_t cq);
+
+/**
+ * @brief Adds a request returned by a non-blocking margo function
+ * (margo_iforward, margo_irespond, margo_bulk_itransfer, etc.) to a
+ * completion queue, typically right after issuing it. The request
+ * is placed in the queue when it completes, or right away if it has
+ * already completed.
+ *
+ * @note A request can only be added to one completion queue, and must be
+ * retrieved from it before margo_wait is called on it. margo_wait_any and
+ * margo_wait_some can still be called on it (not concurrently with
+ * margo_cq_wait or margo_cq_poll on the same queue): they then poll the
+ * requests rather than blocking, and take those they complete out of the
+ * queue.
+ *
+ * @param [in] cq Completion queue.
+ * @param [in] req Request, created by the same margo instance as the queue.
+ * @param [in] uargs Argument returned along with the request.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_cq_add(margo_cq_t cq, margo_request req, void* uargs);
+
+/**
+ * @brief Blocks until at least one request of the completion queue has
+ * completed, and retrieves up to max_count completed requests in their
+ * order of completion. The caller should then call margo_wait on each of
+ * them, which returns immediately with the result of the operation.
+ * If the queue has no request left, this function returns immediately
+ * with count set to 0.
+ *
+ * @param [in] cq Completion queue.
+ * @param [in] max_count Maximum number of requests to retrieve.
+ * @param [out] reqs Completed requests (array of max_count elements).
+ * @param [out] uargs Arguments the requests were added with (array of
+ * max_count elements, may be NULL).
+ * @param [out] count Number of requests retrieved.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_cq_wait(margo_cq_t     cq,
+                          size_t         max_count,
+                          margo_request* reqs,
+                          void**         uargs,
+                          size_t*        count);
+
+/**
+ * @brief Non-blocking version of margo_cq_wait: retrieves up to max_count
+ * completed requests, setting count to 0 if none has completed.
+ *
+ * @param [in] cq Completion queue.
+ * @param [in] max_count Maximum number of requests to retrieve.
+ * @param [out] reqs Completed requests (array of max_count elements).
+ * @param [out] uargs Arguments the requests were added with (array of
+ * max_count elements, may be NULL).
+ * @param [out] count Number of requests retrieved.
+ *
+ * @return 0 on success, hg_return_t values on error.
+ */
+hg_return_t margo_cq_poll(margo_cq_t     cq,
+                          size_t         max_count,
+                          margo_request* reqs,
+                          void**         uargs,
+                          size_t*        count);
+
 /**
  * @brief Test if an operation initiated by a non-blocking
  * margo function (margo_iforward, margo_irespond, etc.)
@@ -1857,6 +2089,25 @@ hg_return_t margo_bulk_ctransfer(margo_instance_id mid,
  */
 void margo_thread_sleep(margo_instance_id mid, double timeout_ms);
 
+/**
+ * @brief Creates a ULT with a deadline. In an "edf_wait" pool, ULTs are
+ * scheduled in order of their deadline (RPC handlers take the deadline set
+ * by the client's timeout, if any); in other pools the deadline is ignored.
+ *
+ * @param [in] pool Pool in which to create the ULT.
+ * @param [in] thread_func Function to run.
+ * @param [in] arg Argument of the function.
+ * @param [in] timeout_ms Deadline, in milliseconds from now.
+ * @param [out] thread Created ULT (may be NULL if not needed).
+ *
+ * @return ABT_SUCCESS or corresponding Argobots error code.
+ */
+int margo_thread_create_with_deadline(ABT_pool pool,
+                                      void (*thread_func)(void*),
+                                      void*       arg,
+                                      double      timeout_ms,
+                                      ABT_thread* thread);
+
 /**
  * @brief Retrieve the abt_handler pool that was associated with
  * the instance at initialization time.
@@ -1908,6 +2159,20 @@ hg_context_t* margo_get_context(margo_instance_id mid);
  */
 hg_class_t* margo_get_class(margo_instance_id mid);
 
+/**
+ * @brief Set the id of the Mercury context that should receive the RPC sent
+ * with this handle on the target. Targets configured with
+ * "progress_contexts": N have contexts 0 to N-1, each driven by its own
+ * progress loop, and clients can spread their RPCs across them.
+ * The target context is 0 by default.
+ *
+ * @param [in] handle Handle.
+ * @param [in] context_id Id of the target context.
+ *
+ * @return HG_SUCCESS or corresponding Mercury error code.
+ */
+hg_return_t margo_set_target_context(hg_handle_t handle, uint8_t context_id);
+
 /**
  * @brief Get the data that was associated with the handle using
  * margo_set_data.
@@ -2207,6 +2472,33 @@ void __margo_respond_with_error(hg_handle_t handle, hg_return_t ret);
  */
 hg_return_t __margo_internal_set_handle_data(hg_handle_t handle);
 
+/**
+ * @private
+ * Internal function used by DEFINE_MARGO_RPC_HANDLER, not supposed to be
+ * called by users! Runs the wrapper in a new ULT in the pool, or inline
+ * depending on the RPC's margo_inline_mode_t.
+ */
+int __margo_internal_dispatch_rpc(hg_handle_t handle,
+                                  ABT_pool    pool,
+                                  void (*wrapper)(void*));
+
+/**
+ * @private
+ * Internal function used by DEFINE_MARGO_RPC_HANDLER, not supposed to be
+ * called by users! Returns HG_TIMEOUT if the client's deadline for the RPC
+ * has passed, HG_BUSY if the RPC exceeds the queue depth limit of its pool
+ * or of its RPC ID, HG_SUCCESS otherwise.
+ */
+hg_return_t __margo_internal_admit_rpc(hg_handle_t handle, ABT_pool pool);
+
+/**
+ * @private
+ * Internal function used by DEFINE_MARGO_RPC_HANDLER, not supposed to be
+ * called by users! Gives back the slot that __margo_internal_admit_rpc took
+ * in the queue depth limit of the RPC's ID, if any.
+ */
+void __margo_internal_release_admission(hg_handle_t handle);
+
 /**
  * @brief Macro that registers a function as an RPC.
  *
@@ -2257,6 +2549,7 @@ hg_return_t _handler_for_NULL(hg_handle_t);
                     "Could not get margo instance when entering ULT " #__name \
                     " for RPC %s",                                            \
                     __rpc_name);                                              \
+        __margo_internal_release_admission(handle);                           \
         margo_destroy(handle);                                                \
         return;                                                               \
     }                                                                         \
@@ -2313,18 +2606,29 @@ hg_return_t _handler_for_NULL(hg_handle_t);
     __margo_internal_pre_handler_hooks(__mid, handle, &__monitoring_args);     \
     __rpc_name = margo_handle_get_name(handle);                                \
     __rpc_name = __rpc_name ? __rpc_name : #__name;                            \
-    margo_trace(__mid, "Spawning ULT " #__name " for RPC %s (handle = %p)",    \
-                __rpc_name, (void*)handle);                                    \
-    __ret = ABT_thread_create(__pool, (void (*)(void*))_wrapper_for_##__name,  \
-                              handle, ABT_THREAD_ATTR_NULL, NULL);             \
-    if (__ret != 0) {                                                          \
-        margo_error(__mid,                                                     \
-                    "Could not create ULT" #__name " for RPC %s (ret = %d)",   \
-                    __rpc_name, __ret);                                        \
-        __margo_respond_with_error(handle, HG_OTHER_ERROR);                    \
+    __hret     = __margo_internal_admit_rpc(handle, __pool);                   \
+    if (__hret != HG_SUCCESS) {                                                \
+        margo_debug(__mid, "Rejecting RPC %s (%s)", __rpc_name,                \
+                    HG_Error_to_string(__hret));                               \
+        __margo_respond_with_error(handle, __hret);                            \
         margo_destroy(handle);                                                 \
         __margo_internal_decr_pending(__mid);                                  \
-        __hret = HG_NOMEM_ERROR;                                               \
+    } else {                                                                   \
+        margo_trace(__mid, "Dispatching " #__name " for RPC %s (handle = %p)", \
+                    __rpc_name, (void*)handle);                                \
+        __ret = __margo_internal_dispatch_rpc(                                 \
+            handle, __pool, (void (*)(void*))_wrapper_for_##__name);           \
+        if (__ret != 0) {                                                      \
+            margo_error(__mid,                                                 \
+                        "Could not create ULT" #__name                         \
+                        " for RPC %s (ret = %d)",                              \
+                        __rpc_name, __ret);                                    \
+            __margo_respond_with_error(handle, HG_OTHER_ERROR);                \
+            __margo_internal_release_admission(handle);                        \
+            margo_destroy(handle);                                             \
+            __margo_internal_decr_pending(__mid);                              \
+            __hret = HG_NOMEM_ERROR;                                           \
+        }                                                                      \
     }                                                                          \
     __monitoring_args.ret = __hret;                                            \
     __margo_internal_post_handler_hooks(__mid, &__monitoring_args);            \
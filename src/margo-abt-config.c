@@ -37,7 +37,9 @@ bool __margo_abt_pool_validate_json(const json_object_t* jpool,
     json_object_t* jkind = json_object_object_get(jpool, "kind");
     if (jkind) {
         CONFIG_IS_IN_ENUM_STRING(jkind, "pool kind", "fifo", "fifo_wait",
-                                 "prio_wait", "earliest_first", "external");
+                                 "prio_wait", "prio_wait_split",
+                                 "earliest_first", "edf_wait", "wfq_wait",
+                                 "mlfq_wait", "ws_wait", "external");
         if (strcmp(json_object_get_string(jkind), "external") == 0) {
             margo_error(mid,
                         "Pool is marked as external and "
@@ -47,6 +49,96 @@ bool __margo_abt_pool_validate_json(const json_object_t* jpool,
     }
     // TODO: support dlopen-ed pool definitions
 
+    /* default: 0 */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "workers", int, "pool");
+    if (json_object_object_get(jpool, "workers")) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(jpool, "workers", "pool.workers");
+    }
+
+    /* default: 0 */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "max_queue_depth", int, "pool");
+    if (json_object_object_get(jpool, "max_queue_depth")) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(jpool, "max_queue_depth",
+                                        "pool.max_queue_depth");
+    }
+
+    /* default: 1, only used by "wfq_wait" pools */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "default_weight", int, "pool");
+    if (json_object_object_get(jpool, "default_weight")) {
+        if (json_object_get_int64(json_object_object_get(jpool,
+                                                         "default_weight"))
+            <= 0) {
+            margo_error(mid, "\"pool.default_weight\" must be positive");
+            return false;
+        }
+    }
+
+    /* default: {}, only used by "wfq_wait" pools */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "weights", object, "pool");
+    json_object_t* jweights = json_object_object_get(jpool, "weights");
+    if (jweights) {
+        json_object_object_foreach(jweights, provider_str, jweight) {
+            char* end         = NULL;
+            long  provider_id = strtol(provider_str, &end, 10);
+            if (*provider_str == '\0' || *end != '\0' || provider_id < 0
+                || provider_id > MARGO_MAX_PROVIDER_ID) {
+                margo_error(mid,
+                            "Invalid provider id \"%s\" in pool.weights",
+                            provider_str);
+                return false;
+            }
+            if (!json_object_is_type(jweight, json_type_int)
+                || json_object_get_int64(jweight) <= 0) {
+                margo_error(mid,
+                            "Weight of provider %s in pool.weights must be "
+                            "a positive integer",
+                            provider_str);
+                return false;
+            }
+        }
+    }
+
+    /* default: 3 levels, only used by "mlfq_wait" pools */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "levels", array, "pool");
+    json_object_t* jlevels = json_object_object_get(jpool, "levels");
+    if (jlevels) {
+        size_t num_levels = json_object_array_length(jlevels);
+        if (num_levels == 0 || num_levels > MARGO_MLFQ_MAX_LEVELS) {
+            margo_error(mid,
+                        "\"pool.levels\" must have between 1 and %d entries",
+                        MARGO_MLFQ_MAX_LEVELS);
+            return false;
+        }
+        for (size_t i = 0; i < num_levels; i++) {
+            json_object_t* jlevel = json_object_array_get_idx(jlevels, i);
+            if (!json_object_is_type(jlevel, json_type_object)) {
+                margo_error(mid, "\"pool.levels\" entries must be objects");
+                return false;
+            }
+            /* default: 1 */
+            ASSERT_CONFIG_HAS_OPTIONAL(jlevel, "quantum", int, "pool level");
+            json_object_t* jquantum = json_object_object_get(jlevel, "quantum");
+            if (jquantum && json_object_get_int64(jquantum) <= 0) {
+                margo_error(mid, "\"pool.levels[].quantum\" must be positive");
+                return false;
+            }
+            /* default: 0 (never demote) */
+            ASSERT_CONFIG_HAS_OPTIONAL(jlevel, "demote_after", int,
+                                       "pool level");
+            if (json_object_object_get(jlevel, "demote_after")) {
+                CONFIG_INTEGER_MUST_BE_POSITIVE(jlevel, "demote_after",
+                                                "pool.levels[].demote_after");
+            }
+        }
+    }
+
+    /* default: 100, only used by "mlfq_wait" pools */
+    ASSERT_CONFIG_HAS_OPTIONAL(jpool, "boost_period_ms", int, "pool");
+    if (json_object_object_get(jpool, "boost_period_ms")) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(jpool, "boost_period_ms",
+                                        "pool.boost_period_ms");
+    }
+
     /* default: generated */
     ASSERT_CONFIG_HAS_OPTIONAL(jpool, "name", string, "pool");
     json_object_t* jname = json_object_object_get(jpool, "name");
@@ -135,6 +227,15 @@ bool __margo_abt_pool_init_from_json(const json_object_t* jpool,
         if (ret != ABT_SUCCESS) {
             margo_error(mid, "ABT_pool_create failed with error code %d", ret);
         }
+    } else if (strcmp(pool->kind, "prio_wait_split") == 0) {
+        if (!pool->access) pool->access = strdup("mpmc");
+        ABT_pool_def prio_split_pool_def;
+        margo_create_prio_split_pool_def(&prio_split_pool_def);
+        ret = ABT_pool_create(&prio_split_pool_def, ABT_POOL_CONFIG_NULL,
+                              &pool->pool);
+        if (ret != ABT_SUCCESS) {
+            margo_error(mid, "ABT_pool_create failed with error code %d", ret);
+        }
     } else if (strcmp(pool->kind, "earliest_first") == 0) {
         if (!pool->access) pool->access = strdup("mpmc");
         ABT_pool_def efirst_pool_def;
@@ -144,6 +245,74 @@ bool __margo_abt_pool_init_from_json(const json_object_t* jpool,
         if (ret != ABT_SUCCESS) {
             margo_error(mid, "ABT_pool_create failed with error code %d", ret);
         }
+    } else if (strcmp(pool->kind, "edf_wait") == 0) {
+        if (!pool->access) pool->access = strdup("mpmc");
+        ABT_pool_def edf_pool_def;
+        margo_create_edf_pool_def(&edf_pool_def);
+        ret = ABT_pool_create(&edf_pool_def, ABT_POOL_CONFIG_NULL,
+                              &pool->pool);
+        if (ret != ABT_SUCCESS) {
+            margo_error(mid, "ABT_pool_create failed with error code %d", ret);
+        }
+    } else if (strcmp(pool->kind, "wfq_wait") == 0) {
+        if (!pool->access) pool->access = strdup("mpmc");
+        ABT_pool_def wfq_pool_def;
+        margo_create_wfq_pool_def(&wfq_pool_def);
+        ret = ABT_pool_create(&wfq_pool_def, ABT_POOL_CONFIG_NULL,
+                              &pool->pool);
+        if (ret != ABT_SUCCESS) {
+            margo_error(mid, "ABT_pool_create failed with error code %d", ret);
+        } else {
+            pool->default_weight
+                = json_object_object_get_int_or(jpool, "default_weight", 0);
+            if (pool->default_weight)
+                margo_wfq_pool_set_default_weight(pool->pool,
+                                                  pool->default_weight);
+            json_object_t* jweights = json_object_object_get(jpool, "weights");
+            if (jweights) {
+                pool->weights = json_object_get(jweights);
+                json_object_object_foreach(jweights, provider_str, jweight) {
+                    margo_wfq_pool_set_weight(pool->pool, atoi(provider_str),
+                                              json_object_get_int(jweight));
+                }
+            }
+        }
+    } else if (strcmp(pool->kind, "ws_wait") == 0) {
+        if (!pool->access) pool->access = strdup("mpmc");
+        ABT_pool_def ws_pool_def;
+        margo_create_ws_pool_def(&ws_pool_def);
+        ret = ABT_pool_create(&ws_pool_def, ABT_POOL_CONFIG_NULL, &pool->pool);
+        if (ret != ABT_SUCCESS) {
+            margo_error(mid, "ABT_pool_create failed with error code %d", ret);
+        }
+    } else if (strcmp(pool->kind, "mlfq_wait") == 0) {
+        if (!pool->access) pool->access = strdup("mpmc");
+        ABT_pool_def mlfq_pool_def;
+        margo_create_mlfq_pool_def(&mlfq_pool_def);
+        ret = ABT_pool_create(&mlfq_pool_def, ABT_POOL_CONFIG_NULL,
+                              &pool->pool);
+        if (ret != ABT_SUCCESS) {
+            margo_error(mid, "ABT_pool_create failed with error code %d", ret);
+        } else {
+            margo_mlfq_params_t params;
+            margo_mlfq_params_init(&params);
+            json_object_t* jlevels = json_object_object_get(jpool, "levels");
+            if (jlevels) {
+                params.num_levels = json_object_array_length(jlevels);
+                for (unsigned i = 0; i < params.num_levels; i++) {
+                    json_object_t* jlevel
+                        = json_object_array_get_idx(jlevels, i);
+                    params.levels[i].quantum
+                        = json_object_object_get_int_or(jlevel, "quantum", 1);
+                    params.levels[i].demote_after
+                        = json_object_object_get_int_or(jlevel, "demote_after",
+                                                        0);
+                }
+            }
+            params.boost_period_ms = json_object_object_get_int_or(
+                jpool, "boost_period_ms", params.boost_period_ms);
+            margo_mlfq_pool_set_params(pool->pool, &params);
+        }
     } else {
         // custom pool definition, not supported for now
         margo_error(mid,
@@ -158,6 +327,18 @@ bool __margo_abt_pool_init_from_json(const json_object_t* jpool,
         return false;
     }
 
+    int num_workers = json_object_object_get_int_or(jpool, "workers", 0);
+    if (num_workers > 0) {
+        pool->workers = __margo_rpc_workers_create(pool->pool, num_workers);
+        if (!pool->workers) {
+            __margo_abt_pool_destroy(pool, abt);
+            return false;
+        }
+    }
+
+    pool->max_queue_depth
+        = json_object_object_get_int_or(jpool, "max_queue_depth", 0);
+
     pool->margo_free_flag = true;
 
     return true;
@@ -186,11 +367,47 @@ json_object_t* __margo_abt_pool_to_json(const margo_abt_pool_t* p)
     if (p->access)
         json_object_object_add_ex(jpool, "access",
                                   json_object_new_string(p->access), flags);
+    if (p->workers)
+        json_object_object_add_ex(
+            jpool, "workers", json_object_new_uint64(p->workers->num_workers),
+            flags);
+    if (p->max_queue_depth)
+        json_object_object_add_ex(jpool, "max_queue_depth",
+                                  json_object_new_uint64(p->max_queue_depth),
+                                  flags);
+    if (p->default_weight)
+        json_object_object_add_ex(jpool, "default_weight",
+                                  json_object_new_uint64(p->default_weight),
+                                  flags);
+    if (p->weights)
+        json_object_object_add_ex(jpool, "weights", json_object_get(p->weights),
+                                  flags);
+    if (p->kind && strcmp(p->kind, "mlfq_wait") == 0) {
+        margo_mlfq_params_t params;
+        margo_mlfq_pool_get_params(p->pool, &params);
+        json_object_t* jlevels = json_object_new_array_ext(params.num_levels);
+        for (unsigned i = 0; i < params.num_levels; i++) {
+            json_object_t* jlevel = json_object_new_object();
+            json_object_object_add_ex(
+                jlevel, "quantum",
+                json_object_new_uint64(params.levels[i].quantum), flags);
+            json_object_object_add_ex(
+                jlevel, "demote_after",
+                json_object_new_uint64(params.levels[i].demote_after), flags);
+            json_object_array_add(jlevels, jlevel);
+        }
+        json_object_object_add_ex(jpool, "levels", jlevels, flags);
+        json_object_object_add_ex(
+            jpool, "boost_period_ms",
+            json_object_new_uint64(params.boost_period_ms), flags);
+    }
     return jpool;
 }
 
 void __margo_abt_pool_destroy(margo_abt_pool_t* p, const margo_abt_t* abt)
 {
+    __margo_rpc_workers_free(p->workers);
+    json_object_put(p->weights);
     free(p->kind);
     free(p->access);
     free((char*)p->name);
@@ -657,6 +874,8 @@ bool __margo_abt_xstream_init_from_json(const json_object_t* jxstream,
             = &((margo_abt_pool_t*)abt->pools)[pool_idx];
         pool_entry->num_xstreams += 1;
         if (xstream_is_primary) pool_entry->used_by_primary = true;
+        /* the pool now has an ES to run its RPC workers */
+        if (pool_entry->workers) __margo_rpc_workers_start(pool_entry->workers);
     }
 
     if (ret == ABT_SUCCESS) {
@@ -733,6 +952,8 @@ bool __margo_abt_xstream_init_external(const char*          name,
             = &((margo_abt_pool_t*)abt->pools)[pool_idx];
         pool_entry->num_xstreams += 1;
         if (xstream_is_primary) pool_entry->used_by_primary = true;
+        /* the pool now has an ES to run its RPC workers */
+        if (pool_entry->workers) __margo_rpc_workers_start(pool_entry->workers);
     }
 
     return true;
@@ -838,6 +1059,10 @@ void __margo_abt_xstream_destroy(margo_abt_xstream_t* x, const margo_abt_t* abt)
             }
             margo_abt_pool_t* pool_entry
                 = &((margo_abt_pool_t*)abt->pools)[pool_idx];
+            /* RPC workers need an ES to exit, so they are stopped while
+             * the last ES running their pool is still there */
+            if (pool_entry->num_xstreams == 1 && pool_entry->workers)
+                __margo_rpc_workers_stop(pool_entry->workers);
             pool_entry->num_xstreams -= 1;
         }
     }
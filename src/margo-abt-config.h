@@ -15,7 +15,12 @@
 #include "margo.h"
 #include "margo-globals.h"
 #include "margo-prio-pool.h"
+#include "margo-prio-split-pool.h"
 #include "margo-efirst-pool.h"
+#include "margo-wfq-pool.h"
+#include "margo-mlfq-pool.h"
+#include "margo-ws-pool.h"
+#include "margo-rpc-workers.h"
 #include "margo-logging.h"
 #include "margo-macros.h"
 #include "margo-abt-macros.h"
@@ -61,6 +66,10 @@ typedef struct margo_abt_pool {
     bool margo_free_flag; /* flag if Margo is responsible for freeing */
     bool used_by_primary; /* flag indicating the this pool is used by the
                              primary ES */
+    struct margo_rpc_workers* workers; /* pre-spawned RPC workers, if any */
+    unsigned max_queue_depth; /* RPCs are rejected beyond it, 0 if none */
+    unsigned default_weight;  /* "wfq_wait" pools only, 0 if not set */
+    json_object_t* weights;   /* "wfq_wait" pools only, provider id -> weight */
 } margo_abt_pool_t;
 
 bool __margo_abt_pool_validate_json(const json_object_t* config,
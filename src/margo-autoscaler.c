@@ -0,0 +1,358 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "margo-instance.h"
+#include "margo-abt-config.h"
+#include "margo-macros.h"
+#include "margo-autoscaler.h"
+
+#define AUTOSCALER_MUTEX(a) ABT_MUTEX_MEMORY_GET_HANDLE(&(a)->mtx)
+#define AUTOSCALER_COND(a)  ABT_COND_MEMORY_GET_HANDLE(&(a)->cond)
+
+/* number of consecutive idle samples before removing an ES */
+#define AUTOSCALER_SHRINK_SAMPLES 5
+
+static void autoscaler_xstream_name(const margo_autoscaler_t* a,
+                                    unsigned                  i,
+                                    char*                     name,
+                                    size_t                    size)
+{
+    snprintf(name, size, "__autoscaled_%s_%u__", a->pool_name, i);
+}
+
+static unsigned autoscaler_num_xstreams(const margo_autoscaler_t* a)
+{
+    margo_instance_id mid = a->mid;
+    unsigned          n   = 0;
+    __margo_abt_lock(mid->abt);
+    int idx = __margo_abt_find_pool_by_handle(mid->abt, a->pool);
+    if (idx >= 0) n = mid->abt->pools[idx].num_xstreams;
+    __margo_abt_unlock(mid->abt);
+    return n;
+}
+
+/* Remembers the index of an ES added by the autoscaler */
+static bool autoscaler_push_added(margo_autoscaler_t* a, unsigned i)
+{
+    if (a->num_added == a->added_cap) {
+        unsigned  cap   = a->added_cap ? 2 * a->added_cap : 8;
+        unsigned* added = realloc(a->added, cap * sizeof(*added));
+        if (!added) return false;
+        a->added     = added;
+        a->added_cap = cap;
+    }
+    a->added[a->num_added++] = i;
+    if (i >= a->next_index) a->next_index = i + 1;
+    return true;
+}
+
+static bool autoscaler_grow(margo_autoscaler_t* a)
+{
+    margo_instance_id mid = a->mid;
+    char              name[256];
+
+    /* skip the names taken by ESs that were not added by us */
+    __margo_abt_lock(mid->abt);
+    do {
+        autoscaler_xstream_name(a, a->next_index++, name, sizeof(name));
+    } while (__margo_abt_find_xstream_by_name(mid->abt, name) >= 0);
+    __margo_abt_unlock(mid->abt);
+
+    /* the pool name may contain any character, so the configuration is
+     * built with json-c rather than formatted by hand */
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    struct json_object* json  = json_object_new_object();
+    struct json_object* sched = json_object_new_object();
+    struct json_object* pools = json_object_new_array();
+    json_object_array_add(pools, json_object_new_string(a->pool_name));
+    json_object_object_add_ex(sched, "type",
+                              json_object_new_string("basic_wait"), flags);
+    json_object_object_add_ex(sched, "pools", pools, flags);
+    json_object_object_add_ex(json, "name", json_object_new_string(name),
+                              flags);
+    json_object_object_add_ex(json, "scheduler", sched, flags);
+    hg_return_t hret = margo_add_xstream_from_json(
+        mid,
+        json_object_to_json_string_ext(
+            json, JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE),
+        NULL);
+    json_object_put(json);
+    if (hret != HG_SUCCESS) {
+        margo_error(mid, "[autoscaler] Could not add xstream %s", name);
+        return false;
+    }
+    if (!autoscaler_push_added(a, a->next_index - 1)) {
+        /* we could not keep track of it, so it is not ours to remove */
+        margo_error(mid, "[autoscaler] Could not record xstream %s", name);
+        return false;
+    }
+    margo_debug(mid, "[autoscaler] Added xstream %s", name);
+    return true;
+}
+
+static bool autoscaler_shrink(margo_autoscaler_t* a)
+{
+    margo_instance_id mid  = a->mid;
+    ABT_xstream       self = ABT_XSTREAM_NULL;
+    char              name[256];
+    ABT_self_get_xstream(&self);
+
+    while (a->num_added > 0) {
+        autoscaler_xstream_name(a, a->added[a->num_added - 1], name,
+                                sizeof(name));
+
+        __margo_abt_lock(mid->abt);
+        int  idx     = __margo_abt_find_xstream_by_name(mid->abt, name);
+        bool is_self = idx >= 0 && mid->abt->xstreams[idx].xstream == self;
+        __margo_abt_unlock(mid->abt);
+
+        if (idx < 0) {
+            /* removed by someone else, forget about it */
+            margo_debug(mid, "[autoscaler] Xstream %s is already gone", name);
+            a->num_added--;
+            continue;
+        }
+        /* the controller may be running on the ES it is about to remove if
+         * the progress pool is also the autoscaled pool, in which case we
+         * retry at the next sample, hopefully from another ES */
+        if (is_self) return false;
+
+        hg_return_t hret = margo_remove_xstream_by_name(mid, name);
+        if (hret != HG_SUCCESS) {
+            margo_error(mid, "[autoscaler] Could not remove xstream %s",
+                        name);
+            return false;
+        }
+        a->num_added--;
+        margo_debug(mid, "[autoscaler] Removed xstream %s", name);
+        return true;
+    }
+    return false;
+}
+
+static void autoscaler_probe_fn(void* arg)
+{
+    struct margo_autoscaler_probe* probe = (struct margo_autoscaler_probe*)arg;
+    probe->started                       = ABT_get_wtime();
+    atomic_store_explicit(&probe->has_started, true, memory_order_release);
+}
+
+/* Returns the queueing latency (in seconds) observed by the current probe,
+ * or by the one still waiting to run, and posts a new probe if needed */
+static double autoscaler_sample_latency(margo_autoscaler_t* a)
+{
+    struct margo_autoscaler_probe* probe   = &a->probe;
+    double                         latency = 0.0;
+    if (probe->thread != ABT_THREAD_NULL) {
+        if (!atomic_load_explicit(&probe->has_started, memory_order_acquire))
+            return ABT_get_wtime() - probe->posted;
+        latency = probe->started - probe->posted;
+        ABT_thread_free(&probe->thread);
+        probe->thread = ABT_THREAD_NULL;
+    }
+    probe->has_started = false;
+    probe->posted      = ABT_get_wtime();
+    int ret = ABT_thread_create(a->pool, autoscaler_probe_fn, probe,
+                                ABT_THREAD_ATTR_NULL, &probe->thread);
+    if (ret != ABT_SUCCESS) probe->thread = ABT_THREAD_NULL;
+    return latency;
+}
+
+static void autoscaler_step(margo_autoscaler_t* a)
+{
+    double   target  = a->target_latency_ms / 1000.0;
+    double   latency = autoscaler_sample_latency(a);
+    size_t   depth   = 0;
+    unsigned num_es  = autoscaler_num_xstreams(a);
+    ABT_pool_get_size(a->pool, &depth);
+    a->last_latency_ms = latency * 1000.0;
+
+    if (num_es < a->min_xstreams) {
+        a->num_low_samples = 0;
+        autoscaler_grow(a);
+    } else if (latency > target) {
+        a->num_low_samples = 0;
+        if (num_es < a->max_xstreams) autoscaler_grow(a);
+    } else if (latency < target / 2 && depth == 0) {
+        /* only the ESs we added are candidates for removal */
+        if (++a->num_low_samples >= AUTOSCALER_SHRINK_SAMPLES
+            && num_es > a->min_xstreams && a->num_added > 0) {
+            if (autoscaler_shrink(a)) a->num_low_samples = 0;
+        }
+    } else {
+        a->num_low_samples = 0;
+    }
+}
+
+static void autoscaler_fn(void* arg)
+{
+    margo_autoscaler_t* a = (margo_autoscaler_t*)arg;
+
+    ABT_mutex_lock(AUTOSCALER_MUTEX(a));
+    while (!a->stopping) {
+        ABT_mutex_unlock(AUTOSCALER_MUTEX(a));
+        autoscaler_step(a);
+        ABT_mutex_lock(AUTOSCALER_MUTEX(a));
+        if (a->stopping) break;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += a->sample_interval_ms / 1000;
+        deadline.tv_nsec += (a->sample_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        ABT_cond_timedwait(AUTOSCALER_COND(a), AUTOSCALER_MUTEX(a),
+                           &deadline);
+    }
+    ABT_mutex_unlock(AUTOSCALER_MUTEX(a));
+}
+
+bool __margo_autoscaler_validate_json(const struct json_object* config)
+{
+    struct json_object* ignore = NULL;
+    if (!config) return true;
+
+#define HANDLE_CONFIG_ERROR return false
+
+    /* Fields:
+       - [optional] min_xstreams: integer >= 1 (default 1)
+       - [optional] max_xstreams: integer >= min_xstreams (default 8, or
+                    min_xstreams if larger)
+       - [optional] target_latency_ms: integer > 0 (default 10)
+       - [optional] sample_interval_ms: integer > 0 (default 100)
+    */
+
+    if (!json_object_is_type(config, json_type_object)) {
+        margo_error(0, "\"autoscaler\" field in configuration "
+                       "should be an object");
+        HANDLE_CONFIG_ERROR;
+    }
+
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "min_xstreams", int, "autoscaler");
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "max_xstreams", int, "autoscaler");
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "target_latency_ms", int, "autoscaler");
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "sample_interval_ms", int,
+                               "autoscaler");
+
+    int min_xstreams = json_object_object_get_int_or(config, "min_xstreams", 1);
+    int max_xstreams = json_object_object_get_int_or(
+        config, "max_xstreams", min_xstreams > 8 ? min_xstreams : 8);
+    if (min_xstreams < 1) {
+        margo_error(0, "\"autoscaler.min_xstreams\" should be at least 1");
+        HANDLE_CONFIG_ERROR;
+    }
+    if (max_xstreams < min_xstreams) {
+        margo_error(0,
+                    "\"autoscaler.max_xstreams\" should be greater than or "
+                    "equal to \"autoscaler.min_xstreams\"");
+        HANDLE_CONFIG_ERROR;
+    }
+    if (CONFIG_HAS(config, "target_latency_ms", ignore)
+        && json_object_get_int(ignore) <= 0) {
+        margo_error(0, "\"autoscaler.target_latency_ms\" should be positive");
+        HANDLE_CONFIG_ERROR;
+    }
+    if (CONFIG_HAS(config, "sample_interval_ms", ignore)
+        && json_object_get_int(ignore) <= 0) {
+        margo_error(0, "\"autoscaler.sample_interval_ms\" should be positive");
+        HANDLE_CONFIG_ERROR;
+    }
+
+    return true;
+#undef HANDLE_CONFIG_ERROR
+}
+
+margo_autoscaler_t* __margo_autoscaler_create(margo_instance_id         mid,
+                                              const struct json_object* config)
+{
+    margo_autoscaler_t* a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+    /* like the other ABT_mutex_memory/ABT_cond_memory in margo, the mutex
+     * and condition variable are statically initialized by calloc */
+    a->mid       = mid;
+    a->pool      = MARGO_RPC_POOL(mid);
+    a->pool_name = strdup(mid->abt->pools[mid->rpc_pool_idx].name);
+    a->min_xstreams
+        = json_object_object_get_int_or(config, "min_xstreams", 1);
+    a->max_xstreams = json_object_object_get_int_or(
+        config, "max_xstreams", a->min_xstreams > 8 ? a->min_xstreams : 8);
+    a->target_latency_ms
+        = json_object_object_get_int_or(config, "target_latency_ms", 10);
+    a->sample_interval_ms
+        = json_object_object_get_int_or(config, "sample_interval_ms", 100);
+    a->probe.thread = ABT_THREAD_NULL;
+    a->ult          = ABT_THREAD_NULL;
+    if (!a->pool_name) goto error;
+
+    /* pick up the ESs added by a previous instance whose configuration
+     * (obtained from margo_get_config) was used to initialize this one */
+    __margo_abt_lock(mid->abt);
+    bool picked_up = true;
+    for (unsigned i = 0; picked_up; i++) {
+        char name[256];
+        autoscaler_xstream_name(a, i, name, sizeof(name));
+        if (__margo_abt_find_xstream_by_name(mid->abt, name) < 0) break;
+        picked_up = autoscaler_push_added(a, i);
+    }
+    __margo_abt_unlock(mid->abt);
+    if (!picked_up) goto error;
+
+    while (autoscaler_num_xstreams(a) < a->min_xstreams)
+        if (!autoscaler_grow(a)) goto error;
+
+    int ret = ABT_thread_create(MARGO_PROGRESS_POOL(mid), autoscaler_fn, a,
+                                ABT_THREAD_ATTR_NULL, &a->ult);
+    if (ret != ABT_SUCCESS) {
+        a->ult = ABT_THREAD_NULL;
+        goto error;
+    }
+    return a;
+
+error:
+    __margo_autoscaler_free(a);
+    return NULL;
+}
+
+struct json_object* __margo_autoscaler_to_json(const margo_autoscaler_t* a)
+{
+    struct json_object* json = json_object_new_object();
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    json_object_object_add_ex(json, "min_xstreams",
+                              json_object_new_uint64(a->min_xstreams), flags);
+    json_object_object_add_ex(json, "max_xstreams",
+                              json_object_new_uint64(a->max_xstreams), flags);
+    json_object_object_add_ex(json, "target_latency_ms",
+                              json_object_new_uint64(a->target_latency_ms),
+                              flags);
+    json_object_object_add_ex(json, "sample_interval_ms",
+                              json_object_new_uint64(a->sample_interval_ms),
+                              flags);
+    return json;
+}
+
+void __margo_autoscaler_free(margo_autoscaler_t* a)
+{
+    if (!a) return;
+    if (a->ult != ABT_THREAD_NULL) {
+        ABT_mutex_lock(AUTOSCALER_MUTEX(a));
+        a->stopping = true;
+        ABT_cond_signal(AUTOSCALER_COND(a));
+        ABT_mutex_unlock(AUTOSCALER_MUTEX(a));
+        ABT_thread_join(a->ult);
+        ABT_thread_free(&a->ult);
+    }
+    if (a->probe.thread != ABT_THREAD_NULL) {
+        ABT_thread_join(a->probe.thread);
+        ABT_thread_free(&a->probe.thread);
+    }
+    free(a->pool_name);
+    free(a->added);
+    free(a);
+}
@@ -0,0 +1,62 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __MARGO_AUTOSCALER_H
+#define __MARGO_AUTOSCALER_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <abt.h>
+#include <json-c/json.h>
+#include "margo.h"
+
+/* Controller adding and removing execution streams running a pool (see
+ * "autoscaler" in the margo configuration). A ULT in the progress pool
+ * periodically measures the queueing latency of the pool by pushing a probe
+ * ULT into it and timing how long it takes to start. An ES is added when the
+ * latency exceeds the target, and one of the ESs added by the controller is
+ * removed when the pool has been idle and well below the target for
+ * AUTOSCALER_SHRINK_SAMPLES consecutive samples. ESs added by the
+ * controller are named "__autoscaled_<pool>_<n>__". */
+typedef struct margo_autoscaler {
+    margo_instance_id mid;
+    char*             pool_name;
+    ABT_pool          pool;
+    unsigned          min_xstreams;
+    unsigned          max_xstreams;
+    unsigned          target_latency_ms;
+    unsigned          sample_interval_ms;
+    unsigned*         added;           /* indices of the ESs added by us */
+    unsigned          num_added;       /* number of ESs in added */
+    unsigned          added_cap;       /* capacity of added */
+    unsigned          next_index;      /* index of the next ES to add */
+    unsigned          num_low_samples; /* consecutive idle samples */
+    double            last_latency_ms;
+    struct margo_autoscaler_probe {
+        ABT_thread    thread; /* ABT_THREAD_NULL if no probe is pending */
+        double        posted;
+        double        started;
+        _Atomic bool  has_started;
+    } probe;
+    ABT_thread       ult;
+    bool             stopping;
+    ABT_mutex_memory mtx;
+    ABT_cond_memory  cond;
+} margo_autoscaler_t;
+
+bool __margo_autoscaler_validate_json(const struct json_object* config);
+
+/* Creates the autoscaler described by the configuration and starts its
+ * controller ULT in the progress pool. */
+margo_autoscaler_t* __margo_autoscaler_create(margo_instance_id         mid,
+                                              const struct json_object* config);
+
+struct json_object* __margo_autoscaler_to_json(const margo_autoscaler_t* a);
+
+/* Stops the controller (the ESs it added are left in place) and frees the
+ * structure. */
+void __margo_autoscaler_free(margo_autoscaler_t* a);
+
+#endif
@@ -12,6 +12,7 @@
 #include <abt.h>
 
 #include "margo.h"
+#include "margo-instance.h"
 #include "margo-bulk-pool.h"
 
 struct margo_bulk_pool {
@@ -54,14 +55,16 @@ hg_return_t margo_bulk_pool_create(margo_instance_id  mid,
         goto err;
     }
 
-    p = malloc(sizeof(*p));
+    p = calloc(1, sizeof(*p));
     if (p == NULL) {
         hret = HG_NOMEM_ERROR;
         goto err;
     }
 
-    ret = posix_memalign(&p->buf, 4096, size * count);
-    if (ret != 0) {
+    /* page-aligned, and hugepage-backed or NUMA-bound according to the
+     * instance's memory policy */
+    p->buf = __margo_memory_alloc(&mid->memory, size * count);
+    if (p->buf == NULL) {
         hret = HG_NOMEM_ERROR;
         goto err;
     }
@@ -108,7 +111,7 @@ err:
                 margo_bulk_free(p->bulks[i]);
             free(p->bulks);
         }
-        if (p->buf != NULL) free(p->buf);
+        __margo_memory_free(&mid->memory, p->buf, size * count);
         free(p);
     }
     *pool = NULL;
@@ -132,7 +135,8 @@ int margo_bulk_pool_destroy(margo_bulk_pool_t pool)
 
     for (i = 0; i < pool->count; i++) { margo_bulk_free(pool->bulks[i]); }
     free(pool->bulks);
-    free(pool->buf);
+    __margo_memory_free(&pool->mid->memory, pool->buf,
+                        pool->size * pool->count);
     free(pool);
 
     return 0;
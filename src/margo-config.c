@@ -9,6 +9,48 @@
 #include <margo-logging.h>
 #include "margo-monitoring-internal.h"
 #include "margo-instance.h"
+#include "margo-autoscaler.h"
+#include "margo-handle-cache.h"
+#include "margo-efirst-pool.h"
+#include "margo-wfq-pool.h"
+
+static struct json_object* arena_stats_to_json(mochi_arena_t arena)
+{
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    mochi_arena_stats_t stats;
+    mochi_arena_get_stats(arena, &stats);
+    struct json_object* json = json_object_new_object();
+    json_object_object_add_ex(json, "num_live",
+                              json_object_new_uint64(stats.num_live), flags);
+    json_object_object_add_ex(json, "num_free",
+                              json_object_new_uint64(stats.num_free), flags);
+    json_object_object_add_ex(json, "num_blocks",
+                              json_object_new_uint64(stats.num_blocks), flags);
+    json_object_object_add_ex(json, "peak_num_blocks",
+                              json_object_new_uint64(stats.peak_num_blocks),
+                              flags);
+    json_object_object_add_ex(
+        json, "num_trimmed_blocks",
+        json_object_new_uint64(stats.num_trimmed_blocks), flags);
+    json_object_object_add_ex(json, "num_full",
+                              json_object_new_uint64(stats.num_full), flags);
+    json_object_object_add_ex(json, "objects_per_block",
+                              json_object_new_uint64(stats.objects_per_block),
+                              flags);
+    return json;
+}
+
+struct json_object* __margo_arenas_stats_to_json(margo_instance_id mid)
+{
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    struct json_object* json = json_object_new_object();
+    json_object_object_add_ex(json, "requests",
+                              arena_stats_to_json(mid->request_arena), flags);
+    json_object_object_add_ex(json, "handle_data",
+                              arena_stats_to_json(mid->handle_data_arena),
+                              flags);
+    return json;
+}
 
 char* margo_get_config(margo_instance_id mid)
 {
@@ -72,10 +114,85 @@ char* margo_get_config_opt(margo_instance_id mid, int options)
     json_object_object_add_ex(
         root, "progress_spindown_msec",
         json_object_new_uint64(mid->hg_progress_spindown_msec), flags);
+    // progress_trigger_batch_size
+    json_object_object_add_ex(
+        root, "progress_trigger_batch_size",
+        json_object_new_uint64(mid->hg_progress_trigger_batch), flags);
+    // progress_policy
+    json_object_object_add_ex(
+        root, "progress_policy",
+        json_object_new_string(
+            mid->hg_progress_policy == MARGO_PROGRESS_POLICY_ADAPTIVE
+                ? "adaptive"
+                : "spindown"),
+        flags);
+    // progress_policy_state (current decisions of the adaptive policy)
+    if (mid->hg_progress_policy == MARGO_PROGRESS_POLICY_ADAPTIVE) {
+        static const char* const state_names[] = {"spin", "poll", "block"};
+        struct margo_adaptive_progress* ap = &mid->hg_progress_adaptive;
+        struct json_object* _state         = json_object_new_object();
+        /* written by the progress loop while we read them */
+        int    state = atomic_load_explicit(&ap->state, memory_order_relaxed);
+        double gap_ewma
+            = atomic_load_explicit(&ap->arrival_gap_ewma, memory_order_relaxed);
+        double yield_ewma
+            = atomic_load_explicit(&ap->yield_ewma, memory_order_relaxed);
+        json_object_object_add_ex(
+            _state, "state", json_object_new_string(state_names[state]),
+            flags);
+        json_object_object_add_ex(_state, "arrival_gap_ewma_usec",
+                                  json_object_new_double(gap_ewma * 1e6),
+                                  flags);
+        json_object_object_add_ex(_state, "yield_ewma",
+                                  json_object_new_double(yield_ewma), flags);
+        json_object_object_add_ex(root, "progress_policy_state", _state,
+                                  flags);
+    }
     // handle_cache_size
     json_object_object_add_ex(root, "handle_cache_size",
                               json_object_new_uint64(mid->handle_cache_size),
                               flags);
+    // handle_cache_tuning (only added if enabled)
+    struct json_object* _tuning = __margo_handle_cache_tuning_to_json(mid);
+    if (_tuning)
+        json_object_object_add_ex(root, "handle_cache_tuning", _tuning, flags);
+    // handle_cache_affinity_size (only added if enabled)
+    if (mid->handle_cache_affinity_size)
+        json_object_object_add_ex(
+            root, "handle_cache_affinity_size",
+            json_object_new_uint64(mid->handle_cache_affinity_size), flags);
+    // progress_contexts (only added if there is more than one, since
+    // instances with a parent cannot have this field)
+    if (mid->num_progress_contexts)
+        json_object_object_add_ex(
+            root, "progress_contexts",
+            json_object_new_uint64(mid->num_progress_contexts + 1), flags);
+    // autoscaler
+    if (mid->autoscaler)
+        json_object_object_add_ex(
+            root, "autoscaler", __margo_autoscaler_to_json(mid->autoscaler),
+            flags);
+    // arenas (only added if configured) and their current usage
+    if (mid->arena_max_objects || mid->arena_wait_when_full
+        || mid->arena_trim_interval_ms) {
+        struct json_object* _arenas = json_object_new_object();
+        if (mid->arena_max_objects)
+            json_object_object_add_ex(
+                _arenas, "max_objects",
+                json_object_new_uint64(mid->arena_max_objects), flags);
+        json_object_object_add_ex(
+            _arenas, "wait_when_full",
+            json_object_new_boolean(mid->arena_wait_when_full), flags);
+        json_object_object_add_ex(
+            _arenas, "trim_interval_ms",
+            json_object_new_uint64(mid->arena_trim_interval_ms), flags);
+        json_object_object_add_ex(root, "arenas", _arenas, flags);
+        json_object_object_add_ex(root, "arenas_state",
+                                  __margo_arenas_stats_to_json(mid), flags);
+    }
+    // memory policy (only added if not the default)
+    struct json_object* _memory = __margo_memory_policy_to_json(&mid->memory);
+    if (_memory) json_object_object_add_ex(root, "memory", _memory, flags);
     // abt profiling
     json_object_object_add_ex(
         root, "enable_abt_profiling",
@@ -983,15 +1100,129 @@ hg_return_t margo_remove_xstream_by_handle(margo_instance_id mid,
     return ret;
 }
 
+#define REBALANCE_BATCH_SIZE 64
+
+/* unit metadata that can be carried over when moving ULTs between two pools
+ * of the same kind while preserving their order */
+typedef enum
+{
+    REBALANCE_CARRY_NONE,
+    REBALANCE_CARRY_DEADLINE, /* edf_wait */
+    REBALANCE_CARRY_KEY       /* wfq_wait */
+} rebalance_carry_t;
+
+/* Moves up to max_num ULTs (or all of them if drain is true) from origin to
+ * target in batches of at most batch_size, yielding between batches */
+static size_t rebalance_pools(ABT_pool          origin_pool,
+                              ABT_pool          target_pool,
+                              size_t            max_num,
+                              bool              drain,
+                              size_t            batch_size,
+                              bool              preserve_order,
+                              rebalance_carry_t carry)
+{
+    ABT_thread threads[REBALANCE_BATCH_SIZE];
+    size_t     moved = 0;
+    if (batch_size == 0 || batch_size > REBALANCE_BATCH_SIZE)
+        batch_size = REBALANCE_BATCH_SIZE;
+
+    while (drain || moved < max_num) {
+        size_t num = drain || max_num - moved > batch_size ? batch_size
+                                                           : max_num - moved;
+        ABT_pool_pop_threads(origin_pool, threads, num, &num);
+        if (num == 0) break;
+        if (!preserve_order) {
+            ABT_pool_push_threads(target_pool, threads, num);
+        } else {
+            /* the hints belong to the ES, and may have been set by the
+             * caller, so they are restored before yielding */
+            double prev_deadline = margo_edf_pool_get_next_deadline();
+            int    prev_key      = margo_wfq_pool_get_next_key();
+            for (size_t i = 0; i < num; i++) {
+                /* the thread is still attached to its unit in the origin
+                 * pool until it is pushed into the target pool */
+                ABT_unit unit = ABT_UNIT_NULL;
+                if (carry != REBALANCE_CARRY_NONE)
+                    ABT_thread_get_unit(threads[i], &unit);
+                if (carry == REBALANCE_CARRY_DEADLINE)
+                    margo_edf_pool_set_next_deadline(
+                        margo_edf_pool_get_unit_deadline(unit));
+                else if (carry == REBALANCE_CARRY_KEY)
+                    margo_wfq_pool_set_next_key(
+                        margo_wfq_pool_get_unit_key(unit));
+                ABT_pool_push_thread(target_pool, threads[i]);
+            }
+            margo_edf_pool_set_next_deadline(prev_deadline);
+            margo_wfq_pool_set_next_key(prev_key);
+        }
+        moved += num;
+        /* let other ULTs (including the moved ones) run; this fails
+         * harmlessly if the caller is not a ULT */
+        ABT_thread_yield();
+    }
+    return moved;
+}
+
 hg_return_t margo_transfer_pool_content(ABT_pool origin_pool,
                                         ABT_pool target_pool)
 {
-    while (1) {
-        ABT_thread threads[64];
-        size_t     num = 0;
-        ABT_pool_pop_threads(origin_pool, threads, 64, &num);
-        if (num == 0) break;
-        ABT_pool_push_threads(target_pool, threads, num);
+    rebalance_pools(origin_pool, target_pool, 0, true, REBALANCE_BATCH_SIZE,
+                    false, REBALANCE_CARRY_NONE);
+    return HG_SUCCESS;
+}
+
+hg_return_t
+margo_rebalance_pools(margo_instance_id                     mid,
+                      ABT_pool                              origin_pool,
+                      ABT_pool                              target_pool,
+                      const struct margo_rebalance_options* options,
+                      size_t*                               num_moved)
+{
+    struct margo_rebalance_options opts = MARGO_REBALANCE_OPTIONS_DEFAULT;
+    if (num_moved) *num_moved = 0;
+    if (!mid) return HG_INVALID_ARG;
+    if (options) opts = *options;
+    if (!(opts.fraction > 0.0 && opts.fraction <= 1.0)) {
+        margo_error(mid, "Invalid fraction (%f) in margo_rebalance_pools",
+                    opts.fraction);
+        return HG_INVALID_ARG;
+    }
+
+    /* both pools must belong to the instance */
+    __margo_abt_lock(mid->abt);
+    int origin_idx = __margo_abt_find_pool_by_handle(mid->abt, origin_pool);
+    int target_idx = __margo_abt_find_pool_by_handle(mid->abt, target_pool);
+    rebalance_carry_t carry = REBALANCE_CARRY_NONE;
+    if (origin_idx >= 0 && target_idx >= 0 && origin_idx != target_idx) {
+        const char* origin_kind = mid->abt->pools[origin_idx].kind;
+        const char* target_kind = mid->abt->pools[target_idx].kind;
+        if (origin_kind && target_kind
+            && strcmp(origin_kind, target_kind) == 0) {
+            if (strcmp(origin_kind, "edf_wait") == 0)
+                carry = REBALANCE_CARRY_DEADLINE;
+            else if (strcmp(origin_kind, "wfq_wait") == 0)
+                carry = REBALANCE_CARRY_KEY;
+        }
+    }
+    __margo_abt_unlock(mid->abt);
+    if (origin_idx < 0 || target_idx < 0 || origin_idx == target_idx) {
+        margo_error(mid, "Invalid pools passed to margo_rebalance_pools");
+        return HG_INVALID_ARG;
     }
+
+    size_t size = 0;
+    ABT_pool_get_size(origin_pool, &size);
+    /* rounded up, without libm */
+    size_t max_num = (size_t)(opts.fraction * size);
+    if ((double)max_num < opts.fraction * size) max_num++;
+    bool   drain   = opts.fraction == 1.0;
+
+    size_t moved
+        = rebalance_pools(origin_pool, target_pool, max_num, drain,
+                          opts.batch_size, opts.preserve_order,
+                          opts.preserve_order ? carry : REBALANCE_CARRY_NONE);
+    margo_debug(mid, "Moved %zu ULTs from pool %d to pool %d", moved,
+                origin_idx, target_idx);
+    if (num_moved) *num_moved = moved;
     return HG_SUCCESS;
 }
@@ -18,11 +18,15 @@
 #include "margo-progress.h"
 #include "margo-monitoring-internal.h"
 #include "margo-handle-cache.h"
+#include "margo-cq.h"
 #include "margo-logging.h"
 #include "margo-instance.h"
 #include "margo-bulk-util.h"
 #include "margo-timer-private.h"
 #include "margo-serialization.h"
+#include "margo-efirst-pool.h"
+#include "margo-wfq-pool.h"
+#include "margo-autoscaler.h"
 #include "margo-id.h"
 #include "utlist.h"
 #include "uthash.h"
@@ -57,9 +61,13 @@ static hg_id_t margo_register_internal(margo_instance_id mid,
                                        hg_rpc_cb_t       rpc_cb,
                                        ABT_pool          pool);
 
-static hg_return_t check_error_in_output(hg_handle_t out);
-static hg_return_t check_parent_id_in_input(hg_handle_t handle,
-                                            hg_id_t*    parent_id);
+// Attaches or refreshes the margo_handle_data of a handle from the
+// registration of the given RPC id
+static hg_return_t set_handle_data(hg_handle_t handle, hg_id_t id);
+
+static hg_return_t check_header_in_input(hg_handle_t handle,
+                                         hg_id_t*    parent_id,
+                                         double*     deadline);
 
 margo_instance_id margo_init(const char* addr_str,
                              int         mode,
@@ -154,6 +162,7 @@ static void margo_cleanup(margo_instance_id mid)
      * could trigger some margo_cb for forward operations that
      * have not completed yet (cancelling them) */
     MARGO_TRACE(mid, "Destroying Mercury environment");
+    __margo_destroy_progress_contexts(mid);
     __margo_hg_destroy(&(mid->hg));
 
     MARGO_TRACE(mid, "Cleaning up RPC data");
@@ -163,13 +172,6 @@ static void margo_cleanup(margo_instance_id mid)
         mid->registered_rpcs = next_rpc;
     }
 
-    /* Destroy the per-call object arenas only now: requests and handle-data can
-     * still be released into them above (margo_cb cancellations and handle
-     * destruction happen during __margo_hg_destroy). */
-    MARGO_TRACE(mid, "Destroying per-call object arenas");
-    mochi_arena_destroy(mid->request_arena);
-    mochi_arena_destroy(mid->handle_data_arena);
-
     /* shut down pending timers */
     MARGO_TRACE(mid, "Cleaning up pending timers");
     __margo_timer_list_free(mid);
@@ -186,6 +188,16 @@ static void margo_cleanup(margo_instance_id mid)
         mid->monitor->finalize(mid->monitor->uargs);
     free(mid->monitor);
 
+    /* Destroy the per-call object arenas only now: requests and handle-data can
+     * still be released into them above (margo_cb cancellations and handle
+     * destruction happen during __margo_hg_destroy), and the monitor reports
+     * their usage when finalized. */
+    MARGO_TRACE(mid, "Destroying per-call object arenas");
+    mochi_arena_destroy(mid->request_arena);
+    mochi_arena_destroy(mid->handle_data_arena);
+    __margo_memory_policy_finalize(&mid->memory);
+    __margo_handle_cache_free_counters(mid);
+
     free(mid->plumber_bucket_policy);
     free(mid->plumber_nic_policy);
 
@@ -276,6 +288,20 @@ void margo_finalize(margo_instance_id mid)
     /* monitoring */
     __MARGO_MONITOR(mid, FN_END, prefinalize, monitoring_args);
 
+    /* stop the autoscaler (the ESs it added are destroyed with the others) */
+    __margo_autoscaler_free(mid->autoscaler);
+    mid->autoscaler = NULL;
+
+    /* stop resizing the handle cache */
+    __margo_handle_cache_stop_tuning(mid);
+
+    /* stop trimming the arenas */
+    if (mid->arena_trim_timer) {
+        margo_timer_cancel(mid->arena_trim_timer);
+        margo_timer_destroy(mid->arena_trim_timer);
+        mid->arena_trim_timer = NULL;
+    }
+
     /* tell progress thread to wrap things up */
     mid->hg_progress_shutdown_flag = 1;
     PROGRESS_NEEDED_INCR(mid);
@@ -284,6 +310,10 @@ void margo_finalize(margo_instance_id mid)
     MARGO_TRACE(mid, "Waiting for progress thread to complete");
     ABT_thread_join(mid->hg_progress_tid);
     ABT_thread_free(&mid->hg_progress_tid);
+    for (unsigned i = 0; i < mid->num_progress_contexts; i++) {
+        ABT_thread_join(mid->progress_contexts[i].tid);
+        ABT_thread_free(&mid->progress_contexts[i].tid);
+    }
     PROGRESS_NEEDED_DECR(mid);
     mid->refcount--;
 
@@ -669,6 +699,57 @@ hg_return_t margo_registered_disabled_response(margo_instance_id mid,
     return HG_SUCCESS;
 }
 
+hg_return_t margo_registered_set_inline(margo_instance_id   mid,
+                                        hg_id_t             id,
+                                        margo_inline_mode_t mode)
+{
+    if (mid == MARGO_INSTANCE_NULL) return HG_INVALID_ARG;
+    if (mode != MARGO_INLINE_NONE && mode != MARGO_INLINE_TRIGGER
+        && mode != MARGO_INLINE_TASK)
+        return HG_INVALID_ARG;
+    struct margo_rpc_data* data
+        = (struct margo_rpc_data*)HG_Registered_data(mid->hg.hg_class, id);
+    if (!data) return HG_NOENTRY;
+    data->inline_mode = mode;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_registered_get_inline(margo_instance_id    mid,
+                                        hg_id_t              id,
+                                        margo_inline_mode_t* mode)
+{
+    if (mid == MARGO_INSTANCE_NULL || !mode) return HG_INVALID_ARG;
+    struct margo_rpc_data* data
+        = (struct margo_rpc_data*)HG_Registered_data(mid->hg.hg_class, id);
+    if (!data) return HG_NOENTRY;
+    *mode = (margo_inline_mode_t)data->inline_mode;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_registered_set_max_queue_depth(margo_instance_id mid,
+                                                 hg_id_t           id,
+                                                 unsigned          max_depth)
+{
+    if (mid == MARGO_INSTANCE_NULL) return HG_INVALID_ARG;
+    struct margo_rpc_data* data
+        = (struct margo_rpc_data*)HG_Registered_data(mid->hg.hg_class, id);
+    if (!data) return HG_NOENTRY;
+    data->queue_limit.max_depth = max_depth;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_registered_get_max_queue_depth(margo_instance_id mid,
+                                                 hg_id_t           id,
+                                                 unsigned*         max_depth)
+{
+    if (mid == MARGO_INSTANCE_NULL || !max_depth) return HG_INVALID_ARG;
+    struct margo_rpc_data* data
+        = (struct margo_rpc_data*)HG_Registered_data(mid->hg.hg_class, id);
+    if (!data) return HG_NOENTRY;
+    *max_depth = data->queue_limit.max_depth;
+    return HG_SUCCESS;
+}
+
 /* Mercury 2.x provides two versions of lookup (async and sync).  If a
  * synchronous lookup call is available then we do not need this callback.
  */
@@ -796,13 +877,19 @@ hg_return_t margo_create(margo_instance_id mid,
 
     /* look for a handle to reuse */
     hret = __margo_handle_cache_get(mid, addr, id, handle);
-    if (hret != HG_SUCCESS) {
+    bool cache_miss = hret != HG_SUCCESS;
+    if (cache_miss) {
         /* else try creating a new handle */
-        hret = HG_Create(mid->hg.hg_context, addr, id, handle);
+        hret = HG_Create(__margo_next_hg_context(mid), addr, id, handle);
     }
     if (hret != HG_SUCCESS) goto finish;
 
-    hret = __margo_internal_set_handle_data(*handle);
+    /* use the requested id rather than the handle's: a handle from the
+     * destination-affine cache is still bound to the id (with provider id)
+     * it was last forwarded with */
+    hret = set_handle_data(*handle, id);
+    if (hret == HG_SUCCESS && cache_miss)
+        __margo_handle_cache_track(mid, *handle);
 
 finish:
 
@@ -892,6 +979,7 @@ static hg_return_t margo_cb(const struct hg_cb_info* info)
         if (req->callback.cb) req->callback.cb(req->callback.uargs, hret);
     } else {
         req->eventual.hret = hret;
+        __margo_cq_request_completed(req);
         MARGO_EVENTUAL_SET(req->eventual.ev);
     }
 
@@ -940,7 +1028,7 @@ static hg_return_t margo_wait_internal(margo_request req)
         goto finish;
     }
     if (req->type == MARGO_FORWARD_REQUEST)
-        hret = check_error_in_output(req->handle);
+        hret = __margo_check_error_in_output(req->handle);
 
 finish:
 
@@ -968,10 +1056,11 @@ static void margo_timeout_cb(void* arg)
     }
 }
 
-static hg_return_t margo_provider_iforward_internal(
+hg_return_t __margo_provider_iforward_proc(
     uint16_t      provider_id,
     hg_handle_t   handle,
     double        timeout_ms,
+    hg_proc_cb_t  in_proc_cb,
     void*         in_struct,
     margo_request req) /* the request should have been allocated */
 {
@@ -1066,11 +1155,15 @@ static hg_return_t margo_provider_iforward_internal(
         }
     }
 
-    hret = HG_Reset(handle, hgi->addr, server_id);
-    if (hret != HG_SUCCESS) {
-        margo_error(mid, "in %s: HG_Reset failed: %s", __func__,
-                    HG_Error_to_string(hret));
-        goto finish;
+    /* the handle only needs to be reset if it is not already bound to this
+     * provider (e.g. when reused from the destination-affine cache) */
+    if (hgi->id != server_id) {
+        hret = HG_Reset(handle, hgi->addr, server_id);
+        if (hret != HG_SUCCESS) {
+            margo_error(mid, "in %s: HG_Reset failed: %s", __func__,
+                        HG_Error_to_string(hret));
+            goto finish;
+        }
     }
 
     if (req->kind == MARGO_REQ_EVENTUAL) {
@@ -1114,13 +1207,18 @@ static hg_return_t margo_provider_iforward_internal(
     hg_id_t parent_rpc_id;
     margo_get_current_rpc_id(mid, &parent_rpc_id);
 
+    // let the server know when we will give up on this RPC
+    double deadline
+        = timeout_ms > 0 ? margo_deadline_clock() + timeout_ms / 1000.0 : 0;
+
     // create the margo_forward_proc_args for the serializer
     struct margo_forward_proc_args forward_args
         = {.handle    = handle,
            .request   = req,
            .user_args = (void*)in_struct,
-           .user_cb   = in_cb,
-           .header    = {.parent_rpc_id = parent_rpc_id}};
+           .user_cb   = in_proc_cb ? in_proc_cb : in_cb,
+           .header    = {.parent_rpc_id = parent_rpc_id,
+                         .deadline      = deadline}};
 
     hret = HG_Forward(handle, margo_cb, (void*)req, (void*)&forward_args);
 
@@ -1151,6 +1249,17 @@ finish:
     return hret;
 }
 
+static inline hg_return_t margo_provider_iforward_internal(
+    uint16_t      provider_id,
+    hg_handle_t   handle,
+    double        timeout_ms,
+    void*         in_struct,
+    margo_request req)
+{
+    return __margo_provider_iforward_proc(provider_id, handle, timeout_ms,
+                                          NULL, in_struct, req);
+}
+
 hg_return_t margo_provider_forward_timed(uint16_t    provider_id,
                                          hg_handle_t handle,
                                          void*       in_struct,
@@ -1164,6 +1273,22 @@ hg_return_t margo_provider_forward_timed(uint16_t    provider_id,
     return margo_wait_internal(&reqs);
 }
 
+void* __margo_arena_get(margo_instance_id mid, mochi_arena_t arena)
+{
+    if (!mid->arena_wait_when_full) return mochi_arena_get(arena);
+    ABT_unit_type type;
+    if (ABT_self_get_type(&type) != ABT_SUCCESS || type != ABT_UNIT_TYPE_THREAD)
+        return mochi_arena_get(arena);
+    ABT_thread self        = ABT_THREAD_NULL;
+    ABT_bool   is_progress = ABT_FALSE;
+    ABT_thread_self(&self);
+    ABT_thread_equal(self, mid->hg_progress_tid, &is_progress);
+    for (unsigned i = 0; i < mid->num_progress_contexts && !is_progress; i++)
+        ABT_thread_equal(self, mid->progress_contexts[i].tid, &is_progress);
+    if (is_progress) return mochi_arena_get(arena);
+    return mochi_arena_get_wait(arena);
+}
+
 hg_return_t margo_provider_iforward_timed(uint16_t       provider_id,
                                           hg_handle_t    handle,
                                           void*          in_struct,
@@ -1172,7 +1297,7 @@ hg_return_t margo_provider_iforward_timed(uint16_t       provider_id,
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return HG_NOMEM_ERROR; }
     hret = margo_provider_iforward_internal(provider_id, handle, timeout_ms,
                                             in_struct, tmp_req);
@@ -1194,7 +1319,7 @@ hg_return_t margo_provider_cforward_timed(uint16_t    provider_id,
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return HG_NOMEM_ERROR; }
     tmp_req->kind             = MARGO_REQ_CALLBACK;
     tmp_req->callback.cb    = on_complete;
@@ -1223,39 +1348,6 @@ int margo_test(margo_request req, int* flag)
     return MARGO_EVENTUAL_TEST(req->eventual.ev, flag);
 }
 
-hg_return_t margo_wait_any(size_t count, margo_request* req, size_t* index)
-{
-    // XXX this is an active loop, we should change it
-    // when Argobots provide an ABT_eventual_wait_any
-    size_t i;
-    int    ret;
-    int    flag = 0;
-    int    has_pending_requests;
-try_again:
-    has_pending_requests = 0;
-    for (i = 0; i < count; i++) {
-        if (req[i] == MARGO_REQUEST_NULL)
-            continue;
-        else
-            has_pending_requests = 1;
-        ret = margo_test(req[i], &flag);
-        if (ret != ABT_SUCCESS) {
-            // LCOV_EXCL_START
-            *index = i;
-            return HG_OTHER_ERROR;
-            // LCOV_EXCL_END
-        }
-        if (flag) {
-            *index = i;
-            return margo_wait(req[i]);
-        }
-    }
-    ABT_thread_yield();
-    if (has_pending_requests) goto try_again;
-    *index = count;
-    return HG_SUCCESS;
-}
-
 hg_handle_t margo_request_get_handle(margo_request req)
 {
     if (!req) return NULL;
@@ -1427,7 +1519,7 @@ margo_irespond(hg_handle_t handle, void* out_struct, margo_request* req)
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     hret = margo_irespond_internal(handle, 0, out_struct, tmp_req);
     if (hret != HG_SUCCESS) {
@@ -1445,7 +1537,7 @@ hg_return_t margo_irespond_timed(hg_handle_t    handle,
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     hret = margo_irespond_internal(handle, timeout_ms, out_struct, tmp_req);
     if (hret != HG_SUCCESS) {
@@ -1463,7 +1555,7 @@ hg_return_t margo_crespond(hg_handle_t handle,
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     tmp_req->kind             = MARGO_REQ_CALLBACK;
     tmp_req->callback.cb    = on_complete;
@@ -1484,7 +1576,7 @@ hg_return_t margo_crespond_timed(hg_handle_t handle,
 {
     hg_return_t       hret;
     margo_instance_id mid     = margo_hg_handle_get_instance(handle);
-    margo_request     tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request     tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     tmp_req->kind             = MARGO_REQ_CALLBACK;
     tmp_req->callback.cb    = on_complete;
@@ -1874,7 +1966,7 @@ hg_return_t margo_bulk_itransfer_timed(margo_instance_id mid,
                                        double            timeout_ms,
                                        margo_request*    req)
 {
-    margo_request tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     hg_return_t hret = margo_bulk_itransfer_internal(
         mid, op, origin_addr, origin_handle, origin_offset, local_handle,
@@ -1901,7 +1993,7 @@ hg_return_t margo_bulk_ctransfer_timed(margo_instance_id mid,
                                        void (*on_complete)(void*, hg_return_t),
                                        void* uargs)
 {
-    margo_request tmp_req = mochi_arena_get(mid->request_arena);
+    margo_request tmp_req = __margo_arena_get(mid, mid->request_arena);
     if (!tmp_req) { return (HG_NOMEM_ERROR); }
     tmp_req->kind             = MARGO_REQ_CALLBACK;
     tmp_req->callback.cb    = on_complete;
@@ -1986,6 +2078,20 @@ static void margo_thread_sleep_cb(void* arg)
     return;
 }
 
+int margo_thread_create_with_deadline(ABT_pool pool,
+                                      void (*thread_func)(void*),
+                                      void*       arg,
+                                      double      timeout_ms,
+                                      ABT_thread* thread)
+{
+    margo_edf_pool_set_next_deadline(
+        timeout_ms >= 0 ? margo_deadline_clock() + timeout_ms / 1000.0 : 0);
+    int ret = ABT_thread_create(pool, thread_func, arg, ABT_THREAD_ATTR_NULL,
+                                thread);
+    margo_edf_pool_set_next_deadline(0);
+    return ret;
+}
+
 void margo_thread_sleep(margo_instance_id mid, double timeout_ms)
 {
     margo_timer_t             sleep_timer;
@@ -2059,6 +2165,11 @@ hg_class_t* margo_get_class(margo_instance_id mid)
     return (mid->hg.hg_class);
 }
 
+hg_return_t margo_set_target_context(hg_handle_t handle, uint8_t context_id)
+{
+    return HG_Set_target_id(handle, context_id);
+}
+
 ABT_pool margo_hg_handle_get_handler_pool(hg_handle_t h)
 {
     struct margo_handle_data* data;
@@ -2099,6 +2210,7 @@ static void margo_rpc_data_free(void* ptr)
 }
 
 static inline hg_return_t margo_internal_progress(margo_instance_id mid,
+                                                  hg_context_t*     context,
                                                   unsigned int      timeout_ms)
 {
     /* monitoring */
@@ -2106,7 +2218,7 @@ static inline hg_return_t margo_internal_progress(margo_instance_id mid,
         = {.timeout_ms = timeout_ms, .ret = HG_SUCCESS};
     __MARGO_MONITOR(mid, FN_START, progress, monitoring_args);
 
-    hg_return_t hret = HG_Progress(mid->hg.hg_context, timeout_ms);
+    hg_return_t hret = HG_Progress(context, timeout_ms);
     mid->num_progress_calls++;
 
     /* monitoring */
@@ -2117,6 +2229,7 @@ static inline hg_return_t margo_internal_progress(margo_instance_id mid,
 }
 
 static inline hg_return_t margo_internal_trigger(margo_instance_id mid,
+                                                 hg_context_t*     context,
                                                  unsigned int      timeout_ms,
                                                  unsigned int      max_count,
                                                  unsigned int*     actual_count)
@@ -2130,8 +2243,7 @@ static inline hg_return_t margo_internal_trigger(margo_instance_id mid,
     __MARGO_MONITOR(mid, FN_START, trigger, monitoring_args);
 
     unsigned int count = 0;
-    hg_return_t  hret
-        = HG_Trigger(mid->hg.hg_context, timeout_ms, max_count, &count);
+    hg_return_t  hret = HG_Trigger(context, timeout_ms, max_count, &count);
     mid->num_trigger_calls++;
     if (hret == HG_SUCCESS && actual_count) *actual_count = count;
 
@@ -2143,11 +2255,122 @@ static inline hg_return_t margo_internal_trigger(margo_instance_id mid,
     return hret;
 }
 
+/* upper bound of the trigger batch size in adaptive mode */
+#define MARGO_MAX_TRIGGER_BATCH 256
+
+/* Runs the completion callbacks queued in the context, in batches of
+ * hg_progress_trigger_batch callbacks per HG_Trigger call. If the batch
+ * size is 0 (adaptive mode), the batch size is kept in adaptive_batch,
+ * doubled when a batch is full (completions are queuing up) and halved
+ * when less than half of it was used. */
+static inline unsigned int
+margo_internal_trigger_batches(margo_instance_id mid,
+                               hg_context_t*     context,
+                               unsigned int*     adaptive_batch)
+{
+    hg_return_t  ret;
+    unsigned int max_count, actual_count;
+    unsigned int total_count = 0;
+
+    do {
+        max_count = mid->hg_progress_trigger_batch;
+        if (!max_count) max_count = *adaptive_batch;
+        actual_count = 0;
+        ret = margo_internal_trigger(mid, context, 0, max_count, &actual_count);
+        total_count += actual_count;
+        if (!mid->hg_progress_trigger_batch) {
+            if (actual_count == max_count
+                && max_count < MARGO_MAX_TRIGGER_BATCH)
+                *adaptive_batch = max_count * 2;
+            else if (actual_count < max_count / 2)
+                *adaptive_batch = max_count / 2;
+        }
+    } while ((ret == HG_SUCCESS) && actual_count == max_count
+             && !mid->hg_progress_shutdown_flag);
+
+    return total_count;
+}
+
+/* Returns the number of ULTs in the pool, including suspended ones but not
+ * the RPC workers of the pool that are waiting for work, since those will
+ * not need the execution stream until an RPC is dispatched to them */
+static inline size_t margo_pool_total_size(margo_instance_id mid,
+                                           unsigned          pool_idx)
+{
+    size_t            size  = 0;
+    margo_abt_pool_t* entry = &mid->abt->pools[pool_idx];
+    ABT_pool_get_total_size(entry->pool, &size);
+    if (entry->workers) {
+        size_t waiting = __margo_rpc_workers_num_waiting(entry->workers);
+        size           = size > waiting ? size - waiting : 0;
+    }
+    return size;
+}
+
+/* weight of the latest sample in the averages of the adaptive policy */
+#define MARGO_ADAPTIVE_PROGRESS_ALPHA 0.125
+
+/* Updates the state of the adaptive progress policy after an iteration of
+ * the progress loop that ran num_completed callbacks, and returns the
+ * timeout to use for the next call to HG_Progress (before accounting for
+ * timers). The expected time until the next completion is estimated from
+ * an exponentially weighted moving average of the time between completions
+ * (or the time since the last completion if it is already longer):
+ * if it is within the spindown window, or if completions were found on most
+ * recent iterations, we busy-poll; if it is shorter than the timeout upper
+ * bound, we use it as timeout; otherwise we block for the full upper
+ * bound. */
+static unsigned int margo_adaptive_progress_update(margo_instance_id mid,
+                                                   unsigned int num_completed,
+                                                   size_t       pool_size)
+{
+    struct margo_adaptive_progress* ap  = &mid->hg_progress_adaptive;
+    double                          now = ABT_get_wtime();
+    double                          gap;
+    const double                    alpha = MARGO_ADAPTIVE_PROGRESS_ALPHA;
+    margo_progress_state_t          state;
+    unsigned int                    timeout;
+
+    /* only this loop writes the averages, the atomics are for readers */
+    double gap_ewma
+        = atomic_load_explicit(&ap->arrival_gap_ewma, memory_order_relaxed);
+    double yield_ewma
+        = atomic_load_explicit(&ap->yield_ewma, memory_order_relaxed);
+
+    if (num_completed) {
+        gap      = (now - ap->last_completion_ts) / num_completed;
+        gap_ewma = alpha * gap + (1 - alpha) * gap_ewma;
+        atomic_store_explicit(&ap->arrival_gap_ewma, gap_ewma,
+                              memory_order_relaxed);
+        ap->last_completion_ts = now;
+    }
+    yield_ewma = alpha * num_completed + (1 - alpha) * yield_ewma;
+    atomic_store_explicit(&ap->yield_ewma, yield_ewma, memory_order_relaxed);
+
+    gap = gap_ewma;
+    if (now - ap->last_completion_ts > gap) gap = now - ap->last_completion_ts;
+    gap *= 1000; /* convert to milliseconds */
+
+    /* we never block if other ULTs in the progress pool may need to run */
+    if (pool_size > 1 || yield_ewma >= 0.5
+        || gap < mid->hg_progress_spindown_msec) {
+        state   = MARGO_PROGRESS_SPIN;
+        timeout = 0;
+    } else if (gap < mid->hg_progress_timeout_ub) {
+        state   = MARGO_PROGRESS_POLL;
+        timeout = gap < 1 ? 1 : (unsigned int)gap;
+    } else {
+        state   = MARGO_PROGRESS_BLOCK;
+        timeout = mid->hg_progress_timeout_ub;
+    }
+    atomic_store_explicit(&ap->state, state, memory_order_relaxed);
+    return timeout;
+}
+
 /* dedicated thread function to drive Mercury progress */
 void __margo_hg_progress_fn(void* foo)
 {
     int                    ret;
-    unsigned int           actual_count;
     struct margo_instance* mid = (struct margo_instance*)foo;
     size_t                 size;
     unsigned int           hg_progress_timeout;
@@ -2155,16 +2378,17 @@ void __margo_hg_progress_fn(void* foo)
     unsigned int           pending;
     int                    spin_flag     = 0;
     double                 spin_start_ts = 0;
+    unsigned int           trigger_batch = 1;
+    unsigned int           num_completed;
+    unsigned int           max_timeout;
 
     while (!mid->hg_progress_shutdown_flag) {
 
         /* Wait for progress to actually be needed */
         WAIT_FOR_PROGRESS_TO_BE_NEEDED(mid);
 
-        do {
-            ret = margo_internal_trigger(mid, 0, 1, &actual_count);
-        } while ((ret == HG_SUCCESS) && actual_count
-                 && !mid->hg_progress_shutdown_flag);
+        num_completed = margo_internal_trigger_batches(mid, mid->hg.hg_context,
+                                                       &trigger_batch);
 
         /* Yield now to give an opportunity for this ES to either a) run other
          * ULTs that are eligible in this pool or b) check for runnable ULTs
@@ -2172,7 +2396,14 @@ void __margo_hg_progress_fn(void* foo)
          */
         ABT_thread_yield();
 
-        if (spin_flag) {
+        max_timeout = mid->hg_progress_timeout_ub;
+
+        if (mid->hg_progress_policy == MARGO_PROGRESS_POLICY_ADAPTIVE) {
+            size = margo_pool_total_size(mid, mid->progress_pool_idx);
+            max_timeout
+                = margo_adaptive_progress_update(mid, num_completed, size);
+            spin_flag = max_timeout == 0;
+        } else if (spin_flag) {
             /* We used a zero progress timeout (busy spinning) on the last
              * iteration.  See if spindown time has elapsed yet.
              */
@@ -2191,7 +2422,8 @@ void __margo_hg_progress_fn(void* foo)
             }
         }
 
-        if (mid->hg_progress_spindown_msec && !spin_flag) {
+        if (mid->hg_progress_policy == MARGO_PROGRESS_POLICY_SPINDOWN
+            && mid->hg_progress_spindown_msec && !spin_flag) {
             /* Determine if it is reasonably safe to briefly block on
              * Mercury progress or if we should enter spin mode.  We check
              * two conditions: are there any RPCs currently being processed
@@ -2217,7 +2449,7 @@ void __margo_hg_progress_fn(void* foo)
              * count includes this ULT so we look for a count > 1
              * instead of a count > 0.
              */
-            ABT_pool_get_total_size(MARGO_PROGRESS_POOL(mid), &size);
+            size = margo_pool_total_size(mid, mid->progress_pool_idx);
 
             if (pending || size > 1) {
                 /* entering spin mode; record timestamp so that we can
@@ -2235,7 +2467,7 @@ void __margo_hg_progress_fn(void* foo)
         if (spin_flag) {
             hg_progress_timeout = 0;
         } else {
-            hg_progress_timeout = mid->hg_progress_timeout_ub;
+            hg_progress_timeout = max_timeout;
             ret = __margo_timer_get_next_expiration(mid, &next_timer_exp);
             if (ret == 0) {
                 /* there is a queued timer, don't block long enough
@@ -2243,7 +2475,7 @@ void __margo_hg_progress_fn(void* foo)
                  */
                 if (next_timer_exp >= 0.0) {
                     next_timer_exp *= 1000; /* convert to milliseconds */
-                    if (next_timer_exp < mid->hg_progress_timeout_ub)
+                    if (next_timer_exp < max_timeout)
                         hg_progress_timeout = (unsigned int)next_timer_exp;
                 } else {
                     hg_progress_timeout = 0;
@@ -2251,7 +2483,8 @@ void __margo_hg_progress_fn(void* foo)
             }
         }
 
-        ret = margo_internal_progress(mid, hg_progress_timeout);
+        ret = margo_internal_progress(mid, mid->hg.hg_context,
+                                      hg_progress_timeout);
         if (ret != HG_SUCCESS && ret != HG_TIMEOUT) {
             /* TODO: error handling */
             MARGO_CRITICAL(mid,
@@ -2267,6 +2500,88 @@ void __margo_hg_progress_fn(void* foo)
     return;
 }
 
+/* thread function driving progress on one of the additional contexts */
+void __margo_hg_context_progress_fn(void* foo)
+{
+    int                            ret;
+    struct margo_progress_context* ctx = (struct margo_progress_context*)foo;
+    struct margo_instance*         mid = ctx->mid;
+    unsigned int                   hg_progress_timeout;
+    unsigned int                   trigger_batch = 1;
+
+    while (!mid->hg_progress_shutdown_flag) {
+
+        WAIT_FOR_PROGRESS_TO_BE_NEEDED(mid);
+
+        margo_internal_trigger_batches(mid, ctx->hg_context, &trigger_batch);
+
+        ABT_thread_yield();
+
+        /* Timers are handled by the main progress loop, so the only reason
+         * not to block is another ULT waiting to run in this pool. */
+        size_t size = margo_pool_total_size(mid, ctx->pool_idx);
+        hg_progress_timeout = size > 1 ? 0 : mid->hg_progress_timeout_ub;
+
+        ret = margo_internal_progress(mid, ctx->hg_context,
+                                      hg_progress_timeout);
+        if (ret != HG_SUCCESS && ret != HG_TIMEOUT) {
+            MARGO_CRITICAL(mid,
+                           "unexpected return code (%d: %s) from HG_Progress()",
+                           ret, HG_Error_to_string(ret));
+            assert(0);
+        }
+    }
+
+    return;
+}
+
+hg_return_t __margo_create_progress_contexts(margo_instance_id mid,
+                                             unsigned          num_contexts,
+                                             const int*        pool_indices)
+{
+    if (num_contexts == 0) return HG_SUCCESS;
+
+    mid->progress_contexts
+        = calloc(num_contexts, sizeof(*mid->progress_contexts));
+    if (!mid->progress_contexts) return HG_NOMEM_ERROR;
+
+    for (unsigned i = 0; i < num_contexts; i++) {
+        struct margo_progress_context* ctx = &mid->progress_contexts[i];
+        ctx->mid                           = mid;
+        ctx->pool_idx                      = pool_indices[i];
+        ctx->tid                           = ABT_THREAD_NULL;
+        /* context 0 is mid->hg.hg_context */
+        ctx->hg_context
+            = HG_Context_create_id(mid->hg.hg_class, (hg_uint8_t)(i + 1));
+        if (!ctx->hg_context) {
+            margo_error(mid, "Could not create Mercury context %u", i + 1);
+            return HG_OTHER_ERROR;
+        }
+        mid->num_progress_contexts += 1;
+    }
+    return HG_SUCCESS;
+}
+
+void __margo_destroy_progress_contexts(margo_instance_id mid)
+{
+    for (unsigned i = 0; i < mid->num_progress_contexts; i++) {
+        struct margo_progress_context* ctx = &mid->progress_contexts[i];
+        if (ctx->tid != ABT_THREAD_NULL) {
+            mid->hg_progress_shutdown_flag = 1;
+            ABT_thread_join(ctx->tid);
+            ABT_thread_free(&ctx->tid);
+        }
+        hg_return_t hret = HG_Context_destroy(ctx->hg_context);
+        if (hret != HG_SUCCESS) {
+            margo_error(mid, "Could not destroy Mercury context %u: %s", i + 1,
+                        HG_Error_to_string(hret));
+        }
+    }
+    free(mid->progress_contexts);
+    mid->progress_contexts     = NULL;
+    mid->num_progress_contexts = 0;
+}
+
 int margo_set_progress_timeout_ub_msec(margo_instance_id mid, unsigned timeout)
 {
     if (!mid) return -1;
@@ -2302,6 +2617,14 @@ int margo_set_param(margo_instance_id mid, const char* key, const char* value)
         return 0;
     }
 
+    if (strcmp(key, "progress_trigger_batch_size") == 0) {
+        MARGO_TRACE(0, "Setting progress_trigger_batch_size to %s", value);
+        int progress_trigger_batch = atoi(value);
+        if (progress_trigger_batch < 0) return -1;
+        mid->hg_progress_trigger_batch = progress_trigger_batch;
+        return 0;
+    }
+
     /* unknown key, or at least one that cannot be modified at runtime */
     return -1;
 }
@@ -2350,13 +2673,18 @@ static hg_id_t margo_register_internal(margo_instance_id mid,
             goto finish;
             // LCOV_EXCL_END
         }
-        margo_data->mid                = mid;
-        margo_data->pool               = pool;
-        margo_data->rpc_name           = name ? strdup(name) : NULL;
-        margo_data->in_proc_cb         = in_proc_cb;
-        margo_data->out_proc_cb        = out_proc_cb;
-        margo_data->user_data          = NULL;
-        margo_data->user_free_callback = NULL;
+        margo_data->mid                   = mid;
+        margo_data->pool                  = pool;
+        margo_data->rpc_name              = name ? strdup(name) : NULL;
+        margo_data->in_proc_cb            = in_proc_cb;
+        margo_data->out_proc_cb           = out_proc_cb;
+        margo_data->inline_mode           = MARGO_INLINE_NONE;
+        margo_data->workers               = NULL;
+        margo_data->pool_max_queue_depth  = 0;
+        margo_data->queue_limit.max_depth = 0;
+        margo_data->queue_limit.depth     = 0;
+        margo_data->user_data             = NULL;
+        margo_data->user_free_callback    = NULL;
         hret = HG_Register_data(mid->hg.hg_class, id, margo_data,
                                 margo_rpc_data_free);
         if (hret != HG_SUCCESS) {
@@ -2374,6 +2702,11 @@ static hg_id_t margo_register_internal(margo_instance_id mid,
     struct margo_pool_info pool_info;
     if (margo_find_pool_by_handle(mid, pool, &pool_info) == HG_SUCCESS) {
         mid->abt->pools[pool_info.index].refcount++;
+        if (margo_data->pool == pool) {
+            margo_data->workers = mid->abt->pools[pool_info.index].workers;
+            margo_data->pool_max_queue_depth
+                = mid->abt->pools[pool_info.index].max_queue_depth;
+        }
     }
 
 finish:
@@ -2442,9 +2775,14 @@ void __margo_internal_pre_handler_hooks(
     struct margo_monitor_rpc_handler_args* monitoring_args)
 {
     hg_id_t parent_id = 0;
-    check_parent_id_in_input(handle, &parent_id);
+    double  deadline  = 0;
+    check_header_in_input(handle, &parent_id, &deadline);
     monitoring_args->parent_rpc_id = parent_id;
 
+    struct margo_handle_data* handle_data
+        = (struct margo_handle_data*)HG_Get_data(handle);
+    if (handle_data) handle_data->deadline = deadline;
+
     /* monitoring */
     __MARGO_MONITOR(mid, FN_START, rpc_handler, (*monitoring_args));
 }
@@ -2462,6 +2800,9 @@ void __margo_internal_pre_wrapper_hooks(
     hg_handle_t                        handle,
     struct margo_monitor_rpc_ult_args* monitoring_args)
 {
+    /* the RPC no longer counts against the queue depth limit of its ID */
+    __margo_internal_release_admission(handle);
+
     const struct hg_info* info = margo_get_info(handle);
     if (!info) return;
     margo_set_current_rpc_id(mid, info->id);
@@ -2472,16 +2813,143 @@ void __margo_internal_pre_wrapper_hooks(
     margo_ref_incr(handle);
 }
 
+static void margo_finalize_ult(void* arg)
+{
+    margo_finalize((margo_instance_id)arg);
+}
+
 void __margo_internal_post_wrapper_hooks(
     margo_instance_id mid, struct margo_monitor_rpc_ult_args* monitoring_args)
 {
     /* monitoring */
     __MARGO_MONITOR(mid, FN_END, rpc_ult, (*monitoring_args));
 
+    struct margo_handle_data* handle_data
+        = (struct margo_handle_data*)HG_Get_data(monitoring_args->handle);
+    bool inlined = handle_data && handle_data->inline_mode != MARGO_INLINE_NONE;
+
     margo_destroy(monitoring_args->handle);
 
     __margo_internal_decr_pending(mid);
-    if (__margo_internal_finalize_requested(mid)) { margo_finalize(mid); }
+    if (__margo_internal_finalize_requested(mid)) {
+        /* an inline handler may be running in the progress loop (which
+         * margo_finalize joins) or in a tasklet (which cannot block) */
+        if (inlined)
+            ABT_thread_create(MARGO_RPC_POOL(mid), margo_finalize_ult, mid,
+                              ABT_THREAD_ATTR_NULL, NULL);
+        else
+            margo_finalize(mid);
+    }
+}
+
+hg_return_t __margo_internal_admit_rpc(hg_handle_t handle, ABT_pool pool)
+{
+    struct margo_handle_data* handle_data
+        = (struct margo_handle_data*)HG_Get_data(handle);
+    if (!handle_data) return HG_SUCCESS;
+
+    /* the client has already given up on this RPC */
+    if (handle_data->deadline
+        && margo_deadline_clock() >= handle_data->deadline)
+        return HG_TIMEOUT;
+
+    /* the pool limit applies to the units ready to run in the pool, whether
+     * they are RPCs or not, and is irrelevant to RPCs run in the progress
+     * loop */
+    if (handle_data->pool_max_queue_depth && handle_data->pool == pool
+        && handle_data->inline_mode != MARGO_INLINE_TRIGGER) {
+        size_t size = 0;
+        ABT_pool_get_size(pool, &size);
+        if (size >= handle_data->pool_max_queue_depth) return HG_BUSY;
+    }
+
+    struct margo_rpc_queue_limit* limit     = handle_data->queue_limit;
+    unsigned                      max_depth = limit ? limit->max_depth : 0;
+    if (max_depth) {
+        if (atomic_fetch_add(&limit->depth, 1) >= max_depth) {
+            atomic_fetch_sub(&limit->depth, 1);
+            return HG_BUSY;
+        }
+        handle_data->queued = true;
+    }
+    return HG_SUCCESS;
+}
+
+void __margo_internal_release_admission(hg_handle_t handle)
+{
+    struct margo_handle_data* handle_data
+        = (struct margo_handle_data*)HG_Get_data(handle);
+    if (handle_data && handle_data->queued) {
+        handle_data->queued = false;
+        atomic_fetch_sub(&handle_data->queue_limit->depth, 1);
+    }
+}
+
+/* Custom pools build their units when they are created, so the information
+ * they need to order an RPC is passed through thread-local hints set around
+ * ABT_thread_create/ABT_task_create: the client's deadline for "edf_wait"
+ * pools and the provider id for "wfq_wait" pools. */
+static inline void set_unit_hints(hg_handle_t                     handle,
+                                  const struct margo_handle_data* handle_data)
+{
+    const struct hg_info* info = HG_Get_info(handle);
+    hg_id_t               base_id;
+    uint16_t              provider_id;
+    margo_edf_pool_set_next_deadline(handle_data ? handle_data->deadline : 0);
+    if (info) {
+        demux_id(info->id, &base_id, &provider_id);
+        margo_wfq_pool_set_next_key(provider_id);
+    }
+}
+
+static inline void clear_unit_hints(void)
+{
+    margo_edf_pool_set_next_deadline(0);
+    margo_wfq_pool_set_next_key(-1);
+}
+
+int __margo_internal_dispatch_rpc(hg_handle_t handle,
+                                  ABT_pool    pool,
+                                  void (*wrapper)(void*))
+{
+    struct margo_handle_data* handle_data
+        = (struct margo_handle_data*)HG_Get_data(handle);
+    margo_instance_id mid = handle_data ? handle_data->mid : MARGO_INSTANCE_NULL;
+    void*             current_rpc_id = NULL;
+    int               ret;
+    switch (handle_data ? handle_data->inline_mode : MARGO_INLINE_NONE) {
+    case MARGO_INLINE_TRIGGER:
+        margo_trace(mid, "Running RPC %s inline in the progress loop",
+                    handle_data->rpc_name ? handle_data->rpc_name : "???");
+        /* the wrapper sets the current RPC id of the progress ULT, which must
+         * not leak as the parent id of what the progress ULT does next */
+        ABT_key_get(mid->current_rpc_id_key, &current_rpc_id);
+        wrapper(handle);
+        ABT_key_set(mid->current_rpc_id_key, current_rpc_id);
+        return ABT_SUCCESS;
+    case MARGO_INLINE_TASK:
+        margo_trace(mid, "Spawning tasklet for RPC %s",
+                    handle_data->rpc_name ? handle_data->rpc_name : "???");
+        set_unit_hints(handle, handle_data);
+        ret = ABT_task_create(pool, wrapper, handle, NULL);
+        clear_unit_hints();
+        return ret;
+    default:
+        /* hand the RPC to a pre-spawned worker of the pool if one is idle */
+        if (handle_data && handle_data->workers
+            && handle_data->pool == pool
+            && __margo_rpc_workers_submit(handle_data->workers, wrapper,
+                                          handle))
+            return ABT_SUCCESS;
+        margo_trace(mid, "Spawning ULT for RPC %s",
+                    handle_data && handle_data->rpc_name ? handle_data->rpc_name
+                                                         : "???");
+        set_unit_hints(handle, handle_data);
+        ret = ABT_thread_create(pool, wrapper, handle, ABT_THREAD_ATTR_NULL,
+                                NULL);
+        clear_unit_hints();
+        return ret;
+    }
 }
 
 void __margo_handle_data_free(void* args)
@@ -2505,23 +2973,38 @@ void __margo_handle_data_free(void* args)
 }
 
 hg_return_t __margo_internal_set_handle_data(hg_handle_t handle)
+{
+    const struct hg_info* info = HG_Get_info(handle);
+    if (!info) return HG_OTHER_ERROR;
+    return set_handle_data(handle, info->id);
+}
+
+static hg_return_t set_handle_data(hg_handle_t handle, hg_id_t id)
 {
     struct margo_rpc_data* rpc_data;
     const struct hg_info*  info = HG_Get_info(handle);
     if (!info) return HG_OTHER_ERROR;
-    rpc_data
-        = (struct margo_rpc_data*)HG_Registered_data(info->hg_class, info->id);
+    rpc_data = (struct margo_rpc_data*)HG_Registered_data(info->hg_class, id);
     if (!rpc_data) return HG_OTHER_ERROR;
     struct margo_handle_data* handle_data;
     handle_data               = HG_Get_data(handle);
     bool handle_data_attached = handle_data != NULL;
-    if (!handle_data)
-        handle_data = mochi_arena_get(rpc_data->mid->handle_data_arena);
-    handle_data->mid         = rpc_data->mid;
-    handle_data->pool        = rpc_data->pool;
-    handle_data->rpc_name    = rpc_data->rpc_name;
-    handle_data->in_proc_cb  = rpc_data->in_proc_cb;
-    handle_data->out_proc_cb = rpc_data->out_proc_cb;
+    if (!handle_data) {
+        handle_data = __margo_arena_get(rpc_data->mid,
+                                        rpc_data->mid->handle_data_arena);
+        if (!handle_data) return HG_NOMEM_ERROR;
+    }
+    handle_data->mid                  = rpc_data->mid;
+    handle_data->pool                 = rpc_data->pool;
+    handle_data->rpc_name             = rpc_data->rpc_name;
+    handle_data->in_proc_cb           = rpc_data->in_proc_cb;
+    handle_data->out_proc_cb          = rpc_data->out_proc_cb;
+    handle_data->inline_mode          = rpc_data->inline_mode;
+    handle_data->workers              = rpc_data->workers;
+    handle_data->pool_max_queue_depth = rpc_data->pool_max_queue_depth;
+    handle_data->queue_limit          = &rpc_data->queue_limit;
+    handle_data->queued               = false;
+    handle_data->deadline             = 0;
     if (!handle_data_attached)
         return HG_Set_data(handle, handle_data, __margo_handle_data_free);
     else
@@ -2565,6 +3048,13 @@ hg_return_t margo_rpc_set_pool(margo_instance_id mid, hg_id_t id, ABT_pool pool)
         mid->abt->pools[new_pool_entry_idx].refcount++;
     else
         margo_warning(mid, "Associating RPC with a pool not know to Margo");
+    data->workers = new_pool_entry_idx >= 0
+                      ? mid->abt->pools[new_pool_entry_idx].workers
+                      : NULL;
+    data->pool_max_queue_depth
+        = new_pool_entry_idx >= 0
+            ? mid->abt->pools[new_pool_entry_idx].max_queue_depth
+            : 0;
     __margo_abt_unlock(mid->abt);
     data->pool = pool;
     return HG_SUCCESS;
@@ -2576,7 +3066,17 @@ const char* margo_handle_get_name(hg_handle_t handle)
     return handle_data ? handle_data->rpc_name : NULL;
 }
 
-hg_return_t check_error_in_output(hg_handle_t handle)
+hg_return_t margo_get_deadline(hg_handle_t handle, double* remaining_ms)
+{
+    if (!remaining_ms) return HG_INVALID_ARG;
+    struct margo_handle_data* handle_data = HG_Get_data(handle);
+    if (!handle_data) return HG_NO_MATCH;
+    if (!handle_data->deadline) return HG_NOENTRY;
+    *remaining_ms = (handle_data->deadline - margo_deadline_clock()) * 1000.0;
+    return HG_SUCCESS;
+}
+
+hg_return_t __margo_check_error_in_output(hg_handle_t handle)
 {
     const struct hg_info* info = HG_Get_info(handle);
     hg_bool_t             disabled;
@@ -2601,7 +3101,8 @@ hg_return_t check_error_in_output(hg_handle_t handle)
     return hret;
 }
 
-hg_return_t check_parent_id_in_input(hg_handle_t handle, hg_id_t* parent_id)
+hg_return_t
+check_header_in_input(hg_handle_t handle, hg_id_t* parent_id, double* deadline)
 {
     struct margo_forward_proc_args forward_args
         = {.user_args = NULL, .user_cb = NULL};
@@ -2612,6 +3113,7 @@ hg_return_t check_parent_id_in_input(hg_handle_t handle, hg_id_t* parent_id)
     // whole input.
     if (hret != HG_SUCCESS && hret != HG_CHECKSUM_ERROR) return hret;
     *parent_id = forward_args.header.parent_rpc_id;
+    *deadline  = forward_args.header.deadline;
     if (hret == HG_CHECKSUM_ERROR) return HG_SUCCESS;
     HG_Free_input(handle, (void*)&forward_args);
     return HG_SUCCESS;
@@ -2629,8 +3131,14 @@ int margo_set_progress_when_needed(margo_instance_id mid, bool when_needed)
     if (mid == MARGO_INSTANCE_NULL) return -1;
     mid->progress_when_needed.flag = when_needed;
     if (!when_needed) {
-        ABT_cond_signal(
+        /* taking the mutex ensures that a progress loop that saw the flag
+         * set is either already waiting or will see it cleared */
+        ABT_mutex_lock(
+            ABT_MUTEX_MEMORY_GET_HANDLE(&mid->progress_when_needed.mutex));
+        ABT_cond_broadcast(
             ABT_COND_MEMORY_GET_HANDLE(&mid->progress_when_needed.cond));
+        ABT_mutex_unlock(
+            ABT_MUTEX_MEMORY_GET_HANDLE(&mid->progress_when_needed.mutex));
     }
     return 0;
 }
@@ -0,0 +1,348 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <abt.h>
+#include "margo.h"
+#include "margo-instance.h"
+#include "margo-cq.h"
+
+/* The cq_link field of a request is 0 until the request is either added to a
+ * completion queue (cq_link then points to the queue) or completed (cq_link
+ * is then CQ_LINK_COMPLETED). Whichever of margo_cq_add and the completion
+ * happens second queues the request, so that the two may race. */
+#define CQ_LINK_COMPLETED ((uintptr_t)1)
+
+struct margo_cq {
+    margo_instance_id mid; /* MARGO_INSTANCE_NULL for internal queues */
+    ABT_mutex_memory  mutex;
+    ABT_cond_memory   cond;
+    margo_request     head; /* completed requests, in order of completion */
+    margo_request     tail;
+    size_t            num_pending; /* requests added but not queued yet */
+};
+
+#define CQ_LOCK(cq)   ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&(cq)->mutex))
+#define CQ_UNLOCK(cq) ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(cq)->mutex))
+
+/* Appends a completed request to the queue in O(1) and wakes up waiters */
+static void cq_push(struct margo_cq* cq, margo_request req)
+{
+    req->cq_next = NULL;
+    CQ_LOCK(cq);
+    if (cq->tail)
+        cq->tail->cq_next = req;
+    else
+        cq->head = req;
+    cq->tail = req;
+    cq->num_pending -= 1;
+    ABT_cond_broadcast(ABT_COND_MEMORY_GET_HANDLE(&cq->cond));
+    CQ_UNLOCK(cq);
+}
+
+/* Removes up to max_count requests from the head of the queue. Must be called
+ * with the queue's mutex held. */
+static size_t
+cq_pop(struct margo_cq* cq, size_t max_count, margo_request* reqs, void** uargs)
+{
+    size_t n = 0;
+    while (n < max_count && cq->head) {
+        margo_request req = cq->head;
+        cq->head          = req->cq_next;
+        if (!cq->head) cq->tail = NULL;
+        req->cq_owner = NULL;
+        reqs[n]       = req;
+        if (uargs) uargs[n] = req->cq_uargs;
+        n++;
+    }
+    return n;
+}
+
+static hg_return_t cq_add(struct margo_cq* cq, margo_request req, void* uargs)
+{
+    if (req->kind != MARGO_REQ_EVENTUAL) return HG_INVALID_ARG;
+
+    /* the request is already in a completion queue (possibly completed but
+     * not retrieved yet), whose argument and list must not be overwritten */
+    uintptr_t link = atomic_load_explicit(&req->cq_link, memory_order_acquire);
+    if (req->cq_owner || (link && link != CQ_LINK_COMPLETED)) return HG_BUSY;
+
+    req->cq_uargs = uargs;
+    if (cq->mid != MARGO_INSTANCE_NULL) req->cq_owner = cq;
+    CQ_LOCK(cq);
+    cq->num_pending += 1;
+    CQ_UNLOCK(cq);
+
+    link = 0;
+    if (atomic_compare_exchange_strong_explicit(&req->cq_link, &link,
+                                                (uintptr_t)cq,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire))
+        return HG_SUCCESS; /* queued by __margo_cq_request_completed */
+
+    /* the request has completed already */
+    cq_push(cq, req);
+    return HG_SUCCESS;
+}
+
+static size_t cq_wait(struct margo_cq* cq,
+                      size_t           max_count,
+                      margo_request*   reqs,
+                      void**           uargs,
+                      bool             block)
+{
+    CQ_LOCK(cq);
+    while (block && !cq->head && cq->num_pending)
+        ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&cq->cond),
+                      ABT_MUTEX_MEMORY_GET_HANDLE(&cq->mutex));
+    size_t n = cq_pop(cq, max_count, reqs, uargs);
+    CQ_UNLOCK(cq);
+    return n;
+}
+
+/* Takes the first count requests of reqs (ignoring MARGO_REQUEST_NULL) out of
+ * an internal queue: requests still pending are removed from it, and the
+ * completion of the others is waited for, leaving them completed but not
+ * waited on. The queue is empty and can go out of scope afterwards. */
+static void cq_detach(struct margo_cq* cq, size_t count, margo_request* reqs)
+{
+    CQ_LOCK(cq);
+    for (size_t i = 0; i < count; i++) {
+        if (reqs[i] == MARGO_REQUEST_NULL) continue;
+        uintptr_t link = (uintptr_t)cq;
+        if (atomic_compare_exchange_strong_explicit(
+                &reqs[i]->cq_link, &link, 0, memory_order_acq_rel,
+                memory_order_acquire))
+            cq->num_pending -= 1;
+    }
+    /* requests whose completion is underway are about to be queued */
+    while (cq->num_pending)
+        ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&cq->cond),
+                      ABT_MUTEX_MEMORY_GET_HANDLE(&cq->mutex));
+    cq->head = cq->tail = NULL;
+    CQ_UNLOCK(cq);
+}
+
+void __margo_cq_request_completed(margo_request req)
+{
+    uintptr_t link = atomic_exchange_explicit(
+        &req->cq_link, CQ_LINK_COMPLETED, memory_order_acq_rel);
+    if (link) cq_push((struct margo_cq*)link, req);
+}
+
+/* Takes a completed request out of the user queue it was added to, unless it
+ * has already been retrieved from it, so that it can be waited on directly */
+static void cq_remove(margo_request req)
+{
+    struct margo_cq* cq = req->cq_owner;
+    if (!cq) return;
+    CQ_LOCK(cq);
+    margo_request prev = NULL;
+    for (margo_request it = cq->head; it; prev = it, it = it->cq_next) {
+        if (it != req) continue;
+        if (prev)
+            prev->cq_next = it->cq_next;
+        else
+            cq->head = it->cq_next;
+        if (cq->tail == it) cq->tail = prev;
+        break;
+    }
+    CQ_UNLOCK(cq);
+    req->cq_owner = NULL;
+}
+
+hg_return_t margo_cq_create(margo_instance_id mid, margo_cq_t* cq)
+{
+    if (mid == MARGO_INSTANCE_NULL || !cq) return HG_INVALID_ARG;
+    /* the mutex and condition variable are statically initialized by calloc */
+    struct margo_cq* tmp = calloc(1, sizeof(*tmp));
+    if (!tmp) return HG_NOMEM_ERROR;
+    tmp->mid = mid;
+    *cq      = tmp;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_cq_destroy(margo_cq_t cq)
+{
+    if (cq == MARGO_CQ_NULL) return HG_INVALID_ARG;
+    CQ_LOCK(cq);
+    bool busy = cq->head || cq->num_pending;
+    CQ_UNLOCK(cq);
+    if (busy) {
+        margo_error(cq->mid,
+                    "Cannot destroy a completion queue with pending or "
+                    "completed requests");
+        return HG_BUSY;
+    }
+    free(cq);
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_cq_add(margo_cq_t cq, margo_request req, void* uargs)
+{
+    if (cq == MARGO_CQ_NULL || req == MARGO_REQUEST_NULL
+        || req->mid != cq->mid)
+        return HG_INVALID_ARG;
+    hg_return_t hret = cq_add(cq, req, uargs);
+    return hret == HG_BUSY ? HG_INVALID_ARG : hret;
+}
+
+hg_return_t margo_cq_wait(margo_cq_t     cq,
+                          size_t         max_count,
+                          margo_request* reqs,
+                          void**         uargs,
+                          size_t*        count)
+{
+    if (cq == MARGO_CQ_NULL || !max_count || !reqs || !count)
+        return HG_INVALID_ARG;
+    *count = cq_wait(cq, max_count, reqs, uargs, true);
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_cq_poll(margo_cq_t     cq,
+                          size_t         max_count,
+                          margo_request* reqs,
+                          void**         uargs,
+                          size_t*        count)
+{
+    if (cq == MARGO_CQ_NULL || !reqs || !count) return HG_INVALID_ARG;
+    *count = cq_wait(cq, max_count, reqs, uargs, false);
+    return HG_SUCCESS;
+}
+
+/* Adds the non-null requests of the array to an internal queue, using their
+ * index as argument. Returns HG_BUSY if one of them is already in a user
+ * queue, in which case the caller should poll them with poll_any instead. */
+static hg_return_t
+cq_add_all(struct margo_cq* cq, size_t count, margo_request* reqs, size_t* index)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (reqs[i] == MARGO_REQUEST_NULL) continue;
+        hg_return_t hret = cq_add(cq, reqs[i], (void*)(uintptr_t)i);
+        if (hret != HG_SUCCESS) {
+            cq_detach(cq, i, reqs);
+            *index = i;
+            return hret;
+        }
+    }
+    return HG_SUCCESS;
+}
+
+/* Polls the non-null requests of the array until at least one has completed
+ * and sets indices to the ones that have (only the first one if num_completed
+ * is NULL), taking them out of their user queue. *num_completed is set to 0 if
+ * there is no request. Unlike cq_add_all, this works for requests that are
+ * already in a user queue. */
+static hg_return_t poll_any(size_t         count,
+                            margo_request* req,
+                            size_t*        num_completed,
+                            size_t*        indices)
+{
+    size_t n;
+    bool   has_pending_requests;
+    do {
+        n                    = 0;
+        has_pending_requests = false;
+        for (size_t i = 0; i < count; i++) {
+            if (req[i] == MARGO_REQUEST_NULL) continue;
+            has_pending_requests = true;
+            int flag             = 0;
+            if (margo_test(req[i], &flag) != ABT_SUCCESS) {
+                // LCOV_EXCL_START
+                if (num_completed) *num_completed = 1;
+                indices[0] = i;
+                return HG_OTHER_ERROR;
+                // LCOV_EXCL_END
+            }
+            if (!flag) continue;
+            cq_remove(req[i]);
+            indices[n++] = i;
+            if (!num_completed) break; /* the first one is enough */
+        }
+        if (n == 0 && has_pending_requests) ABT_thread_yield();
+    } while (n == 0 && has_pending_requests);
+    if (num_completed) *num_completed = n;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_wait_any(size_t count, margo_request* req, size_t* index)
+{
+    struct margo_cq cq = {0};
+    margo_request   completed;
+    void*           uargs;
+
+    hg_return_t hret = cq_add_all(&cq, count, req, index);
+    if (hret == HG_BUSY) {
+        *index = count;
+        hret   = poll_any(count, req, NULL, index);
+        if (hret != HG_SUCCESS || *index == count) return hret;
+        return margo_wait(req[*index]);
+    }
+    if (hret != HG_SUCCESS) return hret;
+
+    size_t n = cq_wait(&cq, 1, &completed, &uargs, true);
+    cq_detach(&cq, count, req);
+    if (n == 0) {
+        *index = count;
+        return HG_SUCCESS;
+    }
+    *index = (size_t)(uintptr_t)uargs;
+    return margo_wait(completed);
+}
+
+hg_return_t margo_wait_some(size_t         count,
+                            margo_request* req,
+                            size_t*        num_completed,
+                            size_t*        indices,
+                            hg_return_t*   rets)
+{
+    struct margo_cq cq = {0};
+    margo_request   completed;
+    void*           uargs;
+    size_t          n = 0, index;
+
+    *num_completed   = 0;
+    hg_return_t hret = cq_add_all(&cq, count, req, &index);
+    if (hret == HG_BUSY) {
+        hret = poll_any(count, req, &n, indices);
+        if (hret != HG_SUCCESS) return hret;
+    } else if (hret != HG_SUCCESS) {
+        return hret;
+    } else {
+        /* block for the first completion, then take the ones already there */
+        while (cq_wait(&cq, 1, &completed, &uargs, n == 0) == 1)
+            indices[n++] = (size_t)(uintptr_t)uargs;
+        cq_detach(&cq, count, req);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        hg_return_t ret = margo_wait(req[indices[i]]);
+        req[indices[i]] = MARGO_REQUEST_NULL;
+        if (rets) rets[i] = ret;
+        if (hret == HG_SUCCESS) hret = ret;
+    }
+    *num_completed = n;
+    return hret;
+}
+
+hg_return_t margo_wait_all(size_t count, margo_request* req, hg_return_t* rets)
+{
+    /* waiting on each eventual in turn blocks until the last completion
+     * without polling, no completion queue is needed */
+    hg_return_t hret = HG_SUCCESS;
+    for (size_t i = 0; i < count; i++) {
+        hg_return_t ret = HG_SUCCESS;
+        if (req[i] != MARGO_REQUEST_NULL) {
+            ret    = margo_wait(req[i]);
+            req[i] = MARGO_REQUEST_NULL;
+        }
+        if (rets) rets[i] = ret;
+        if (hret == HG_SUCCESS) hret = ret;
+    }
+    return hret;
+}
@@ -0,0 +1,17 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __MARGO_CQ_H
+#define __MARGO_CQ_H
+
+#include <margo.h>
+
+// private function called by margo_cb when an eventual-based request
+// completes, before its eventual is set: queues the request in the completion
+// queue it was added to, if any, or marks it as completed so that
+// margo_cq_add queues it right away.
+void __margo_cq_request_completed(margo_request req);
+
+#endif
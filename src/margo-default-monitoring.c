@@ -11,6 +11,7 @@
 #include <json-c/json.h>
 #include "margo-macros.h"
 #include "margo-instance.h"
+#include "margo-handle-cache.h"
 #include "margo-monitoring.h"
 #include "margo-id.h"
 #ifdef __clang_analyzer__
@@ -241,15 +242,17 @@ origin_rpc_statistics_to_json(const origin_rpc_statistics_t* stats, bool reset);
 
 /* Statistics related to RPCs at their target */
 typedef struct target_rpc_statistics {
-    statistics_t   handler; /* handler timestamp isn't used */
-    statistics_t   ult[2];
-    statistics_t   respond[2];
-    statistics_t   respond_cb[2];
-    statistics_t   wait[2];
-    statistics_t   set_output[2];
-    statistics_t   get_input[2];
-    callpath_t     callpath; /* hash key */
-    UT_hash_handle hh;       /* hash handle */
+    statistics_t     handler; /* handler timestamp isn't used */
+    statistics_t     ult[2];
+    statistics_t     respond[2];
+    statistics_t     respond_cb[2];
+    statistics_t     wait[2];
+    statistics_t     set_output[2];
+    statistics_t     get_input[2];
+    _Atomic uint64_t num_shed;    /* RPCs rejected because of a full queue */
+    _Atomic uint64_t num_expired; /* RPCs dropped past their deadline */
+    callpath_t       callpath; /* hash key */
+    UT_hash_handle   hh;       /* hash handle */
 } target_rpc_statistics_t;
 
 static struct json_object*
@@ -1173,6 +1176,8 @@ static void __margo_default_monitor_on_rpc_handler(
             rpc_stats = session->target.stats;
             double t  = timestamp - event_args->uctx.f;
             UPDATE_STATISTICS_WITH(rpc_stats->handler, t);
+            if (event_args->ret == HG_BUSY) rpc_stats->num_shed += 1;
+            if (event_args->ret == HG_TIMEOUT) rpc_stats->num_expired += 1;
         }
     }
 }
@@ -1833,6 +1838,20 @@ target_rpc_statistics_to_json(const target_rpc_statistics_t* stats, bool reset)
     json_object_object_add_ex(handler, "duration",
                               statistics_to_json(&stats->handler, reset),
                               JSON_C_OBJECT_ADD_KEY_IS_NEW);
+    uint64_t num_shed
+        = reset ? atomic_exchange(&((target_rpc_statistics_t*)stats)->num_shed,
+                                  0)
+                : stats->num_shed;
+    json_object_object_add_ex(handler, "num_shed",
+                              json_object_new_uint64(num_shed),
+                              JSON_C_OBJECT_ADD_KEY_IS_NEW);
+    uint64_t num_expired
+        = reset ? atomic_exchange(
+              &((target_rpc_statistics_t*)stats)->num_expired, 0)
+                : stats->num_expired;
+    json_object_object_add_ex(handler, "num_expired",
+                              json_object_new_uint64(num_expired),
+                              JSON_C_OBJECT_ADD_KEY_IS_NEW);
 
     json_object_object_add_ex(
         json, "ult",
@@ -1931,6 +1950,60 @@ static void fill_json_with_rpc_info(struct json_object*            rpc_json,
                               JSON_C_OBJECT_ADD_KEY_IS_NEW);
 }
 
+/* Depth and share of service of each sub-queue of the "wfq_wait" pools.
+ * The counters are owned by the pools, so they are not reset. */
+static struct json_object*
+wfq_pools_statistics_to_json(const default_monitor_state_t* state)
+{
+    struct json_object* json = NULL;
+    margo_instance_id   mid  = state->mid;
+    __margo_abt_lock(mid->abt);
+    for (unsigned i = 0; i < mid->abt->pools_len; i++) {
+        const margo_abt_pool_t* pool = &mid->abt->pools[i];
+        if (!pool->kind || strcmp(pool->kind, "wfq_wait") != 0) continue;
+        size_t num_queues = margo_wfq_pool_get_stats(pool->pool, NULL, 0);
+        margo_wfq_queue_stats_t* stats
+            = calloc(num_queues ? num_queues : 1, sizeof(*stats));
+        if (!stats) continue;
+        /* sub-queues may have been added since the first call */
+        size_t n = margo_wfq_pool_get_stats(pool->pool, stats, num_queues);
+        if (n < num_queues) num_queues = n;
+        uint64_t total_served = 0;
+        for (size_t j = 0; j < num_queues; j++)
+            total_served += stats[j].num_served;
+        struct json_object* queues = json_object_new_object();
+        for (size_t j = 0; j < num_queues; j++) {
+            struct json_object* queue = json_object_new_object();
+            char                key[16];
+            snprintf(key, sizeof(key), "%d", stats[j].key);
+            json_object_object_add_ex(queue, "weight",
+                                      json_object_new_uint64(stats[j].weight),
+                                      JSON_C_OBJECT_ADD_KEY_IS_NEW);
+            json_object_object_add_ex(queue, "depth",
+                                      json_object_new_uint64(stats[j].depth),
+                                      JSON_C_OBJECT_ADD_KEY_IS_NEW);
+            json_object_object_add_ex(
+                queue, "num_served", json_object_new_uint64(stats[j].num_served),
+                JSON_C_OBJECT_ADD_KEY_IS_NEW);
+            json_object_object_add_ex(
+                queue, "share",
+                json_object_new_double(
+                    total_served ? (double)stats[j].num_served / total_served
+                                 : 0.0),
+                JSON_C_OBJECT_ADD_KEY_IS_NEW);
+            json_object_object_add(queues, key, queue);
+        }
+        free(stats);
+        struct json_object* pool_json = json_object_new_object();
+        json_object_object_add_ex(pool_json, "queues", queues,
+                                  JSON_C_OBJECT_ADD_KEY_IS_NEW);
+        if (!json) json = json_object_new_object();
+        json_object_object_add(json, pool->name, pool_json);
+    }
+    __margo_abt_unlock(mid->abt);
+    return json;
+}
+
 static struct json_object*
 monitor_statistics_to_json(const default_monitor_state_t* state, bool reset)
 {
@@ -2121,6 +2194,19 @@ monitor_statistics_to_json(const default_monitor_state_t* state, bool reset)
         ABT_mutex_unlock(
             ABT_MUTEX_MEMORY_GET_HANDLE(&state->bulk_transfer_stats_mtx));
     }
+    // weighted fair-queuing pools statistics (only if there are such pools)
+    struct json_object* wfq_pools = wfq_pools_statistics_to_json(state);
+    if (wfq_pools)
+        json_object_object_add_ex(json, "pools", wfq_pools,
+                                  JSON_C_OBJECT_ADD_KEY_IS_NEW);
+    // usage of the arenas recycling request and handle structures
+    json_object_object_add_ex(json, "arenas",
+                              __margo_arenas_stats_to_json(state->mid),
+                              JSON_C_OBJECT_ADD_KEY_IS_NEW);
+    // usage of the handle cache
+    json_object_object_add_ex(json, "handle_cache",
+                              __margo_handle_cache_stats_to_json(state->mid),
+                              JSON_C_OBJECT_ADD_KEY_IS_NEW);
     // add hostname and pid
     char hostname[1024];
     hostname[1023] = '\0';
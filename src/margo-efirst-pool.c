@@ -7,7 +7,10 @@
 #include <abt.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "margo-efirst-pool.h"
 
@@ -18,6 +21,19 @@
  * min-heap structure as an implementation of a priority queue.
  */
 
+/* ABT_POOL_EDF_WAIT */
+
+/* The same pool can order its units by deadline instead ("edf_wait" kind):
+ * the priority of a unit is then its deadline in microseconds, taken from
+ * margo_edf_pool_set_next_deadline when the unit is created, or set to
+ * EDF_DEFAULT_DEADLINE_USEC after its first push if no deadline was given,
+ * so that units without a deadline cannot be starved. The deadline is also
+ * stored on the ULT itself (in a key), so that the unit created for the ULT
+ * when it migrates or is pushed into another pool keeps it.
+ */
+
+#define EDF_DEFAULT_DEADLINE_USEC 1000000
+
 #define IS_IN_POOL 0x1
 #define IS_THREAD  0x2
 
@@ -188,10 +204,69 @@ static inline unit_t* queue_pop(queue_t* queue)
 typedef struct pool_t {
     queue_t*        queue;
     uint64_t        num; // number of new units created so far
+    bool            edf; // priorities are deadlines
     pthread_mutex_t mutex;
     pthread_cond_t  cond;
 } pool_t;
 
+/* deadline (in usec) of the next unit created by this ES, 0 if none */
+static _Thread_local uint64_t edf_next_deadline = 0;
+
+/* deadline (in usec) of a ULT, kept for the lifetime of the ULT */
+static ABT_key        edf_deadline_key      = ABT_KEY_NULL;
+static pthread_once_t edf_deadline_key_once = PTHREAD_ONCE_INIT;
+
+static void edf_deadline_key_create(void)
+{
+    ABT_key_create(NULL, &edf_deadline_key);
+}
+
+static void edf_store_deadline(ABT_thread thread, uint64_t deadline)
+{
+    ABT_thread_set_specific(thread, edf_deadline_key,
+                            (void*)(uintptr_t)deadline);
+}
+
+/* Deadline of a unit being created for the given ULT: the one given by
+ * margo_edf_pool_set_next_deadline, or the one the ULT already had */
+static uint64_t edf_unit_deadline(ABT_thread thread)
+{
+    uint64_t deadline = edf_next_deadline;
+    if (deadline) {
+        edf_store_deadline(thread, deadline);
+    } else {
+        void* value = NULL;
+        ABT_thread_get_specific(thread, edf_deadline_key, &value);
+        deadline = (uint64_t)(uintptr_t)value;
+    }
+    return deadline;
+}
+
+/* must use the same clock as margo_deadline_clock */
+static inline uint64_t edf_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void margo_edf_pool_set_next_deadline(double deadline)
+{
+    /* rounded, so that the value returned by the getter sets it back */
+    edf_next_deadline = deadline > 0 ? (uint64_t)(deadline * 1e6 + 0.5) : 0;
+}
+
+double margo_edf_pool_get_next_deadline(void)
+{
+    return edf_next_deadline / 1e6;
+}
+
+double margo_edf_pool_get_unit_deadline(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->priority / 1e6;
+}
+
 static ABT_unit_type pool_unit_get_type(ABT_unit unit)
 {
     unit_t* p_unit = (unit_t*)unit;
@@ -235,6 +310,22 @@ static ABT_unit pool_unit_create_from_task(ABT_task task)
     return (ABT_unit)p_unit;
 }
 
+static ABT_unit edf_unit_create_from_thread(ABT_thread thread)
+{
+    unit_t* p_unit   = (unit_t*)pool_unit_create_from_thread(thread);
+    p_unit->priority = edf_unit_deadline(thread);
+    return (ABT_unit)p_unit;
+}
+
+static ABT_unit edf_unit_create_from_task(ABT_task task)
+{
+    /* a tasklet runs to completion once popped, so its unit is never
+     * re-created and its deadline does not need to be kept on it */
+    unit_t* p_unit   = (unit_t*)pool_unit_create_from_task(task);
+    p_unit->priority = edf_next_deadline;
+    return (ABT_unit)p_unit;
+}
+
 static void pool_unit_free(ABT_unit* p_unit)
 {
     free(*p_unit);
@@ -252,6 +343,16 @@ static int pool_init(ABT_pool pool, ABT_pool_config config)
     return ABT_SUCCESS;
 }
 
+static int edf_pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    int ret = pool_init(pool, config);
+    if (ret != ABT_SUCCESS) return ret;
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    p_pool->edf = true;
+    return ABT_SUCCESS;
+}
+
 static size_t pool_get_size(ABT_pool pool)
 {
     pool_t* p_pool;
@@ -266,10 +367,18 @@ static void pool_push(ABT_pool pool, ABT_unit unit)
     pool_t* p_pool;
     ABT_pool_get_data(pool, (void**)&p_pool);
     unit_t* p_unit = (unit_t*)unit;
+    bool    is_new = p_unit->priority == 0;
+    if (is_new && p_pool->edf) {
+        /* the unit is not in the pool yet, so its deadline can be set (and
+         * stored on its ULT, which may allocate) before taking the lock */
+        p_unit->priority = edf_now() + EDF_DEFAULT_DEADLINE_USEC;
+        if (p_unit->flag & IS_THREAD)
+            edf_store_deadline(p_unit->thread, p_unit->priority);
+    }
     pthread_mutex_lock(&p_pool->mutex);
-    if (p_unit->priority == 0) {
+    if (is_new) {
         p_pool->num += 1;
-        p_unit->priority = p_pool->num;
+        if (!p_pool->edf) p_unit->priority = p_pool->num;
     }
     queue_push(p_pool->queue, p_unit);
     pthread_cond_signal(&p_pool->cond);
@@ -350,3 +459,12 @@ void margo_create_efirst_pool_def(ABT_pool_def* p_def)
     p_def->p_free               = pool_free;
     p_def->p_print_all          = NULL; /* Optional */
 }
+
+void margo_create_edf_pool_def(ABT_pool_def* p_def)
+{
+    pthread_once(&edf_deadline_key_once, edf_deadline_key_create);
+    margo_create_efirst_pool_def(p_def);
+    p_def->u_create_from_thread = edf_unit_create_from_thread;
+    p_def->u_create_from_task   = edf_unit_create_from_task;
+    p_def->p_init               = edf_pool_init;
+}
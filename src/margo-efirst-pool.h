@@ -15,6 +15,20 @@ extern "C" {
 
 void margo_create_efirst_pool_def(ABT_pool_def* p_def);
 
+void margo_create_edf_pool_def(ABT_pool_def* p_def);
+
+/* Sets the deadline (in seconds, on the margo_deadline_clock clock) of the
+ * units that the calling execution stream creates next in "edf_wait" pools,
+ * until it is reset with a deadline of 0. */
+void margo_edf_pool_set_next_deadline(double deadline);
+
+/* Deadline last set by the calling execution stream (0 if none), so that it
+ * can be restored after being changed temporarily */
+double margo_edf_pool_get_next_deadline(void);
+
+/* Deadline (in seconds, 0 if none yet) of a unit of an "edf_wait" pool */
+double margo_edf_pool_get_unit_deadline(ABT_unit unit);
+
 #ifdef __cplusplus
 }
 #endif
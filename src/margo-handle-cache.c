@@ -4,93 +4,751 @@
  * See COPYRIGHT in top-level directory.
  */
 #include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 #include "margo-instance.h"
+#include "margo-macros.h"
 #include "margo-handle-cache.h"
 
+/* The free handles are spread across shards, one per execution stream at
+ * initialization (rounded up to a power of 2, up to
+ * MARGO_HANDLE_CACHE_MAX_SHARDS). A ULT gets and puts handles from the shard
+ * of the ES it runs on (by rank, wrapping around for ESs added later), so
+ * that ESs creating and destroying handles concurrently do not contend on a
+ * single lock. When its shard is empty, a ULT steals from the other shards,
+ * taking half of the first non-empty one so that the next gets on its ES
+ * find handles locally. Handles are put back in the shard of the ES that
+ * destroys them, which is where they are likely to be needed next. */
+#define MARGO_HANDLE_CACHE_MAX_SHARDS 64
+#define CACHE_LINE_SIZE               64
+
 struct margo_handle_cache_el {
     hg_handle_t                   handle;
-    struct margo_handle_cache_el* next; /* free list link */
+    struct margo_handle_cache_el* next; /* free list or hash chain link */
+    /* destination given to margo_create, and LRU links while the handle is
+     * parked in the destination-affine cache */
+    hg_addr_t                     addr;
+    hg_id_t                       id;
+    struct margo_handle_cache_el* lru_prev;
+    struct margo_handle_cache_el* lru_next;
+};
+
+/* Destination-affine cache (see "handle_cache_affinity_size" in the margo
+ * configuration). A handle released by margo_destroy is parked in a hash
+ * table keyed by the address and RPC id it was created for, still bound to
+ * that address and to the id it was last forwarded with (which includes the
+ * provider id). margo_create hands it back for the same address and RPC id
+ * without calling HG_Reset, and the provider forward does not reset it
+ * either if it is sent to the same provider again. When the cache is full,
+ * the least recently parked handle goes back to the shards. The key uses
+ * the hg_addr_t itself: parked handles hold a reference to their address,
+ * so it cannot be freed and reused for another destination while they are
+ * in the cache. */
+struct margo_handle_affinity {
+    ABT_mutex_memory               mtx;
+    size_t                         capacity;
+    size_t                         count;
+    size_t                         num_buckets; /* power of 2 */
+    struct margo_handle_cache_el** buckets;
+    struct margo_handle_cache_el*  lru_head; /* most recently parked */
+    struct margo_handle_cache_el*  lru_tail;
+    /* handles taken from and parked in the table, written under the lock */
+    _Atomic size_t num_gets;
+    _Atomic size_t num_puts;
 };
 
-hg_return_t __margo_handle_cache_init(margo_instance_id mid,
-                                      size_t            handle_cache_size)
+struct margo_handle_cache_shard {
+    _Alignas(CACHE_LINE_SIZE) ABT_mutex_memory mtx;
+    struct margo_handle_cache_el* free_list;
+    size_t                        count;
+    /* handles handed out by and returned to this shard, written under the
+     * lock (moves between shards and from the affine table are not
+     * counted), read without it by __margo_handle_cache_in_use */
+    _Atomic size_t num_gets;
+    _Atomic size_t num_puts;
+};
+
+/* Usage counters and self-tuning state (see "handle_cache_tuning" in the
+ * margo configuration). The counters of handles handed out and returned are
+ * kept per shard so that the fast path does not share a cache line between
+ * ESs; the number of handles in use is their difference, plus the handles
+ * that margo_create had to HG_Create after a miss and that are not destroyed
+ * yet. The peak number of handles in use is sampled every time a handle is
+ * handed out, from the cache or after a miss, and on every tick of the
+ * tuning timer (the samples only read the counters, and only write the
+ * peaks when they grow). If tuning is enabled, miss_threshold
+ * misses since the cache last changed size make the ULT seeing the last one
+ * start a ULT in the progress pool that adds grow_batch handles (up to
+ * max_size), so that the miss itself only costs one HG_Create, and every
+ * shrink_interval_ms
+ * without misses the timer removes up to grow_batch free handles, keeping
+ * at least grow_batch more than the peak use over the interval and never
+ * going below the initial handle_cache_size. */
+struct margo_handle_cache_tuner {
+    _Atomic size_t   size;        /* current number of cached handles */
+    _Atomic size_t   num_misses;
+    _Atomic size_t   num_uncached; /* handles created after a miss, in use */
+    _Atomic size_t   peak_in_use;
+    _Atomic size_t   interval_peak_in_use;
+    _Atomic size_t   misses_since_resize;
+    _Atomic size_t   num_grown;
+    _Atomic size_t   num_shrunk;
+    _Atomic bool     resizing;
+    ABT_thread       grow_ult;   /* last ULT started by cache_grow */
+    unsigned         grow_shard; /* shard to which it adds handles */
+    size_t           last_tick_misses;
+    /* counters of the shards and affine table, once they are destroyed */
+    size_t           retired_gets;
+    size_t           retired_puts;
+    /* configuration, tuning is disabled if max_size is 0 */
+    size_t           initial_size;
+    size_t           max_size;
+    size_t           grow_batch;
+    size_t           miss_threshold;
+    unsigned         shrink_interval_ms;
+    margo_timer_t    timer;
+};
+
+#define SHARD_LOCK(s) ABT_mutex_spinlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(s)->mtx))
+#define SHARD_UNLOCK(s) ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(s)->mtx))
+#define AFFINITY_LOCK(a) \
+    ABT_mutex_spinlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(a)->mtx))
+#define AFFINITY_UNLOCK(a) \
+    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(a)->mtx))
+
+static inline unsigned shard_index(margo_instance_id mid)
 {
-    struct margo_handle_cache_el* el;
-    hg_return_t                   hret = HG_SUCCESS;
+    int rank;
+    if (ABT_self_get_xstream_rank(&rank) != ABT_SUCCESS || rank < 0) return 0;
+    return (unsigned)rank & (mid->handle_cache_num_shards - 1);
+}
+
+static inline void counter_incr(_Atomic size_t* counter)
+{
+    /* only incremented with the lock held, so a load/store pair suffices */
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+}
 
-    ABT_mutex_create(&(mid->handle_cache_mtx));
+/* count is false for handles that are not returned by a caller (new handles,
+ * handles moved out of the affine table) */
+static inline void shard_push(struct margo_handle_cache_shard* shard,
+                              struct margo_handle_cache_el*    el,
+                              bool                             count)
+{
+    SHARD_LOCK(shard);
+    LL_PREPEND(shard->free_list, el);
+    shard->count++;
+    if (count) counter_incr(&shard->num_puts);
+    SHARD_UNLOCK(shard);
+}
 
-    for (unsigned i = 0; i < handle_cache_size; i++) {
-        el = malloc(sizeof(*el));
+/* count is false for handles that are not handed out (removed handles) */
+static inline struct margo_handle_cache_el*
+shard_pop(struct margo_handle_cache_shard* shard, bool count)
+{
+    SHARD_LOCK(shard);
+    struct margo_handle_cache_el* el = shard->free_list;
+    if (el) {
+        shard->free_list = el->next;
+        shard->count--;
+        if (count) counter_incr(&shard->num_gets);
+    }
+    SHARD_UNLOCK(shard);
+    return el;
+}
+
+/* Takes one element for the caller and half of the remaining ones of the
+ * first non-empty shard other than the caller's, moving the latter into the
+ * caller's shard. */
+static struct margo_handle_cache_el* shard_steal(margo_instance_id mid,
+                                                 unsigned          self)
+{
+    unsigned n = mid->handle_cache_num_shards;
+    for (unsigned i = 1; i < n; i++) {
+        struct margo_handle_cache_shard* victim
+            = &mid->handle_cache_shards[(self + i) & (n - 1)];
+        /* racy peek to skip empty shards without taking their lock */
+        if (!victim->free_list) continue;
+
+        SHARD_LOCK(victim);
+        struct margo_handle_cache_el* el = victim->free_list;
         if (!el) {
-            margo_error(mid,
-                        "Could not allocate handle cache element (%u/%zu)", i,
-                        handle_cache_size);
-            hret = HG_NOMEM_ERROR;
+            SHARD_UNLOCK(victim);
+            continue;
+        }
+        size_t                        num_stolen = (victim->count - 1) / 2;
+        struct margo_handle_cache_el* head       = el->next;
+        struct margo_handle_cache_el* tail       = el;
+        for (size_t j = 0; j < num_stolen; j++) tail = tail->next;
+        victim->free_list = tail->next;
+        victim->count -= num_stolen + 1;
+        counter_incr(&victim->num_gets);
+        SHARD_UNLOCK(victim);
+
+        if (num_stolen) {
+            struct margo_handle_cache_shard* shard
+                = &mid->handle_cache_shards[self];
+            SHARD_LOCK(shard);
+            tail->next       = shard->free_list;
+            shard->free_list = head;
+            shard->count += num_stolen;
+            SHARD_UNLOCK(shard);
+        }
+        el->next = NULL;
+        return el;
+    }
+    return NULL;
+}
+
+static inline struct margo_handle_cache_el**
+affinity_bucket(struct margo_handle_affinity* a, hg_addr_t addr, hg_id_t id)
+{
+    uint64_t h = ((uint64_t)(uintptr_t)addr >> 4) ^ (uint64_t)id;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return &a->buckets[(h >> 32) & (a->num_buckets - 1)];
+}
+
+/* Removes a parked element from its hash chain and from the LRU list.
+ * Must be called with the affinity cache locked. */
+static void affinity_unlink(struct margo_handle_affinity* a,
+                            struct margo_handle_cache_el* el)
+{
+    struct margo_handle_cache_el** p = affinity_bucket(a, el->addr, el->id);
+    while (*p != el) p = &(*p)->next;
+    *p = el->next;
+    if (el->lru_prev)
+        el->lru_prev->lru_next = el->lru_next;
+    else
+        a->lru_head = el->lru_next;
+    if (el->lru_next)
+        el->lru_next->lru_prev = el->lru_prev;
+    else
+        a->lru_tail = el->lru_prev;
+    el->next = el->lru_prev = el->lru_next = NULL;
+    a->count--;
+}
+
+/* Returns the most recently parked element for (addr, id), or NULL */
+static struct margo_handle_cache_el*
+affinity_take(struct margo_handle_affinity* a, hg_addr_t addr, hg_id_t id)
+{
+    AFFINITY_LOCK(a);
+    struct margo_handle_cache_el* el = *affinity_bucket(a, addr, id);
+    while (el && (el->addr != addr || el->id != id)) el = el->next;
+    if (el) {
+        affinity_unlink(a, el);
+        counter_incr(&a->num_gets);
+    }
+    AFFINITY_UNLOCK(a);
+    return el;
+}
+
+/* Parks an element, returning the element evicted to make room, if any */
+static struct margo_handle_cache_el*
+affinity_park(struct margo_handle_affinity* a, struct margo_handle_cache_el* el)
+{
+    struct margo_handle_cache_el* victim = NULL;
+    AFFINITY_LOCK(a);
+    if (a->count == a->capacity) {
+        victim = a->lru_tail;
+        affinity_unlink(a, victim);
+    }
+    struct margo_handle_cache_el** bucket = affinity_bucket(a, el->addr, el->id);
+    el->next     = *bucket;
+    *bucket      = el;
+    el->lru_prev = NULL;
+    el->lru_next = a->lru_head;
+    if (a->lru_head)
+        a->lru_head->lru_prev = el;
+    else
+        a->lru_tail = el;
+    a->lru_head = el;
+    a->count++;
+    counter_incr(&a->num_puts);
+    AFFINITY_UNLOCK(a);
+    return victim;
+}
+
+static struct margo_handle_affinity* affinity_create(size_t capacity)
+{
+    struct margo_handle_affinity* a = calloc(1, sizeof(*a));
+    if (!a) return NULL;
+    /* the mutex is statically initialized by calloc */
+    a->capacity    = capacity;
+    a->num_buckets = 1;
+    while (a->num_buckets < 2 * capacity) a->num_buckets *= 2;
+    a->buckets = calloc(a->num_buckets, sizeof(*a->buckets));
+    if (!a->buckets) {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+/* Creates a cache element wrapping a new handle */
+static hg_return_t cache_el_create(margo_instance_id              mid,
+                                   struct margo_handle_cache_el** el_out)
+{
+    hg_return_t                   hret;
+    struct margo_handle_cache_el* el = calloc(1, sizeof(*el));
+    if (!el) {
+        margo_error(mid, "Could not allocate handle cache element");
+        return HG_NOMEM_ERROR;
+    }
+
+    /* create handle with NULL_ADDRs, we will reset later to valid addrs;
+     * handles are spread across the instance's contexts */
+    hret = HG_Create(__margo_next_hg_context(mid), HG_ADDR_NULL, 0,
+                     &el->handle);
+    if (hret != HG_SUCCESS) {
+        margo_error(mid, "Could not create cached handle: HG_Create: %s",
+                    HG_Error_to_string(hret));
+        free(el);
+        return hret;
+    }
+
+    /* Pre-attach a margo_handle_data carrying a back-pointer to this cache
+     * element. HG_Reset preserves handle data, so this link is permanent
+     * for the lifetime of the cached handle and lets __margo_handle_cache_put
+     * recycle the handle in O(1) without any lookup or caller bookkeeping. */
+    struct margo_handle_data* data = calloc(1, sizeof(*data));
+    if (!data) {
+        margo_error(mid, "Could not allocate handle data for cached handle");
+        HG_Destroy(el->handle);
+        free(el);
+        return HG_NOMEM_ERROR;
+    }
+    data->cache_el = el;
+    hret           = HG_Set_data(el->handle, data, __margo_handle_data_free);
+    if (hret != HG_SUCCESS) {
+        margo_error(mid,
+                    "Could not attach data to cached handle: HG_Set_data: %s",
+                    HG_Error_to_string(hret));
+        free(data);
+        HG_Destroy(el->handle);
+        free(el);
+        return hret;
+    }
+
+    *el_out = el;
+    return HG_SUCCESS;
+}
+
+bool __margo_handle_cache_validate_json(const struct json_object* tuning,
+                                        size_t handle_cache_size)
+{
+    struct json_object* ignore = NULL;
+    if (!tuning) return true;
+
+#define HANDLE_CONFIG_ERROR return false
+
+    /* Fields:
+       - [optional] max_size: integer >= handle_cache_size (default 4 times
+                    handle_cache_size, or 4 times grow_batch if it is 0)
+       - [optional] grow_batch: integer > 0 (default 32)
+       - [optional] miss_threshold: integer > 0 (default 16)
+       - [optional] shrink_interval_ms: integer > 0 (default 1000)
+    */
+
+    if (!json_object_is_type(tuning, json_type_object)) {
+        margo_error(0, "\"handle_cache_tuning\" field in configuration "
+                       "should be an object");
+        HANDLE_CONFIG_ERROR;
+    }
+
+    ASSERT_CONFIG_HAS_OPTIONAL(tuning, "max_size", int, "handle_cache_tuning");
+    ASSERT_CONFIG_HAS_OPTIONAL(tuning, "grow_batch", int,
+                               "handle_cache_tuning");
+    ASSERT_CONFIG_HAS_OPTIONAL(tuning, "miss_threshold", int,
+                               "handle_cache_tuning");
+    ASSERT_CONFIG_HAS_OPTIONAL(tuning, "shrink_interval_ms", int,
+                               "handle_cache_tuning");
+
+    if (CONFIG_HAS(tuning, "max_size", ignore)
+        && json_object_get_int64(ignore) < (int64_t)handle_cache_size) {
+        margo_error(0,
+                    "\"handle_cache_tuning.max_size\" should be greater "
+                    "than or equal to \"handle_cache_size\"");
+        HANDLE_CONFIG_ERROR;
+    }
+    const char* positive_fields[]
+        = {"grow_batch", "miss_threshold", "shrink_interval_ms"};
+    for (unsigned i = 0; i < 3; i++) {
+        if (CONFIG_HAS(tuning, positive_fields[i], ignore)
+            && json_object_get_int64(ignore) <= 0) {
+            margo_error(0,
+                        "\"handle_cache_tuning.%s\" should be strictly "
+                        "positive",
+                        positive_fields[i]);
+            HANDLE_CONFIG_ERROR;
+        }
+    }
+    return true;
+#undef HANDLE_CONFIG_ERROR
+}
+
+hg_return_t __margo_handle_cache_init(margo_instance_id         mid,
+                                      size_t                    handle_cache_size,
+                                      const struct json_object* tuning)
+{
+    struct margo_handle_cache_el* el;
+    hg_return_t                   hret       = HG_SUCCESS;
+    unsigned                      num_shards = 1;
+
+    struct margo_handle_cache_tuner* t = calloc(1, sizeof(*t));
+    if (!t) {
+        margo_error(mid, "Could not allocate handle cache counters");
+        return HG_NOMEM_ERROR;
+    }
+    t->initial_size = handle_cache_size;
+    if (tuning) {
+        t->grow_batch
+            = json_object_object_get_uint64_or(tuning, "grow_batch", 32);
+        t->max_size = json_object_object_get_uint64_or(
+            tuning, "max_size",
+            handle_cache_size ? 4 * handle_cache_size : 4 * t->grow_batch);
+        t->miss_threshold
+            = json_object_object_get_uint64_or(tuning, "miss_threshold", 16);
+        t->shrink_interval_ms = json_object_object_get_uint64_or(
+            tuning, "shrink_interval_ms", 1000);
+    }
+    mid->handle_cache_tuner = t;
+
+    while (num_shards < mid->abt->xstreams_len
+           && num_shards < MARGO_HANDLE_CACHE_MAX_SHARDS)
+        num_shards *= 2;
+    mid->handle_cache_shards = aligned_alloc(
+        CACHE_LINE_SIZE, num_shards * sizeof(*mid->handle_cache_shards));
+    if (!mid->handle_cache_shards) {
+        margo_error(mid, "Could not allocate handle cache shards");
+        return HG_NOMEM_ERROR;
+    }
+    /* the shards' mutexes are statically initialized by the memset */
+    memset(mid->handle_cache_shards, 0,
+           num_shards * sizeof(*mid->handle_cache_shards));
+    mid->handle_cache_num_shards = num_shards;
+
+    if (mid->handle_cache_affinity_size) {
+        mid->handle_affinity = affinity_create(mid->handle_cache_affinity_size);
+        if (!mid->handle_affinity) {
+            margo_error(mid, "Could not allocate destination-affine handle "
+                             "cache");
             __margo_handle_cache_destroy(mid);
-            break;
+            return HG_NOMEM_ERROR;
         }
+    }
 
-        /* create handle with NULL_ADDRs, we will reset later to valid addrs */
-        hret = HG_Create(mid->hg.hg_context, HG_ADDR_NULL, 0, &el->handle);
+    /* handles are created on the contexts in turn, so each shard takes as
+     * many consecutive handles as there are contexts (otherwise, with an
+     * even number of shards and two contexts, each shard would only hold
+     * handles of one context) */
+    unsigned num_contexts = mid->num_progress_contexts + 1;
+    for (unsigned i = 0; i < handle_cache_size; i++) {
+        hret = cache_el_create(mid, &el);
         if (hret != HG_SUCCESS) {
-            margo_error(mid, "Could not create cached handle: HG_Create: %s",
-                        HG_Error_to_string(hret));
-            free(el);
+            margo_error(mid, "Could not fill the handle cache (%u/%zu)", i,
+                        handle_cache_size);
             __margo_handle_cache_destroy(mid);
             break;
         }
+        /* add to the free list of a shard, round-robin */
+        shard_push(
+            &mid->handle_cache_shards[(i / num_contexts) & (num_shards - 1)],
+            el, false);
+    }
+    if (hret == HG_SUCCESS) t->size = handle_cache_size;
+
+    return hret;
+}
+
+/* Number of handles handed out by the cache since it was created */
+static size_t count_hits(margo_instance_id mid)
+{
+    size_t num_gets = mid->handle_cache_tuner->retired_gets;
+    for (unsigned i = 0; i < mid->handle_cache_num_shards; i++)
+        num_gets += atomic_load_explicit(
+            &mid->handle_cache_shards[i].num_gets, memory_order_relaxed);
+    if (mid->handle_affinity)
+        num_gets += atomic_load_explicit(&mid->handle_affinity->num_gets,
+                                         memory_order_relaxed);
+    return num_gets;
+}
+
+void __margo_handle_cache_free_counters(margo_instance_id mid)
+{
+    free(mid->handle_cache_tuner);
+    mid->handle_cache_tuner = NULL;
+}
+
+void __margo_handle_cache_destroy(margo_instance_id mid)
+{
+    struct margo_handle_cache_el *el, *tmp;
+
+    /* the counters outlive the cache, since the default monitor reports
+     * them when finalized (see __margo_handle_cache_free_counters) */
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (t) {
+        size_t in_use = __margo_handle_cache_in_use(mid)
+                      - atomic_load_explicit(&t->num_uncached,
+                                             memory_order_relaxed);
+        t->retired_gets = count_hits(mid);
+        t->retired_puts = t->retired_gets - in_use;
+    }
 
-        /* Pre-attach a margo_handle_data carrying a back-pointer to this cache
-         * element. HG_Reset preserves handle data, so this link is permanent
-         * for the lifetime of the cached handle and lets __margo_handle_cache_put
-         * recycle the handle in O(1) without any lookup or caller bookkeeping. */
-        struct margo_handle_data* data = calloc(1, sizeof(*data));
-        if (!data) {
-            margo_error(mid, "Could not allocate handle data for cached handle");
+    /* parked handles are destroyed like the free ones */
+    struct margo_handle_affinity* a = mid->handle_affinity;
+    if (a) {
+        while (a->lru_head) {
+            el = a->lru_head;
+            affinity_unlink(a, el);
             HG_Destroy(el->handle);
             free(el);
-            hret = HG_NOMEM_ERROR;
-            __margo_handle_cache_destroy(mid);
-            break;
         }
-        data->cache_el = el;
-        hret           = HG_Set_data(el->handle, data, __margo_handle_data_free);
-        if (hret != HG_SUCCESS) {
-            margo_error(mid,
-                        "Could not attach data to cached handle: HG_Set_data: %s",
-                        HG_Error_to_string(hret));
-            free(data);
+        free(a->buckets);
+        free(a);
+        mid->handle_affinity = NULL;
+    }
+
+    if (!mid->handle_cache_shards) return;
+
+    /* only free elements still on the free lists -- handles currently in use
+     * are owned by the application and will be released via margo_destroy.
+     * HG_Destroy releases each handle's attached data via __margo_handle_data_free. */
+    for (unsigned i = 0; i < mid->handle_cache_num_shards; i++) {
+        struct margo_handle_cache_shard* shard = &mid->handle_cache_shards[i];
+        LL_FOREACH_SAFE(shard->free_list, el, tmp)
+        {
+            LL_DELETE(shard->free_list, el);
             HG_Destroy(el->handle);
             free(el);
-            __margo_handle_cache_destroy(mid);
-            break;
         }
+    }
+
+    free(mid->handle_cache_shards);
+    mid->handle_cache_shards     = NULL;
+    mid->handle_cache_num_shards = 0;
 
-        /* add to the free list */
-        LL_PREPEND(mid->free_handle_list, el);
+    return;
+}
+
+size_t __margo_handle_cache_in_use(margo_instance_id mid)
+{
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    /* counts of different shards may not match (a handle taken from one
+     * shard can be returned to another), only their sums are meaningful;
+     * unsigned wrap-around makes the difference right */
+    size_t num_gets = t->retired_gets, num_puts = t->retired_puts;
+    for (unsigned i = 0; i < mid->handle_cache_num_shards; i++) {
+        struct margo_handle_cache_shard* shard = &mid->handle_cache_shards[i];
+        num_gets += atomic_load_explicit(&shard->num_gets, memory_order_relaxed);
+        num_puts += atomic_load_explicit(&shard->num_puts, memory_order_relaxed);
+    }
+    struct margo_handle_affinity* a = mid->handle_affinity;
+    if (a) {
+        num_gets += atomic_load_explicit(&a->num_gets, memory_order_relaxed);
+        num_puts += atomic_load_explicit(&a->num_puts, memory_order_relaxed);
     }
+    size_t in_use = num_gets - num_puts;
+    /* the counters are read without synchronization, so they may be
+     * slightly inconsistent */
+    size_t size = atomic_load_explicit(&t->size, memory_order_relaxed);
+    if (in_use > size) in_use = size;
+    return in_use + atomic_load_explicit(&t->num_uncached, memory_order_relaxed);
+}
 
-    return hret;
+static void atomic_size_max(_Atomic size_t* x, size_t v)
+{
+    size_t cur = atomic_load_explicit(x, memory_order_relaxed);
+    while (cur < v
+           && !atomic_compare_exchange_weak_explicit(
+               x, &cur, v, memory_order_relaxed, memory_order_relaxed))
+        ;
 }
 
-void __margo_handle_cache_destroy(margo_instance_id mid)
+static size_t sample_in_use(margo_instance_id mid)
 {
-    struct margo_handle_cache_el *el, *tmp;
+    struct margo_handle_cache_tuner* t      = mid->handle_cache_tuner;
+    size_t                           in_use = __margo_handle_cache_in_use(mid);
+    atomic_size_max(&t->peak_in_use, in_use);
+    atomic_size_max(&t->interval_peak_in_use, in_use);
+    return in_use;
+}
 
-    /* only free elements still on the free list -- handles currently in use are
-     * owned by the application and will be released via margo_destroy.
-     * HG_Destroy releases each handle's attached data via __margo_handle_data_free. */
-    LL_FOREACH_SAFE(mid->free_handle_list, el, tmp)
-    {
-        LL_DELETE(mid->free_handle_list, el);
+/* Adds grow_batch handles (up to max_size) to the shard that missed */
+static void cache_grow_ult(void* arg)
+{
+    margo_instance_id                mid = (margo_instance_id)arg;
+    struct margo_handle_cache_tuner* t   = mid->handle_cache_tuner;
+    size_t size = atomic_load_explicit(&t->size, memory_order_relaxed);
+    size_t n    = t->max_size > size ? t->max_size - size : 0;
+    if (n > t->grow_batch) n = t->grow_batch;
+    size_t num_added = 0;
+    for (; num_added < n; num_added++) {
+        struct margo_handle_cache_el* el;
+        if (cache_el_create(mid, &el) != HG_SUCCESS) break;
+        shard_push(&mid->handle_cache_shards[t->grow_shard], el, false);
+        atomic_fetch_add_explicit(&t->size, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&t->num_grown, num_added, memory_order_relaxed);
+    atomic_store_explicit(&t->misses_since_resize, 0, memory_order_relaxed);
+    if (num_added)
+        margo_debug(mid, "[handle cache] Grew by %zu handles to %zu", num_added,
+                    size + num_added);
+    atomic_store_explicit(&t->resizing, false, memory_order_release);
+}
+
+/* Starts a ULT growing the given shard. Only one ULT resizes the cache at a
+ * time, others return immediately. */
+static void cache_grow(margo_instance_id mid, unsigned self)
+{
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (atomic_exchange_explicit(&t->resizing, true, memory_order_acquire))
+        return;
+    /* the previous ULT has cleared resizing, so it is done or about to be */
+    if (t->grow_ult != ABT_THREAD_NULL) ABT_thread_free(&t->grow_ult);
+    t->grow_shard = self;
+    int ret = ABT_thread_create(MARGO_PROGRESS_POOL(mid), cache_grow_ult, mid,
+                                ABT_THREAD_ATTR_NULL, &t->grow_ult);
+    if (ret != ABT_SUCCESS) {
+        t->grow_ult = ABT_THREAD_NULL;
+        atomic_store_explicit(&t->resizing, false, memory_order_release);
+    }
+}
+
+/* Removes up to n free handles from the shards, returns how many */
+static size_t cache_shrink(margo_instance_id mid, size_t n)
+{
+    size_t   num_removed = 0;
+    unsigned num_empty   = 0;
+    for (unsigned i = 0; num_removed < n && num_empty < mid->handle_cache_num_shards;
+         i = (i + 1) & (mid->handle_cache_num_shards - 1)) {
+        struct margo_handle_cache_el* el
+            = shard_pop(&mid->handle_cache_shards[i], false);
+        if (!el) {
+            num_empty++;
+            continue;
+        }
+        num_empty = 0;
         HG_Destroy(el->handle);
         free(el);
+        num_removed++;
     }
+    return num_removed;
+}
 
-    ABT_mutex_free(&mid->handle_cache_mtx);
+static void tuning_timer_cb(void* arg)
+{
+    margo_instance_id                mid = (margo_instance_id)arg;
+    struct margo_handle_cache_tuner* t   = mid->handle_cache_tuner;
 
-    return;
+    sample_in_use(mid);
+    size_t peak = atomic_exchange_explicit(&t->interval_peak_in_use, 0,
+                                           memory_order_relaxed);
+    size_t num_misses
+        = atomic_load_explicit(&t->num_misses, memory_order_relaxed);
+    bool idle             = num_misses == t->last_tick_misses;
+    t->last_tick_misses   = num_misses;
+
+    if (idle
+        && !atomic_exchange_explicit(&t->resizing, true,
+                                     memory_order_acquire)) {
+        size_t size   = atomic_load_explicit(&t->size, memory_order_relaxed);
+        size_t target = peak + t->grow_batch;
+        if (target < t->initial_size) target = t->initial_size;
+        if (size > target) {
+            size_t n = size - target;
+            if (n > t->grow_batch) n = t->grow_batch;
+            n = cache_shrink(mid, n);
+            atomic_fetch_sub_explicit(&t->size, n, memory_order_relaxed);
+            atomic_fetch_add_explicit(&t->num_shrunk, n, memory_order_relaxed);
+            atomic_store_explicit(&t->misses_since_resize, 0,
+                                  memory_order_relaxed);
+            if (n)
+                margo_debug(mid, "[handle cache] Shrank by %zu handles to %zu",
+                            n, size - n);
+        }
+        atomic_store_explicit(&t->resizing, false, memory_order_release);
+    }
+
+    /* fails if margo_finalize is canceling the timer */
+    margo_timer_start(t->timer, t->shrink_interval_ms);
+}
+
+void __margo_handle_cache_start_tuning(margo_instance_id mid)
+{
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (!t || !t->max_size) return;
+    margo_timer_create_with_pool(mid, tuning_timer_cb, mid,
+                                 MARGO_PROGRESS_POOL(mid), &t->timer);
+    margo_timer_start(t->timer, t->shrink_interval_ms);
+}
+
+void __margo_handle_cache_stop_tuning(margo_instance_id mid)
+{
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (!t || !t->timer) return;
+    margo_timer_cancel(t->timer);
+    margo_timer_destroy(t->timer);
+    t->timer = NULL;
+    /* keep resizing set so that no other growing ULT is started, and wait
+     * for the current one before the cache is destroyed */
+    while (atomic_exchange_explicit(&t->resizing, true, memory_order_acquire))
+        ABT_thread_yield();
+    if (t->grow_ult != ABT_THREAD_NULL) ABT_thread_free(&t->grow_ult);
+}
+
+void __margo_handle_cache_track(margo_instance_id mid, hg_handle_t handle)
+{
+    struct margo_handle_data* data
+        = (struct margo_handle_data*)HG_Get_data(handle);
+    if (!data || data->cache_el) return;
+    data->uncached = true;
+    atomic_fetch_add_explicit(&mid->handle_cache_tuner->num_uncached, 1,
+                              memory_order_relaxed);
+    sample_in_use(mid);
+}
+
+struct json_object* __margo_handle_cache_stats_to_json(margo_instance_id mid)
+{
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (!t) return NULL;
+    struct json_object* json     = json_object_new_object();
+    size_t              in_use   = sample_in_use(mid);
+    size_t num_hits = count_hits(mid);
+#define ADD_SIZE(__name__, __value__) \
+    json_object_object_add_ex(json, __name__,                   \
+                              json_object_new_uint64(__value__), flags)
+    ADD_SIZE("size", atomic_load(&t->size));
+    ADD_SIZE("num_hits", num_hits);
+    ADD_SIZE("num_misses", atomic_load(&t->num_misses));
+    ADD_SIZE("in_use", in_use);
+    ADD_SIZE("peak_in_use", atomic_load(&t->peak_in_use));
+    ADD_SIZE("num_grown", atomic_load(&t->num_grown));
+    ADD_SIZE("num_shrunk", atomic_load(&t->num_shrunk));
+#undef ADD_SIZE
+    return json;
+}
+
+struct json_object* __margo_handle_cache_tuning_to_json(margo_instance_id mid)
+{
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+    if (!t || !t->max_size) return NULL;
+    struct json_object* json = json_object_new_object();
+    json_object_object_add_ex(json, "max_size",
+                              json_object_new_uint64(t->max_size), flags);
+    json_object_object_add_ex(json, "grow_batch",
+                              json_object_new_uint64(t->grow_batch), flags);
+    json_object_object_add_ex(json, "miss_threshold",
+                              json_object_new_uint64(t->miss_threshold), flags);
+    json_object_object_add_ex(json, "shrink_interval_ms",
+                              json_object_new_uint64(t->shrink_interval_ms),
+                              flags);
+    return json;
 }
 
 hg_return_t __margo_handle_cache_get(margo_instance_id mid,
@@ -98,15 +756,36 @@ hg_return_t __margo_handle_cache_get(margo_instance_id mid,
                                      hg_id_t           id,
                                      hg_handle_t*      handle)
 {
-    /* pop first element from the free handle list (the only operation that
-     * needs the lock; HG_Reset below is done outside the critical section) */
-    ABT_mutex_spinlock(mid->handle_cache_mtx);
-    struct margo_handle_cache_el* el = mid->free_handle_list;
-    if (el) LL_DELETE(mid->free_handle_list, el);
-    ABT_mutex_unlock(mid->handle_cache_mtx);
+    /* a handle parked for this destination is already bound to it */
+    if (mid->handle_affinity && addr != HG_ADDR_NULL) {
+        struct margo_handle_cache_el* el
+            = affinity_take(mid->handle_affinity, addr, id);
+        if (el) {
+            *handle = el->handle;
+            sample_in_use(mid);
+            return HG_SUCCESS;
+        }
+    }
+
+    /* pop the first element of the caller's shard, stealing from the other
+     * shards if it is empty (the only operations that need a lock; HG_Reset
+     * below is done outside the critical section) */
+    unsigned                      self = shard_index(mid);
+    struct margo_handle_cache_el* el
+        = shard_pop(&mid->handle_cache_shards[self], true);
+    if (!el) el = shard_steal(mid, self);
 
     if (!el) {
-        /* no available handles, caller should HG_Create one */
+        /* no available handles, caller should HG_Create one (the cache may
+         * grow so that the next calls find some) */
+        struct margo_handle_cache_tuner* t = mid->handle_cache_tuner;
+        atomic_fetch_add_explicit(&t->num_misses, 1, memory_order_relaxed);
+        if (t->max_size
+            && atomic_fetch_add_explicit(&t->misses_since_resize, 1,
+                                         memory_order_relaxed)
+                       + 1
+                   >= t->miss_threshold)
+            cache_grow(mid, self);
         return HG_OTHER_ERROR;
     }
 
@@ -114,15 +793,16 @@ hg_return_t __margo_handle_cache_get(margo_instance_id mid,
      * reachable by any other thread) */
     hg_return_t hret = HG_Reset(el->handle, addr, id);
     if (hret == HG_SUCCESS) {
-        *handle = el->handle;
+        *handle  = el->handle;
+        el->addr = addr;
+        el->id   = id;
+        sample_in_use(mid);
     } else {
         /* reset failed, return the element to the free list (the caller will
          * fall back to creating a fresh handle) */
         margo_error(mid, "Could not reset cached handle: HG_Reset: %s",
                     HG_Error_to_string(hret));
-        ABT_mutex_spinlock(mid->handle_cache_mtx);
-        LL_PREPEND(mid->free_handle_list, el);
-        ABT_mutex_unlock(mid->handle_cache_mtx);
+        shard_push(&mid->handle_cache_shards[self], el, true);
     }
 
     return hret;
@@ -137,6 +817,9 @@ hg_return_t __margo_handle_cache_put(margo_instance_id mid, hg_handle_t handle)
     struct margo_handle_cache_el* el = data ? data->cache_el : NULL;
     if (!el) {
         /* this handle was manually allocated -- caller should HG_Destroy it */
+        if (data && data->uncached && mid->handle_cache_tuner)
+            atomic_fetch_sub_explicit(&mid->handle_cache_tuner->num_uncached, 1,
+                                      memory_order_relaxed);
         return HG_OTHER_ERROR;
     }
 
@@ -146,10 +829,24 @@ hg_return_t __margo_handle_cache_put(margo_instance_id mid, hg_handle_t handle)
     memset(data, 0, sizeof(*data));
     data->cache_el = el;
 
-    /* return the element to the free list in O(1), no lookup required */
-    ABT_mutex_spinlock(mid->handle_cache_mtx);
-    LL_PREPEND(mid->free_handle_list, el);
-    ABT_mutex_unlock(mid->handle_cache_mtx);
+    /* park the handle if it is still bound to the address it was created
+     * for, making room by sending the least recently parked one back to
+     * the shards */
+    if (mid->handle_affinity && el->addr != HG_ADDR_NULL) {
+        const struct hg_info* info = HG_Get_info(handle);
+        if (info && info->addr == el->addr) {
+            struct margo_handle_cache_el* victim
+                = affinity_park(mid->handle_affinity, el);
+            if (victim)
+                shard_push(&mid->handle_cache_shards[shard_index(mid)],
+                           victim, false);
+            return HG_SUCCESS;
+        }
+    }
+
+    /* return the element to the free list of the caller's shard in O(1), no
+     * lookup required */
+    shard_push(&mid->handle_cache_shards[shard_index(mid)], el, true);
 
     return HG_SUCCESS;
 }
@@ -6,6 +6,8 @@
 #ifndef __MARGO_HANDLE_CACHE_H
 #define __MARGO_HANDLE_CACHE_H
 
+#include <stdbool.h>
+#include <json-c/json.h>
 #include <margo.h>
 
 // private functions that initialize the handle cache for a margo instance,
@@ -13,11 +15,25 @@
 
 struct margo_handle_cache_el; /* defined in margo-handle-cache.c */
 
-hg_return_t __margo_handle_cache_init(margo_instance_id mid,
-                                      size_t            handle_cache_size);
+bool __margo_handle_cache_validate_json(const struct json_object* tuning,
+                                        size_t handle_cache_size);
+
+/* tuning is the "handle_cache_tuning" configuration (may be NULL) */
+hg_return_t __margo_handle_cache_init(margo_instance_id         mid,
+                                      size_t                    handle_cache_size,
+                                      const struct json_object* tuning);
 
 void __margo_handle_cache_destroy(margo_instance_id mid);
 
+/* Frees the counters of the cache, which __margo_handle_cache_destroy keeps
+ * so that the default monitor can still report them when finalized. */
+void __margo_handle_cache_free_counters(margo_instance_id mid);
+
+/* Start and stop the timer shrinking the cache, if tuning is enabled (the
+ * timer runs in the progress pool) */
+void __margo_handle_cache_start_tuning(margo_instance_id mid);
+void __margo_handle_cache_stop_tuning(margo_instance_id mid);
+
 /* Returns a recycled, reset handle from the cache (or HG_OTHER_ERROR if the
  * cache is empty, in which case the caller should HG_Create one). The handle
  * carries an internal back-pointer to its cache element, so the caller does no
@@ -33,4 +49,18 @@ hg_return_t __margo_handle_cache_get(margo_instance_id mid,
  * it instead. */
 hg_return_t __margo_handle_cache_put(margo_instance_id mid, hg_handle_t handle);
 
+/* Counts a handle that the caller created after a miss as in use until it is
+ * destroyed, so that the peak use of the cache accounts for it. */
+void __margo_handle_cache_track(margo_instance_id mid, hg_handle_t handle);
+
+/* Number of handles currently obtained from margo_create and not destroyed */
+size_t __margo_handle_cache_in_use(margo_instance_id mid);
+
+/* Usage counters (size, hits, misses, in-use and peak in-use handles,
+ * handles added and removed by tuning) for the default monitor */
+struct json_object* __margo_handle_cache_stats_to_json(margo_instance_id mid);
+
+/* Returns the "handle_cache_tuning" configuration, or NULL if disabled */
+struct json_object* __margo_handle_cache_tuning_to_json(margo_instance_id mid);
+
 #endif
@@ -0,0 +1,479 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "margo.h"
+#include "margo-multi.h"
+#include "margo-timer.h"
+#include "margo-instance.h"
+#include "uthash.h"
+
+/* A hedged forward sends the RPC to the first replica and starts a timer set
+ * to the configured percentile of that replica's latencies. Each time the
+ * timer fires (or every RPC sent so far has failed), the RPC is sent to the
+ * next replica and the timer is restarted with the percentile of the new one.
+ * The first successful response wins, and the RPCs still in flight are
+ * canceled with HG_Cancel. The latency of every response feeds the samples
+ * of its replica. The time a canceled RPC had been waiting is only a lower
+ * bound of its latency, and would pull the percentile (hence the delay)
+ * down, making hedging more and more frequent: such an RPC is recorded as
+ * censored, with the larger of this time and the current delay of its
+ * replica.
+ *
+ * Replicas are identified by the string of their address and their provider
+ * id, so that different hg_addr_t for the same address share their samples.
+ * Since converting an address into a string is costly, a small direct-mapped
+ * cache remembers the replica of the last hg_addr_t and provider id seen in
+ * each of its slots. A slot keeps a duplicate of its address, with which the
+ * address of a hit is compared in case the hg_addr_t was freed and its
+ * memory reused for another address. At most HEDGE_MAX_TARGETS replicas are
+ * tracked, the least recently used one that no call is sending to being
+ * forgotten to make room for a new one. */
+
+#define HEDGE_NUM_SAMPLES 64 /* latencies kept per replica */
+#define HEDGE_MIN_SAMPLES 8  /* latencies needed before using the percentile */
+#define HEDGE_MAX_TARGETS 1024
+#define HEDGE_NUM_SLOTS   64 /* entries of the address cache */
+#define HEDGE_NO_WINNER   SIZE_MAX
+
+struct hedge_target {
+    char*          key; /* "address#provider_id" */
+    double         samples[HEDGE_NUM_SAMPLES]; /* latest latencies in ms */
+    size_t         num_samples;
+    size_t         next_sample;
+    size_t         num_users; /* calls with an RPC sent to it */
+    uint64_t       last_used;
+    UT_hash_handle hh;
+};
+
+struct hedge_slot {
+    hg_addr_t            addr; /* as passed by the caller */
+    hg_addr_t            dup;
+    uint16_t             provider_id;
+    struct hedge_target* target; /* NULL if the slot is empty */
+};
+
+struct margo_hedge {
+    margo_instance_id          mid;
+    struct margo_hedge_options options;
+    ABT_mutex_memory           mutex; /* protects the fields below */
+    struct hedge_target*       targets;
+    struct hedge_slot          slots[HEDGE_NUM_SLOTS];
+    uint64_t                   clock; /* incremented on every lookup */
+};
+
+struct hedge_call;
+
+struct hedge_attempt {
+    struct hedge_call*   call;
+    hg_handle_t          handle;
+    struct hedge_target* target; /* NULL if the address could not be resolved */
+    double               start;  /* ABT_get_wtime() when the RPC was sent */
+    double               latency_ms;
+    hg_return_t          hret;
+    bool                 done;
+    bool                 canceled;
+};
+
+struct hedge_call {
+    ABT_mutex_memory      mutex;
+    ABT_cond_memory       cond;
+    struct hedge_attempt* attempts;
+    size_t                num_sent;
+    size_t                num_done;
+    size_t                winner; /* first successful attempt */
+    bool                  timer_fired;
+};
+
+#define HEDGE_LOCK(h)   ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&(h)->mutex))
+#define HEDGE_UNLOCK(h) ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(h)->mutex))
+#define HEDGE_SIGNAL(c) ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(&(c)->cond))
+#define HEDGE_WAIT(c)                                     \
+    ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&(c)->cond), \
+                  ABT_MUTEX_MEMORY_GET_HANDLE(&(c)->mutex))
+
+static inline struct hedge_slot*
+hedge_slot(struct margo_hedge* hedge, hg_addr_t addr, uint16_t provider_id)
+{
+    uintptr_t h = ((uintptr_t)addr >> 4) ^ ((uintptr_t)provider_id * 31);
+    return &hedge->slots[h % HEDGE_NUM_SLOTS];
+}
+
+/* Forgets the least recently used target that no call is using. Must be
+ * called with the tracker's mutex held. */
+static void hedge_target_evict(struct margo_hedge* hedge)
+{
+    struct hedge_target *target, *tmp, *victim = NULL;
+    HASH_ITER(hh, hedge->targets, target, tmp)
+    {
+        if (target->num_users) continue;
+        if (!victim || target->last_used < victim->last_used) victim = target;
+    }
+    if (!victim) return;
+    for (size_t i = 0; i < HEDGE_NUM_SLOTS; i++) {
+        struct hedge_slot* slot = &hedge->slots[i];
+        if (slot->target != victim) continue;
+        margo_addr_free(hedge->mid, slot->dup);
+        memset(slot, 0, sizeof(*slot));
+    }
+    HASH_DEL(hedge->targets, victim);
+    free(victim->key);
+    free(victim);
+}
+
+/* Returns the target of the given replica, creating it if needed, or NULL
+ * if its address could not be resolved. Must be called with the tracker's
+ * mutex held, which is released while the address is converted into a
+ * string when it is not in the address cache. */
+static struct hedge_target* hedge_target_find(struct margo_hedge* hedge,
+                                              hg_addr_t           addr,
+                                              uint16_t            provider_id)
+{
+    struct hedge_slot* slot = hedge_slot(hedge, addr, provider_id);
+    if (slot->target && slot->addr == addr && slot->provider_id == provider_id
+        && margo_addr_cmp(hedge->mid, slot->dup, addr)) {
+        slot->target->last_used = ++hedge->clock;
+        return slot->target;
+    }
+
+    HEDGE_UNLOCK(hedge);
+    hg_size_t size = 0;
+    char*     key  = NULL;
+    hg_addr_t dup  = HG_ADDR_NULL;
+    if (margo_addr_to_string(hedge->mid, NULL, &size, addr) == HG_SUCCESS)
+        /* room for "#65535" after the address */
+        key = malloc(size + 6);
+    if (key && margo_addr_to_string(hedge->mid, key, &size, addr) == HG_SUCCESS
+        && margo_addr_dup(hedge->mid, addr, &dup) == HG_SUCCESS) {
+        sprintf(key + strlen(key), "#%u", (unsigned)provider_id);
+    } else {
+        free(key);
+        key = NULL;
+    }
+    HEDGE_LOCK(hedge);
+    if (!key) return NULL;
+
+    struct hedge_target* target = NULL;
+    HASH_FIND_STR(hedge->targets, key, target);
+    if (!target) {
+        if (HASH_COUNT(hedge->targets) >= HEDGE_MAX_TARGETS)
+            hedge_target_evict(hedge);
+        target = calloc(1, sizeof(*target));
+        if (!target) {
+            free(key);
+            margo_addr_free(hedge->mid, dup);
+            return NULL;
+        }
+        target->key = key;
+        key         = NULL;
+        HASH_ADD_KEYPTR(hh, hedge->targets, target->key, strlen(target->key),
+                        target);
+    }
+    free(key);
+    target->last_used = ++hedge->clock;
+
+    /* remember it for the next lookups of this hg_addr_t */
+    if (slot->target) margo_addr_free(hedge->mid, slot->dup);
+    slot->addr        = addr;
+    slot->dup         = dup;
+    slot->provider_id = provider_id;
+    slot->target      = target;
+    return target;
+}
+
+static int compare_latencies(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Must be called with the tracker's mutex held */
+static double hedge_target_delay(struct margo_hedge*  hedge,
+                                 struct hedge_target* target)
+{
+    double delay = hedge->options.initial_delay_ms;
+    if (target && target->num_samples >= HEDGE_MIN_SAMPLES) {
+        double sorted[HEDGE_NUM_SAMPLES];
+        size_t n = target->num_samples;
+        memcpy(sorted, target->samples, n * sizeof(double));
+        qsort(sorted, n, sizeof(double), compare_latencies);
+        /* nearest-rank percentile */
+        double rank = hedge->options.percentile * n / 100.0;
+        size_t k    = (size_t)rank;
+        if (k < rank) k++;
+        if (k > n) k = n;
+        delay = sorted[k ? k - 1 : 0];
+    }
+    if (delay < hedge->options.min_delay_ms) delay = hedge->options.min_delay_ms;
+    return delay;
+}
+
+/* Must be called with the tracker's mutex held */
+static void hedge_target_add_sample(struct hedge_target* target,
+                                    double               latency_ms)
+{
+    target->samples[target->next_sample] = latency_ms;
+    target->next_sample = (target->next_sample + 1) % HEDGE_NUM_SAMPLES;
+    if (target->num_samples < HEDGE_NUM_SAMPLES) target->num_samples++;
+}
+
+/* Completion callback of the RPCs, called by margo_cb in the progress loop */
+static void hedge_forward_cb(void* uargs, hg_return_t hret)
+{
+    struct hedge_attempt* attempt = (struct hedge_attempt*)uargs;
+    struct hedge_call*    call    = attempt->call;
+    double latency_ms = (ABT_get_wtime() - attempt->start) * 1000.0;
+
+    /* errors reported by the remote margo instance are in the output */
+    if (hret == HG_SUCCESS)
+        hret = __margo_check_error_in_output(attempt->handle);
+
+    HEDGE_LOCK(call);
+    attempt->latency_ms = latency_ms;
+    attempt->hret       = hret;
+    attempt->done       = true;
+    call->num_done += 1;
+    if (hret == HG_SUCCESS && call->winner == HEDGE_NO_WINNER)
+        call->winner = attempt - call->attempts;
+    HEDGE_SIGNAL(call);
+    HEDGE_UNLOCK(call);
+}
+
+/* Timer callback, called directly in the progress loop */
+static void hedge_timer_cb(void* arg)
+{
+    struct hedge_call* call = (struct hedge_call*)arg;
+    HEDGE_LOCK(call);
+    call->timer_fired = true;
+    HEDGE_SIGNAL(call);
+    HEDGE_UNLOCK(call);
+}
+
+/* Sends the RPC as the call's next attempt. A failure to send counts as a
+ * failed attempt, so the caller moves on to the next replica. */
+static void hedge_send(struct margo_hedge* hedge,
+                       struct hedge_call*  call,
+                       hg_id_t             id,
+                       hg_addr_t           addr,
+                       uint16_t            provider_id,
+                       void*               in_struct,
+                       double              timeout_ms)
+{
+    struct hedge_attempt* attempt = &call->attempts[call->num_sent];
+    attempt->call                 = call;
+    HEDGE_LOCK(hedge);
+    /* the target is kept until the end of the call */
+    attempt->target = hedge_target_find(hedge, addr, provider_id);
+    if (attempt->target) attempt->target->num_users++;
+    HEDGE_UNLOCK(hedge);
+
+    hg_return_t hret = margo_create(hedge->mid, addr, id, &attempt->handle);
+    if (hret == HG_SUCCESS) {
+        attempt->start = ABT_get_wtime();
+        hret           = margo_provider_cforward_timed(provider_id,
+                                             attempt->handle, in_struct,
+                                             timeout_ms, hedge_forward_cb,
+                                             attempt);
+        if (hret != HG_SUCCESS) {
+            margo_destroy(attempt->handle);
+            attempt->handle = HG_HANDLE_NULL;
+        }
+    } else {
+        attempt->handle = HG_HANDLE_NULL;
+    }
+
+    HEDGE_LOCK(call);
+    call->num_sent += 1;
+    if (hret != HG_SUCCESS) {
+        attempt->hret = hret;
+        attempt->done = true;
+        call->num_done += 1;
+    }
+    HEDGE_UNLOCK(call);
+}
+
+/* Starts the timer after which the RPC is sent to the next replica, with the
+ * delay of the replica sent to last */
+static void hedge_start_timer(struct margo_hedge* hedge,
+                              struct hedge_call*  call,
+                              margo_timer_t       timer)
+{
+    struct hedge_attempt* last = &call->attempts[call->num_sent - 1];
+    HEDGE_LOCK(hedge);
+    double delay_ms = hedge_target_delay(hedge, last->target);
+    HEDGE_UNLOCK(hedge);
+    margo_timer_start(timer, delay_ms);
+}
+
+hg_return_t margo_hedge_create(margo_instance_id                 mid,
+                               const struct margo_hedge_options* options,
+                               margo_hedge_t*                    hedge)
+{
+    if (mid == MARGO_INSTANCE_NULL || !hedge) return HG_INVALID_ARG;
+    if (options
+        && (options->percentile < 0 || options->percentile > 100
+            || options->initial_delay_ms < 0 || options->min_delay_ms < 0)) {
+        margo_error(mid, "Invalid options passed to margo_hedge_create");
+        return HG_INVALID_ARG;
+    }
+
+    /* the mutex is statically initialized by calloc */
+    struct margo_hedge* tmp = calloc(1, sizeof(*tmp));
+    if (!tmp) return HG_NOMEM_ERROR;
+    tmp->mid = mid;
+    if (options) tmp->options = *options;
+    if (tmp->options.percentile == 0) tmp->options.percentile = 95;
+    if (tmp->options.initial_delay_ms == 0) tmp->options.initial_delay_ms = 10;
+    if (tmp->options.initial_replicas == 0) tmp->options.initial_replicas = 1;
+    *hedge = tmp;
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_hedge_destroy(margo_hedge_t hedge)
+{
+    if (hedge == MARGO_HEDGE_NULL) return HG_INVALID_ARG;
+    for (size_t i = 0; i < HEDGE_NUM_SLOTS; i++)
+        if (hedge->slots[i].target)
+            margo_addr_free(hedge->mid, hedge->slots[i].dup);
+    struct hedge_target *target, *tmp;
+    HASH_ITER(hh, hedge->targets, target, tmp)
+    {
+        HASH_DEL(hedge->targets, target);
+        free(target->key);
+        free(target);
+    }
+    free(hedge);
+    return HG_SUCCESS;
+}
+
+hg_return_t margo_hedge_get_delay(margo_hedge_t hedge,
+                                  hg_addr_t     addr,
+                                  uint16_t      provider_id,
+                                  double*       delay_ms)
+{
+    if (hedge == MARGO_HEDGE_NULL || addr == HG_ADDR_NULL || !delay_ms)
+        return HG_INVALID_ARG;
+    HEDGE_LOCK(hedge);
+    struct hedge_target* target = hedge_target_find(hedge, addr, provider_id);
+    if (target) *delay_ms = hedge_target_delay(hedge, target);
+    HEDGE_UNLOCK(hedge);
+    return target ? HG_SUCCESS : HG_NOMEM_ERROR;
+}
+
+hg_return_t margo_forward_hedged(margo_hedge_t    hedge,
+                                 hg_id_t          id,
+                                 size_t           count,
+                                 const hg_addr_t* addrs,
+                                 const uint16_t*  provider_ids,
+                                 void*            in_struct,
+                                 double           timeout_ms,
+                                 hg_handle_t*     handle,
+                                 size_t*          index)
+{
+    if (hedge == MARGO_HEDGE_NULL || !count || !addrs || !handle)
+        return HG_INVALID_ARG;
+    *handle = HG_HANDLE_NULL;
+
+    size_t max_replicas = hedge->options.max_replicas;
+    if (!max_replicas || max_replicas > count) max_replicas = count;
+    size_t initial_replicas = hedge->options.initial_replicas;
+    if (initial_replicas > max_replicas) initial_replicas = max_replicas;
+
+    /* the mutex and condition variable are statically initialized */
+    struct hedge_call call = {0};
+    call.winner            = HEDGE_NO_WINNER;
+    call.attempts          = calloc(max_replicas, sizeof(*call.attempts));
+    if (!call.attempts) return HG_NOMEM_ERROR;
+
+    margo_timer_t timer = MARGO_TIMER_NULL;
+    if (initial_replicas < max_replicas
+        && margo_timer_create_with_pool(hedge->mid, hedge_timer_cb, &call,
+                                        ABT_POOL_NULL, &timer)
+               != 0) {
+        free(call.attempts);
+        return HG_OTHER_ERROR;
+    }
+
+#define SEND_NEXT()                                                         \
+    hedge_send(hedge, &call, id, addrs[call.num_sent],                      \
+               provider_ids ? provider_ids[call.num_sent]                   \
+                            : MARGO_DEFAULT_PROVIDER_ID,                    \
+               in_struct, timeout_ms)
+
+    while (call.num_sent < initial_replicas) SEND_NEXT();
+    if (timer) hedge_start_timer(hedge, &call, timer);
+
+    HEDGE_LOCK(&call);
+    while (call.winner == HEDGE_NO_WINNER) {
+        bool all_failed = call.num_done == call.num_sent;
+        if (call.num_sent < max_replicas && (call.timer_fired || all_failed)) {
+            HEDGE_UNLOCK(&call);
+            /* the timer's callback takes the call's mutex */
+            margo_timer_cancel(timer);
+            call.timer_fired = false;
+            SEND_NEXT();
+            if (call.num_sent < max_replicas)
+                hedge_start_timer(hedge, &call, timer);
+            HEDGE_LOCK(&call);
+            continue;
+        }
+        if (all_failed) break;
+        HEDGE_WAIT(&call);
+    }
+    HEDGE_UNLOCK(&call);
+
+#undef SEND_NEXT
+
+    if (timer) {
+        margo_timer_cancel(timer);
+        margo_timer_destroy(timer);
+    }
+
+    /* cancel the RPCs still in flight and wait for their completion */
+    HEDGE_LOCK(&call);
+    for (size_t i = 0; i < call.num_sent; i++) {
+        struct hedge_attempt* attempt = &call.attempts[i];
+        if (attempt->done) continue;
+        attempt->canceled = true;
+        HG_Cancel(attempt->handle);
+    }
+    while (call.num_done < call.num_sent) HEDGE_WAIT(&call);
+    HEDGE_UNLOCK(&call);
+
+    HEDGE_LOCK(hedge);
+    for (size_t i = 0; i < call.num_sent; i++) {
+        struct hedge_attempt* attempt = &call.attempts[i];
+        if (!attempt->target) continue;
+        if (attempt->hret == HG_SUCCESS) {
+            hedge_target_add_sample(attempt->target, attempt->latency_ms);
+        } else if (attempt->canceled) {
+            /* censored, see above */
+            double delay = hedge_target_delay(hedge, attempt->target);
+            hedge_target_add_sample(attempt->target,
+                                    attempt->latency_ms > delay
+                                        ? attempt->latency_ms
+                                        : delay);
+        }
+        attempt->target->num_users--;
+    }
+    HEDGE_UNLOCK(hedge);
+
+    hg_return_t hret = HG_SUCCESS;
+    for (size_t i = 0; i < call.num_sent; i++) {
+        struct hedge_attempt* attempt = &call.attempts[i];
+        if (i == call.winner) continue;
+        if (attempt->handle) margo_destroy(attempt->handle);
+        if (call.winner == HEDGE_NO_WINNER) hret = attempt->hret;
+    }
+    if (call.winner != HEDGE_NO_WINNER) {
+        *handle = call.attempts[call.winner].handle;
+        if (index) *index = call.winner;
+    }
+    free(call.attempts);
+    return hret;
+}
@@ -16,6 +16,7 @@
 #include "margo-macros.h"
 #include "margo-util.h"
 #include "margo-prio-pool.h"
+#include "margo-autoscaler.h"
 #include "abtx_prof.h"
 
 // Validates the format of the configuration and
@@ -28,6 +29,14 @@ static bool __margo_validate_json_with_parent(
     struct json_object* _config, const char* address, int mode,
     const struct margo_init_info* uargs);
 bool __margo_plumber_validate_json(const json_object_t* p);
+static bool __margo_arenas_validate_json(const json_object_t* a);
+
+// Periodically frees the unused blocks of the instance's arenas
+static void arena_trim_cb(void* arg);
+
+// Allocate the blocks of the instance's arenas according to its memory policy
+static void* arena_block_alloc(void* uargs, size_t size);
+static void  arena_block_free(void* uargs, void* ptr, size_t size);
 
 // Sets environment variables for Argobots
 static void set_argobots_environment_variables(struct json_object* config);
@@ -78,6 +87,8 @@ margo_instance_id margo_init_ext(const char*                   address,
     margo_instance_id   mid                   = MARGO_INSTANCE_NULL;
     char*               plumber_bucket_policy = NULL;
     char*               plumber_nic_policy    = NULL;
+    int*                progress_context_pools = NULL;
+    int                 num_progress_contexts  = 0;
 
     struct margo_hg hg
         = {HG_INIT_INFO_INITIALIZER, NULL, NULL, HG_ADDR_NULL, NULL, 0};
@@ -301,6 +312,47 @@ margo_instance_id margo_init_ext(const char*                   address,
         }
     }
 
+    // initialize the pools of the additional progress contexts
+    num_progress_contexts
+        = json_object_object_get_int_or(config, "progress_contexts", 1) - 1;
+    if (num_progress_contexts > 0) {
+        progress_context_pools = calloc(num_progress_contexts, sizeof(int));
+        if (!progress_context_pools) goto error;
+        for (int i = 0; i < num_progress_contexts; i++) {
+            char name[64];
+            snprintf(name, 64, "__progress_context_%d__", i + 1);
+            /* the pool may already exist if the configuration was produced
+             * by margo_get_config */
+            int pool_idx = __margo_abt_find_pool_by_name(effective_abt, name);
+            if (pool_idx < 0) {
+                /* add a pool and an ES dedicated to this context */
+                json_object_t* jpool = json_object_new_object();
+                json_object_object_add(jpool, "name",
+                                       json_object_new_string(name));
+                json_object_object_add(jpool, "access",
+                                       json_object_new_string("mpmc"));
+                pool_idx = effective_abt->pools_len;
+                ret = __margo_abt_add_pool_from_json(effective_abt, jpool);
+                json_object_put(jpool);
+                if (!ret) goto error;
+                json_object_t* jxstream = json_object_new_object();
+                json_object_t* jsched   = json_object_new_object();
+                json_object_object_add(jxstream, "name",
+                                       json_object_new_string(name));
+                json_object_object_add(jxstream, "scheduler", jsched);
+                json_object_t* jxstream_pools = json_object_new_array_ext(1);
+                json_object_object_add(jsched, "pools", jxstream_pools);
+                json_object_array_add(jxstream_pools,
+                                      json_object_new_int(pool_idx));
+                ret = __margo_abt_add_xstream_from_json(effective_abt,
+                                                        jxstream);
+                json_object_put(jxstream);
+                if (!ret) goto error;
+            }
+            progress_context_pools[i] = pool_idx;
+        }
+    }
+
     /* Defensively re-validate the resolved pool indices against the effective
      * set of pools. The earlier JSON validation bounds integer indices against
      * the raw JSON pool count, but the effective set may differ (e.g. added
@@ -337,8 +389,14 @@ margo_instance_id margo_init_ext(const char*                   address,
         = json_object_object_get_int_or(config, "progress_spindown_msec", 10);
     int progress_timeout_ub = json_object_object_get_int_or(
         config, "progress_timeout_ub_msec", 100);
+    int progress_trigger_batch = json_object_object_get_int_or(
+        config, "progress_trigger_batch_size", 1);
+    const char* progress_policy = json_object_object_get_string_or(
+        config, "progress_policy", "spindown");
     int handle_cache_size
         = json_object_object_get_int_or(config, "handle_cache_size", 256);
+    int handle_cache_affinity_size = json_object_object_get_int_or(
+        config, "handle_cache_affinity_size", 0);
     int abt_profiling_enabled
         = json_object_object_get_bool_or(config, "enable_abt_profiling", false);
 
@@ -365,6 +423,15 @@ margo_instance_id margo_init_ext(const char*                   address,
     mid->hg_progress_tid           = ABT_THREAD_NULL;
     mid->hg_progress_shutdown_flag = 0;
     mid->hg_progress_timeout_ub    = progress_timeout_ub;
+    mid->hg_progress_trigger_batch = progress_trigger_batch;
+    mid->hg_progress_policy        = strcmp(progress_policy, "adaptive") == 0
+                                       ? MARGO_PROGRESS_POLICY_ADAPTIVE
+                                       : MARGO_PROGRESS_POLICY_SPINDOWN;
+    /* the adaptive policy starts as if the instance had been idle */
+    mid->hg_progress_adaptive.state              = MARGO_PROGRESS_BLOCK;
+    mid->hg_progress_adaptive.last_completion_ts = ABT_get_wtime();
+    mid->hg_progress_adaptive.arrival_gap_ewma
+        = progress_timeout_ub / 1000.0;
 
     mid->plumber_nic_policy    = plumber_nic_policy;
     mid->plumber_bucket_policy = plumber_bucket_policy;
@@ -385,19 +452,54 @@ margo_instance_id margo_init_ext(const char*                   address,
     mid->enable_remote_shutdown = 0;
 
     mid->identity_rpc_id = 0;
+    mid->relay_rpc_id    = 0;
+    mid->enable_relay    = 0;
+
+    // create additional progress contexts before the handle cache,
+    // since cached handles are spread across contexts
+    hret = __margo_create_progress_contexts(mid, num_progress_contexts,
+                                            progress_context_pools);
+    if (hret != HG_SUCCESS) goto error;
 
     mid->timer_list = __margo_timer_list_create();
 
-    mid->handle_cache_size = handle_cache_size;
-    mid->free_handle_list  = NULL;
-    hret                   = __margo_handle_cache_init(mid, handle_cache_size);
+    mid->handle_cache_size          = handle_cache_size;
+    mid->handle_cache_affinity_size = handle_cache_affinity_size;
+    hret = __margo_handle_cache_init(
+        mid, handle_cache_size,
+        json_object_object_get(config, "handle_cache_tuning"));
     if (hret != HG_SUCCESS) goto error;
 
+    __margo_memory_policy_init(&mid->memory,
+                               json_object_object_get(config, "memory"));
+
     mid->request_arena
         = mochi_arena_create(sizeof(struct margo_request_struct), 64);
     mid->handle_data_arena
         = mochi_arena_create(sizeof(struct margo_handle_data), 64);
     if (!mid->request_arena || !mid->handle_data_arena) goto error;
+    if (__margo_memory_policy_is_set(&mid->memory)) {
+        mochi_arena_allocator_t allocator = {
+            .alloc       = arena_block_alloc,
+            .free        = arena_block_free,
+            .uargs       = &mid->memory,
+            .granularity = __margo_memory_granularity(&mid->memory),
+        };
+        mochi_arena_set_allocator(mid->request_arena, &allocator);
+        mochi_arena_set_allocator(mid->handle_data_arena, &allocator);
+    }
+
+    struct json_object* arenas = json_object_object_get(config, "arenas");
+    mid->arena_max_objects
+        = json_object_object_get_uint64_or(arenas, "max_objects", 0);
+    mid->arena_wait_when_full
+        = json_object_object_get_bool_or(arenas, "wait_when_full", false);
+    mid->arena_trim_interval_ms
+        = json_object_object_get_uint64_or(arenas, "trim_interval_ms", 0);
+    mochi_arena_set_limit(mid->request_arena, mid->arena_max_objects,
+                          mid->arena_wait_when_full);
+    mochi_arena_set_limit(mid->handle_data_arena, mid->arena_max_objects,
+                          mid->arena_wait_when_full);
 
     // create current_rpc_id_key ABT_key
     ret = ABT_key_create(NULL, &(mid->current_rpc_id_key));
@@ -441,27 +543,68 @@ margo_instance_id margo_init_ext(const char*                   address,
     mid->identity_rpc_id
         = MARGO_REGISTER(mid, "__identity__", void, hg_string_t, NULL);
 
-    MARGO_TRACE(0, "Starting progress loop");
+    mid->relay_rpc_id = __margo_register_relay(mid);
+
+    // start the autoscaler, if any
+    struct json_object* autoscaler
+        = json_object_object_get(config, "autoscaler");
+    if (autoscaler && !mid->parent_mid) {
+        mid->autoscaler = __margo_autoscaler_create(mid, autoscaler);
+        if (!mid->autoscaler) {
+            MARGO_ERROR(0, "Could not start the autoscaler");
+            goto error;
+        }
+    }
+
+    MARGO_TRACE(0, "Starting progress loops");
+    for (unsigned i = 0; i < mid->num_progress_contexts; i++) {
+        struct margo_progress_context* ctx = &mid->progress_contexts[i];
+        ret = ABT_thread_create(mid->abt->pools[ctx->pool_idx].pool,
+                                __margo_hg_context_progress_fn, ctx,
+                                ABT_THREAD_ATTR_NULL, &ctx->tid);
+        if (ret != ABT_SUCCESS) goto error;
+    }
     ret = ABT_thread_create(MARGO_PROGRESS_POOL(mid), __margo_hg_progress_fn,
                             mid, ABT_THREAD_ATTR_NULL, &mid->hg_progress_tid);
     if (ret != ABT_SUCCESS) goto error;
 
+    __margo_handle_cache_start_tuning(mid);
+
+    if (mid->arena_trim_interval_ms) {
+        margo_timer_create_with_pool(mid, arena_trim_cb, mid,
+                                     MARGO_PROGRESS_POOL(mid),
+                                     &mid->arena_trim_timer);
+        margo_timer_start(mid->arena_trim_timer, mid->arena_trim_interval_ms);
+    }
+
     mid->refcount = 1;
 
 finish:
     json_object_put(config);
+    free(progress_context_pools);
     return mid;
 
 error:
     if (mid) {
+        __margo_autoscaler_free(mid->autoscaler);
         if(mid->parent_mid) margo_instance_release(mid->parent_mid);
         __margo_handle_cache_destroy(mid);
+        __margo_handle_cache_free_counters(mid);
+        __margo_destroy_progress_contexts(mid);
         mochi_arena_destroy(mid->request_arena);
         mochi_arena_destroy(mid->handle_data_arena);
+        __margo_memory_policy_finalize(&mid->memory);
         __margo_timer_list_free(mid);
         ABT_mutex_free(&mid->finalize_mutex);
         ABT_cond_free(&mid->finalize_cond);
         if (mid->current_rpc_id_key) ABT_key_free(&(mid->current_rpc_id_key));
+        if (!mid->parent_mid && mid->abt) {
+            /* xstreams may have been added to the copy (e.g. by the
+             * autoscaler), so that is the one to destroy */
+            memcpy(&abt, mid->abt, sizeof(abt));
+            abt.mid = NULL;
+            free(mid->abt);
+        }
         free(mid);
     }
     mid = MARGO_INSTANCE_NULL;
@@ -494,11 +637,23 @@ static bool __margo_validate_json(struct json_object*           _margo,
        - [optional] argobots: object
        - [optional] progress_spindown_msec: integer >= 0 (default 10)
        - [optional] progress_timeout_ub_msec: integer >= 0 (default 100)
+       - [optional] progress_trigger_batch_size: integer >= 0 (default 1,
+                    0 means adaptive)
+       - [optional] progress_policy: "spindown" (default) or "adaptive"
        - [optional] handle_cache_size: integer >= 0 (default 32)
+       - [optional] handle_cache_affinity_size: integer >= 0 (default 0)
+       - [optional] handle_cache_tuning: object (see margo-handle-cache.c)
        - [optional] use_progress_thread: bool (default false)
        - [optional] rpc_thread_count: integer (default 0)
        - [optional] progress_pool: integer or string
        - [optional] rpc_pool: integer or string
+       - [optional] progress_contexts: integer >= 1 (default 1)
+       - [optional] autoscaler: object (see margo-autoscaler.c)
+       - [optional] arenas: object
+       -            [optional] max_objects: integer >= 1 (default none)
+       -            [optional] wait_when_full: bool (default false)
+       -            [optional] trim_interval_ms: integer >= 0 (default 0)
+       - [optional] memory: object (see margo-memory.c)
        - [optional] monitoring: object
        - [optional] plumber: object
        -            [optional]: bucket_policy: string
@@ -537,6 +692,23 @@ static bool __margo_validate_json(struct json_object*           _margo,
                                         "progress_timeout_ub_msec");
     }
 
+    // check "progress_trigger_batch_size" field
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_trigger_batch_size", int,
+                               "margo");
+    if (CONFIG_HAS(_margo, "progress_trigger_batch_size", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(_margo, "progress_trigger_batch_size",
+                                        "progress_trigger_batch_size");
+    }
+
+    // check "progress_policy" field
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_policy", string, "margo");
+    struct json_object* _progress_policy
+        = json_object_object_get(_margo, "progress_policy");
+    if (_progress_policy) {
+        CONFIG_IS_IN_ENUM_STRING(_progress_policy, "progress_policy",
+                                 "spindown", "adaptive");
+    }
+
     // check "handle_cache_size" field
     ASSERT_CONFIG_HAS_OPTIONAL(_margo, "handle_cache_size", int, "margo");
     if (CONFIG_HAS(_margo, "handle_cache_size", ignore)) {
@@ -544,6 +716,21 @@ static bool __margo_validate_json(struct json_object*           _margo,
                                         "handle_cache_size");
     }
 
+    // check "handle_cache_affinity_size" field
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "handle_cache_affinity_size", int,
+                               "margo");
+    if (CONFIG_HAS(_margo, "handle_cache_affinity_size", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(_margo, "handle_cache_affinity_size",
+                                        "handle_cache_affinity_size");
+    }
+
+    // check "handle_cache_tuning" field
+    if (!__margo_handle_cache_validate_json(
+            json_object_object_get(_margo, "handle_cache_tuning"),
+            json_object_object_get_int_or(_margo, "handle_cache_size", 256))) {
+        return false;
+    }
+
     // check "progress_pool"
     struct json_object* _progress_pool
         = json_object_object_get(_margo, "progress_pool");
@@ -661,6 +848,51 @@ static bool __margo_validate_json(struct json_object*           _margo,
                       " external rpc pool was provided");
     }
 
+    // check "progress_contexts" field
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_contexts", int, "margo");
+    struct json_object* _progress_contexts
+        = json_object_object_get(_margo, "progress_contexts");
+    if (_progress_contexts) {
+        int num_contexts = json_object_get_int(_progress_contexts);
+        if (num_contexts < 1 || num_contexts > 256) {
+            margo_error(0,
+                        "\"progress_contexts\" should be between 1 and 256");
+            HANDLE_CONFIG_ERROR;
+        }
+        // the additional contexts are created from the Mercury class, which
+        // must have been initialized for them
+        if (num_contexts > 1 && uargs->hg_class) {
+            margo_error(0,
+                        "\"progress_contexts\" cannot be greater than 1"
+                        " when an external Mercury class is provided");
+            HANDLE_CONFIG_ERROR;
+        }
+        // Mercury needs to know the number of contexts at initialization
+        if (num_contexts > 1
+            && json_object_object_get_int_or(_mercury, "max_contexts", 0)
+                   < num_contexts) {
+            if (!_mercury) {
+                _mercury = json_object_new_object();
+                json_object_object_add(_margo, "mercury", _mercury);
+            }
+            json_object_object_add(_mercury, "max_contexts",
+                                   json_object_new_int(num_contexts));
+        }
+    }
+
+    // check "autoscaler" field
+    struct json_object* _autoscaler
+        = json_object_object_get(_margo, "autoscaler");
+    if (!__margo_autoscaler_validate_json(_autoscaler)) { return false; }
+
+    // check "arenas" field
+    struct json_object* _arenas = json_object_object_get(_margo, "arenas");
+    if (!__margo_arenas_validate_json(_arenas)) { return false; }
+
+    // check "memory" field
+    struct json_object* _memory = json_object_object_get(_margo, "memory");
+    if (!__margo_memory_validate_json(_memory)) { return false; }
+
     return true;
 #undef HANDLE_CONFIG_ERROR
 }
@@ -709,10 +941,32 @@ static bool __margo_validate_json_with_parent(
         HANDLE_CONFIG_ERROR;
     }
 
+    if (json_object_object_get(_margo, "progress_contexts")) {
+        margo_error(0,
+                    "Margo instance initialized with a parent "
+                    "cannot have a \"progress_contexts\" configuration");
+        HANDLE_CONFIG_ERROR;
+    }
+
+    if (json_object_object_get(_margo, "autoscaler")) {
+        margo_error(0,
+                    "Margo instance initialized with a parent "
+                    "cannot have an \"autoscaler\" configuration");
+        HANDLE_CONFIG_ERROR;
+    }
+
     /* ------- Plumber configuration ------ */
     struct json_object* _plumber = json_object_object_get(_margo, "plumber");
     if (!__margo_plumber_validate_json(_plumber)) { return false; }
 
+    /* ------- Arenas configuration ------ */
+    struct json_object* _arenas = json_object_object_get(_margo, "arenas");
+    if (!__margo_arenas_validate_json(_arenas)) { return false; }
+
+    /* ------- Memory configuration ------ */
+    struct json_object* _memory = json_object_object_get(_margo, "memory");
+    if (!__margo_memory_validate_json(_memory)) { return false; }
+
     /* ------- Optional integer fields ------ */
     ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_spindown_msec", int, "margo");
     if (CONFIG_HAS(_margo, "progress_spindown_msec", ignore)) {
@@ -727,12 +981,40 @@ static bool __margo_validate_json_with_parent(
                                         "progress_timeout_ub_msec");
     }
 
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_trigger_batch_size", int,
+                               "margo");
+    if (CONFIG_HAS(_margo, "progress_trigger_batch_size", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(_margo, "progress_trigger_batch_size",
+                                        "progress_trigger_batch_size");
+    }
+
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "progress_policy", string, "margo");
+    struct json_object* _progress_policy
+        = json_object_object_get(_margo, "progress_policy");
+    if (_progress_policy) {
+        CONFIG_IS_IN_ENUM_STRING(_progress_policy, "progress_policy",
+                                 "spindown", "adaptive");
+    }
+
     ASSERT_CONFIG_HAS_OPTIONAL(_margo, "handle_cache_size", int, "margo");
     if (CONFIG_HAS(_margo, "handle_cache_size", ignore)) {
         CONFIG_INTEGER_MUST_BE_POSITIVE(_margo, "handle_cache_size",
                                         "handle_cache_size");
     }
 
+    ASSERT_CONFIG_HAS_OPTIONAL(_margo, "handle_cache_affinity_size", int,
+                               "margo");
+    if (CONFIG_HAS(_margo, "handle_cache_affinity_size", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(_margo, "handle_cache_affinity_size",
+                                        "handle_cache_affinity_size");
+    }
+
+    if (!__margo_handle_cache_validate_json(
+            json_object_object_get(_margo, "handle_cache_tuning"),
+            json_object_object_get_int_or(_margo, "handle_cache_size", 256))) {
+        return false;
+    }
+
     /* ------- Validate progress_pool against parent's pools ------ */
     margo_abt_t* parent_abt = uargs->parent_mid->abt;
     struct json_object* _progress_pool
@@ -1046,3 +1328,58 @@ bool __margo_plumber_validate_json(const json_object_t* p)
 
     return true;
 }
+
+static bool __margo_arenas_validate_json(const json_object_t* a)
+{
+    struct json_object* ignore = NULL;
+    if (!a) return true;
+
+#define HANDLE_CONFIG_ERROR return false
+
+    if (!json_object_is_type(a, json_type_object)) {
+        margo_error(0,
+                    "\"arenas\" field in configuration "
+                    "should be an object");
+        HANDLE_CONFIG_ERROR;
+    }
+    ASSERT_CONFIG_HAS_OPTIONAL(a, "max_objects", int, "arenas");
+    if (CONFIG_HAS(a, "max_objects", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(a, "max_objects", "arenas.max_objects");
+        /* 0 is the default meaning "no limit", which is expressed by leaving
+         * the field out rather than by a limit of no objects */
+        if (json_object_get_int64(json_object_object_get(a, "max_objects"))
+            == 0) {
+            margo_error(0, "\"arenas.max_objects\" must not be 0");
+            HANDLE_CONFIG_ERROR;
+        }
+    }
+    ASSERT_CONFIG_HAS_OPTIONAL(a, "wait_when_full", boolean, "arenas");
+    ASSERT_CONFIG_HAS_OPTIONAL(a, "trim_interval_ms", int, "arenas");
+    if (CONFIG_HAS(a, "trim_interval_ms", ignore)) {
+        CONFIG_INTEGER_MUST_BE_POSITIVE(a, "trim_interval_ms",
+                                        "arenas.trim_interval_ms");
+    }
+    return true;
+#undef HANDLE_CONFIG_ERROR
+}
+
+static void arena_trim_cb(void* arg)
+{
+    margo_instance_id mid = (margo_instance_id)arg;
+    size_t num_trimmed    = mochi_arena_trim(mid->request_arena)
+                       + mochi_arena_trim(mid->handle_data_arena);
+    if (num_trimmed)
+        MARGO_TRACE(mid, "Freed %zu unused arena blocks", num_trimmed);
+    /* fails if margo_finalize is canceling the timer */
+    margo_timer_start(mid->arena_trim_timer, mid->arena_trim_interval_ms);
+}
+
+static void* arena_block_alloc(void* uargs, size_t size)
+{
+    return __margo_memory_alloc((const margo_memory_policy_t*)uargs, size);
+}
+
+static void arena_block_free(void* uargs, void* ptr, size_t size)
+{
+    __margo_memory_free((const margo_memory_policy_t*)uargs, ptr, size);
+}
@@ -7,6 +7,8 @@
 #define __MARGO_INTERNAL_H
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <errno.h>
 #include <abt.h>
@@ -27,13 +29,17 @@
 #include "margo-bulk-util.h"
 #include "margo-timer-private.h"
 #include "mochi-arena.h"
+#include "margo-memory.h"
 #include "utlist.h"
 #include "uthash.h"
 
 #define MARGO_OWNS_HG_CLASS   0x1
 #define MARGO_OWNS_HG_CONTEXT 0x2
 
-struct margo_handle_cache_el; /* defined in margo-handle-cache.c */
+struct margo_handle_cache_el;    /* defined in margo-handle-cache.c */
+struct margo_handle_cache_shard; /* defined in margo-handle-cache.c */
+struct margo_handle_affinity;    /* defined in margo-handle-cache.c */
+struct margo_handle_cache_tuner; /* defined in margo-handle-cache.c */
 
 struct margo_finalize_cb {
     const void* owner;
@@ -53,6 +59,40 @@ struct margo_registered_rpc {
     struct margo_registered_rpc* next;          /* pointer to next in list */
 };
 
+/* Additional Mercury context driven by its own progress loop, running in
+ * its own pool (see "progress_contexts" in the configuration) */
+struct margo_progress_context {
+    margo_instance_id mid;
+    hg_context_t*     hg_context;
+    unsigned          pool_idx; /* index of the pool in mid->abt->pools */
+    ABT_thread        tid;      /* progress ULT */
+};
+
+/* Policies used by the main progress loop to decide between busy-polling
+ * and blocking in HG_Progress (see "progress_policy" in the configuration) */
+typedef enum {
+    MARGO_PROGRESS_POLICY_SPINDOWN, /* spin for progress_spindown_msec while
+                                       operations are pending */
+    MARGO_PROGRESS_POLICY_ADAPTIVE  /* driven by the measured arrival rate */
+} margo_progress_policy_t;
+
+/* Current decision of the adaptive progress policy */
+typedef enum {
+    MARGO_PROGRESS_SPIN,  /* zero timeout */
+    MARGO_PROGRESS_POLL,  /* timeout shorter than progress_timeout_ub_msec */
+    MARGO_PROGRESS_BLOCK, /* timeout of progress_timeout_ub_msec */
+} margo_progress_state_t;
+
+/* State of the adaptive progress policy, only updated by the progress loop
+ * (other threads, e.g. margo_get_config, read the atomic fields and may see
+ * a slightly outdated state) */
+struct margo_adaptive_progress {
+    _Atomic int    state;              /* margo_progress_state_t */
+    double         last_completion_ts; /* time of the last completion */
+    _Atomic double arrival_gap_ewma;   /* seconds between completions */
+    _Atomic double yield_ewma;         /* completions per loop iteration */
+};
+
 /* Bit layout of margo_instance::shutdown_state */
 #define MARGO_FINALIZE_BIT ((uint32_t)0x80000000u)
 #define MARGO_PENDING_MASK ((uint32_t)0x7FFFFFFFu)
@@ -74,16 +114,35 @@ struct margo_instance {
     _Atomic unsigned progress_pool_idx;
     _Atomic unsigned rpc_pool_idx;
 
+    /* controller adding/removing ESs running the rpc pool, if enabled */
+    struct margo_autoscaler* autoscaler;
+
     /* internal to margo for this particular instance */
     ABT_thread       hg_progress_tid;
     _Atomic int      hg_progress_shutdown_flag;
     _Atomic unsigned hg_progress_timeout_ub;
     _Atomic unsigned hg_progress_spindown_msec;
+    _Atomic unsigned hg_progress_trigger_batch; /* 0 means adaptive */
+    margo_progress_policy_t        hg_progress_policy;
+    struct margo_adaptive_progress hg_progress_adaptive;
+
+    /* additional Mercury contexts (mid->hg.hg_context being context 0),
+     * outgoing handles are spread across all the contexts in round-robin */
+    struct margo_progress_context* progress_contexts;
+    unsigned                       num_progress_contexts; /* excluding 0 */
+    _Atomic unsigned               progress_context_idx;
 
     /* "when_needed" progress logic */
+    /* progress_when_needed.pending is maintained with atomic operations
+     * only; the mutex and condition variable are used only by progress
+     * loops going to sleep (counted in sleepers) and by whoever needs to
+     * wake them up, i.e. on a 0->1 transition of pending while there are
+     * sleepers, or when the flag is cleared (see PROGRESS_NEEDED_INCR and
+     * WAIT_FOR_PROGRESS_TO_BE_NEEDED). */
     struct {
-        bool             flag;
-        uint64_t         pending;
+        _Atomic bool     flag;
+        _Atomic uint64_t pending;
+        _Atomic unsigned sleepers;
         ABT_mutex_memory mutex;
         ABT_cond_memory  cond;
     } progress_when_needed;
@@ -120,20 +179,40 @@ struct margo_instance {
     /* control logic for provider identity */
     hg_id_t identity_rpc_id;
 
+    /* RPC relaying multi-destination forwards (see margo-multi.c) */
+    hg_id_t relay_rpc_id;
+    bool    enable_relay;
+
     /* timer data */
     struct margo_timer_list* timer_list;
 
-    /* linked list of free hg handles; in-use handles are identified by a
-     * back-pointer stored in their margo_handle_data (cache_el), so no
-     * separate hash of in-use handles is needed. */
-    size_t                        handle_cache_size;
-    struct margo_handle_cache_el* free_handle_list;
-    ABT_mutex handle_cache_mtx; /* mutex protecting access to the free list */
+    /* free hg handles, in lists sharded by execution stream (see
+     * margo-handle-cache.c); in-use handles are identified by a back-pointer
+     * stored in their margo_handle_data (cache_el), so no separate hash of
+     * in-use handles is needed. */
+    size_t                           handle_cache_size;
+    struct margo_handle_cache_shard* handle_cache_shards;
+    unsigned handle_cache_num_shards; /* power of 2 */
+    /* handles kept bound to their last destination (NULL if
+     * handle_cache_affinity_size is 0) */
+    size_t                        handle_cache_affinity_size;
+    struct margo_handle_affinity* handle_affinity;
+    /* usage counters and "handle_cache_tuning" state */
+    struct margo_handle_cache_tuner* handle_cache_tuner;
 
     /* arenas recycling the per-call structs that the async/callback and
      * server-receive paths would otherwise calloc/free on every operation */
     mochi_arena_t request_arena;     /* margo_request_struct */
     mochi_arena_t handle_data_arena; /* margo_handle_data */
+    /* "arenas" configuration: limit on the objects of each arena (0 for
+     * none), and period of the timer freeing their unused blocks */
+    size_t        arena_max_objects;
+    bool          arena_wait_when_full;
+    unsigned      arena_trim_interval_ms;
+    margo_timer_t arena_trim_timer;
+    /* "memory" configuration: how arena blocks and bulk pool buffers are
+     * allocated */
+    margo_memory_policy_t memory;
 
     /* logging */
     struct margo_logger logger;
@@ -161,6 +240,26 @@ struct margo_instance {
 
 #define MARGO_RPC_POOL(mid) (mid)->abt->pools[mid->rpc_pool_idx].pool
 
+/* Usage statistics of the instance's arenas, as a JSON object with one
+ * entry per arena (defined in margo-config.c) */
+struct json_object* __margo_arenas_stats_to_json(margo_instance_id mid);
+
+/* Gets an object from one of the instance's arenas. If the arena is full and
+ * "wait_when_full" is set, waits for an object to be released, unless the
+ * caller is a progress ULT (which would then never release it), a tasklet or
+ * an external thread, in which case NULL is returned (defined in
+ * margo-core.c) */
+void* __margo_arena_get(margo_instance_id mid, mochi_arena_t arena);
+
+/* Selects the Mercury context on which to create the next handle */
+static inline hg_context_t* __margo_next_hg_context(margo_instance_id mid)
+{
+    if (!mid->num_progress_contexts) return mid->hg.hg_context;
+    unsigned i = mid->progress_context_idx++ % (mid->num_progress_contexts + 1);
+    return i == 0 ? mid->hg.hg_context
+                  : mid->progress_contexts[i - 1].hg_context;
+}
+
 typedef enum margo_request_kind {
     MARGO_REQ_EVENTUAL,
     MARGO_REQ_CALLBACK
@@ -186,6 +285,19 @@ struct margo_request_struct {
             void* uargs;
         } callback;
     };
+    /* completion queue the request was added to, if any (see margo-cq.c) */
+    _Atomic(uintptr_t) cq_link;
+    void*              cq_uargs;
+    margo_request      cq_next;
+    margo_cq_t         cq_owner; /* user queue, for margo_wait_any */
+};
+
+/* Limit on the number of RPCs of a given ID that were dispatched to their
+ * pool but whose handler has not started yet (see
+ * margo_registered_set_max_queue_depth) */
+struct margo_rpc_queue_limit {
+    _Atomic unsigned max_depth; /* 0 means unlimited */
+    _Atomic unsigned depth;
 };
 
 // Data registered to an RPC id with HG_Register_data
@@ -195,7 +307,11 @@ struct margo_rpc_data {
     char*             rpc_name;
     hg_proc_cb_t      in_proc_cb;  /* user-provided input proc */
     hg_proc_cb_t      out_proc_cb; /* user-provided output proc */
-    void*             user_data;
+    _Atomic int       inline_mode; /* margo_inline_mode_t */
+    _Atomic(struct margo_rpc_workers*) workers; /* workers of the pool */
+    _Atomic unsigned pool_max_queue_depth; /* limit of the pool, 0 if none */
+    struct margo_rpc_queue_limit queue_limit;
+    void*                        user_data;
     void (*user_free_callback)(void*);
 };
 
@@ -207,7 +323,13 @@ struct margo_handle_data {
                                    not the responsibility of the handle to free it */
     hg_proc_cb_t in_proc_cb;    /* user-provided input proc */
     hg_proc_cb_t out_proc_cb;   /* user-provided output proc */
-    void*        user_data;
+    int          inline_mode;   /* margo_inline_mode_t */
+    struct margo_rpc_workers* workers;
+    unsigned                  pool_max_queue_depth;
+    struct margo_rpc_queue_limit* queue_limit;
+    bool queued; /* counted in queue_limit->depth until the handler starts */
+    double deadline; /* deadline set by the client, 0 if none */
+    void* user_data;
     void (*user_free_callback)(void*);
     margo_monitor_data_t monitor_data;
     /* if this handle came from the instance's handle cache, points back to
@@ -215,6 +337,9 @@ struct margo_handle_data {
      * Set once when the cache attaches the data, and used by
      * __margo_handle_cache_put to recycle the handle in O(1) without a lookup. */
     struct margo_handle_cache_el* cache_el;
+    /* created by margo_create because the handle cache was empty, counted as
+     * in use by the cache until destroyed */
+    bool uncached;
 };
 
 /* Frees a margo_handle_data; installed as the HG_Set_data free callback so
@@ -222,6 +347,24 @@ struct margo_handle_data {
  * can attach pre-allocated data to cached handles with the same callback. */
 void __margo_handle_data_free(void* args);
 
+/* Registers the RPC through which margo_iforward_multi relays RPCs */
+hg_id_t __margo_register_relay(margo_instance_id mid);
+
+/* Non-blocking forward in which in_proc_cb, if not NULL, serializes in_struct
+ * instead of the input callback registered for the RPC (which Mercury still
+ * uses on the receiving side). req must have been allocated by the caller. */
+hg_return_t __margo_provider_iforward_proc(uint16_t      provider_id,
+                                           hg_handle_t   handle,
+                                           double        timeout_ms,
+                                           hg_proc_cb_t  in_proc_cb,
+                                           void*         in_struct,
+                                           margo_request req);
+
+/* Returns the error that the margo header of a forward's output carries, as
+ * margo_wait does for eventual-based requests. Callback-based forwards do not
+ * get this check, hence it is exposed for the callbacks that need it. */
+hg_return_t __margo_check_error_in_output(hg_handle_t handle);
+
 struct lookup_cb_evt {
     hg_return_t hret;
     hg_addr_t   addr;
@@ -239,48 +382,48 @@ typedef struct {
     char      is_asleep;
 } margo_thread_sleep_cb_dat;
 
-#define PROGRESS_NEEDED_INCR(__mid__)                                \
-    do {                                                             \
-        bool notify = false;                                         \
-        if ((__mid__)->progress_when_needed.flag) {                  \
-            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(              \
-                &(__mid__)->progress_when_needed.mutex));            \
-            notify = ++(__mid__)->progress_when_needed.pending == 1; \
-            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(            \
-                &(__mid__)->progress_when_needed.mutex));            \
-        }                                                            \
-        if (notify) {                                                \
-            ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(              \
-                &(__mid__)->progress_when_needed.cond));             \
-        }                                                            \
-    } while (0)
-
-#define PROGRESS_NEEDED_DECR(__mid__)                     \
-    do {                                                  \
-        if ((__mid__)->progress_when_needed.flag) {       \
-            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(   \
-                &(__mid__)->progress_when_needed.mutex)); \
-            --(__mid__)->progress_when_needed.pending;    \
-            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE( \
-                &(__mid__)->progress_when_needed.mutex)); \
-        }                                                 \
+/* The pending counter is updated regardless of the flag, so that it stays
+ * consistent if the flag is changed while operations are in flight. The
+ * sequentially consistent increment of pending (resp. sleepers) followed by
+ * a load of sleepers (resp. pending) ensures that either the incrementing
+ * ULT sees the sleeper and broadcasts under the mutex, or the sleeper sees
+ * the new pending operation and does not wait. */
+#define PROGRESS_NEEDED_INCR(__mid__)                                      \
+    do {                                                                   \
+        if (atomic_fetch_add(&(__mid__)->progress_when_needed.pending, 1)  \
+                == 0                                                       \
+            && (__mid__)->progress_when_needed.flag                        \
+            && (__mid__)->progress_when_needed.sleepers) {                 \
+            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(                    \
+                &(__mid__)->progress_when_needed.mutex));                  \
+            ABT_cond_broadcast(ABT_COND_MEMORY_GET_HANDLE(                 \
+                &(__mid__)->progress_when_needed.cond));                   \
+            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(                  \
+                &(__mid__)->progress_when_needed.mutex));                  \
+        }                                                                  \
     } while (0)
 
-#define WAIT_FOR_PROGRESS_TO_BE_NEEDED(__mid__)                             \
-    do {                                                                    \
-        if ((__mid__)->progress_when_needed.flag) {                         \
-            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(                     \
-                &(__mid__)->progress_when_needed.mutex));                   \
-            while (!(__mid__)->progress_when_needed.pending) {              \
-                ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(                   \
-                                  &(__mid__)->progress_when_needed.cond),   \
-                              ABT_MUTEX_MEMORY_GET_HANDLE(                  \
-                                  &(__mid__)->progress_when_needed.mutex)); \
-                if (!(__mid__)->progress_when_needed.flag) break;           \
-            }                                                               \
-            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(                   \
-                &(__mid__)->progress_when_needed.mutex));                   \
-        }                                                                   \
+#define PROGRESS_NEEDED_DECR(__mid__) \
+    atomic_fetch_sub(&(__mid__)->progress_when_needed.pending, 1)
+
+#define WAIT_FOR_PROGRESS_TO_BE_NEEDED(__mid__)                               \
+    do {                                                                      \
+        if ((__mid__)->progress_when_needed.flag                              \
+            && !(__mid__)->progress_when_needed.pending) {                    \
+            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(                       \
+                &(__mid__)->progress_when_needed.mutex));                     \
+            atomic_fetch_add(&(__mid__)->progress_when_needed.sleepers, 1);   \
+            while ((__mid__)->progress_when_needed.flag                       \
+                   && !(__mid__)->progress_when_needed.pending) {             \
+                ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(                     \
+                                  &(__mid__)->progress_when_needed.cond),     \
+                              ABT_MUTEX_MEMORY_GET_HANDLE(                    \
+                                  &(__mid__)->progress_when_needed.mutex));   \
+            }                                                                 \
+            atomic_fetch_sub(&(__mid__)->progress_when_needed.sleepers, 1);   \
+            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(                     \
+                &(__mid__)->progress_when_needed.mutex));                     \
+        }                                                                     \
     } while (0)
 
 #define MARGO_TRACE    margo_trace
@@ -0,0 +1,183 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_MOCHI_PLUMBER
+    #include <hwloc.h>
+#endif
+#include "margo.h"
+#include "margo-macros.h"
+#include "margo-memory.h"
+
+/* size of the transparent huge pages the mappings are aligned on */
+#define MARGO_HUGEPAGE_SIZE (2UL * 1024 * 1024)
+
+/* Round x up to a multiple of a (a must be a power of two). */
+static inline size_t round_up(size_t x, size_t a)
+{
+    return (x + (a - 1)) & ~(a - 1);
+}
+
+static size_t mapping_length(const margo_memory_policy_t* policy, size_t size)
+{
+    size_t align = policy->hugepages ? MARGO_HUGEPAGE_SIZE
+                                     : (size_t)sysconf(_SC_PAGESIZE);
+    return round_up(size, align);
+}
+
+bool __margo_memory_validate_json(const struct json_object* config)
+{
+    if (!config) return true;
+
+#define HANDLE_CONFIG_ERROR return false
+
+    /* Fields:
+       - [optional] hugepages: bool (default false)
+       - [optional] numa_local: bool (default false)
+    */
+
+    if (!json_object_is_type(config, json_type_object)) {
+        margo_error(0, "\"memory\" field in configuration "
+                       "should be an object");
+        HANDLE_CONFIG_ERROR;
+    }
+
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "hugepages", boolean, "memory");
+    ASSERT_CONFIG_HAS_OPTIONAL(config, "numa_local", boolean, "memory");
+
+    return true;
+#undef HANDLE_CONFIG_ERROR
+}
+
+void __margo_memory_policy_init(margo_memory_policy_t*    policy,
+                                const struct json_object* config)
+{
+    policy->hugepages
+        = json_object_object_get_bool_or(config, "hugepages", false);
+    policy->numa_local
+        = json_object_object_get_bool_or(config, "numa_local", false);
+    policy->topology = NULL;
+    if (!policy->numa_local) return;
+
+#ifdef HAVE_MOCHI_PLUMBER
+    hwloc_topology_t topology;
+    if (hwloc_topology_init(&topology) != 0) goto no_binding;
+    if (hwloc_topology_load(topology) != 0) {
+        hwloc_topology_destroy(topology);
+        goto no_binding;
+    }
+    policy->topology = topology;
+    return;
+no_binding:
+    margo_warning(0,
+                  "Could not load the hwloc topology, \"memory.numa_local\" "
+                  "will rely on first-touch placement");
+#else
+    margo_warning(0,
+                  "Margo was built without hwloc, \"memory.numa_local\" "
+                  "will rely on first-touch placement");
+#endif
+}
+
+bool __margo_memory_policy_is_set(const margo_memory_policy_t* policy)
+{
+    return policy->hugepages || policy->numa_local;
+}
+
+struct json_object*
+__margo_memory_policy_to_json(const margo_memory_policy_t* policy)
+{
+    if (!__margo_memory_policy_is_set(policy)) return NULL;
+    int flags = JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_CONSTANT_KEY;
+    struct json_object* json = json_object_new_object();
+    json_object_object_add_ex(json, "hugepages",
+                              json_object_new_boolean(policy->hugepages),
+                              flags);
+    json_object_object_add_ex(json, "numa_local",
+                              json_object_new_boolean(policy->numa_local),
+                              flags);
+    return json;
+}
+
+void __margo_memory_policy_finalize(margo_memory_policy_t* policy)
+{
+#ifdef HAVE_MOCHI_PLUMBER
+    if (policy->topology) hwloc_topology_destroy(policy->topology);
+#endif
+    policy->topology = NULL;
+}
+
+/* Binds the pages of [ptr, ptr+length) to the NUMA node of the core the
+ * caller last ran on. Best effort: pages stay subject to first-touch
+ * placement if binding is not supported. */
+static void bind_local(const margo_memory_policy_t* policy,
+                       void*                        ptr,
+                       size_t                       length)
+{
+#ifdef HAVE_MOCHI_PLUMBER
+    if (!policy->topology) return;
+    hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+    if (!cpuset) return;
+    if (hwloc_get_last_cpu_location(policy->topology, cpuset,
+                                    HWLOC_CPUBIND_THREAD)
+        == 0)
+        hwloc_set_area_membind(policy->topology, ptr, length, cpuset,
+                               HWLOC_MEMBIND_BIND, 0);
+    hwloc_bitmap_free(cpuset);
+#else
+    (void)policy;
+    (void)ptr;
+    (void)length;
+#endif
+}
+
+void* __margo_memory_alloc(const margo_memory_policy_t* policy, size_t size)
+{
+    if (!__margo_memory_policy_is_set(policy)) {
+        void* ptr = NULL;
+        if (posix_memalign(&ptr, 4096, size) != 0) return NULL;
+        return ptr;
+    }
+
+    size_t length = mapping_length(policy, size);
+    /* mmap only guarantees page alignment, so map an extra huge page and
+     * unmap what lies outside of the aligned range */
+    size_t extra = policy->hugepages ? MARGO_HUGEPAGE_SIZE : 0;
+    char*  ptr   = mmap(NULL, length + extra, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
+    if (extra) {
+        char*  aligned = (char*)round_up((uintptr_t)ptr, MARGO_HUGEPAGE_SIZE);
+        size_t head    = aligned - ptr;
+        if (head) munmap(ptr, head);
+        if (extra - head) munmap(aligned + length, extra - head);
+        ptr = aligned;
+#ifdef MADV_HUGEPAGE
+        /* only a hint, the kernel may not have transparent huge pages */
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+    }
+    if (policy->numa_local) bind_local(policy, ptr, length);
+    return ptr;
+}
+
+void __margo_memory_free(const margo_memory_policy_t* policy,
+                         void*                        ptr,
+                         size_t                       size)
+{
+    if (!ptr) return;
+    if (!__margo_memory_policy_is_set(policy))
+        free(ptr);
+    else
+        munmap(ptr, mapping_length(policy, size));
+}
+
+size_t __margo_memory_granularity(const margo_memory_policy_t* policy)
+{
+    return policy->hugepages ? MARGO_HUGEPAGE_SIZE : 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __MARGO_MEMORY_H
+#define __MARGO_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <json-c/json.h>
+
+struct hwloc_topology;
+
+/* Policy used to allocate the blocks of the instance's arenas and the
+ * buffers of its bulk pools (see "memory" in the margo configuration).
+ * With the default policy memory comes from malloc/posix_memalign. Otherwise
+ * it is mmap-ed, advised with MADV_HUGEPAGE if hugepages is set, and bound
+ * to the NUMA node of the calling execution stream if numa_local is set and
+ * margo was built with hwloc (i.e. with mochi-plumber support). Without
+ * hwloc, numa_local only relies on the kernel's first-touch placement. */
+typedef struct margo_memory_policy {
+    bool                   hugepages;
+    bool                   numa_local;
+    struct hwloc_topology* topology; /* NULL if NUMA binding is unavailable */
+} margo_memory_policy_t;
+
+bool __margo_memory_validate_json(const struct json_object* config);
+
+/* Reads the policy from the "memory" configuration (which may be NULL) and
+ * loads the hwloc topology if needed. */
+void __margo_memory_policy_init(margo_memory_policy_t*    policy,
+                                const struct json_object* config);
+
+/* Returns true if the policy differs from plain malloc. */
+bool __margo_memory_policy_is_set(const margo_memory_policy_t* policy);
+
+/* Returns the "memory" configuration, or NULL for the default policy. */
+struct json_object*
+__margo_memory_policy_to_json(const margo_memory_policy_t* policy);
+
+void __margo_memory_policy_finalize(margo_memory_policy_t* policy);
+
+/* Allocates size bytes, aligned on at least a page, according to the policy.
+ * The memory must be freed by __margo_memory_free with the same size. */
+void* __margo_memory_alloc(const margo_memory_policy_t* policy, size_t size);
+
+void __margo_memory_free(const margo_memory_policy_t* policy,
+                         void*                        ptr,
+                         size_t                       size);
+
+/* Granularity at which the policy hands out memory (a huge page if
+ * hugepages is set, 0 otherwise), so that callers can size their
+ * allocations to fill it. */
+size_t __margo_memory_granularity(const margo_memory_policy_t* policy);
+
+#endif
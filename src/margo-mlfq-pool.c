@@ -0,0 +1,393 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <abt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "margo-mlfq-pool.h"
+
+/* ABT_POOL_MLFQ_WAIT */
+
+/* This is a custom Argobots pool, compatible with ABT_POOL_FIFO_WAIT, that
+ * generalizes the two levels of the prio_wait pool into a multi-level
+ * feedback queue:
+ *
+ * - new units enter the first (highest priority) level;
+ * - a unit that has yielded levels[i].demote_after times while at level i
+ *   moves to level i+1, so long-running background ULTs sink to the lower
+ *   levels while short RPC handlers complete at the top;
+ * - pops serve the highest non-empty level, but a level may only run
+ *   levels[i].quantum units in a row while a lower level is waiting, after
+ *   which the next non-empty lower level runs one unit;
+ * - every boost_period_ms, all the units are moved back to the first level
+ *   (units that are running at that time are moved on their next push).
+ */
+
+typedef struct unit_t {
+    ABT_thread     thread;
+    ABT_task       task;
+    struct unit_t* p_prev;
+    struct unit_t* p_next;
+    unsigned       level;
+    unsigned       num_yields; /* at the current level */
+    uint64_t       epoch;      /* boost epoch of the level/num_yields fields */
+    bool           started;    /* pushed at least once */
+    ABT_bool       is_in_pool;
+} unit_t;
+
+typedef struct queue_t {
+    unit_t* p_head;
+    unit_t* p_tail;
+} queue_t;
+
+typedef struct pool_t {
+    margo_mlfq_params_t params;
+    queue_t             queues[MARGO_MLFQ_MAX_LEVELS];
+    unsigned            served[MARGO_MLFQ_MAX_LEVELS]; /* pops in a row */
+    uint64_t            epoch;
+    uint64_t            next_boost_ms;
+    _Atomic size_t      num; /* read locklessly in pool_pop's fast path */
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+} pool_t;
+
+void margo_mlfq_params_init(margo_mlfq_params_t* params)
+{
+    static const margo_mlfq_level_t default_levels[3]
+        = {{16, 8}, {4, 64}, {1, 0}};
+    params->num_levels = 3;
+    for (unsigned i = 0; i < 3; i++) params->levels[i] = default_levels[i];
+    params->boost_period_ms = 100;
+}
+
+static inline uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline void queue_push(queue_t* p_queue, unit_t* p_unit)
+{
+    p_unit->p_next = NULL;
+    p_unit->p_prev = p_queue->p_tail;
+    if (p_queue->p_tail)
+        p_queue->p_tail->p_next = p_unit;
+    else
+        p_queue->p_head = p_unit;
+    p_queue->p_tail = p_unit;
+}
+
+static inline void queue_unlink(queue_t* p_queue, unit_t* p_unit)
+{
+    if (p_unit->p_prev)
+        p_unit->p_prev->p_next = p_unit->p_next;
+    else
+        p_queue->p_head = p_unit->p_next;
+    if (p_unit->p_next)
+        p_unit->p_next->p_prev = p_unit->p_prev;
+    else
+        p_queue->p_tail = p_unit->p_prev;
+    p_unit->p_next = NULL;
+    p_unit->p_prev = NULL;
+}
+
+/* appends the units of src at the end of dst, setting their level */
+static inline void queue_splice(queue_t* dst, queue_t* src, unsigned level)
+{
+    if (!src->p_head) return;
+    for (unit_t* p_unit = src->p_head; p_unit; p_unit = p_unit->p_next)
+        p_unit->level = level;
+    if (dst->p_tail) {
+        dst->p_tail->p_next = src->p_head;
+        src->p_head->p_prev = dst->p_tail;
+    } else {
+        dst->p_head = src->p_head;
+    }
+    dst->p_tail = src->p_tail;
+    src->p_head = NULL;
+    src->p_tail = NULL;
+}
+
+/* must be called with the pool's mutex held */
+static void pool_boost(pool_t* p_pool)
+{
+    p_pool->epoch++;
+    for (unsigned i = 1; i < p_pool->params.num_levels; i++)
+        queue_splice(&p_pool->queues[0], &p_pool->queues[i], 0);
+    unit_t* p_unit = p_pool->queues[0].p_head;
+    while (p_unit) {
+        p_unit->num_yields = 0;
+        p_unit->epoch      = p_pool->epoch;
+        p_unit             = p_unit->p_next;
+    }
+    for (unsigned i = 0; i < p_pool->params.num_levels; i++)
+        p_pool->served[i] = 0;
+}
+
+/* must be called with the pool's mutex held */
+static unit_t* pool_pop_locked(pool_t* p_pool)
+{
+    if (p_pool->params.boost_period_ms) {
+        uint64_t now = now_ms();
+        if (now >= p_pool->next_boost_ms) {
+            pool_boost(p_pool);
+            p_pool->next_boost_ms = now + p_pool->params.boost_period_ms;
+        }
+    }
+
+    unsigned num_levels = p_pool->params.num_levels;
+    unsigned level      = 0;
+    while (level < num_levels && !p_pool->queues[level].p_head) level++;
+    if (level == num_levels) return NULL;
+
+    while (true) {
+        unsigned next = level + 1;
+        while (next < num_levels && !p_pool->queues[next].p_head) next++;
+        if (next == num_levels) break; /* no lower level is waiting */
+        if (p_pool->served[level] < p_pool->params.levels[level].quantum) {
+            p_pool->served[level]++;
+            break;
+        }
+        /* quantum used up, let the next lower level run */
+        p_pool->served[level] = 0;
+        level                 = next;
+    }
+
+    unit_t* p_unit = p_pool->queues[level].p_head;
+    queue_unlink(&p_pool->queues[level], p_unit);
+    p_unit->is_in_pool = ABT_FALSE;
+    p_pool->num--;
+    return p_unit;
+}
+
+static ABT_unit_type pool_unit_get_type(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    if (p_unit->thread != ABT_THREAD_NULL) {
+        return ABT_UNIT_TYPE_THREAD;
+    } else {
+        return ABT_UNIT_TYPE_TASK;
+    }
+}
+
+static ABT_thread pool_unit_get_thread(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->thread;
+}
+
+static ABT_task pool_unit_get_task(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->task;
+}
+
+static ABT_bool pool_unit_is_in_pool(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->is_in_pool;
+}
+
+static ABT_unit pool_unit_create_from_thread(ABT_thread thread)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread     = thread;
+    p_unit->task       = ABT_TASK_NULL;
+    p_unit->is_in_pool = ABT_FALSE;
+    return (ABT_unit)p_unit;
+}
+
+static ABT_unit pool_unit_create_from_task(ABT_task task)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread     = ABT_THREAD_NULL;
+    p_unit->task       = task;
+    p_unit->is_in_pool = ABT_FALSE;
+    return (ABT_unit)p_unit;
+}
+
+static void pool_unit_free(ABT_unit* p_unit)
+{
+    free(*p_unit);
+    *p_unit = ABT_UNIT_NULL;
+}
+
+static int pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    (void)config;
+    pool_t* p_pool = (pool_t*)calloc(1, sizeof(pool_t));
+    if (!p_pool) return ABT_ERR_MEM;
+    margo_mlfq_params_init(&p_pool->params);
+    p_pool->next_boost_ms = now_ms() + p_pool->params.boost_period_ms;
+    pthread_mutex_init(&p_pool->mutex, NULL);
+    pthread_cond_init(&p_pool->cond, NULL);
+    ABT_pool_set_data(pool, (void*)p_pool);
+    return ABT_SUCCESS;
+}
+
+static size_t pool_get_size(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    return p_pool->num;
+}
+
+static void pool_push(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t* p_unit = (unit_t*)unit;
+
+    pthread_mutex_lock(&p_pool->mutex);
+    unsigned num_levels = p_pool->params.num_levels;
+    if (p_unit->epoch != p_pool->epoch) {
+        /* a boost happened since the unit was last pushed */
+        p_unit->level      = 0;
+        p_unit->num_yields = 0;
+        p_unit->epoch      = p_pool->epoch;
+    } else if (p_unit->started) {
+        /* the unit ran and yielded (or was suspended) */
+        unsigned demote_after = p_unit->level < num_levels
+                                  ? p_pool->params.levels[p_unit->level]
+                                        .demote_after
+                                  : 0;
+        p_unit->num_yields++;
+        if (demote_after && p_unit->num_yields >= demote_after) {
+            p_unit->level++;
+            p_unit->num_yields = 0;
+        }
+    }
+    if (p_unit->level >= num_levels) p_unit->level = num_levels - 1;
+    p_unit->started = true;
+    queue_push(&p_pool->queues[p_unit->level], p_unit);
+    p_unit->is_in_pool = ABT_TRUE;
+    p_pool->num++;
+    pthread_cond_signal(&p_pool->cond);
+    pthread_mutex_unlock(&p_pool->mutex);
+}
+
+static ABT_unit pool_pop(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    /* Fast path: skip taking the mutex when the pool is empty (see the
+     * prio_wait pool). */
+    if (atomic_load_explicit(&p_pool->num, memory_order_relaxed) == 0)
+        return ABT_UNIT_NULL;
+
+    pthread_mutex_lock(&p_pool->mutex);
+    unit_t* p_unit = pool_pop_locked(p_pool);
+    pthread_mutex_unlock(&p_pool->mutex);
+    return p_unit ? (ABT_unit)p_unit : ABT_UNIT_NULL;
+}
+
+static inline void convert_double_sec_to_timespec(struct timespec* ts_out,
+                                                  double           seconds)
+{
+    ts_out->tv_sec  = (time_t)seconds;
+    ts_out->tv_nsec = (long)((seconds - ts_out->tv_sec) * 1000000000.0);
+}
+
+static ABT_unit pool_pop_timedwait(ABT_pool pool, double abstime_secs)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_lock(&p_pool->mutex);
+    if (p_pool->num == 0) {
+        struct timespec ts;
+        convert_double_sec_to_timespec(&ts, abstime_secs);
+        pthread_cond_timedwait(&p_pool->cond, &p_pool->mutex, &ts);
+    }
+    unit_t* p_unit = pool_pop_locked(p_pool);
+    pthread_mutex_unlock(&p_pool->mutex);
+    return p_unit ? (ABT_unit)p_unit : ABT_UNIT_NULL;
+}
+
+static int pool_remove(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t* p_unit = (unit_t*)unit;
+
+    pthread_mutex_lock(&p_pool->mutex);
+    if (!p_unit->is_in_pool) {
+        pthread_mutex_unlock(&p_pool->mutex);
+        return ABT_ERR_POOL;
+    }
+    queue_unlink(&p_pool->queues[p_unit->level], p_unit);
+    p_unit->is_in_pool = ABT_FALSE;
+    p_pool->num--;
+    pthread_mutex_unlock(&p_pool->mutex);
+
+    return ABT_SUCCESS;
+}
+
+static int pool_free(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_destroy(&p_pool->mutex);
+    pthread_cond_destroy(&p_pool->cond);
+    free(p_pool);
+
+    return ABT_SUCCESS;
+}
+
+void margo_create_mlfq_pool_def(ABT_pool_def* p_def)
+{
+    p_def->access               = ABT_POOL_ACCESS_MPMC;
+    p_def->u_get_type           = pool_unit_get_type;
+    p_def->u_get_thread         = pool_unit_get_thread;
+    p_def->u_get_task           = pool_unit_get_task;
+    p_def->u_is_in_pool         = pool_unit_is_in_pool;
+    p_def->u_create_from_thread = pool_unit_create_from_thread;
+    p_def->u_create_from_task   = pool_unit_create_from_task;
+    p_def->u_free               = pool_unit_free;
+    p_def->p_init               = pool_init;
+    p_def->p_get_size           = pool_get_size;
+    p_def->p_push               = pool_push;
+    p_def->p_pop                = pool_pop;
+    p_def->p_pop_timedwait      = pool_pop_timedwait;
+    p_def->p_remove             = pool_remove;
+    p_def->p_free               = pool_free;
+    p_def->p_print_all          = NULL; /* Optional. */
+}
+
+void margo_mlfq_pool_set_params(ABT_pool                   pool,
+                                const margo_mlfq_params_t* params)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    if (params->num_levels == 0 || params->num_levels > MARGO_MLFQ_MAX_LEVELS)
+        return;
+    pthread_mutex_lock(&p_pool->mutex);
+    /* units in levels that no longer exist go to the new last level */
+    for (unsigned i = params->num_levels; i < p_pool->params.num_levels; i++)
+        queue_splice(&p_pool->queues[params->num_levels - 1],
+                     &p_pool->queues[i], params->num_levels - 1);
+    p_pool->params        = *params;
+    p_pool->next_boost_ms = now_ms() + params->boost_period_ms;
+    for (unsigned i = 0; i < MARGO_MLFQ_MAX_LEVELS; i++) p_pool->served[i] = 0;
+    pthread_mutex_unlock(&p_pool->mutex);
+}
+
+void margo_mlfq_pool_get_params(ABT_pool pool, margo_mlfq_params_t* params)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_lock(&p_pool->mutex);
+    *params = p_pool->params;
+    pthread_mutex_unlock(&p_pool->mutex);
+}
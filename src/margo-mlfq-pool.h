@@ -0,0 +1,47 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef __MARGO_MLFQ_POOL
+#define __MARGO_MLFQ_POOL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <abt.h>
+
+#define MARGO_MLFQ_MAX_LEVELS 16
+
+typedef struct margo_mlfq_level {
+    /* consecutive units this level may run while lower levels wait */
+    unsigned quantum;
+    /* yields after which a unit moves to the next level (0 for never) */
+    unsigned demote_after;
+} margo_mlfq_level_t;
+
+typedef struct margo_mlfq_params {
+    unsigned           num_levels;
+    margo_mlfq_level_t levels[MARGO_MLFQ_MAX_LEVELS];
+    /* all units go back to the first level this often (0 for never) */
+    unsigned boost_period_ms;
+} margo_mlfq_params_t;
+
+/* Default parameters: 3 levels with quanta 16, 4, 1, demotion after 8
+ * and 64 yields, and a boost every 100 ms */
+void margo_mlfq_params_init(margo_mlfq_params_t* params);
+
+void margo_create_mlfq_pool_def(ABT_pool_def* p_def);
+
+void margo_mlfq_pool_set_params(ABT_pool                   pool,
+                                const margo_mlfq_params_t* params);
+
+void margo_mlfq_pool_get_params(ABT_pool pool, margo_mlfq_params_t* params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MARGO_MLFQ_POOL */
@@ -0,0 +1,671 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "margo.h"
+#include "margo-multi.h"
+#include "margo-instance.h"
+#include "margo-id.h"
+
+/* A multi-destination forward serializes its input once with the input
+ * callback of the RPC, and every handle then copies the resulting bytes into
+ * its own buffer. When relayed, these bytes travel down a tree of "__relay__"
+ * RPCs: each relay receives the list of destinations of its subtree (itself
+ * first), forwards the RPC to itself, splits the rest of the list into
+ * relay_fanout groups, and relays the RPC to the first destination of each
+ * group. Each relay responds with the statuses of its subtree. A relay does
+ * not wait for its subtree in its handler ULT: its operations complete with
+ * callbacks, and the last one sends the response. The RPC a relay sends to
+ * itself goes through Mercury's local path, not through the network.
+ * Instances refuse to relay until margo_enable_relay is called. */
+
+struct multi_payload {
+    void*     data;
+    hg_size_t size;
+};
+
+/* Either the RPC sent to a destination, or the relay RPC sent to the first
+ * destination of a subtree */
+struct multi_op {
+    struct margo_multi_request* m;
+    hg_handle_t                 handle;
+    margo_request               req;
+    size_t first; /* first destination reached by the operation */
+    size_t count; /* number of destinations it reaches */
+    bool   relay;
+};
+
+struct margo_multi_request {
+    margo_instance_id mid;
+    size_t            count; /* number of destinations */
+    hg_return_t*      rets;  /* result for each destination */
+    struct multi_op*  ops;
+    size_t            num_ops;
+    bool              relayed;
+    bool              completed;
+    /* if set, the operations complete with callbacks instead of being
+     * waited for, and on_done is called once none of them is pending */
+    void (*on_done)(struct margo_multi_request* m, void* uargs);
+    void*          on_done_uargs;
+    _Atomic size_t pending;
+};
+
+/* Destinations of a relayed forward. Only the root of the tree knows their
+ * hg_addr_t, relays look up their addresses from addr_strs. */
+struct relay_tree {
+    hg_id_t               rpc_id;
+    double                timeout_ms;
+    unsigned              fanout;
+    const hg_addr_t*      addrs;
+    char**                addr_strs;
+    uint16_t*             provider_ids;
+    struct multi_payload* payload;
+};
+
+typedef struct {
+    uint64_t             rpc_id;
+    double               timeout_ms;
+    uint32_t             fanout;
+    uint64_t             count; /* destinations, the first being the receiver */
+    char**               addrs; /* addresses of the others (addrs[0] unused) */
+    uint16_t*            provider_ids;
+    struct multi_payload payload;
+} relay_in_t;
+
+typedef struct {
+    uint64_t count;
+    int32_t* rets;
+} relay_out_t;
+
+#define PROC_OR_RETURN(__call__)                      \
+    do {                                              \
+        hg_return_t __hret = (__call__);              \
+        if (__hret != HG_SUCCESS) return __hret;      \
+    } while (0)
+
+static void relay_in_free(relay_in_t* in)
+{
+    for (uint64_t i = 1; in->addrs && i < in->count; i++) free(in->addrs[i]);
+    free(in->addrs);
+    free(in->provider_ids);
+    free(in->payload.data);
+    memset(in, 0, sizeof(*in));
+}
+
+static hg_return_t proc_relay_in(hg_proc_t proc, relay_in_t* in)
+{
+    hg_proc_op_t op = hg_proc_get_op(proc);
+
+    PROC_OR_RETURN(hg_proc_uint64_t(proc, &in->rpc_id));
+    PROC_OR_RETURN(hg_proc_memcpy(proc, &in->timeout_ms, sizeof(double)));
+    PROC_OR_RETURN(hg_proc_uint32_t(proc, &in->fanout));
+    PROC_OR_RETURN(hg_proc_uint64_t(proc, &in->count));
+    if (op == HG_DECODE) {
+        /* the sizes below come from the sender, so they are checked against
+         * what is left in the buffer before being allocated (each
+         * destination takes at least the bytes of its provider id) */
+        if (in->count > hg_proc_get_size_left(proc) / sizeof(uint16_t))
+            return HG_OVERFLOW;
+        in->addrs        = calloc(in->count, sizeof(*in->addrs));
+        in->provider_ids = calloc(in->count, sizeof(*in->provider_ids));
+        if (!in->addrs || !in->provider_ids) return HG_NOMEM;
+    }
+    for (uint64_t i = 0; i < in->count; i++)
+        PROC_OR_RETURN(hg_proc_uint16_t(proc, &in->provider_ids[i]));
+    for (uint64_t i = 1; i < in->count; i++) {
+        uint32_t len = op == HG_ENCODE ? strlen(in->addrs[i]) + 1 : 0;
+        PROC_OR_RETURN(hg_proc_uint32_t(proc, &len));
+        if (op == HG_DECODE && len > hg_proc_get_size_left(proc))
+            return HG_OVERFLOW;
+        if (op == HG_DECODE && !(in->addrs[i] = malloc(len))) return HG_NOMEM;
+        PROC_OR_RETURN(hg_proc_memcpy(proc, in->addrs[i], len));
+    }
+    PROC_OR_RETURN(hg_proc_hg_size_t(proc, &in->payload.size));
+    if (op == HG_DECODE && in->payload.size > hg_proc_get_size_left(proc))
+        return HG_OVERFLOW;
+    if (op == HG_DECODE && in->payload.size
+        && !(in->payload.data = malloc(in->payload.size)))
+        return HG_NOMEM;
+    if (in->payload.size)
+        PROC_OR_RETURN(
+            hg_proc_memcpy(proc, in->payload.data, in->payload.size));
+    return HG_SUCCESS;
+}
+
+static hg_return_t hg_proc_relay_in_t(hg_proc_t proc, void* arg)
+{
+    relay_in_t* in = (relay_in_t*)arg;
+    if (hg_proc_get_op(proc) == HG_FREE) {
+        relay_in_free(in);
+        return HG_SUCCESS;
+    }
+    hg_return_t hret = proc_relay_in(proc, in);
+    if (hret != HG_SUCCESS && hg_proc_get_op(proc) == HG_DECODE)
+        relay_in_free(in);
+    return hret;
+}
+
+static hg_return_t hg_proc_relay_out_t(hg_proc_t proc, void* arg)
+{
+    relay_out_t* out = (relay_out_t*)arg;
+    switch (hg_proc_get_op(proc)) {
+    case HG_FREE:
+        free(out->rets);
+        out->rets = NULL;
+        return HG_SUCCESS;
+    case HG_DECODE:
+        PROC_OR_RETURN(hg_proc_uint64_t(proc, &out->count));
+        if (out->count > hg_proc_get_size_left(proc) / sizeof(*out->rets))
+            return HG_OVERFLOW;
+        out->rets = calloc(out->count, sizeof(*out->rets));
+        if (out->count && !out->rets) return HG_NOMEM;
+        break;
+    default:
+        PROC_OR_RETURN(hg_proc_uint64_t(proc, &out->count));
+        break;
+    }
+    for (uint64_t i = 0; i < out->count; i++)
+        PROC_OR_RETURN(hg_proc_int32_t(proc, &out->rets[i]));
+    return HG_SUCCESS;
+}
+
+/* Copies the serialized input into the buffer of a handle */
+static hg_return_t hg_proc_multi_payload(hg_proc_t proc, void* arg)
+{
+    struct multi_payload* payload = (struct multi_payload*)arg;
+    if (hg_proc_get_op(proc) != HG_ENCODE) return HG_SUCCESS;
+    return hg_proc_memcpy(proc, payload->data, payload->size);
+}
+
+static hg_return_t payload_encode(margo_instance_id     mid,
+                                  hg_id_t               id,
+                                  void*                 in_struct,
+                                  struct multi_payload* payload)
+{
+    struct margo_rpc_data* rpc_data
+        = (struct margo_rpc_data*)HG_Registered_data(mid->hg.hg_class, id);
+    if (!rpc_data) return HG_NOENTRY;
+    payload->data = NULL;
+    payload->size = 0;
+    if (!rpc_data->in_proc_cb) return HG_SUCCESS;
+
+    hg_size_t buf_size = HG_Class_get_input_eager_size(mid->hg.hg_class);
+    if (!buf_size) buf_size = 4096;
+    void* buf = malloc(buf_size);
+    if (!buf) return HG_NOMEM;
+    hg_proc_t   proc;
+    hg_return_t hret = hg_proc_create_set(mid->hg.hg_class, buf, buf_size,
+                                          HG_ENCODE, HG_NOHASH, &proc);
+    if (hret != HG_SUCCESS) {
+        free(buf);
+        return hret;
+    }
+    hret = rpc_data->in_proc_cb(proc, in_struct);
+    if (hret == HG_SUCCESS) {
+        payload->size = hg_proc_get_size_used(proc);
+        /* larger inputs are moved to an extra buffer owned by the proc */
+        void* extra = hg_proc_get_extra_buf(proc);
+        if (extra) {
+            void* data = malloc(payload->size);
+            if (data)
+                memcpy(data, extra, payload->size);
+            else
+                hret = HG_NOMEM;
+            free(buf);
+            buf = data;
+        }
+    }
+    hg_proc_free(proc);
+    if (hret != HG_SUCCESS) {
+        free(buf);
+        payload->size = 0;
+        return hret;
+    }
+    payload->data = buf;
+    return HG_SUCCESS;
+}
+
+static struct margo_multi_request*
+multi_create(margo_instance_id mid, size_t count, size_t max_ops)
+{
+    struct margo_multi_request* m = calloc(1, sizeof(*m));
+    if (!m) return NULL;
+    m->mid   = mid;
+    m->count = count;
+    m->rets  = calloc(count, sizeof(*m->rets));
+    m->ops   = calloc(max_ops, sizeof(*m->ops));
+    if ((count && !m->rets) || (max_ops && !m->ops)) {
+        free(m->rets);
+        free(m->ops);
+        free(m);
+        return NULL;
+    }
+    return m;
+}
+
+static void multi_free(struct margo_multi_request* m)
+{
+    if (!m) return;
+    for (size_t i = 0; i < m->num_ops; i++)
+        if (m->ops[i].handle) margo_destroy(m->ops[i].handle);
+    free(m->ops);
+    free(m->rets);
+    free(m);
+}
+
+static void multi_fail(struct margo_multi_request* m,
+                       size_t                      first,
+                       size_t                      count,
+                       hg_return_t                 hret)
+{
+    for (size_t i = first; i < first + count; i++) m->rets[i] = hret;
+}
+
+/* Records the result of an operation */
+static void multi_op_complete(struct margo_multi_request* m,
+                              struct multi_op*            op,
+                              hg_return_t                 hret)
+{
+    if (!op->relay) {
+        m->rets[op->first] = hret;
+        return;
+    }
+    if (hret == HG_SUCCESS) {
+        relay_out_t out = {0};
+        hret            = margo_get_output(op->handle, &out);
+        if (hret == HG_SUCCESS) {
+            if (out.count == op->count)
+                for (size_t j = 0; j < op->count; j++)
+                    m->rets[op->first + j] = (hg_return_t)out.rets[j];
+            else
+                hret = HG_PROTOCOL_ERROR;
+            margo_free_output(op->handle, &out);
+        }
+    }
+    if (hret != HG_SUCCESS) multi_fail(m, op->first, op->count, hret);
+    /* relayed outputs are not available to the caller */
+    margo_destroy(op->handle);
+    op->handle = HG_HANDLE_NULL;
+}
+
+/* Drops a reference on the pending operations of a request whose
+ * operations complete with callbacks */
+static void multi_release(struct margo_multi_request* m)
+{
+    if (atomic_fetch_sub_explicit(&m->pending, 1, memory_order_acq_rel) == 1)
+        m->on_done(m, m->on_done_uargs);
+}
+
+/* Completion callback of the operations of such a request (called in the
+ * progress loop, so it must not block) */
+static void multi_op_done(void* uargs, hg_return_t hret)
+{
+    struct multi_op*            op = (struct multi_op*)uargs;
+    struct margo_multi_request* m  = op->m;
+    multi_op_complete(m, op, hret);
+    multi_release(m);
+}
+
+/* Sends the RPC to destination dest */
+static void multi_forward(struct margo_multi_request* m,
+                          hg_addr_t                   addr,
+                          hg_id_t                     id,
+                          uint16_t                    provider_id,
+                          double                      timeout_ms,
+                          struct multi_payload*       payload,
+                          size_t                      dest)
+{
+    margo_instance_id mid = m->mid;
+    struct multi_op*  op  = &m->ops[m->num_ops++];
+    margo_request     req = MARGO_REQUEST_NULL;
+    op->m                 = m;
+    op->first             = dest;
+    op->count             = 1;
+
+    hg_return_t hret = margo_create(mid, addr, id, &op->handle);
+    if (hret != HG_SUCCESS) goto error;
+    req = __margo_arena_get(mid, mid->request_arena);
+    if (!req) {
+        hret = HG_NOMEM_ERROR;
+        goto error;
+    }
+    if (m->on_done) {
+        /* the request is released by margo once the callback has run */
+        req->kind           = MARGO_REQ_CALLBACK;
+        req->callback.cb    = multi_op_done;
+        req->callback.uargs = op;
+        atomic_fetch_add_explicit(&m->pending, 1, memory_order_relaxed);
+    } else {
+        op->req = req;
+    }
+    hret = __margo_provider_iforward_proc(
+        provider_id, op->handle, timeout_ms,
+        payload->data ? hg_proc_multi_payload : NULL, payload, req);
+    if (hret == HG_SUCCESS) return;
+
+    /* the caller holds a reference, so this is not the last one */
+    if (m->on_done)
+        atomic_fetch_sub_explicit(&m->pending, 1, memory_order_relaxed);
+    mochi_arena_release(mid->request_arena, req);
+error:
+    op->req = MARGO_REQUEST_NULL;
+    if (op->handle) margo_destroy(op->handle);
+    op->handle = HG_HANDLE_NULL;
+    multi_fail(m, dest, 1, hret);
+}
+
+/* Number of hops from the first destination of a subtree to its farthest
+ * destination, plus one */
+static unsigned subtree_depth(size_t count, unsigned fanout)
+{
+    unsigned depth = 0;
+    while (count) {
+        depth += 1;
+        count = (count - 1 + fanout - 1) / fanout;
+    }
+    return depth;
+}
+
+/* Relays the RPC to the subtree of count destinations starting at first */
+static void multi_relay(struct margo_multi_request* m,
+                        const struct relay_tree*    t,
+                        size_t                      first,
+                        size_t                      count)
+{
+    margo_instance_id mid  = m->mid;
+    struct multi_op*  op   = &m->ops[m->num_ops++];
+    hg_addr_t         addr = HG_ADDR_NULL;
+    hg_return_t       hret;
+    op->m     = m;
+    op->first = first;
+    op->count = count;
+    op->relay = true;
+
+    if (t->addrs)
+        addr = t->addrs[first];
+    else if ((hret = margo_addr_lookup(mid, t->addr_strs[first], &addr))
+             != HG_SUCCESS)
+        goto error;
+
+    relay_in_t in = {.rpc_id       = t->rpc_id,
+                     .timeout_ms   = t->timeout_ms,
+                     .fanout       = t->fanout,
+                     .count        = count,
+                     .addrs        = t->addr_strs + first,
+                     .provider_ids = t->provider_ids + first,
+                     .payload      = *t->payload};
+    /* each hop of the subtree may take up to timeout_ms */
+    double timeout_ms = t->timeout_ms * subtree_depth(count, t->fanout);
+
+    hret = margo_create(mid, addr, mid->relay_rpc_id, &op->handle);
+    if (hret == HG_SUCCESS && m->on_done) {
+        atomic_fetch_add_explicit(&m->pending, 1, memory_order_relaxed);
+        hret = margo_cforward_timed(op->handle, &in, timeout_ms,
+                                    multi_op_done, op);
+        if (hret != HG_SUCCESS)
+            atomic_fetch_sub_explicit(&m->pending, 1, memory_order_relaxed);
+    } else if (hret == HG_SUCCESS) {
+        hret = margo_iforward_timed(op->handle, &in, timeout_ms, &op->req);
+    }
+    if (!t->addrs) margo_addr_free(mid, addr);
+    if (hret == HG_SUCCESS) return;
+
+error:
+    op->req = MARGO_REQUEST_NULL;
+    if (op->handle) margo_destroy(op->handle);
+    op->handle = HG_HANDLE_NULL;
+    multi_fail(m, first, count, hret);
+}
+
+/* Splits the destinations in [first, last) into fanout subtrees */
+static void multi_relay_all(struct margo_multi_request* m,
+                            const struct relay_tree*    t,
+                            size_t                      first,
+                            size_t                      last)
+{
+    size_t n = last - first;
+    size_t k = n < t->fanout ? n : t->fanout;
+    for (size_t c = 0; c < k; c++) {
+        size_t b = first + c * n / k;
+        size_t e = first + (c + 1) * n / k;
+        multi_relay(m, t, b, e - b);
+    }
+    m->relayed = true;
+}
+
+static hg_return_t multi_wait(struct margo_multi_request* m)
+{
+    for (size_t i = 0; i < m->num_ops && !m->completed; i++) {
+        struct multi_op* op = &m->ops[i];
+        if (!op->req) continue;
+        hg_return_t hret = margo_wait(op->req);
+        op->req          = MARGO_REQUEST_NULL;
+        multi_op_complete(m, op, hret);
+    }
+    m->completed = true;
+
+    for (size_t i = 0; i < m->count; i++)
+        if (m->rets[i] != HG_SUCCESS) return m->rets[i];
+    return HG_SUCCESS;
+}
+
+/* Sends the statuses of its subtree back to the parent of a relay, once
+ * all its operations have completed (possibly in the progress loop) */
+static void relay_respond(struct margo_multi_request* m, void* uargs)
+{
+    hg_handle_t handle = (hg_handle_t)uargs;
+    relay_out_t out    = {0};
+    out.rets           = calloc(m->count, sizeof(*out.rets));
+    if (out.rets) {
+        /* the parent fails the whole subtree if the count does not match */
+        out.count = m->count;
+        for (size_t i = 0; i < m->count; i++)
+            out.rets[i] = (int32_t)m->rets[i];
+    }
+    margo_crespond(handle, &out, NULL, NULL);
+    free(out.rets);
+    multi_free(m);
+    margo_destroy(handle);
+}
+
+static void relay_ult(hg_handle_t handle)
+{
+    margo_instance_id           mid  = margo_hg_handle_get_instance(handle);
+    relay_in_t                  in   = {0};
+    relay_out_t                 out  = {0};
+    struct margo_multi_request* m    = NULL;
+    hg_addr_t                   self = HG_ADDR_NULL;
+
+    if (margo_get_input(handle, &in) != HG_SUCCESS) goto respond;
+    if (!in.count || !in.fanout) goto free_input;
+    if (!mid->enable_relay) {
+        /* the whole subtree is reported as refused */
+        out.rets = malloc(in.count * sizeof(*out.rets));
+        if (out.rets) {
+            out.count = in.count;
+            for (uint64_t i = 0; i < in.count; i++)
+                out.rets[i] = HG_PERMISSION;
+        }
+        goto free_input;
+    }
+
+    size_t num_relays = in.count - 1 < in.fanout ? in.count - 1 : in.fanout;
+    m                 = multi_create(mid, in.count, 1 + num_relays);
+    if (!m) goto free_input;
+    m->on_done       = relay_respond;
+    m->on_done_uargs = handle;
+    /* held until every operation has been issued */
+    atomic_init(&m->pending, 1);
+
+    /* this process is the first destination of the subtree */
+    uint16_t    provider_id = in.provider_ids[0];
+    hg_return_t hret        = margo_addr_self(mid, &self);
+    if (hret == HG_SUCCESS) {
+        multi_forward(m, self, mux_id((hg_id_t)in.rpc_id, provider_id),
+                      provider_id, in.timeout_ms, &in.payload, 0);
+        margo_addr_free(mid, self);
+    } else {
+        multi_fail(m, 0, 1, hret);
+    }
+
+    struct relay_tree t = {.rpc_id       = (hg_id_t)in.rpc_id,
+                           .timeout_ms   = in.timeout_ms,
+                           .fanout       = in.fanout,
+                           .addrs        = NULL,
+                           .addr_strs    = in.addrs,
+                           .provider_ids = in.provider_ids,
+                           .payload      = &in.payload};
+    multi_relay_all(m, &t, 1, in.count);
+
+    /* the input was copied by the forwards, and the handle is destroyed by
+     * relay_respond */
+    margo_free_input(handle, &in);
+    multi_release(m);
+    return;
+
+free_input:
+    margo_free_input(handle, &in);
+respond:
+    margo_respond(handle, &out);
+    free(out.rets);
+    margo_destroy(handle);
+}
+DEFINE_MARGO_RPC_HANDLER(relay_ult)
+
+void margo_enable_relay(margo_instance_id mid) { mid->enable_relay = 1; }
+
+hg_id_t __margo_register_relay(margo_instance_id mid)
+{
+    return MARGO_REGISTER(mid, "__relay__", relay_in_t, relay_out_t,
+                          relay_ult);
+}
+
+hg_return_t
+margo_iforward_multi(margo_instance_id                         mid,
+                     hg_id_t                                   id,
+                     size_t                                    count,
+                     const hg_addr_t*                          addrs,
+                     const uint16_t*                           provider_ids,
+                     void*                                     in_struct,
+                     const struct margo_forward_multi_options* options,
+                     margo_multi_request_t*                    req)
+{
+    if (mid == MARGO_INSTANCE_NULL || !req || (count && !addrs))
+        return HG_INVALID_ARG;
+
+    double   timeout_ms = options ? options->timeout_ms : 0;
+    unsigned fanout     = options ? options->relay_fanout : 0;
+    size_t   max_ops    = fanout && fanout < count ? fanout : count;
+    uint16_t* ids       = NULL;
+    char**    strs      = NULL;
+
+    struct multi_payload payload = {0};
+    hg_return_t hret = payload_encode(mid, id, in_struct, &payload);
+    if (hret != HG_SUCCESS) return hret;
+
+    struct margo_multi_request* m = multi_create(mid, count, max_ops);
+    if (!m) {
+        hret = HG_NOMEM_ERROR;
+        goto finish;
+    }
+
+    if (!fanout) {
+        for (size_t i = 0; i < count; i++)
+            multi_forward(m, addrs[i], id,
+                          provider_ids ? provider_ids[i]
+                                       : MARGO_DEFAULT_PROVIDER_ID,
+                          timeout_ms, &payload, i);
+        goto finish;
+    }
+
+    /* relays need the addresses and provider ids of their subtree */
+    ids  = malloc(count * sizeof(*ids));
+    strs = calloc(count, sizeof(*strs));
+    if (!ids || !strs) {
+        hret = HG_NOMEM_ERROR;
+        goto finish;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ids[i] = provider_ids ? provider_ids[i] : MARGO_DEFAULT_PROVIDER_ID;
+        hg_size_t size = 0;
+        hret           = margo_addr_to_string(mid, NULL, &size, addrs[i]);
+        if (hret != HG_SUCCESS) goto finish;
+        strs[i] = malloc(size);
+        if (!strs[i]) {
+            hret = HG_NOMEM_ERROR;
+            goto finish;
+        }
+        hret = margo_addr_to_string(mid, strs[i], &size, addrs[i]);
+        if (hret != HG_SUCCESS) goto finish;
+    }
+    struct relay_tree t = {.rpc_id       = id,
+                           .timeout_ms   = timeout_ms,
+                           .fanout       = fanout,
+                           .addrs        = addrs,
+                           .addr_strs    = strs,
+                           .provider_ids = ids,
+                           .payload      = &payload};
+    multi_relay_all(m, &t, 0, count);
+
+finish:
+    /* the payload and the addresses were copied by the forwards */
+    for (size_t i = 0; strs && i < count; i++) free(strs[i]);
+    free(strs);
+    free(ids);
+    free(payload.data);
+    if (hret != HG_SUCCESS) {
+        multi_free(m);
+        return hret;
+    }
+    *req = m;
+    return HG_SUCCESS;
+}
+
+hg_return_t
+margo_forward_multi(margo_instance_id                         mid,
+                    hg_id_t                                   id,
+                    size_t                                    count,
+                    const hg_addr_t*                          addrs,
+                    const uint16_t*                           provider_ids,
+                    void*                                     in_struct,
+                    const struct margo_forward_multi_options* options,
+                    margo_multi_request_t*                    req)
+{
+    hg_return_t hret = margo_iforward_multi(mid, id, count, addrs,
+                                            provider_ids, in_struct, options,
+                                            req);
+    if (hret != HG_SUCCESS) return hret;
+    return multi_wait(*req);
+}
+
+hg_return_t margo_multi_wait(margo_multi_request_t req)
+{
+    if (req == MARGO_MULTI_REQUEST_NULL) return HG_INVALID_ARG;
+    return multi_wait(req);
+}
+
+hg_return_t margo_multi_get_status(margo_multi_request_t req, size_t index)
+{
+    if (req == MARGO_MULTI_REQUEST_NULL || index >= req->count)
+        return HG_INVALID_ARG;
+    return req->rets[index];
+}
+
+hg_handle_t margo_multi_get_handle(margo_multi_request_t req, size_t index)
+{
+    if (req == MARGO_MULTI_REQUEST_NULL || index >= req->count || req->relayed)
+        return HG_HANDLE_NULL;
+    return req->ops[index].handle;
+}
+
+hg_return_t margo_multi_request_free(margo_multi_request_t req)
+{
+    if (req == MARGO_MULTI_REQUEST_NULL) return HG_INVALID_ARG;
+    multi_wait(req);
+    multi_free(req);
+    return HG_SUCCESS;
+}
@@ -0,0 +1,368 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <abt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "margo-prio-split-pool.h"
+
+/* ABT_POOL_PRIO_WAIT_SPLIT */
+
+/* This is a variant of the prio_wait pool (see margo-prio-pool.c) with the
+ * same policy: units that have never run go to a low-priority queue, units
+ * that have yielded fewer than SCHED_COUNTER_PRIORITY_LIMIT times go to a
+ * high-priority queue, and one pop out of 256 looks at the low-priority queue
+ * first. Instead of a single mutex and condition variable, each queue has
+ * its own lock and the number of units in each queue is kept in atomics, so
+ * that pops only take the lock of a queue that is not empty, and pushes to
+ * one queue do not contend with pops from the other.
+ *
+ * Waiting is done in two steps in pool_pop_timedwait: the scheduler first
+ * spins for a bounded number of iterations watching the number of units,
+ * then sleeps on a futex (or a condition variable where futexes are not
+ * available). Pushes only issue a wake-up system call when a scheduler is
+ * actually sleeping.
+ */
+
+#define SCHED_COUNTER_PRIORITY_LIMIT 25
+
+/* Number of iterations pool_pop_timedwait spins before sleeping */
+#define SPIN_ITERATIONS 1024
+
+typedef struct unit_t {
+    ABT_thread      thread;
+    ABT_task        task;
+    struct unit_t*  p_prev;
+    struct unit_t*  p_next;
+    struct queue_t* p_queue; /* queue the unit is in, NULL if not in pool */
+    int             sched_counter;
+} unit_t;
+
+typedef struct queue_t {
+    unit_t*         p_head;
+    unit_t*         p_tail;
+    _Atomic size_t  size; /* read without the lock to skip empty queues */
+    pthread_mutex_t mutex;
+} queue_t;
+
+/* the queues and the counters are kept on separate cache lines */
+#define CACHE_LINE_SIZE 64
+
+typedef struct pool_t {
+    _Alignas(CACHE_LINE_SIZE) queue_t high_prio_queue;
+    _Alignas(CACHE_LINE_SIZE) queue_t low_prio_queue;
+    _Alignas(CACHE_LINE_SIZE) _Atomic size_t num;
+    _Atomic uint32_t cnt;
+    _Atomic uint32_t seq;         /* incremented by each push */
+    _Atomic int      num_waiters; /* schedulers sleeping in pop_timedwait */
+#ifndef __linux__
+    pthread_mutex_t wait_mutex;
+    pthread_cond_t  wait_cond;
+#endif
+} pool_t;
+
+static inline void queue_init(queue_t* p_queue)
+{
+    p_queue->p_head = NULL;
+    p_queue->p_tail = NULL;
+    p_queue->size   = 0;
+    pthread_mutex_init(&p_queue->mutex, NULL);
+}
+
+static inline void queue_push(queue_t* p_queue, unit_t* p_unit)
+{
+    pthread_mutex_lock(&p_queue->mutex);
+    p_unit->p_next = NULL;
+    p_unit->p_prev = p_queue->p_tail;
+    if (p_queue->p_tail)
+        p_queue->p_tail->p_next = p_unit;
+    else
+        p_queue->p_head = p_unit;
+    p_queue->p_tail = p_unit;
+    p_unit->p_queue = p_queue;
+    atomic_fetch_add_explicit(&p_queue->size, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&p_queue->mutex);
+}
+
+static inline void queue_unlink(queue_t* p_queue, unit_t* p_unit)
+{
+    if (p_unit->p_prev)
+        p_unit->p_prev->p_next = p_unit->p_next;
+    else
+        p_queue->p_head = p_unit->p_next;
+    if (p_unit->p_next)
+        p_unit->p_next->p_prev = p_unit->p_prev;
+    else
+        p_queue->p_tail = p_unit->p_prev;
+    p_unit->p_next  = NULL;
+    p_unit->p_prev  = NULL;
+    p_unit->p_queue = NULL;
+    atomic_fetch_sub_explicit(&p_queue->size, 1, memory_order_relaxed);
+}
+
+static inline unit_t* queue_pop(queue_t* p_queue)
+{
+    if (atomic_load_explicit(&p_queue->size, memory_order_relaxed) == 0)
+        return NULL;
+    pthread_mutex_lock(&p_queue->mutex);
+    unit_t* p_unit = p_queue->p_head;
+    if (p_unit) queue_unlink(p_queue, p_unit);
+    pthread_mutex_unlock(&p_queue->mutex);
+    return p_unit;
+}
+
+/* Sleeps until seq changes from the given value or abstime_secs is reached */
+static void pool_wait(pool_t* p_pool, uint32_t seq, double abstime_secs)
+{
+    struct timespec ts;
+    ts.tv_sec  = (time_t)abstime_secs;
+    ts.tv_nsec = (long)((abstime_secs - ts.tv_sec) * 1000000000.0);
+#ifdef __linux__
+    syscall(SYS_futex, &p_pool->seq,
+            FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME, seq,
+            &ts, NULL, FUTEX_BITSET_MATCH_ANY);
+#else
+    pthread_mutex_lock(&p_pool->wait_mutex);
+    if (atomic_load(&p_pool->seq) == seq)
+        pthread_cond_timedwait(&p_pool->wait_cond, &p_pool->wait_mutex, &ts);
+    pthread_mutex_unlock(&p_pool->wait_mutex);
+#endif
+}
+
+static void pool_wake_one(pool_t* p_pool)
+{
+#ifdef __linux__
+    syscall(SYS_futex, &p_pool->seq, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL,
+            NULL, 0);
+#else
+    pthread_mutex_lock(&p_pool->wait_mutex);
+    pthread_cond_signal(&p_pool->wait_cond);
+    pthread_mutex_unlock(&p_pool->wait_mutex);
+#endif
+}
+
+static ABT_unit_type pool_unit_get_type(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    if (p_unit->thread != ABT_THREAD_NULL) {
+        return ABT_UNIT_TYPE_THREAD;
+    } else {
+        return ABT_UNIT_TYPE_TASK;
+    }
+}
+
+static ABT_thread pool_unit_get_thread(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->thread;
+}
+
+static ABT_task pool_unit_get_task(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->task;
+}
+
+static ABT_bool pool_unit_is_in_pool(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->p_queue ? ABT_TRUE : ABT_FALSE;
+}
+
+static ABT_unit pool_unit_create_from_thread(ABT_thread thread)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread = thread;
+    p_unit->task   = ABT_TASK_NULL;
+    return (ABT_unit)p_unit;
+}
+
+static ABT_unit pool_unit_create_from_task(ABT_task task)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread = ABT_THREAD_NULL;
+    p_unit->task   = task;
+    return (ABT_unit)p_unit;
+}
+
+static void pool_unit_free(ABT_unit* p_unit)
+{
+    free(*p_unit);
+    *p_unit = ABT_UNIT_NULL;
+}
+
+static int pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    (void)config;
+    /* sizeof(pool_t) is a multiple of its alignment */
+    pool_t* p_pool = (pool_t*)aligned_alloc(CACHE_LINE_SIZE, sizeof(pool_t));
+    if (!p_pool) return ABT_ERR_MEM;
+    memset(p_pool, 0, sizeof(*p_pool));
+    queue_init(&p_pool->high_prio_queue);
+    queue_init(&p_pool->low_prio_queue);
+#ifndef __linux__
+    pthread_mutex_init(&p_pool->wait_mutex, NULL);
+    pthread_cond_init(&p_pool->wait_cond, NULL);
+#endif
+    ABT_pool_set_data(pool, (void*)p_pool);
+    return ABT_SUCCESS;
+}
+
+static size_t pool_get_size(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    return atomic_load_explicit(&p_pool->num, memory_order_relaxed);
+}
+
+static void pool_push(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t* p_unit = (unit_t*)unit;
+
+    /* save incoming value of push counter, then increment */
+    int sched_counter = p_unit->sched_counter;
+    if (p_unit->sched_counter < SCHED_COUNTER_PRIORITY_LIMIT)
+        p_unit->sched_counter++;
+
+    /* num is incremented before the unit becomes visible so that it never
+     * goes below the number of units in the queues. It is also incremented
+     * before num_waiters is read, while a waiter increments num_waiters
+     * before reading num (both sequentially consistent), so either the
+     * waiter sees the unit or we see the waiter. */
+    atomic_fetch_add(&p_pool->num, 1);
+    if (sched_counter == 0 || sched_counter >= SCHED_COUNTER_PRIORITY_LIMIT)
+        queue_push(&p_pool->low_prio_queue, p_unit);
+    else
+        queue_push(&p_pool->high_prio_queue, p_unit);
+    atomic_fetch_add(&p_pool->seq, 1);
+    if (atomic_load(&p_pool->num_waiters) > 0) pool_wake_one(p_pool);
+}
+
+static ABT_unit pool_pop(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    if (atomic_load_explicit(&p_pool->num, memory_order_relaxed) == 0)
+        return ABT_UNIT_NULL;
+
+    /* Sometimes it should pop from low_prio_queue to avoid a deadlock. */
+    unit_t* p_unit = NULL;
+    if ((atomic_fetch_add_explicit(&p_pool->cnt, 1, memory_order_relaxed)
+         & 0xFF)
+        != 0) {
+        p_unit = queue_pop(&p_pool->high_prio_queue);
+        if (!p_unit) p_unit = queue_pop(&p_pool->low_prio_queue);
+    } else {
+        p_unit = queue_pop(&p_pool->low_prio_queue);
+        if (!p_unit) p_unit = queue_pop(&p_pool->high_prio_queue);
+    }
+    if (p_unit) atomic_fetch_sub(&p_pool->num, 1);
+    return p_unit ? (ABT_unit)p_unit : ABT_UNIT_NULL;
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static ABT_unit pool_pop_timedwait(ABT_pool pool, double abstime_secs)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    ABT_unit unit = pool_pop(pool);
+    if (unit != ABT_UNIT_NULL) return unit;
+
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        if (atomic_load_explicit(&p_pool->num, memory_order_relaxed) != 0) {
+            unit = pool_pop(pool);
+            if (unit != ABT_UNIT_NULL) return unit;
+        }
+        cpu_relax();
+    }
+
+    uint32_t seq = atomic_load(&p_pool->seq);
+    atomic_fetch_add(&p_pool->num_waiters, 1);
+    if (atomic_load(&p_pool->num) == 0) pool_wait(p_pool, seq, abstime_secs);
+    atomic_fetch_sub(&p_pool->num_waiters, 1);
+    return pool_pop(pool);
+}
+
+static int pool_remove(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t*  p_unit  = (unit_t*)unit;
+    queue_t* p_queue = p_unit->p_queue;
+    if (!p_queue) return ABT_ERR_POOL;
+
+    pthread_mutex_lock(&p_queue->mutex);
+    /* a concurrent pop may have unlinked the unit before the lock was
+     * taken, in which case it is no longer ours to remove */
+    if (p_unit->p_queue != p_queue) {
+        pthread_mutex_unlock(&p_queue->mutex);
+        return ABT_ERR_POOL;
+    }
+    queue_unlink(p_queue, p_unit);
+    pthread_mutex_unlock(&p_queue->mutex);
+    atomic_fetch_sub(&p_pool->num, 1);
+
+    return ABT_SUCCESS;
+}
+
+static int pool_free(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_destroy(&p_pool->high_prio_queue.mutex);
+    pthread_mutex_destroy(&p_pool->low_prio_queue.mutex);
+#ifndef __linux__
+    pthread_mutex_destroy(&p_pool->wait_mutex);
+    pthread_cond_destroy(&p_pool->wait_cond);
+#endif
+    free(p_pool);
+
+    return ABT_SUCCESS;
+}
+
+void margo_create_prio_split_pool_def(ABT_pool_def* p_def)
+{
+    p_def->access               = ABT_POOL_ACCESS_MPMC;
+    p_def->u_get_type           = pool_unit_get_type;
+    p_def->u_get_thread         = pool_unit_get_thread;
+    p_def->u_get_task           = pool_unit_get_task;
+    p_def->u_is_in_pool         = pool_unit_is_in_pool;
+    p_def->u_create_from_thread = pool_unit_create_from_thread;
+    p_def->u_create_from_task   = pool_unit_create_from_task;
+    p_def->u_free               = pool_unit_free;
+    p_def->p_init               = pool_init;
+    p_def->p_get_size           = pool_get_size;
+    p_def->p_push               = pool_push;
+    p_def->p_pop                = pool_pop;
+    p_def->p_pop_timedwait      = pool_pop_timedwait;
+    p_def->p_remove             = pool_remove;
+    p_def->p_free               = pool_free;
+    p_def->p_print_all          = NULL; /* Optional. */
+}
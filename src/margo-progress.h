@@ -6,7 +6,22 @@
 #ifndef __MARGO_PROGRESS_H
 #define __MARGO_PROGRESS_H
 
+#include "margo.h"
+
 // progress function defined in margo-core.c
 void __margo_hg_progress_fn(void* foo);
 
+// progress function for the additional contexts, defined in margo-core.c
+void __margo_hg_context_progress_fn(void* foo);
+
+// creates num_contexts additional Mercury contexts, whose progress loops
+// will run in the pools at the specified indices, defined in margo-core.c
+hg_return_t __margo_create_progress_contexts(margo_instance_id mid,
+                                             unsigned          num_contexts,
+                                             const int*        pool_indices);
+
+// stops the progress loops of the additional contexts, if they are still
+// running, and destroys the contexts, defined in margo-core.c
+void __margo_destroy_progress_contexts(margo_instance_id mid);
+
 #endif
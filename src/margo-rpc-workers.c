@@ -0,0 +1,120 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdlib.h>
+#include "margo-rpc-workers.h"
+
+#define WORKERS_MUTEX(w) ABT_MUTEX_MEMORY_GET_HANDLE(&(w)->mtx)
+#define WORKERS_COND(w)  ABT_COND_MEMORY_GET_HANDLE(&(w)->cond)
+
+static void worker_fn(void* arg)
+{
+    margo_rpc_workers_t*  w = (margo_rpc_workers_t*)arg;
+    struct margo_rpc_work work;
+
+    ABT_mutex_lock(WORKERS_MUTEX(w));
+    while (true) {
+        w->num_idle++;
+        while (!w->count && !w->stopping)
+            ABT_cond_wait(WORKERS_COND(w), WORKERS_MUTEX(w));
+        if (!w->count) break; /* stopping */
+        /* the item was reserved by the submitter (num_idle was decremented
+         * then), so we do not decrement num_idle again here */
+        work    = w->queue[w->head];
+        w->head = (w->head + 1) % w->num_workers;
+        w->count--;
+        ABT_mutex_unlock(WORKERS_MUTEX(w));
+        work.fn(work.arg);
+        ABT_mutex_lock(WORKERS_MUTEX(w));
+    }
+    w->num_idle--;
+    ABT_mutex_unlock(WORKERS_MUTEX(w));
+}
+
+margo_rpc_workers_t* __margo_rpc_workers_create(ABT_pool pool,
+                                                unsigned num_workers)
+{
+    margo_rpc_workers_t* w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+    w->threads = calloc(num_workers, sizeof(*w->threads));
+    w->queue   = calloc(num_workers, sizeof(*w->queue));
+    if (!w->threads || !w->queue) {
+        free(w->threads);
+        free(w->queue);
+        free(w);
+        return NULL;
+    }
+    /* like the other ABT_mutex_memory/ABT_cond_memory in margo, the mutex
+     * and condition variable are statically initialized by calloc */
+    w->pool        = pool;
+    w->num_workers = num_workers;
+    return w;
+}
+
+void __margo_rpc_workers_start(margo_rpc_workers_t* w)
+{
+    ABT_mutex_lock(WORKERS_MUTEX(w));
+    if (!w->started && !w->stopping) {
+        for (unsigned i = 0; i < w->num_workers; i++)
+            ABT_thread_create(w->pool, worker_fn, w, ABT_THREAD_ATTR_NULL,
+                              &w->threads[i]);
+        w->started = true;
+    }
+    ABT_mutex_unlock(WORKERS_MUTEX(w));
+}
+
+bool __margo_rpc_workers_submit(margo_rpc_workers_t* w,
+                                void (*fn)(void*),
+                                void* arg)
+{
+    bool submitted = false;
+
+    ABT_mutex_lock(WORKERS_MUTEX(w));
+    if (!w->stopping && w->num_idle) {
+        w->num_idle--;
+        w->queue[(w->head + w->count) % w->num_workers]
+            = (struct margo_rpc_work){fn, arg};
+        w->count++;
+        ABT_cond_signal(WORKERS_COND(w));
+        submitted = true;
+    }
+    ABT_mutex_unlock(WORKERS_MUTEX(w));
+    return submitted;
+}
+
+unsigned __margo_rpc_workers_num_waiting(const margo_rpc_workers_t* w)
+{
+    /* workers reserved by a queued item are about to run it, they are
+     * already out of num_idle */
+    return w->num_idle;
+}
+
+void __margo_rpc_workers_stop(margo_rpc_workers_t* w)
+{
+    ABT_mutex_lock(WORKERS_MUTEX(w));
+    bool started = w->started && !w->stopping;
+    w->stopping  = true;
+    ABT_cond_broadcast(WORKERS_COND(w));
+    ABT_mutex_unlock(WORKERS_MUTEX(w));
+    if (!started) return;
+    for (unsigned i = 0; i < w->num_workers; i++) {
+        ABT_thread_join(w->threads[i]);
+        ABT_thread_free(&w->threads[i]);
+    }
+    /* the workers can be started again if an ES runs the pool again */
+    ABT_mutex_lock(WORKERS_MUTEX(w));
+    w->started  = false;
+    w->stopping = false;
+    ABT_mutex_unlock(WORKERS_MUTEX(w));
+}
+
+void __margo_rpc_workers_free(margo_rpc_workers_t* w)
+{
+    if (!w) return;
+    __margo_rpc_workers_stop(w);
+    free(w->threads);
+    free(w->queue);
+    free(w);
+}
@@ -0,0 +1,59 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __MARGO_RPC_WORKERS_H
+#define __MARGO_RPC_WORKERS_H
+
+#include <stdbool.h>
+#include <abt.h>
+
+/* Set of long-lived ULTs executing the RPCs dispatched to a pool (see
+ * "workers" in the pool configuration). The ULTs are created when the
+ * first execution stream running the pool is set up, so that the first RPCs
+ * do not pay for their creation, and wait for work on a condition variable. A submission only
+ * succeeds if a worker is idle, so the queue never holds more items than
+ * there are waiting workers, and the caller falls back to creating a ULT
+ * otherwise (which also prevents handlers that block on each other from
+ * deadlocking when all the workers are busy). */
+typedef struct margo_rpc_workers {
+    ABT_pool    pool;
+    unsigned    num_workers;
+    ABT_thread* threads;
+    bool        started;
+    bool        stopping;
+    unsigned    num_idle; /* waiting workers not reserved by a queued item */
+    struct margo_rpc_work {
+        void (*fn)(void*);
+        void* arg;
+    }* queue; /* circular buffer of num_workers items */
+    unsigned         head;
+    unsigned         count;
+    ABT_mutex_memory mtx;
+    ABT_cond_memory  cond;
+} margo_rpc_workers_t;
+
+margo_rpc_workers_t* __margo_rpc_workers_create(ABT_pool pool,
+                                                unsigned num_workers);
+
+/* Creates the worker ULTs in the pool if they are not running */
+void __margo_rpc_workers_start(margo_rpc_workers_t* workers);
+
+/* Hands fn(arg) to an idle worker, returns false if there is none */
+bool __margo_rpc_workers_submit(margo_rpc_workers_t* workers,
+                                void (*fn)(void*),
+                                void* arg);
+
+/* Number of workers waiting for work that no queued item has reserved */
+unsigned __margo_rpc_workers_num_waiting(const margo_rpc_workers_t* workers);
+
+/* Stops and joins the workers. This needs an execution stream to still be
+ * running the pool; later submissions fail until the workers are started
+ * again. */
+void __margo_rpc_workers_stop(margo_rpc_workers_t* workers);
+
+/* Stops the workers if needed and frees the structure */
+void __margo_rpc_workers_free(margo_rpc_workers_t* workers);
+
+#endif
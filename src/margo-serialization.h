@@ -6,6 +6,7 @@
 #ifndef __MARGO_SERIALIZATION_H
 #define __MARGO_SERIALIZATION_H
 
+#include <time.h>
 #include "margo.h"
 #include "margo-instance.h"
 #include "margo-monitoring-internal.h"
@@ -29,6 +30,19 @@
 // that prevented the RPC from running. It allows to not care about the
 // semantics of the user-provided data, since any value other than HG_SUCCESS
 // will make serialization stop at the error code.
+//
+// The margo_forward_proc_args header carries the absolute deadline of the
+// RPC when the client used a timed forward, so that the server can drop it
+// if it expires before a ULT is spawned (see margo_get_deadline).
+
+/* Clock used for the deadlines carried in RPC headers. Unlike ABT_get_wtime,
+ * it is comparable across processes (assuming synchronized clocks). */
+static inline double margo_deadline_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
 typedef struct margo_forward_proc_args {
     hg_handle_t   handle;
@@ -37,6 +51,7 @@ typedef struct margo_forward_proc_args {
     hg_proc_cb_t  user_cb;
     struct {
         hg_id_t parent_rpc_id;
+        double  deadline; /* margo_deadline_clock() time, 0 if none */
     } header;
 } * margo_forward_proc_args_t;
 
@@ -15,6 +15,16 @@
 #include "margo-timer-private.h"
 #include "utlist.h"
 
+/* Timers are kept in a hashed timing wheel: time is divided into ticks of
+ * MARGO_TIMER_WHEEL_RESOLUTION seconds and a timer expiring during tick k
+ * is stored in slot (k % MARGO_TIMER_WHEEL_SLOTS). Starting and canceling
+ * a timer are O(1), and __margo_check_timers only visits the slots of the
+ * ticks that elapsed since its previous call, leaving in place the timers
+ * that belong to a later revolution of the wheel. */
+#define MARGO_TIMER_WHEEL_SLOTS      4096 /* must be a power of 2 */
+#define MARGO_TIMER_WHEEL_MASK       (MARGO_TIMER_WHEEL_SLOTS - 1)
+#define MARGO_TIMER_WHEEL_RESOLUTION 0.001 /* seconds per tick */
+
 /* Timer definition */
 typedef struct margo_timer {
     margo_instance_id       mid;
@@ -22,6 +32,7 @@ typedef struct margo_timer {
     void*                   cb_dat;
     ABT_pool                pool;
     double                  expiration;
+    uint64_t                tick; /* tick of the wheel the timer belongs to */
 
     /* finalization mechanism, to ensure that no ULT associated with
      * this timer remains to be executed. */
@@ -37,9 +48,13 @@ typedef struct margo_timer {
     struct margo_timer* prev;
 } margo_timer;
 
-/* List of timers sorted by expiration date */
+/* Timing wheel of timers */
 struct margo_timer_list {
-    margo_timer*     queue_head;
+    margo_timer*     slots[MARGO_TIMER_WHEEL_SLOTS];
+    uint64_t         next_tick;  /* first tick not fully processed yet */
+    size_t           num_queued; /* number of timers in the wheel */
+    double           next_expiration; /* cached earliest expiration */
+    bool             next_expiration_valid;
     ABT_mutex_memory mutex;
     /* finalization mechanism, to ensure that no ULT associated with timers
      * remain */
@@ -54,6 +69,17 @@ struct margo_timer_list {
      * unblocks and frees the list. */
 };
 
+static inline uint64_t time_to_tick(double t)
+{
+    return (uint64_t)(t / MARGO_TIMER_WHEEL_RESOLUTION);
+}
+
+static inline margo_timer** timer_slot(struct margo_timer_list* timer_lst,
+                                       uint64_t                 tick)
+{
+    return &timer_lst->slots[tick & MARGO_TIMER_WHEEL_MASK];
+}
+
 static inline struct margo_timer_list* get_timer_list(margo_instance_id mid)
 {
     return mid->timer_list;
@@ -95,6 +121,40 @@ static void timer_ult(void* args)
         ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(&timer_lst->cv));
 }
 
+/* Removes a timer from the wheel. Must be called with the list's mutex held. */
+static inline void timer_dequeue(struct margo_timer_list* timer_lst,
+                                 margo_timer*             timer)
+{
+    DL_DELETE(*timer_slot(timer_lst, timer->tick), timer);
+    timer->prev = timer->next = NULL;
+    timer_lst->num_queued -= 1;
+    if (timer->expiration <= timer_lst->next_expiration)
+        timer_lst->next_expiration_valid = false;
+}
+
+/* Submits the ULT of a timer that was removed from the wheel, or calls
+ * its callback directly if it is not associated with a pool.
+ * Must be called with the list's mutex held. */
+static inline void timer_fire(struct margo_timer_list* timer_lst,
+                              margo_timer*             timer)
+{
+    int ret;
+    if (timer->pool != ABT_POOL_NULL) {
+        ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer->mutex));
+        timer->num_pending += 1;
+        ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer->mutex));
+
+        timer_lst->num_pending += 1;
+
+        ret = ABT_thread_create(timer->pool, timer_ult, timer,
+                                ABT_THREAD_ATTR_NULL, NULL);
+        assert(ret == ABT_SUCCESS);
+        (void)ret;
+    } else {
+        timer->cb_fn(timer->cb_dat);
+    }
+}
+
 struct margo_timer_list* __margo_timer_list_create()
 {
     struct margo_timer_list* timer_lst;
@@ -109,31 +169,18 @@ void __margo_timer_list_free(margo_instance_id mid)
 {
     struct margo_timer_list* timer_lst = get_timer_list(mid);
     margo_timer*             cur;
-    int                      ret;
 
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
     timer_lst->destroy_requested = true;
-    /* delete any remaining timers from the queue */
-    while (timer_lst->queue_head) {
-        cur = timer_lst->queue_head;
-        DL_DELETE(timer_lst->queue_head, cur);
-        cur->prev = cur->next = NULL;
-
-        /* we must issue the callback now for any pending timers or else the
-         * callers may hang indefinitely
-         */
-        if (cur->pool != ABT_POOL_NULL) {
-            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&cur->mutex));
-            cur->num_pending += 1;
-            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&cur->mutex));
-
-            timer_lst->num_pending += 1;
-
-            ret = ABT_thread_create(cur->pool, timer_ult, cur,
-                                    ABT_THREAD_ATTR_NULL, NULL);
-            assert(ret == ABT_SUCCESS);
-        } else {
-            cur->cb_fn(cur->cb_dat);
+    /* delete any remaining timers from the wheel */
+    for (size_t i = 0; i < MARGO_TIMER_WHEEL_SLOTS; i++) {
+        while (timer_lst->slots[i]) {
+            cur = timer_lst->slots[i];
+            timer_dequeue(timer_lst, cur);
+            /* we must issue the callback now for any pending timers or else
+             * the callers may hang indefinitely
+             */
+            timer_fire(timer_lst, cur);
         }
     }
 
@@ -150,45 +197,83 @@ void __margo_timer_list_free(margo_instance_id mid)
 
 void __margo_check_timers(margo_instance_id mid)
 {
-    int                      ret;
-    margo_timer*             cur;
+    margo_timer *            cur, *tmp;
     struct margo_timer_list* timer_lst;
     double                   now;
+    uint64_t                 now_tick, num_ticks;
 
     timer_lst = get_timer_list(mid);
     assert(timer_lst);
 
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
-    if (timer_lst->queue_head) now = ABT_get_wtime();
-
-    /* iterate through timer list, performing timeout action
-     * for all elements which have passed expiration time
-     */
-    while (timer_lst->queue_head && (timer_lst->queue_head->expiration < now)) {
-        cur = timer_lst->queue_head;
-        DL_DELETE(timer_lst->queue_head, cur);
-        cur->prev = cur->next = NULL;
-
-        if (cur->pool != ABT_POOL_NULL) {
-            ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&cur->mutex));
-            cur->num_pending += 1;
-            ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&cur->mutex));
-
-            timer_lst->num_pending += 1;
-
-            ret = ABT_thread_create(cur->pool, timer_ult, cur,
-                                    ABT_THREAD_ATTR_NULL, NULL);
-            assert(ret == ABT_SUCCESS);
-        } else {
-            cur->cb_fn(cur->cb_dat);
+    if (timer_lst->num_queued == 0) goto finish;
+
+    now      = ABT_get_wtime();
+    now_tick = time_to_tick(now);
+    if (now_tick < timer_lst->next_tick) goto finish;
+
+    /* visit the slots of all the ticks that elapsed since the last call,
+     * including the current tick, which is only partially elapsed;
+     * if more than a full revolution elapsed, visit every slot once */
+    num_ticks = now_tick - timer_lst->next_tick + 1;
+    if (num_ticks > MARGO_TIMER_WHEEL_SLOTS)
+        num_ticks = MARGO_TIMER_WHEEL_SLOTS;
+
+    for (uint64_t t = 0; t < num_ticks && timer_lst->num_queued; t++) {
+        margo_timer** slot = timer_slot(timer_lst, timer_lst->next_tick + t);
+        DL_FOREACH_SAFE(*slot, cur, tmp)
+        {
+            /* timers from a later revolution of the wheel stay in place */
+            if (cur->tick >= now_tick && cur->expiration >= now) continue;
+            timer_dequeue(timer_lst, cur);
+            timer_fire(timer_lst, cur);
         }
     }
+    /* the current tick will be visited again by the next call */
+    timer_lst->next_tick = now_tick;
+
+finish:
     ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
     return;
 }
 
+/* Recomputes the earliest expiration among queued timers.
+ * Must be called with the list's mutex held and num_queued > 0. */
+static void timer_list_update_next_expiration(struct margo_timer_list* timer_lst)
+{
+    margo_timer* cur;
+    double       earliest = 0.0;
+    bool         found    = false;
+
+    /* the first tick (starting from next_tick) that has a timer in its slot
+     * holds the earliest timers, since timers are never queued in a tick
+     * that precedes next_tick */
+    for (uint64_t t = 0; t < MARGO_TIMER_WHEEL_SLOTS && !found; t++) {
+        uint64_t tick = timer_lst->next_tick + t;
+        DL_FOREACH(*timer_slot(timer_lst, tick), cur)
+        {
+            if (cur->tick != tick) continue;
+            if (!found || cur->expiration < earliest)
+                earliest = cur->expiration;
+            found = true;
+        }
+    }
+    /* all the timers are more than a revolution away, look at all of them */
+    bool full_scan = !found;
+    for (size_t i = 0; full_scan && i < MARGO_TIMER_WHEEL_SLOTS; i++) {
+        DL_FOREACH(timer_lst->slots[i], cur)
+        {
+            if (!found || cur->expiration < earliest)
+                earliest = cur->expiration;
+            found = true;
+        }
+    }
+    timer_lst->next_expiration       = earliest;
+    timer_lst->next_expiration_valid = true;
+}
+
 /* returns 0 and sets 'next_timer_exp' if the timer instance
  * has timers queued up, -1 otherwise
  */
@@ -203,9 +288,11 @@ int __margo_timer_get_next_expiration(margo_instance_id mid,
     assert(timer_lst);
 
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
-    if (timer_lst->queue_head) {
+    if (timer_lst->num_queued) {
+        if (!timer_lst->next_expiration_valid)
+            timer_list_update_next_expiration(timer_lst);
         now             = ABT_get_wtime();
-        *next_timer_exp = timer_lst->queue_head->expiration - now;
+        *next_timer_exp = timer_lst->next_expiration - now;
         ret             = 0;
     } else {
         ret = -1;
@@ -216,38 +303,33 @@ int __margo_timer_get_next_expiration(margo_instance_id mid,
 }
 
 static void __margo_timer_queue(struct margo_timer_list* timer_lst,
-                                margo_timer*             timer)
+                                margo_timer*             timer,
+                                double                   now)
 {
-    margo_timer* cur;
+    uint64_t tick;
 
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
-    /* if list of timers is empty, put ourselves on it */
-    if (!(timer_lst->queue_head)) {
-        DL_APPEND(timer_lst->queue_head, timer);
-    } else {
-        /* something else already in queue, keep it sorted in ascending order
-         * of expiration time
-         */
-        cur = timer_lst->queue_head;
-        do {
-            /* walk backwards through queue */
-            cur = cur->prev;
-            /* as soon as we find an element that expires before this one,
-             * then we add ours after it
-             */
-            if (cur->expiration < timer->expiration) {
-                DL_APPEND_ELEM(timer_lst->queue_head, cur, timer);
-                break;
-            }
-        } while (cur != timer_lst->queue_head);
-
-        /* if we never found one with an expiration before this one, then
-         * this one is the new head
-         */
-        if (timer->prev == NULL && timer->next == NULL)
-            DL_PREPEND(timer_lst->queue_head, timer);
+    /* if the wheel is empty, no slot needs to be revisited before now */
+    if (timer_lst->num_queued == 0) {
+        uint64_t now_tick = time_to_tick(now);
+        if (now_tick > timer_lst->next_tick) timer_lst->next_tick = now_tick;
     }
+
+    /* a timer can't go in a tick that __margo_check_timers won't revisit */
+    tick = time_to_tick(timer->expiration);
+    if (tick < timer_lst->next_tick) tick = timer_lst->next_tick;
+    timer->tick = tick;
+    DL_APPEND(*timer_slot(timer_lst, tick), timer);
+
+    timer_lst->num_queued += 1;
+    if (timer_lst->num_queued == 1) {
+        timer_lst->next_expiration       = timer->expiration;
+        timer_lst->next_expiration_valid = true;
+    } else if (timer->expiration < timer_lst->next_expiration) {
+        timer_lst->next_expiration = timer->expiration;
+    }
+
     ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
     return;
@@ -294,8 +376,9 @@ int margo_timer_start(margo_timer_t timer, double timeout_ms)
     if (already_started || timer->canceled || timer_lst->destroy_requested)
         return -1;
 
-    timer->expiration = ABT_get_wtime() + (timeout_ms / 1000);
-    __margo_timer_queue(timer_lst, timer);
+    double now        = ABT_get_wtime();
+    timer->expiration = now + (timeout_ms / 1000);
+    __margo_timer_queue(timer_lst, timer, now);
 
     return 0;
 }
@@ -310,11 +393,9 @@ int margo_timer_cancel(margo_timer_t timer)
 
     // Remove the timer from the list of pending timers
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
-    if (timer->prev || timer->next) DL_DELETE(timer_lst->queue_head, timer);
+    if (timer->prev || timer->next) timer_dequeue(timer_lst, timer);
     ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
-    timer->prev = timer->next = NULL;
-
     // Wait for any remaining ULTs
     ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer->mutex));
     while (timer->num_pending != 0) {
@@ -339,8 +420,7 @@ int margo_timer_cancel_many(size_t n, margo_timer_t* timers)
         timers[i]->canceled = true;
         // Remove each timer from the list of pending timers
         if (timers[i]->prev || timers[i]->next)
-            DL_DELETE(timer_lst->queue_head, timers[i]);
-        timers[i]->prev = timers[i]->next = NULL;
+            timer_dequeue(timer_lst, timers[i]);
     }
     ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&timer_lst->mutex));
 
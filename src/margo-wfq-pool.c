@@ -0,0 +1,375 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <abt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "margo-wfq-pool.h"
+#include "uthash.h"
+#include "utlist.h"
+
+/* ABT_POOL_WFQ_WAIT */
+
+/* This is a custom Argobots pool, compatible with ABT_POOL_FIFO_WAIT, that
+ * keeps one FIFO sub-queue per key (the provider id of the RPC that created
+ * the unit, or -1 for units that are not RPCs) and serves the non-empty
+ * sub-queues with deficit round robin: at each turn, a sub-queue may run up
+ * to "weight" units before the next sub-queue is served, so a provider
+ * flooding the pool with RPCs cannot starve the others.
+ *
+ * The key of a unit is taken from margo_wfq_pool_set_next_key when the unit
+ * is created, and a unit that yields goes back to the sub-queue it came from.
+ * The key is also stored on the ULT itself (in an ABT key), so that the unit
+ * created for the ULT when it migrates or is pushed into another pool keeps
+ * it, as the deadlines of the EDF pool do.
+ */
+
+typedef struct subqueue_t subqueue_t;
+
+typedef struct unit_t {
+    ABT_thread     thread;
+    ABT_task       task;
+    struct unit_t* p_next;
+    int            key;
+    subqueue_t*    queue; /* resolved on the first push */
+    ABT_bool       is_in_pool;
+} unit_t;
+
+struct subqueue_t {
+    int            key;
+    unsigned       weight;
+    unsigned       deficit; /* units this sub-queue may still run this turn */
+    unit_t*        p_head;
+    unit_t*        p_tail;
+    size_t         depth;
+    uint64_t       num_served;
+    subqueue_t*    prev; /* active ring (non-empty sub-queues) */
+    subqueue_t*    next;
+    UT_hash_handle hh; /* all the sub-queues, by key */
+};
+
+typedef struct pool_t {
+    subqueue_t*     queues;         /* hash of all the sub-queues */
+    subqueue_t*     others;         /* sub-queue of units without key */
+    subqueue_t*     active;         /* sub-queue currently being served */
+    unsigned        default_weight; /* of sub-queues not configured */
+    _Atomic size_t  num; /* read locklessly in pool_pop's fast path */
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} pool_t;
+
+/* key of the next unit created by this ES */
+static _Thread_local int wfq_next_key = -1;
+
+void margo_wfq_pool_set_next_key(int key) { wfq_next_key = key; }
+
+int margo_wfq_pool_get_next_key(void) { return wfq_next_key; }
+
+/* key of a ULT plus one (so that 0 means none), kept for its lifetime */
+static ABT_key        wfq_key_key      = ABT_KEY_NULL;
+static pthread_once_t wfq_key_key_once = PTHREAD_ONCE_INIT;
+
+static void wfq_key_key_create(void) { ABT_key_create(NULL, &wfq_key_key); }
+
+/* Key of a unit being created for the given ULT: the one given by
+ * margo_wfq_pool_set_next_key, or the one the ULT already had */
+static int wfq_unit_key(ABT_thread thread)
+{
+    int key = wfq_next_key;
+    if (key != -1) {
+        ABT_thread_set_specific(thread, wfq_key_key,
+                                (void*)(intptr_t)(key + 1));
+    } else {
+        void* value = NULL;
+        ABT_thread_get_specific(thread, wfq_key_key, &value);
+        key = (int)(intptr_t)value - 1;
+    }
+    return key;
+}
+
+int margo_wfq_pool_get_unit_key(ABT_unit unit) { return ((unit_t*)unit)->key; }
+
+/* must be called with the pool's mutex held */
+static subqueue_t* find_or_add_queue(pool_t* p_pool, int key)
+{
+    subqueue_t* queue = NULL;
+    HASH_FIND_INT(p_pool->queues, &key, queue);
+    if (queue) return queue;
+    queue = (subqueue_t*)calloc(1, sizeof(*queue));
+    if (!queue) return NULL;
+    queue->key    = key;
+    queue->weight = p_pool->default_weight;
+    HASH_ADD_INT(p_pool->queues, key, queue);
+    return queue;
+}
+
+static inline void
+queue_push(pool_t* p_pool, subqueue_t* queue, unit_t* p_unit)
+{
+    p_unit->p_next = NULL;
+    if (queue->p_tail)
+        queue->p_tail->p_next = p_unit;
+    else
+        queue->p_head = p_unit;
+    queue->p_tail = p_unit;
+    /* a sub-queue becoming non-empty joins the end of the round */
+    if (queue->depth++ == 0) CDL_APPEND(p_pool->active, queue);
+    p_unit->is_in_pool = ABT_TRUE;
+}
+
+static inline unit_t* queue_pop(pool_t* p_pool)
+{
+    subqueue_t* queue = p_pool->active;
+    if (!queue) return NULL;
+
+    /* start of the turn of this sub-queue */
+    if (queue->deficit == 0) queue->deficit = queue->weight;
+
+    unit_t* p_unit = queue->p_head;
+    queue->p_head  = p_unit->p_next;
+    if (!queue->p_head) queue->p_tail = NULL;
+    queue->depth -= 1;
+    queue->deficit -= 1;
+    queue->num_served += 1;
+
+    if (queue->depth == 0) {
+        /* an empty sub-queue loses its remaining deficit */
+        queue->deficit = 0;
+        CDL_DELETE(p_pool->active, queue);
+        queue->prev = queue->next = NULL;
+    } else if (queue->deficit == 0) {
+        p_pool->active = queue->next;
+    }
+
+    p_unit->p_next     = NULL;
+    p_unit->is_in_pool = ABT_FALSE;
+    return p_unit;
+}
+
+static ABT_unit_type pool_unit_get_type(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    if (p_unit->thread != ABT_THREAD_NULL) {
+        return ABT_UNIT_TYPE_THREAD;
+    } else {
+        return ABT_UNIT_TYPE_TASK;
+    }
+}
+
+static ABT_thread pool_unit_get_thread(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->thread;
+}
+
+static ABT_task pool_unit_get_task(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->task;
+}
+
+static ABT_bool pool_unit_is_in_pool(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->is_in_pool;
+}
+
+static ABT_unit pool_unit_create_from_thread(ABT_thread thread)
+{
+    unit_t* p_unit     = (unit_t*)malloc(sizeof(unit_t));
+    p_unit->thread     = thread;
+    p_unit->task       = ABT_TASK_NULL;
+    p_unit->p_next     = NULL;
+    p_unit->key        = wfq_unit_key(thread);
+    p_unit->queue      = NULL;
+    p_unit->is_in_pool = ABT_FALSE;
+    return (ABT_unit)p_unit;
+}
+
+static ABT_unit pool_unit_create_from_task(ABT_task task)
+{
+    unit_t* p_unit     = (unit_t*)malloc(sizeof(unit_t));
+    p_unit->thread     = ABT_THREAD_NULL;
+    p_unit->task       = task;
+    p_unit->p_next     = NULL;
+    p_unit->key        = wfq_next_key;
+    p_unit->queue      = NULL;
+    p_unit->is_in_pool = ABT_FALSE;
+    return (ABT_unit)p_unit;
+}
+
+static void pool_unit_free(ABT_unit* p_unit)
+{
+    free(*p_unit);
+    *p_unit = ABT_UNIT_NULL;
+}
+
+static int pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    (void)config;
+    pool_t* p_pool = (pool_t*)calloc(1, sizeof(pool_t));
+    if (!p_pool) return ABT_ERR_MEM;
+    p_pool->default_weight = 1;
+    p_pool->others         = find_or_add_queue(p_pool, -1);
+    if (!p_pool->others) {
+        free(p_pool);
+        return ABT_ERR_MEM;
+    }
+    pthread_mutex_init(&p_pool->mutex, NULL);
+    pthread_cond_init(&p_pool->cond, NULL);
+    ABT_pool_set_data(pool, (void*)p_pool);
+    return ABT_SUCCESS;
+}
+
+static size_t pool_get_size(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    return p_pool->num;
+}
+
+static void pool_push(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t* p_unit = (unit_t*)unit;
+
+    pthread_mutex_lock(&p_pool->mutex);
+    if (!p_unit->queue) {
+        p_unit->queue = find_or_add_queue(p_pool, p_unit->key);
+        /* if the sub-queue could not be allocated, fall back to the one of
+         * units that are not RPCs rather than losing the unit */
+        if (!p_unit->queue) p_unit->queue = p_pool->others;
+    }
+    queue_push(p_pool, p_unit->queue, p_unit);
+    p_pool->num++;
+    pthread_cond_signal(&p_pool->cond);
+    pthread_mutex_unlock(&p_pool->mutex);
+}
+
+static ABT_unit pool_pop(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    /* Fast path: an idle scheduler calls pool_pop in a tight loop, so skip
+     * taking the mutex when the pool is empty (see margo-prio-pool.c). */
+    if (atomic_load_explicit(&p_pool->num, memory_order_relaxed) == 0)
+        return ABT_UNIT_NULL;
+
+    pthread_mutex_lock(&p_pool->mutex);
+    unit_t* p_unit = queue_pop(p_pool);
+    if (p_unit) p_pool->num--;
+    pthread_mutex_unlock(&p_pool->mutex);
+    return p_unit ? (ABT_unit)p_unit : ABT_UNIT_NULL;
+}
+
+static inline void convert_double_sec_to_timespec(struct timespec* ts_out,
+                                                  double           seconds)
+{
+    ts_out->tv_sec  = (time_t)seconds;
+    ts_out->tv_nsec = (long)((seconds - ts_out->tv_sec) * 1000000000.0);
+}
+
+static ABT_unit pool_pop_timedwait(ABT_pool pool, double abstime_secs)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_lock(&p_pool->mutex);
+    if (p_pool->num == 0) {
+        struct timespec ts;
+        convert_double_sec_to_timespec(&ts, abstime_secs);
+        pthread_cond_timedwait(&p_pool->cond, &p_pool->mutex, &ts);
+    }
+    unit_t* p_unit = queue_pop(p_pool);
+    if (p_unit) p_pool->num--;
+    pthread_mutex_unlock(&p_pool->mutex);
+    return p_unit ? (ABT_unit)p_unit : ABT_UNIT_NULL;
+}
+
+static int pool_free(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    subqueue_t *queue, *tmp;
+    HASH_ITER(hh, p_pool->queues, queue, tmp)
+    {
+        HASH_DEL(p_pool->queues, queue);
+        free(queue);
+    }
+    pthread_mutex_destroy(&p_pool->mutex);
+    pthread_cond_destroy(&p_pool->cond);
+    free(p_pool);
+
+    return ABT_SUCCESS;
+}
+
+void margo_create_wfq_pool_def(ABT_pool_def* p_def)
+{
+    pthread_once(&wfq_key_key_once, wfq_key_key_create);
+    p_def->access               = ABT_POOL_ACCESS_MPMC;
+    p_def->u_get_type           = pool_unit_get_type;
+    p_def->u_get_thread         = pool_unit_get_thread;
+    p_def->u_get_task           = pool_unit_get_task;
+    p_def->u_is_in_pool         = pool_unit_is_in_pool;
+    p_def->u_create_from_thread = pool_unit_create_from_thread;
+    p_def->u_create_from_task   = pool_unit_create_from_task;
+    p_def->u_free               = pool_unit_free;
+    p_def->p_init               = pool_init;
+    p_def->p_get_size           = pool_get_size;
+    p_def->p_push               = pool_push;
+    p_def->p_pop                = pool_pop;
+    p_def->p_pop_timedwait      = pool_pop_timedwait;
+    p_def->p_remove             = NULL; /* Optional */
+    p_def->p_free               = pool_free;
+    p_def->p_print_all          = NULL; /* Optional */
+}
+
+void margo_wfq_pool_set_default_weight(ABT_pool pool, unsigned weight)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_lock(&p_pool->mutex);
+    p_pool->default_weight = weight ? weight : 1;
+    pthread_mutex_unlock(&p_pool->mutex);
+}
+
+void margo_wfq_pool_set_weight(ABT_pool pool, int key, unsigned weight)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    pthread_mutex_lock(&p_pool->mutex);
+    subqueue_t* queue = find_or_add_queue(p_pool, key);
+    if (queue) queue->weight = weight ? weight : 1;
+    pthread_mutex_unlock(&p_pool->mutex);
+}
+
+size_t margo_wfq_pool_get_stats(ABT_pool                 pool,
+                                margo_wfq_queue_stats_t* stats,
+                                size_t                   max_stats)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    size_t      count = 0;
+    subqueue_t *queue, *tmp;
+    pthread_mutex_lock(&p_pool->mutex);
+    HASH_ITER(hh, p_pool->queues, queue, tmp)
+    {
+        if (count < max_stats) {
+            stats[count].key        = queue->key;
+            stats[count].weight     = queue->weight;
+            stats[count].depth      = queue->depth;
+            stats[count].num_served = queue->num_served;
+        }
+        count += 1;
+    }
+    pthread_mutex_unlock(&p_pool->mutex);
+    return count;
+}
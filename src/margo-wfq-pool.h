@@ -0,0 +1,52 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef __MARGO_WFQ_POOL
+#define __MARGO_WFQ_POOL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <abt.h>
+
+void margo_create_wfq_pool_def(ABT_pool_def* p_def);
+
+/* Sets the key (provider id, or -1 for none) of the units that the calling
+ * execution stream creates next in "wfq_wait" pools. */
+void margo_wfq_pool_set_next_key(int key);
+
+/* Key last set by the calling execution stream (-1 if none) */
+int margo_wfq_pool_get_next_key(void);
+
+/* Key of a unit of a "wfq_wait" pool */
+int margo_wfq_pool_get_unit_key(ABT_unit unit);
+
+/* Weight of the sub-queues that were not given one explicitly (default 1) */
+void margo_wfq_pool_set_default_weight(ABT_pool pool, unsigned weight);
+
+/* Weight of the sub-queue of the given key */
+void margo_wfq_pool_set_weight(ABT_pool pool, int key, unsigned weight);
+
+typedef struct margo_wfq_queue_stats {
+    int      key;
+    unsigned weight;
+    size_t   depth;      /* units currently in the sub-queue */
+    uint64_t num_served; /* units popped from the sub-queue so far */
+} margo_wfq_queue_stats_t;
+
+/* Fills up to max_stats entries with the statistics of the pool's
+ * sub-queues and returns the total number of sub-queues */
+size_t margo_wfq_pool_get_stats(ABT_pool                 pool,
+                                margo_wfq_queue_stats_t* stats,
+                                size_t                   max_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MARGO_WFQ_POOL */
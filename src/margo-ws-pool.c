@@ -0,0 +1,387 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#include <abt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "margo-ws-pool.h"
+
+/* ABT_POOL_WS_WAIT */
+
+/* This is a custom Argobots pool, compatible with ABT_POOL_FIFO_WAIT, in
+ * which each execution stream popping from the pool gets its own deque, so
+ * the pool can be shared by several ESs (with the basic_wait scheduler)
+ * without a single queue they all contend on:
+ *
+ * - a unit created by an ES of the pool goes to the bottom of that ES's
+ *   deque, and the ES pops from the bottom (LIFO), so child ULTs run on the
+ *   ES that created them while their data is still in its cache;
+ * - units pushed by other ESs (e.g. RPC handlers created by the progress
+ *   loop) go to a shared injection queue (FIFO);
+ * - a unit that already ran goes back to the deque of the last ES that ran
+ *   it: at the bottom if it is resumed by another ES (e.g. a ULT blocked in
+ *   margo_forward woken up by the progress loop), so it runs next, and at
+ *   the top if it yielded, so it does not starve the rest of the deque;
+ * - an ES whose deque and the injection queue are empty steals from the top
+ *   of the other ESs' deques, starting with its neighbour.
+ *
+ * ESs are identified by their rank; ESs with a rank of WS_MAX_XSTREAMS or
+ * more, or that never pop from the pool, only use the injection queue.
+ */
+
+#define WS_MAX_XSTREAMS 256
+
+typedef struct deque_t deque_t;
+
+typedef struct unit_t {
+    ABT_thread     thread;
+    ABT_task       task;
+    struct unit_t* p_prev;
+    struct unit_t* p_next;
+    deque_t*       p_deque; /* deque the unit is in, NULL if not in pool */
+    int            home;    /* rank of the last ES that popped it, or -1 */
+} unit_t;
+
+struct deque_t {
+    unit_t*         p_top;
+    unit_t*         p_bottom;
+    _Atomic size_t  size; /* read without the lock to skip empty deques */
+    pthread_mutex_t mutex;
+};
+
+typedef struct pool_t {
+    deque_t          injection;
+    deque_t* _Atomic deques[WS_MAX_XSTREAMS]; /* created on first pop */
+    _Atomic int      max_rank; /* highest rank with a deque */
+    _Atomic size_t   num;
+    _Atomic int      num_waiters; /* ESs sleeping in pool_pop_timedwait */
+    pthread_mutex_t  wait_mutex;
+    pthread_cond_t   wait_cond;
+} pool_t;
+
+static inline void deque_init(deque_t* p_deque)
+{
+    p_deque->p_top    = NULL;
+    p_deque->p_bottom = NULL;
+    p_deque->size     = 0;
+    pthread_mutex_init(&p_deque->mutex, NULL);
+}
+
+static inline void deque_push_bottom(deque_t* p_deque, unit_t* p_unit)
+{
+    pthread_mutex_lock(&p_deque->mutex);
+    p_unit->p_prev = p_deque->p_bottom;
+    p_unit->p_next = NULL;
+    if (p_deque->p_bottom)
+        p_deque->p_bottom->p_next = p_unit;
+    else
+        p_deque->p_top = p_unit;
+    p_deque->p_bottom = p_unit;
+    p_unit->p_deque   = p_deque;
+    atomic_fetch_add_explicit(&p_deque->size, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&p_deque->mutex);
+}
+
+static inline void deque_push_top(deque_t* p_deque, unit_t* p_unit)
+{
+    pthread_mutex_lock(&p_deque->mutex);
+    p_unit->p_prev = NULL;
+    p_unit->p_next = p_deque->p_top;
+    if (p_deque->p_top)
+        p_deque->p_top->p_prev = p_unit;
+    else
+        p_deque->p_bottom = p_unit;
+    p_deque->p_top  = p_unit;
+    p_unit->p_deque = p_deque;
+    atomic_fetch_add_explicit(&p_deque->size, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&p_deque->mutex);
+}
+
+/* must be called with the deque's mutex held */
+static inline void deque_unlink(deque_t* p_deque, unit_t* p_unit)
+{
+    if (p_unit->p_prev)
+        p_unit->p_prev->p_next = p_unit->p_next;
+    else
+        p_deque->p_top = p_unit->p_next;
+    if (p_unit->p_next)
+        p_unit->p_next->p_prev = p_unit->p_prev;
+    else
+        p_deque->p_bottom = p_unit->p_prev;
+    p_unit->p_next  = NULL;
+    p_unit->p_prev  = NULL;
+    p_unit->p_deque = NULL;
+    atomic_fetch_sub_explicit(&p_deque->size, 1, memory_order_relaxed);
+}
+
+static inline unit_t* deque_pop(deque_t* p_deque, bool bottom)
+{
+    if (atomic_load_explicit(&p_deque->size, memory_order_relaxed) == 0)
+        return NULL;
+    pthread_mutex_lock(&p_deque->mutex);
+    unit_t* p_unit = bottom ? p_deque->p_bottom : p_deque->p_top;
+    if (p_unit) deque_unlink(p_deque, p_unit);
+    pthread_mutex_unlock(&p_deque->mutex);
+    return p_unit;
+}
+
+/* rank of the calling ES, or -1 if it cannot have a deque */
+static inline int self_rank(void)
+{
+    int rank;
+    if (ABT_self_get_xstream_rank(&rank) != ABT_SUCCESS) return -1;
+    if (rank < 0 || rank >= WS_MAX_XSTREAMS) return -1;
+    return rank;
+}
+
+/* deque of the given rank, created if needed */
+static deque_t* get_or_create_deque(pool_t* p_pool, int rank)
+{
+    deque_t* p_deque = atomic_load(&p_pool->deques[rank]);
+    if (p_deque) return p_deque;
+    deque_t* p_new = (deque_t*)malloc(sizeof(*p_new));
+    if (!p_new) return NULL;
+    deque_init(p_new);
+    if (!atomic_compare_exchange_strong(&p_pool->deques[rank], &p_deque,
+                                        p_new)) {
+        /* another thread created it first (p_deque was updated) */
+        pthread_mutex_destroy(&p_new->mutex);
+        free(p_new);
+        return p_deque;
+    }
+    int max_rank = atomic_load(&p_pool->max_rank);
+    while (max_rank < rank
+           && !atomic_compare_exchange_weak(&p_pool->max_rank, &max_rank,
+                                            rank)) {}
+    return p_new;
+}
+
+static ABT_unit_type pool_unit_get_type(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    if (p_unit->thread != ABT_THREAD_NULL) {
+        return ABT_UNIT_TYPE_THREAD;
+    } else {
+        return ABT_UNIT_TYPE_TASK;
+    }
+}
+
+static ABT_thread pool_unit_get_thread(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->thread;
+}
+
+static ABT_task pool_unit_get_task(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->task;
+}
+
+static ABT_bool pool_unit_is_in_pool(ABT_unit unit)
+{
+    unit_t* p_unit = (unit_t*)unit;
+    return p_unit->p_deque ? ABT_TRUE : ABT_FALSE;
+}
+
+static ABT_unit pool_unit_create_from_thread(ABT_thread thread)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread = thread;
+    p_unit->task   = ABT_TASK_NULL;
+    p_unit->home   = -1;
+    return (ABT_unit)p_unit;
+}
+
+static ABT_unit pool_unit_create_from_task(ABT_task task)
+{
+    unit_t* p_unit = (unit_t*)calloc(1, sizeof(unit_t));
+    if (!p_unit) return ABT_UNIT_NULL;
+    p_unit->thread = ABT_THREAD_NULL;
+    p_unit->task   = task;
+    p_unit->home   = -1;
+    return (ABT_unit)p_unit;
+}
+
+static void pool_unit_free(ABT_unit* p_unit)
+{
+    free(*p_unit);
+    *p_unit = ABT_UNIT_NULL;
+}
+
+static int pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    (void)config;
+    pool_t* p_pool = (pool_t*)calloc(1, sizeof(pool_t));
+    if (!p_pool) return ABT_ERR_MEM;
+    deque_init(&p_pool->injection);
+    p_pool->max_rank = -1;
+    pthread_mutex_init(&p_pool->wait_mutex, NULL);
+    pthread_cond_init(&p_pool->wait_cond, NULL);
+    ABT_pool_set_data(pool, (void*)p_pool);
+    return ABT_SUCCESS;
+}
+
+static size_t pool_get_size(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    return atomic_load_explicit(&p_pool->num, memory_order_relaxed);
+}
+
+static void pool_push(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t*  p_unit = (unit_t*)unit;
+    int      rank   = self_rank();
+    deque_t* p_self = rank >= 0 ? atomic_load(&p_pool->deques[rank]) : NULL;
+
+    /* num is incremented before the unit becomes visible so that it never
+     * goes below the number of units in the deques, and before num_waiters
+     * is read (see pool_pop_timedwait) */
+    atomic_fetch_add(&p_pool->num, 1);
+    if (p_unit->home >= 0) {
+        deque_t* p_home = atomic_load(&p_pool->deques[p_unit->home]);
+        if (p_home == p_self)
+            deque_push_top(p_home, p_unit); /* yielded */
+        else
+            deque_push_bottom(p_home, p_unit); /* resumed by another ES */
+    } else if (p_self) {
+        deque_push_bottom(p_self, p_unit); /* spawned by an ES of the pool */
+    } else {
+        deque_push_bottom(&p_pool->injection, p_unit);
+    }
+    if (atomic_load(&p_pool->num_waiters) > 0) {
+        pthread_mutex_lock(&p_pool->wait_mutex);
+        pthread_cond_signal(&p_pool->wait_cond);
+        pthread_mutex_unlock(&p_pool->wait_mutex);
+    }
+}
+
+static ABT_unit pool_pop(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    if (atomic_load_explicit(&p_pool->num, memory_order_relaxed) == 0)
+        return ABT_UNIT_NULL;
+
+    int      rank   = self_rank();
+    deque_t* p_self = rank >= 0 ? get_or_create_deque(p_pool, rank) : NULL;
+
+    /* own deque (LIFO), then injection queue (FIFO), then steal */
+    unit_t* p_unit = p_self ? deque_pop(p_self, true) : NULL;
+    if (!p_unit) p_unit = deque_pop(&p_pool->injection, false);
+    if (!p_unit) {
+        int max_rank = atomic_load(&p_pool->max_rank);
+        for (int i = 1; i <= max_rank + 1 && !p_unit; i++) {
+            deque_t* p_victim = atomic_load(
+                &p_pool->deques[(rank + i) % (max_rank + 1)]);
+            if (p_victim && p_victim != p_self)
+                p_unit = deque_pop(p_victim, false);
+        }
+    }
+    if (!p_unit) return ABT_UNIT_NULL;
+    atomic_fetch_sub(&p_pool->num, 1);
+    /* units stolen or taken from the injection queue are now homed here */
+    p_unit->home = p_self ? rank : -1;
+    return (ABT_unit)p_unit;
+}
+
+static inline void convert_double_sec_to_timespec(struct timespec* ts_out,
+                                                  double           seconds)
+{
+    ts_out->tv_sec  = (time_t)seconds;
+    ts_out->tv_nsec = (long)((seconds - ts_out->tv_sec) * 1000000000.0);
+}
+
+static ABT_unit pool_pop_timedwait(ABT_pool pool, double abstime_secs)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+
+    ABT_unit unit = pool_pop(pool);
+    if (unit != ABT_UNIT_NULL) return unit;
+
+    /* num_waiters is incremented before num is read, while pushes increment
+     * num before reading num_waiters, so a push cannot be missed */
+    pthread_mutex_lock(&p_pool->wait_mutex);
+    atomic_fetch_add(&p_pool->num_waiters, 1);
+    if (atomic_load(&p_pool->num) == 0) {
+        struct timespec ts;
+        convert_double_sec_to_timespec(&ts, abstime_secs);
+        pthread_cond_timedwait(&p_pool->wait_cond, &p_pool->wait_mutex, &ts);
+    }
+    atomic_fetch_sub(&p_pool->num_waiters, 1);
+    pthread_mutex_unlock(&p_pool->wait_mutex);
+    return pool_pop(pool);
+}
+
+static int pool_remove(ABT_pool pool, ABT_unit unit)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    unit_t*  p_unit  = (unit_t*)unit;
+    deque_t* p_deque = p_unit->p_deque;
+    if (!p_deque) return ABT_ERR_POOL;
+
+    pthread_mutex_lock(&p_deque->mutex);
+    /* the owner or a thief may have popped the unit before the lock was
+     * taken, in which case it is no longer ours to remove */
+    if (p_unit->p_deque != p_deque) {
+        pthread_mutex_unlock(&p_deque->mutex);
+        return ABT_ERR_POOL;
+    }
+    deque_unlink(p_deque, p_unit);
+    pthread_mutex_unlock(&p_deque->mutex);
+    atomic_fetch_sub(&p_pool->num, 1);
+
+    return ABT_SUCCESS;
+}
+
+static int pool_free(ABT_pool pool)
+{
+    pool_t* p_pool;
+    ABT_pool_get_data(pool, (void**)&p_pool);
+    for (int i = 0; i < WS_MAX_XSTREAMS; i++) {
+        deque_t* p_deque = atomic_load(&p_pool->deques[i]);
+        if (!p_deque) continue;
+        pthread_mutex_destroy(&p_deque->mutex);
+        free(p_deque);
+    }
+    pthread_mutex_destroy(&p_pool->injection.mutex);
+    pthread_mutex_destroy(&p_pool->wait_mutex);
+    pthread_cond_destroy(&p_pool->wait_cond);
+    free(p_pool);
+
+    return ABT_SUCCESS;
+}
+
+void margo_create_ws_pool_def(ABT_pool_def* p_def)
+{
+    p_def->access               = ABT_POOL_ACCESS_MPMC;
+    p_def->u_get_type           = pool_unit_get_type;
+    p_def->u_get_thread         = pool_unit_get_thread;
+    p_def->u_get_task           = pool_unit_get_task;
+    p_def->u_is_in_pool         = pool_unit_is_in_pool;
+    p_def->u_create_from_thread = pool_unit_create_from_thread;
+    p_def->u_create_from_task   = pool_unit_create_from_task;
+    p_def->u_free               = pool_unit_free;
+    p_def->p_init               = pool_init;
+    p_def->p_get_size           = pool_get_size;
+    p_def->p_push               = pool_push;
+    p_def->p_pop                = pool_pop;
+    p_def->p_pop_timedwait      = pool_pop_timedwait;
+    p_def->p_remove             = pool_remove;
+    p_def->p_free               = pool_free;
+    p_def->p_print_all          = NULL; /* Optional. */
+}
@@ -0,0 +1,22 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+#ifndef __MARGO_WS_POOL
+#define __MARGO_WS_POOL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <abt.h>
+
+void margo_create_ws_pool_def(ABT_pool_def* p_def);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MARGO_WS_POOL */
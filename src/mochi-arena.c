@@ -6,25 +6,82 @@
 #include "mochi-arena.h"
 
 #include <abt.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Each block holds block_capacity objects right after this header. Blocks are
- * chained so that mochi_arena_destroy can free them all. */
+/* Each execution stream (up to MOCHI_ARENA_MAX_XSTREAMS, by rank) gets a
+ * magazine caching up to MOCHI_ARENA_MAGAZINE_SIZE free objects, so that get
+ * and release usually do not touch the shared free lists. An empty magazine
+ * is refilled with MOCHI_ARENA_BATCH_SIZE objects from the free lists, and a
+ * full one flushes MOCHI_ARENA_BATCH_SIZE objects to them, in both cases
+ * under a single acquisition of the lock. This relies on the operations of a
+ * magazine not yielding (ABT_mutex_spinlock does not yield), so that only
+ * one ULT at a time uses the magazine of an ES. Callers that are not running
+ * on an ES (or whose ES rank is too large) use the free lists directly, and
+ * so does everyone once the arena has a limit, since objects sitting in the
+ * magazines would make the arena look full while some of them are free. */
+#define MOCHI_ARENA_MAX_XSTREAMS  256
+#define MOCHI_ARENA_MAGAZINE_SIZE 32
+#define MOCHI_ARENA_BATCH_SIZE    (MOCHI_ARENA_MAGAZINE_SIZE / 2)
+#define CACHE_LINE_SIZE           64
+
+struct mochi_arena_magazine {
+    _Alignas(CACHE_LINE_SIZE) size_t count;
+    void* objs[MOCHI_ARENA_MAGAZINE_SIZE];
+    /* only written by the ES owning the magazine, read by get_stats */
+    _Atomic size_t num_gets;
+    _Atomic size_t num_releases;
+};
+
+/* Each block holds block_capacity slots right after this header. A slot is
+ * made of a pointer to its block followed by the object, so that a released
+ * object goes back to the free list of its own block. A block whose objects
+ * are all in its free list can be given back to the system by
+ * mochi_arena_trim. Blocks are chained so that mochi_arena_destroy can free
+ * them all, and blocks with free objects are also in the arena's partial
+ * list, from which objects are handed out. */
 struct mochi_arena_block {
-    struct mochi_arena_block* next;
+    struct mochi_arena_block* next; /* all blocks */
+    struct mochi_arena_block* next_partial;
+    struct mochi_arena_block* prev_partial;
+    void*                     free_list; /* intrusive */
+    size_t                    num_free;
 };
 
+#define SLOT_HEADER_SIZE sizeof(struct mochi_arena_block*)
+#define BLOCK_OF(obj) \
+    (*(struct mochi_arena_block**)((char*)(obj)-SLOT_HEADER_SIZE))
+
 struct mochi_arena {
     size_t object_size;    /* >= sizeof(void*), rounded up for alignment */
     size_t block_capacity; /* number of objects per block, >= 1 */
-    void*  free_list;      /* intrusive: a free object's first bytes hold the
-                              pointer to the next free object */
+    size_t max_objects;    /* 0 for no limit */
+    bool   wait_when_full;
+    mochi_arena_allocator_t allocator; /* alloc is NULL for malloc/free */
     struct mochi_arena_block* blocks;
-    ABT_mutex_memory          mtx;
+    struct mochi_arena_block* partial;
+    /* statistics (protected by the lock), see mochi_arena_stats_t */
+    size_t           num_blocks;
+    size_t           peak_num_blocks;
+    size_t           num_trimmed_blocks;
+    size_t           num_gets;     /* by callers without a magazine */
+    size_t           num_releases; /* by callers without a magazine */
+    size_t           num_out; /* objects out of the blocks' free lists */
+    _Atomic size_t   num_full;
+    unsigned         num_waiters; /* callers waiting for a free object */
+    ABT_mutex_memory mtx;
+    ABT_cond_memory  cond; /* signaled when an object is released */
+    /* per-ES magazines, allocated the first time an ES uses the arena */
+    _Atomic(struct mochi_arena_magazine*) magazines[MOCHI_ARENA_MAX_XSTREAMS];
 };
 
+#define ARENA_LOCK(arena) \
+    ABT_mutex_spinlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(arena)->mtx))
+#define ARENA_UNLOCK(arena) \
+    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&(arena)->mtx))
+
 /* Round x up to a multiple of a (a must be a power of two). */
 static inline size_t round_up(size_t x, size_t a)
 {
@@ -41,57 +98,340 @@ mochi_arena_t mochi_arena_create(size_t object_size, size_t initial_capacity)
      * of which contain only doubles/pointers/integers) */
     arena->object_size    = round_up(object_size, 8);
     arena->block_capacity = initial_capacity < 1 ? 1 : initial_capacity;
-    arena->free_list      = NULL;
     arena->blocks         = NULL;
+    arena->partial        = NULL;
     return arena;
 }
 
-/* Allocate a new block and thread its objects onto the free list.
+static inline size_t block_size(mochi_arena_t arena)
+{
+    size_t header = round_up(sizeof(struct mochi_arena_block), 8);
+    size_t stride = SLOT_HEADER_SIZE + arena->object_size;
+    return header + arena->block_capacity * stride;
+}
+
+static inline void block_free(mochi_arena_t             arena,
+                              struct mochi_arena_block* block)
+{
+    if (arena->allocator.free)
+        arena->allocator.free(arena->allocator.uargs, block,
+                              block_size(arena));
+    else
+        free(block);
+}
+
+void mochi_arena_set_allocator(mochi_arena_t                  arena,
+                               const mochi_arena_allocator_t* allocator)
+{
+    if (!arena) return;
+    if (!allocator || !allocator->alloc || !allocator->free) {
+        memset(&arena->allocator, 0, sizeof(arena->allocator));
+        return;
+    }
+    arena->allocator = *allocator;
+    size_t g         = allocator->granularity;
+    if (g) {
+        /* give the tail of the last granule to additional objects */
+        size_t header = round_up(sizeof(struct mochi_arena_block), 8);
+        size_t stride = SLOT_HEADER_SIZE + arena->object_size;
+        size_t total  = (block_size(arena) + g - 1) / g * g;
+        arena->block_capacity = (total - header) / stride;
+    }
+}
+
+/* Must be called with the arena locked */
+static inline void partial_link(mochi_arena_t             arena,
+                                struct mochi_arena_block* b)
+{
+    b->prev_partial = NULL;
+    b->next_partial = arena->partial;
+    if (arena->partial) arena->partial->prev_partial = b;
+    arena->partial = b;
+}
+
+/* Must be called with the arena locked */
+static inline void partial_unlink(mochi_arena_t             arena,
+                                  struct mochi_arena_block* b)
+{
+    if (b->prev_partial)
+        b->prev_partial->next_partial = b->next_partial;
+    else
+        arena->partial = b->next_partial;
+    if (b->next_partial) b->next_partial->prev_partial = b->prev_partial;
+}
+
+/* Allocate a new block and thread its objects onto its free list.
  * Must be called with the arena locked. Returns 0 on success, -1 on OOM. */
 static int mochi_arena_grow(mochi_arena_t arena)
 {
     size_t header = round_up(sizeof(struct mochi_arena_block), 8);
-    size_t total  = header + arena->block_capacity * arena->object_size;
+    size_t stride = SLOT_HEADER_SIZE + arena->object_size;
+    size_t total  = block_size(arena);
 
     struct mochi_arena_block* block
-        = (struct mochi_arena_block*)malloc(total);
+        = arena->allocator.alloc
+            ? (struct mochi_arena_block*)arena->allocator.alloc(
+                arena->allocator.uargs, total)
+            : (struct mochi_arena_block*)malloc(total);
     if (!block) return -1;
 
-    block->next    = arena->blocks;
-    arena->blocks  = block;
+    block->next      = arena->blocks;
+    block->free_list = NULL;
+    block->num_free  = arena->block_capacity;
+    arena->blocks    = block;
+    partial_link(arena, block);
 
     char* base = (char*)block + header;
     for (size_t i = 0; i < arena->block_capacity; i++) {
-        void* obj         = base + i * arena->object_size;
-        *(void**)obj      = arena->free_list;
-        arena->free_list  = obj;
+        char* slot                        = base + i * stride;
+        void* obj                         = slot + SLOT_HEADER_SIZE;
+        *(struct mochi_arena_block**)slot = block;
+        *(void**)obj                      = block->free_list;
+        block->free_list                  = obj;
     }
+
+    arena->num_blocks++;
+    if (arena->num_blocks > arena->peak_num_blocks)
+        arena->peak_num_blocks = arena->num_blocks;
     return 0;
 }
 
+/* Takes a free object out of the blocks, growing the arena if needed.
+ * Must be called with the arena locked. Returns NULL if the arena is full
+ * (*full is then set to true) or on OOM. Since an arena with a limit has no
+ * magazines, num_out is then the exact number of live objects. */
+static void* mochi_arena_pop(mochi_arena_t arena, bool* full)
+{
+    if (arena->max_objects && arena->num_out >= arena->max_objects) {
+        *full = true;
+        return NULL;
+    }
+    if (!arena->partial && mochi_arena_grow(arena) != 0) return NULL;
+    struct mochi_arena_block* block = arena->partial;
+    void*                     obj   = block->free_list;
+    block->free_list                = *(void**)obj;
+    if (--block->num_free == 0) partial_unlink(arena, block);
+    arena->num_out++;
+    return obj;
+}
+
+/* Puts an object back into its block. Must be called with the arena locked. */
+static void mochi_arena_push(mochi_arena_t arena, void* obj)
+{
+    struct mochi_arena_block* block = BLOCK_OF(obj);
+    *(void**)obj                    = block->free_list;
+    block->free_list                = obj;
+    if (block->num_free++ == 0) partial_link(arena, block);
+    arena->num_out--;
+}
+
+/* Returns the magazine of the calling ES, or NULL if it cannot have one */
+static struct mochi_arena_magazine* mochi_arena_magazine(mochi_arena_t arena)
+{
+    /* max_objects is only set before the arena is first used */
+    if (arena->max_objects) return NULL;
+    int rank = -1;
+    if (ABT_self_get_xstream_rank(&rank) != ABT_SUCCESS || rank < 0
+        || rank >= MOCHI_ARENA_MAX_XSTREAMS)
+        return NULL;
+    struct mochi_arena_magazine* mag = atomic_load_explicit(
+        &arena->magazines[rank], memory_order_acquire);
+    if (mag) return mag;
+    mag = (struct mochi_arena_magazine*)aligned_alloc(
+        CACHE_LINE_SIZE, sizeof(struct mochi_arena_magazine));
+    if (!mag) return NULL;
+    mag->count = 0;
+    atomic_init(&mag->num_gets, 0);
+    atomic_init(&mag->num_releases, 0);
+    struct mochi_arena_magazine* expected = NULL;
+    /* an ES that was destroyed may have had the same rank */
+    if (!atomic_compare_exchange_strong(&arena->magazines[rank], &expected,
+                                        mag)) {
+        free(mag);
+        mag = expected;
+    }
+    return mag;
+}
+
+/* Moves up to MOCHI_ARENA_BATCH_SIZE objects from the blocks (growing the
+ * arena if needed) into an empty magazine. */
+static void mochi_arena_refill(mochi_arena_t                arena,
+                               struct mochi_arena_magazine* mag,
+                               bool*                        full)
+{
+    ARENA_LOCK(arena);
+    while (mag->count < MOCHI_ARENA_BATCH_SIZE) {
+        void* obj = mochi_arena_pop(arena, full);
+        if (!obj) break;
+        mag->objs[mag->count++] = obj;
+    }
+    ARENA_UNLOCK(arena);
+}
+
+/* Moves num objects from the top of a magazine back to their blocks */
+static void mochi_arena_flush(mochi_arena_t                arena,
+                              struct mochi_arena_magazine* mag,
+                              size_t                       num)
+{
+    ARENA_LOCK(arena);
+    for (size_t i = 0; i < num; i++)
+        mochi_arena_push(arena, mag->objs[--mag->count]);
+    ARENA_UNLOCK(arena);
+}
+
+static inline void counter_incr(_Atomic size_t* counter)
+{
+    /* single writer, so no need for an atomic read-modify-write */
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+}
+
+static void* mochi_arena_try_get(mochi_arena_t arena, bool* full)
+{
+    void*                        obj = NULL;
+    struct mochi_arena_magazine* mag = mochi_arena_magazine(arena);
+    if (mag) {
+        if (mag->count == 0) mochi_arena_refill(arena, mag, full);
+        if (mag->count == 0) return NULL;
+        obj = mag->objs[--mag->count];
+        counter_incr(&mag->num_gets);
+    } else {
+        ARENA_LOCK(arena);
+        obj = mochi_arena_pop(arena, full);
+        if (obj) arena->num_gets++;
+        ARENA_UNLOCK(arena);
+    }
+    return obj;
+}
+
 void* mochi_arena_get(mochi_arena_t arena)
 {
     if (!arena) return NULL;
-    void* obj = NULL;
-    ABT_mutex_spinlock(ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
-    if (!arena->free_list && mochi_arena_grow(arena) != 0) {
-        ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
-        return NULL;
+    bool  full = false;
+    void* obj  = mochi_arena_try_get(arena, &full);
+    if (!obj && full)
+        atomic_fetch_add_explicit(&arena->num_full, 1, memory_order_relaxed);
+    if (obj) memset(obj, 0, arena->object_size);
+    return obj;
+}
+
+void* mochi_arena_get_wait(mochi_arena_t arena)
+{
+    if (!arena) return NULL;
+    if (!arena->wait_when_full) return mochi_arena_get(arena);
+    /* the arena has a limit, hence no magazines */
+    bool  full = false;
+    void* obj  = NULL;
+    ARENA_LOCK(arena);
+    obj = mochi_arena_pop(arena, &full);
+    if (!obj && full) {
+        atomic_fetch_add_explicit(&arena->num_full, 1, memory_order_relaxed);
+        arena->num_waiters++;
+        while (!obj && full) {
+            ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&arena->cond),
+                          ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
+            full = false;
+            obj  = mochi_arena_pop(arena, &full);
+        }
+        arena->num_waiters--;
     }
-    obj              = arena->free_list;
-    arena->free_list = *(void**)obj;
-    memset(obj, 0, arena->object_size);
-    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
+    if (obj) arena->num_gets++;
+    ARENA_UNLOCK(arena);
+    if (obj) memset(obj, 0, arena->object_size);
     return obj;
 }
 
 void mochi_arena_release(mochi_arena_t arena, void* obj)
 {
     if (!arena || !obj) return;
-    ABT_mutex_spinlock(ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
-    *(void**)obj     = arena->free_list;
-    arena->free_list = obj;
-    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&arena->mtx));
+    struct mochi_arena_magazine* mag = mochi_arena_magazine(arena);
+    if (mag) {
+        counter_incr(&mag->num_releases);
+        if (mag->count == MOCHI_ARENA_MAGAZINE_SIZE)
+            mochi_arena_flush(arena, mag, MOCHI_ARENA_BATCH_SIZE);
+        mag->objs[mag->count++] = obj;
+        return;
+    }
+    ARENA_LOCK(arena);
+    mochi_arena_push(arena, obj);
+    arena->num_releases++;
+    if (arena->num_waiters)
+        ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(&arena->cond));
+    ARENA_UNLOCK(arena);
+}
+
+void mochi_arena_set_limit(mochi_arena_t arena,
+                           size_t        max_objects,
+                           bool          wait_when_full)
+{
+    if (!arena) return;
+    ARENA_LOCK(arena);
+    arena->max_objects    = max_objects;
+    arena->wait_when_full = wait_when_full;
+    ARENA_UNLOCK(arena);
+}
+
+size_t mochi_arena_trim(mochi_arena_t arena)
+{
+    if (!arena) return 0;
+    size_t num_trimmed = 0;
+    bool   kept        = false;
+    ARENA_LOCK(arena);
+    struct mochi_arena_block** pb = &arena->blocks;
+    while (*pb) {
+        struct mochi_arena_block* block = *pb;
+        if (block->num_free != arena->block_capacity) {
+            pb = &block->next;
+            continue;
+        }
+        if (!kept) {
+            /* keep one free block to absorb small bursts */
+            kept = true;
+            pb   = &block->next;
+            continue;
+        }
+        *pb = block->next;
+        partial_unlink(arena, block);
+        block_free(arena, block);
+        arena->num_blocks--;
+        num_trimmed++;
+    }
+    arena->num_trimmed_blocks += num_trimmed;
+    ARENA_UNLOCK(arena);
+    return num_trimmed;
+}
+
+void mochi_arena_get_stats(mochi_arena_t arena, mochi_arena_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (!arena) return;
+    size_t num_gets = 0, num_releases = 0;
+    for (size_t i = 0; i < MOCHI_ARENA_MAX_XSTREAMS; i++) {
+        struct mochi_arena_magazine* mag = atomic_load_explicit(
+            &arena->magazines[i], memory_order_acquire);
+        if (!mag) continue;
+        num_gets += atomic_load_explicit(&mag->num_gets, memory_order_relaxed);
+        num_releases
+            += atomic_load_explicit(&mag->num_releases, memory_order_relaxed);
+    }
+    ARENA_LOCK(arena);
+    num_gets += arena->num_gets;
+    num_releases += arena->num_releases;
+    stats->num_blocks         = arena->num_blocks;
+    stats->peak_num_blocks    = arena->peak_num_blocks;
+    stats->num_trimmed_blocks = arena->num_trimmed_blocks;
+    stats->max_objects        = arena->max_objects;
+    ARENA_UNLOCK(arena);
+    /* the counters of the magazines are read without synchronization, so
+     * they may be slightly inconsistent */
+    size_t capacity = stats->num_blocks * arena->block_capacity;
+    stats->num_live = num_gets > num_releases ? num_gets - num_releases : 0;
+    if (stats->num_live > capacity) stats->num_live = capacity;
+    stats->num_free = capacity - stats->num_live;
+    stats->objects_per_block = arena->block_capacity;
+    stats->num_full
+        = atomic_load_explicit(&arena->num_full, memory_order_relaxed);
 }
 
 void mochi_arena_destroy(mochi_arena_t arena)
@@ -100,8 +440,10 @@ void mochi_arena_destroy(mochi_arena_t arena)
     struct mochi_arena_block* block = arena->blocks;
     while (block) {
         struct mochi_arena_block* next = block->next;
-        free(block);
+        block_free(arena, block);
         block = next;
     }
+    for (size_t i = 0; i < MOCHI_ARENA_MAX_XSTREAMS; i++)
+        free(arena->magazines[i]);
     free(arena);
 }
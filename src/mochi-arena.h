@@ -6,6 +6,7 @@
 #ifndef MOCHI_ARENA_H
 #define MOCHI_ARENA_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -18,17 +19,21 @@ typedef struct mochi_arena* mochi_arena_t;
 /**
  * @brief Create an arena that hands out fixed-size, zeroed objects of
  * object_size bytes. Memory is grabbed from the heap in blocks of
- * initial_capacity objects; when a block is exhausted another block of the
- * same size is allocated. Objects never move, so a pointer returned by
- * mochi_arena_get stays valid until it is released (and the underlying memory
- * stays valid until mochi_arena_destroy).
+ * initial_capacity objects; when all the blocks are exhausted another block of
+ * the same size is allocated. Objects never move, so a pointer returned by
+ * mochi_arena_get stays valid until it is released. Blocks are only given
+ * back to the heap by mochi_arena_trim (once all their objects are released)
+ * and by mochi_arena_destroy.
  *
  * object_size is clamped to at least sizeof(void*) (the free list is stored
  * in-place in unused objects) and rounded up for alignment. initial_capacity
  * is clamped to at least 1.
  *
- * get/release are thread-safe (guarded by an internal spinlock). create and
- * destroy are not meant to be called concurrently with get/release.
+ * get/release are thread-safe. Each execution stream caches a few free
+ * objects so that it rarely needs to take the arena's internal spinlock (see
+ * mochi-arena.c); callers outside of an execution stream always take it.
+ * create and destroy are not meant to be called concurrently with
+ * get/release.
  *
  * @param object_size Size in bytes of each object.
  * @param initial_capacity Number of objects per block.
@@ -39,16 +44,79 @@ mochi_arena_t mochi_arena_create(size_t object_size, size_t initial_capacity);
 
 /**
  * @brief Get a zeroed object from the arena. Returns NULL if memory could not
- * be allocated.
+ * be allocated or if the arena has reached its limit, without waiting.
  */
 void* mochi_arena_get(mochi_arena_t arena);
 
+/**
+ * @brief Same as mochi_arena_get, except that if the arena has reached its
+ * limit and was set to wait_when_full, the caller blocks on a condition
+ * variable until an object is released. The caller must be allowed to block
+ * (e.g. it must not be the ULT whose progress releases the objects).
+ */
+void* mochi_arena_get_wait(mochi_arena_t arena);
+
 /**
  * @brief Return an object previously obtained from this arena. The object must
  * not be used after this call.
  */
 void mochi_arena_release(mochi_arena_t arena, void* obj);
 
+/**
+ * @brief Bound the number of live objects of the arena (0 for no limit),
+ * regardless of the number of objects per block. When the limit is reached,
+ * mochi_arena_get returns NULL and, if wait_when_full is true,
+ * mochi_arena_get_wait waits until an object is released. Execution streams
+ * do not cache free objects in an arena that has a limit. Must be called
+ * before the first mochi_arena_get.
+ */
+void mochi_arena_set_limit(mochi_arena_t arena,
+                           size_t        max_objects,
+                           bool          wait_when_full);
+
+/* Functions used by an arena to obtain and give back its blocks. size is the
+ * same in both calls for a given block. */
+typedef struct mochi_arena_allocator {
+    void* (*alloc)(void* uargs, size_t size);
+    void (*free)(void* uargs, void* ptr, size_t size);
+    void* uargs;
+    /* if not 0, the number of objects per block is raised so that blocks
+     * fill a whole multiple of granularity bytes (e.g. a huge page) */
+    size_t granularity;
+} mochi_arena_allocator_t;
+
+/**
+ * @brief Make the arena allocate its blocks with the given allocator instead
+ * of malloc/free (NULL to go back to malloc/free). Must be called before the
+ * first mochi_arena_get, since the number of objects per block may change.
+ */
+void mochi_arena_set_allocator(mochi_arena_t                  arena,
+                               const mochi_arena_allocator_t* allocator);
+
+/**
+ * @brief Free the blocks whose objects are all free, except for one, and
+ * return the number of blocks freed. Objects cached by execution streams
+ * count as used, so their blocks are not freed.
+ */
+size_t mochi_arena_trim(mochi_arena_t arena);
+
+typedef struct mochi_arena_stats {
+    size_t num_live;           /* objects currently obtained by callers */
+    size_t num_free;           /* other objects in the allocated blocks */
+    size_t num_blocks;         /* blocks currently allocated */
+    size_t peak_num_blocks;    /* high-water mark of num_blocks */
+    size_t num_trimmed_blocks; /* blocks freed by mochi_arena_trim */
+    size_t num_full;           /* times mochi_arena_get hit the limit */
+    size_t objects_per_block;
+    size_t max_objects;        /* 0 for no limit */
+} mochi_arena_stats_t;
+
+/**
+ * @brief Fill stats with the arena's usage. The numbers of live and free
+ * objects are approximate while other threads use the arena.
+ */
+void mochi_arena_get_stats(mochi_arena_t arena, mochi_arena_stats_t* stats);
+
 /**
  * @brief Destroy the arena and free all its blocks. NULL-safe. Any object still
  * checked out becomes invalid.
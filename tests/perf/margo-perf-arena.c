@@ -0,0 +1,128 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark measuring the throughput of mochi_arena_get/release (used
+ * for the request and handle-data structures on every async forward and
+ * every received RPC) when 1 to 64 execution streams share an arena.
+ * Each ES runs one ULT that performs num_ops get/release pairs, keeping up
+ * to window objects checked out at a time so that the per-ES caches are
+ * regularly refilled and flushed.
+ * Usage: ./margo-perf-arena [num_ops] [window] (defaults to 1000000 and 48).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+#include "mochi-arena.h"
+
+#define MAX_XSTREAMS 64
+
+struct bench_args {
+    mochi_arena_t arena;
+    int           num_ops;
+    int           window;
+};
+
+static void arena_ult(void* arg)
+{
+    struct bench_args* args = (struct bench_args*)arg;
+    void**             objs = calloc(args->window, sizeof(*objs));
+    for (int i = 0; i < args->num_ops; i += args->window) {
+        for (int j = 0; j < args->window; j++)
+            objs[j] = mochi_arena_get(args->arena);
+        for (int j = 0; j < args->window; j++)
+            mochi_arena_release(args->arena, objs[j]);
+    }
+    free(objs);
+}
+
+static int run(int num_xstreams, int num_ops, int window)
+{
+    char*       config = malloc(256 + num_xstreams * 128);
+    size_t      len    = 0;
+    ABT_thread* ults   = calloc(num_xstreams, sizeof(*ults));
+    int         ret    = 0;
+
+    /* one pool and one ES per benchmark ULT */
+    len += sprintf(config + len, "{\"argobots\":{\"pools\":[");
+    for (int i = 0; i < num_xstreams; i++)
+        len += sprintf(config + len, "%s{\"name\":\"bench_%d\"}", i ? "," : "",
+                       i);
+    len += sprintf(config + len, "],\"xstreams\":[");
+    for (int i = 0; i < num_xstreams; i++)
+        len += sprintf(config + len,
+                       "%s{\"name\":\"es_%d\",\"scheduler\":{\"type\":"
+                       "\"basic_wait\",\"pools\":[\"bench_%d\"]}}",
+                       i ? "," : "", i, i);
+    sprintf(config + len, "]}}");
+
+    struct margo_init_info mii = {0};
+    mii.json_config            = config;
+    margo_instance_id mid = margo_init_ext("na+sm", MARGO_SERVER_MODE, &mii);
+    free(config);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init_ext()\n");
+        free(ults);
+        return -1;
+    }
+
+    struct bench_args args = {
+        .arena   = mochi_arena_create(64, 64),
+        .num_ops = num_ops,
+        .window  = window,
+    };
+
+    double t1 = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        char                   name[64];
+        struct margo_pool_info pool_info;
+        snprintf(name, sizeof(name), "bench_%d", i);
+        margo_find_pool_by_name(mid, name, &pool_info);
+        if (ABT_thread_create(pool_info.pool, arena_ult, &args,
+                              ABT_THREAD_ATTR_NULL, &ults[i])
+            != ABT_SUCCESS) {
+            fprintf(stderr, "Error: ABT_thread_create()\n");
+            num_xstreams = i;
+            ret          = -1;
+            break;
+        }
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+    }
+    double t2 = ABT_get_wtime();
+
+    if (ret == 0) {
+        /* a get and a release per operation */
+        double total_ops = 2.0 * num_xstreams * num_ops;
+        printf("%3d ES  %8.3f Mops/s\n", num_xstreams,
+               total_ops / (t2 - t1) / 1e6);
+    }
+
+    mochi_arena_destroy(args.arena);
+    margo_finalize(mid);
+    free(ults);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int num_ops = argc > 1 ? atoi(argv[1]) : 1000000;
+    int window  = argc > 2 ? atoi(argv[2]) : 48;
+    int ret     = 0;
+
+    if (num_ops <= 0 || window <= 0) {
+        fprintf(stderr, "Usage: %s [num_ops] [window]\n", argv[0]);
+        return -1;
+    }
+
+    for (int n = 1; n <= MAX_XSTREAMS && ret == 0; n *= 2)
+        ret = run(n, num_ops, window);
+
+    return ret;
+}
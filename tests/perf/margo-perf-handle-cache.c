@@ -0,0 +1,142 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark measuring the throughput of many ULTs running
+ * margo_create/margo_forward/margo_destroy loops (to the same process) on an
+ * increasing number of execution streams, which stresses the handle cache
+ * from which margo_create takes its handles and to which margo_destroy
+ * returns them.
+ * Usage: ./margo-perf-handle-cache [max_xstreams [ults_per_xstream
+ * [num_iterations]]] (defaults to 16 execution streams, 8 ULTs per execution
+ * stream, 1000 RPCs per ULT). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+
+DECLARE_MARGO_RPC_HANDLER(null_ult)
+static void null_ult(hg_handle_t handle)
+{
+    margo_respond(handle, NULL);
+    margo_destroy(handle);
+}
+DEFINE_MARGO_RPC_HANDLER(null_ult)
+
+struct client_args {
+    margo_instance_id mid;
+    hg_addr_t         addr;
+    hg_id_t           rpc_id;
+    int               num_iterations;
+    int               ret;
+};
+
+static void client_ult(void* arg)
+{
+    struct client_args* args = (struct client_args*)arg;
+    hg_handle_t         handle;
+
+    for (int i = 0; i < args->num_iterations; i++) {
+        hg_return_t hret
+            = margo_create(args->mid, args->addr, args->rpc_id, &handle);
+        if (hret != HG_SUCCESS) goto error;
+        hret = margo_forward(handle, NULL);
+        margo_destroy(handle);
+        if (hret != HG_SUCCESS) goto error;
+    }
+    return;
+
+error:
+    args->ret = -1;
+}
+
+static int run(int num_xstreams, int ults_per_xstream, int num_iterations)
+{
+    int                    num_ults = num_xstreams * ults_per_xstream;
+    char                   config[256];
+    struct margo_init_info init_info = {0};
+    struct client_args*    args      = calloc(num_ults, sizeof(*args));
+    ABT_thread*            ults      = calloc(num_ults, sizeof(*ults));
+    ABT_pool               pool      = ABT_POOL_NULL;
+    hg_addr_t              addr      = HG_ADDR_NULL;
+    hg_id_t                rpc_id;
+    int                    ret = 0;
+
+    /* the client ULTs run in the handler pool, next to the RPC handlers,
+     * with a cache large enough for all of them */
+    snprintf(config, sizeof(config),
+             "{\"use_progress_thread\":true,\"rpc_thread_count\":%d,"
+             "\"handle_cache_size\":%d}",
+             num_xstreams, 2 * num_ults);
+    init_info.json_config = config;
+
+    margo_instance_id mid
+        = margo_init_ext("na+sm", MARGO_SERVER_MODE, &init_info);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init_ext()\n");
+        free(ults);
+        free(args);
+        return -1;
+    }
+
+    rpc_id = MARGO_REGISTER(mid, "null_rpc", void, void, null_ult);
+    margo_get_handler_pool(mid, &pool);
+    if (margo_addr_self(mid, &addr) != HG_SUCCESS) {
+        fprintf(stderr, "Error: margo_addr_self()\n");
+        ret = -1;
+        goto finish;
+    }
+
+    double t1 = ABT_get_wtime();
+    for (int i = 0; i < num_ults; i++) {
+        args[i].mid            = mid;
+        args[i].addr           = addr;
+        args[i].rpc_id         = rpc_id;
+        args[i].num_iterations = num_iterations;
+        ABT_thread_create(pool, client_ult, &args[i], ABT_THREAD_ATTR_NULL,
+                          &ults[i]);
+    }
+    for (int i = 0; i < num_ults; i++) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+        if (args[i].ret != 0) ret = -1;
+    }
+    double t2 = ABT_get_wtime();
+
+    if (ret != 0)
+        fprintf(stderr, "Error: some RPCs failed\n");
+    else
+        printf("%3d ES  %4d ULTs  %10.1f RPC/s\n", num_xstreams, num_ults,
+               num_ults * num_iterations / (t2 - t1));
+
+finish:
+    if (addr != HG_ADDR_NULL) margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    free(ults);
+    free(args);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int max_xstreams     = argc > 1 ? atoi(argv[1]) : 16;
+    int ults_per_xstream = argc > 2 ? atoi(argv[2]) : 8;
+    int num_iterations   = argc > 3 ? atoi(argv[3]) : 1000;
+    int ret              = 0;
+
+    if (max_xstreams <= 0 || ults_per_xstream <= 0 || num_iterations <= 0) {
+        fprintf(stderr,
+                "Usage: %s [max_xstreams [ults_per_xstream "
+                "[num_iterations]]]\n",
+                argv[0]);
+        return -1;
+    }
+
+    for (int n = 1; n <= max_xstreams && ret == 0; n *= 2)
+        ret = run(n, ults_per_xstream, num_iterations);
+
+    return ret;
+}
@@ -0,0 +1,148 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark measuring the throughput of many client ULTs issuing
+ * margo_iforward concurrently (to the same process), which stresses the
+ * accounting done on every forward and completion, in particular when the
+ * progress loop only runs when needed.
+ * Usage: ./margo-perf-iforward [num_ults [num_xstreams [num_iterations]]]
+ * (defaults to 64 ULTs on 4 execution streams, 1000 RPCs per ULT). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+
+DECLARE_MARGO_RPC_HANDLER(null_ult)
+static void null_ult(hg_handle_t handle)
+{
+    margo_respond(handle, NULL);
+    margo_destroy(handle);
+}
+DEFINE_MARGO_RPC_HANDLER(null_ult)
+
+struct client_args {
+    margo_instance_id mid;
+    hg_addr_t         addr;
+    hg_id_t           rpc_id;
+    int               num_iterations;
+    int               ret;
+};
+
+static void client_ult(void* arg)
+{
+    struct client_args* args = (struct client_args*)arg;
+    hg_handle_t         handle;
+    margo_request       req;
+
+    for (int i = 0; i < args->num_iterations; i++) {
+        hg_return_t hret
+            = margo_create(args->mid, args->addr, args->rpc_id, &handle);
+        if (hret != HG_SUCCESS) goto error;
+        hret = margo_iforward(handle, NULL, &req);
+        if (hret == HG_SUCCESS) hret = margo_wait(req);
+        margo_destroy(handle);
+        if (hret != HG_SUCCESS) goto error;
+    }
+    return;
+
+error:
+    args->ret = -1;
+}
+
+static int run(margo_instance_id mid,
+               ABT_pool          pool,
+               hg_addr_t         addr,
+               hg_id_t           rpc_id,
+               int               num_ults,
+               int               num_iterations,
+               bool              when_needed)
+{
+    struct client_args* args = calloc(num_ults, sizeof(*args));
+    ABT_thread*         ults = calloc(num_ults, sizeof(*ults));
+    double              t1, t2;
+    int                 ret = 0;
+
+    margo_set_progress_when_needed(mid, when_needed);
+
+    t1 = ABT_get_wtime();
+    for (int i = 0; i < num_ults; i++) {
+        args[i].mid            = mid;
+        args[i].addr           = addr;
+        args[i].rpc_id         = rpc_id;
+        args[i].num_iterations = num_iterations;
+        ABT_thread_create(pool, client_ult, &args[i], ABT_THREAD_ATTR_NULL,
+                          &ults[i]);
+    }
+    for (int i = 0; i < num_ults; i++) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+        if (args[i].ret != 0) ret = -1;
+    }
+    t2 = ABT_get_wtime();
+
+    if (ret != 0)
+        fprintf(stderr, "Error: some RPCs failed\n");
+    else
+        printf("progress_when_needed=%d: %d ULTs x %d RPCs in %.3f s "
+               "(%.1f RPC/s)\n",
+               when_needed, num_ults, num_iterations, t2 - t1,
+               num_ults * num_iterations / (t2 - t1));
+
+    free(ults);
+    free(args);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int                    num_ults       = argc > 1 ? atoi(argv[1]) : 64;
+    int                    num_xstreams   = argc > 2 ? atoi(argv[2]) : 4;
+    int                    num_iterations = argc > 3 ? atoi(argv[3]) : 1000;
+    char                   config[256];
+    struct margo_init_info init_info = {0};
+    ABT_pool               pool      = ABT_POOL_NULL;
+    hg_addr_t              addr      = HG_ADDR_NULL;
+    hg_id_t                rpc_id;
+    int                    ret = 0;
+
+    if (num_ults <= 0 || num_xstreams <= 0 || num_iterations <= 0) {
+        fprintf(stderr,
+                "Usage: %s [num_ults [num_xstreams [num_iterations]]]\n",
+                argv[0]);
+        return -1;
+    }
+
+    /* the client ULTs run in the handler pool, next to the RPC handlers */
+    snprintf(config, sizeof(config),
+             "{\"use_progress_thread\":true,\"rpc_thread_count\":%d}",
+             num_xstreams);
+    init_info.json_config = config;
+
+    margo_instance_id mid
+        = margo_init_ext("na+sm", MARGO_SERVER_MODE, &init_info);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init_ext()\n");
+        return -1;
+    }
+
+    rpc_id = MARGO_REGISTER(mid, "null_rpc", void, void, null_ult);
+    margo_get_handler_pool(mid, &pool);
+    if (margo_addr_self(mid, &addr) != HG_SUCCESS) {
+        fprintf(stderr, "Error: margo_addr_self()\n");
+        ret = -1;
+        goto finish;
+    }
+
+    ret = run(mid, pool, addr, rpc_id, num_ults, num_iterations, false);
+    if (ret == 0)
+        ret = run(mid, pool, addr, rpc_id, num_ults, num_iterations, true);
+
+finish:
+    if (addr != HG_ADDR_NULL) margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    return ret;
+}
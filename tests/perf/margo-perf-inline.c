@@ -0,0 +1,120 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark comparing the latency of a short RPC handler executed in a
+ * ULT (default), inline in the progress loop, and in a tasklet (see
+ * margo_registered_set_inline). RPCs are sent to the same process.
+ * Usage: ./margo-perf-inline [num_iterations] (defaults to 10000). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+
+DECLARE_MARGO_RPC_HANDLER(null_ult)
+static void null_ult(hg_handle_t handle)
+{
+    /* inline handlers cannot wait for the response to complete */
+    margo_crespond(handle, NULL, NULL, NULL);
+    margo_destroy(handle);
+}
+DEFINE_MARGO_RPC_HANDLER(null_ult)
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int run(margo_instance_id   mid,
+               hg_addr_t           addr,
+               hg_id_t             rpc_id,
+               margo_inline_mode_t mode,
+               const char*         mode_name,
+               int                 num_iterations)
+{
+    double*     latencies = calloc(num_iterations, sizeof(*latencies));
+    double      total     = 0;
+    hg_handle_t handle;
+    hg_return_t hret;
+    int         ret = 0;
+
+    margo_registered_set_inline(mid, rpc_id, mode);
+
+    hret = margo_create(mid, addr, rpc_id, &handle);
+    if (hret != HG_SUCCESS) {
+        fprintf(stderr, "Error: margo_create()\n");
+        free(latencies);
+        return -1;
+    }
+
+    /* warmup */
+    margo_forward(handle, NULL);
+
+    for (int i = 0; i < num_iterations; i++) {
+        double t1 = ABT_get_wtime();
+        hret      = margo_forward(handle, NULL);
+        double t2 = ABT_get_wtime();
+        if (hret != HG_SUCCESS) {
+            fprintf(stderr, "Error: margo_forward()\n");
+            ret = -1;
+            goto finish;
+        }
+        latencies[i] = (t2 - t1) * 1e6;
+        total += latencies[i];
+    }
+
+    qsort(latencies, num_iterations, sizeof(*latencies), compare_doubles);
+    printf("%-8s avg %.2f us, median %.2f us, p99 %.2f us\n", mode_name,
+           total / num_iterations, latencies[num_iterations / 2],
+           latencies[(int)(num_iterations * 0.99)]);
+
+finish:
+    margo_destroy(handle);
+    free(latencies);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int       num_iterations = argc > 1 ? atoi(argv[1]) : 10000;
+    hg_addr_t addr           = HG_ADDR_NULL;
+    hg_id_t   rpc_id;
+    int       ret = 0;
+
+    if (num_iterations <= 0) {
+        fprintf(stderr, "Usage: %s [num_iterations]\n", argv[0]);
+        return -1;
+    }
+
+    /* the progress loop runs in its own execution stream so that the
+     * ULT mode is not penalized by sharing it with the client */
+    margo_instance_id mid = margo_init("na+sm", MARGO_SERVER_MODE, 1, 0);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init()\n");
+        return -1;
+    }
+
+    rpc_id = MARGO_REGISTER(mid, "null_rpc", void, void, null_ult);
+    if (margo_addr_self(mid, &addr) != HG_SUCCESS) {
+        fprintf(stderr, "Error: margo_addr_self()\n");
+        ret = -1;
+        goto finish;
+    }
+
+    ret = run(mid, addr, rpc_id, MARGO_INLINE_NONE, "ult", num_iterations);
+    if (ret == 0)
+        ret = run(mid, addr, rpc_id, MARGO_INLINE_TRIGGER, "trigger",
+                  num_iterations);
+    if (ret == 0)
+        ret = run(mid, addr, rpc_id, MARGO_INLINE_TASK, "tasklet",
+                  num_iterations);
+
+finish:
+    if (addr != HG_ADDR_NULL) margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    return ret;
+}
@@ -0,0 +1,107 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark measuring the push/pop throughput of the prio_wait,
+ * prio_wait_split and ws_wait pool kinds when 1 to 64 execution streams
+ * share the pool.
+ * Each ES count runs num_ults ULTs that yield num_yields times each (every
+ * yield pushes the ULT back into the pool and pops the next one).
+ * Usage: ./margo-perf-pool [num_ults] [num_yields] (defaults to 256 and 1000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+
+#define MAX_XSTREAMS 64
+
+static void yield_ult(void* arg)
+{
+    int num_yields = *(int*)arg;
+    for (int i = 0; i < num_yields; i++) ABT_thread_yield();
+}
+
+static int
+run(const char* kind, int num_xstreams, int num_ults, int num_yields)
+{
+    char*       config = malloc(256 + num_xstreams * 128);
+    size_t      len    = 0;
+    ABT_thread* ults   = calloc(num_ults, sizeof(*ults));
+    int         ret    = 0;
+
+    /* one pool shared by num_xstreams execution streams */
+    len += sprintf(config + len,
+                   "{\"argobots\":{\"pools\":[{\"name\":\"bench\","
+                   "\"kind\":\"%s\"}],\"xstreams\":[",
+                   kind);
+    for (int i = 0; i < num_xstreams; i++)
+        len += sprintf(config + len,
+                       "%s{\"name\":\"es_%d\",\"scheduler\":{\"type\":"
+                       "\"basic_wait\",\"pools\":[\"bench\"]}}",
+                       i ? "," : "", i);
+    sprintf(config + len, "]}}");
+
+    struct margo_init_info mii = {0};
+    mii.json_config            = config;
+    margo_instance_id mid = margo_init_ext("na+sm", MARGO_SERVER_MODE, &mii);
+    free(config);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init_ext()\n");
+        free(ults);
+        return -1;
+    }
+
+    struct margo_pool_info pool_info;
+    margo_find_pool_by_name(mid, "bench", &pool_info);
+
+    double t1 = ABT_get_wtime();
+    for (int i = 0; i < num_ults; i++) {
+        if (ABT_thread_create(pool_info.pool, yield_ult, &num_yields,
+                              ABT_THREAD_ATTR_NULL, &ults[i])
+            != ABT_SUCCESS) {
+            fprintf(stderr, "Error: ABT_thread_create()\n");
+            num_ults = i;
+            ret      = -1;
+            break;
+        }
+    }
+    for (int i = 0; i < num_ults; i++) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+    }
+    double t2 = ABT_get_wtime();
+
+    if (ret == 0) {
+        /* each ULT is pushed once when created and once per yield */
+        double num_ops = (double)num_ults * (num_yields + 1);
+        printf("%-16s %3d ES  %8.3f Mops/s\n", kind, num_xstreams,
+               num_ops / (t2 - t1) / 1e6);
+    }
+
+    margo_finalize(mid);
+    free(ults);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int num_ults   = argc > 1 ? atoi(argv[1]) : 256;
+    int num_yields = argc > 2 ? atoi(argv[2]) : 1000;
+    int ret        = 0;
+
+    if (num_ults <= 0 || num_yields < 0) {
+        fprintf(stderr, "Usage: %s [num_ults] [num_yields]\n", argv[0]);
+        return -1;
+    }
+
+    const char* kinds[] = {"prio_wait", "prio_wait_split", "ws_wait"};
+    for (int k = 0; k < 3 && ret == 0; k++)
+        for (int n = 1; n <= MAX_XSTREAMS && ret == 0; n *= 2)
+            ret = run(kinds[k], n, num_ults, num_yields);
+
+    return ret;
+}
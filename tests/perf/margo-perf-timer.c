@@ -0,0 +1,76 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+
+/* Microbenchmark measuring the cost of starting and canceling a large
+ * number of timers. Usage: ./margo-perf-timer [num_timers...]
+ * (defaults to 1000, 10000 and 100000 timers). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <abt.h>
+#include <margo.h>
+#include <margo-timer.h>
+
+static void timer_cb(void* arg) { (void)arg; }
+
+static int run(margo_instance_id mid, size_t num_timers)
+{
+    margo_timer_t* timers = calloc(num_timers, sizeof(*timers));
+    double         t1, t2, t3;
+    int            ret = 0;
+
+    for (size_t i = 0; i < num_timers; i++) {
+        ret = margo_timer_create_with_pool(mid, timer_cb, NULL, ABT_POOL_NULL,
+                                           &timers[i]);
+        if (ret != 0) {
+            fprintf(stderr, "Error: margo_timer_create_with_pool()\n");
+            goto finish;
+        }
+    }
+
+    /* timeouts are spread over 10 to 70 seconds so that no timer fires
+     * during the measurement */
+    t1 = ABT_get_wtime();
+    for (size_t i = 0; i < num_timers; i++)
+        margo_timer_start(timers[i], 10000.0 + (rand() % 60000));
+    t2 = ABT_get_wtime();
+    for (size_t i = 0; i < num_timers; i++) margo_timer_cancel(timers[i]);
+    t3 = ABT_get_wtime();
+
+    printf("%10zu timers: start %.3f us/timer, cancel %.3f us/timer\n",
+           num_timers, (t2 - t1) * 1e6 / num_timers,
+           (t3 - t2) * 1e6 / num_timers);
+
+finish:
+    for (size_t i = 0; i < num_timers; i++)
+        if (timers[i]) margo_timer_destroy(timers[i]);
+    free(timers);
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    size_t default_sizes[] = {1000, 10000, 100000};
+    int    ret             = 0;
+
+    margo_instance_id mid = margo_init("na+sm", MARGO_CLIENT_MODE, 0, 0);
+    if (mid == MARGO_INSTANCE_NULL) {
+        fprintf(stderr, "Error: margo_init()\n");
+        return -1;
+    }
+
+    srand(42);
+    if (argc > 1) {
+        for (int i = 1; i < argc && ret == 0; i++)
+            ret = run(mid, (size_t)atol(argv[i]));
+    } else {
+        for (size_t i = 0; i < 3 && ret == 0; i++)
+            ret = run(mid, default_sizes[i]);
+    }
+
+    margo_finalize(mid);
+    return ret;
+}
@@ -138,9 +138,378 @@ error:
     return MUNIT_FAIL;
 }
 
+struct edf_order {
+    int ids[3];
+    int count;
+};
+
+struct edf_arg {
+    struct edf_order* order;
+    int               id;
+};
+
+static void edf_thread_func(void* args) {
+    struct edf_arg* arg = (struct edf_arg*)args;
+    /* a single ES runs the pool, so no synchronization is needed */
+    arg->order->ids[arg->order->count++] = arg->id;
+}
+
+/* check that ULTs in an edf_wait pool run in order of their deadlines */
+static MunitResult edf_pool_order(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    struct edf_order order = {{0}, 0};
+    struct edf_arg args[3];
+    double timeouts_ms[3] = {3000.0, 1000.0, 2000.0};
+    ABT_thread ults[3];
+    hg_return_t hret;
+
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    /* no ES runs the pool yet, so the ULTs accumulate in it */
+    struct margo_pool_info pool_info = {0};
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"my_edf_pool\",\"kind\":\"edf_wait\"}", &pool_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 3; ++i) {
+        args[i].order = &order;
+        args[i].id    = i;
+        int ret = margo_thread_create_with_deadline(pool_info.pool,
+            edf_thread_func, &args[i], timeouts_ms[i], &ults[i]);
+        munit_assert_int(ret, ==, ABT_SUCCESS);
+    }
+
+    struct margo_xstream_info xstream_info = {0};
+    hret = margo_add_xstream_from_json(ctx->mid,
+        "{\"scheduler\":{\"type\":\"basic_wait\",\"pools\":[\"my_edf_pool\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 3; ++i) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+    }
+    munit_assert_int(order.count, ==, 3);
+    munit_assert_int(order.ids[0], ==, 1);
+    munit_assert_int(order.ids[1], ==, 2);
+    munit_assert_int(order.ids[2], ==, 0);
+
+    margo_finalize(ctx->mid);
+    return MUNIT_OK;
+}
+
+/* check that ULTs moved to another edf_wait pool keep their deadlines */
+static MunitResult edf_pool_order_after_move(const MunitParameter params[],
+                                             void*                data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    struct edf_order order = {{0}, 0};
+    struct edf_arg args[3];
+    double timeouts_ms[3] = {3000.0, 1000.0, 2000.0};
+    ABT_thread ults[3];
+    ABT_thread moved[3];
+    size_t num_moved = 0;
+    hg_return_t hret;
+
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    struct margo_pool_info from_info = {0}, to_info = {0};
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"edf_from\",\"kind\":\"edf_wait\"}", &from_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"edf_to\",\"kind\":\"edf_wait\"}", &to_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 3; ++i) {
+        args[i].order = &order;
+        args[i].id    = i;
+        int ret = margo_thread_create_with_deadline(from_info.pool,
+            edf_thread_func, &args[i], timeouts_ms[i], &ults[i]);
+        munit_assert_int(ret, ==, ABT_SUCCESS);
+    }
+
+    /* the units are re-created in the target pool without any hint */
+    munit_assert_int(ABT_pool_pop_threads(from_info.pool, moved, 3, &num_moved),
+                     ==, ABT_SUCCESS);
+    munit_assert_int(num_moved, ==, 3);
+    munit_assert_int(ABT_pool_push_threads(to_info.pool, moved, num_moved),
+                     ==, ABT_SUCCESS);
+
+    struct margo_xstream_info xstream_info = {0};
+    hret = margo_add_xstream_from_json(ctx->mid,
+        "{\"scheduler\":{\"type\":\"basic_wait\",\"pools\":[\"edf_to\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 3; ++i) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+    }
+    munit_assert_int(order.count, ==, 3);
+    munit_assert_int(order.ids[0], ==, 1);
+    munit_assert_int(order.ids[1], ==, 2);
+    munit_assert_int(order.ids[2], ==, 0);
+
+    margo_finalize(ctx->mid);
+    return MUNIT_OK;
+}
+
+/* provider ids of the RPCs in the order in which a wfq_wait pool ran them */
+static struct {
+    int ids[8];
+    int count;
+} wfq_order;
+
+DECLARE_MARGO_RPC_HANDLER(wfq_rpc_ult)
+static void wfq_rpc_ult(hg_handle_t handle)
+{
+    /* a single ES runs the pool, so no synchronization is needed */
+    wfq_order.ids[wfq_order.count++]
+        = margo_get_info(handle)->id & MARGO_MAX_PROVIDER_ID;
+    margo_respond(handle, NULL);
+    margo_destroy(handle);
+}
+DEFINE_MARGO_RPC_HANDLER(wfq_rpc_ult)
+
+/* check that a wfq_wait pool serves providers according to their weights */
+static MunitResult wfq_pool_share(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    hg_handle_t handles[8];
+    margo_request reqs[8];
+    hg_addr_t addr;
+    hg_return_t hret;
+
+    wfq_order.count = 0;
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    /* no ES runs the pool yet, so the RPCs accumulate in it */
+    struct margo_pool_info pool_info = {0};
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"my_wfq_pool\",\"kind\":\"wfq_wait\","
+        "\"weights\":{\"1\":3,\"2\":1}}", &pool_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    hg_id_t rpc_id = MARGO_REGISTER_PROVIDER(ctx->mid, "wfq_rpc", void, void,
+        wfq_rpc_ult, 1, pool_info.pool);
+    MARGO_REGISTER_PROVIDER(ctx->mid, "wfq_rpc", void, void,
+        wfq_rpc_ult, 2, pool_info.pool);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 8; ++i) {
+        hret = margo_create(ctx->mid, addr, rpc_id, &handles[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        hret = margo_provider_iforward(1 + i % 2, handles[i], NULL, &reqs[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+    }
+
+    /* wait for all the RPCs to be in the pool */
+    size_t pool_size = 0;
+    while(pool_size < 8) {
+        margo_thread_sleep(ctx->mid, 10);
+        ABT_pool_get_size(pool_info.pool, &pool_size);
+    }
+
+    struct margo_xstream_info xstream_info = {0};
+    hret = margo_add_xstream_from_json(ctx->mid,
+        "{\"scheduler\":{\"type\":\"basic_wait\",\"pools\":[\"my_wfq_pool\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 8; ++i) {
+        hret = margo_wait(reqs[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        margo_destroy(handles[i]);
+    }
+    margo_addr_free(ctx->mid, addr);
+
+    /* whichever provider is served first, the first round of the deficit
+     * round robin runs 3 RPCs of provider 1 for 1 RPC of provider 2 */
+    munit_assert_int(wfq_order.count, ==, 8);
+    int num_provider_1 = 0;
+    for(int i = 0; i < 4; ++i)
+        num_provider_1 += wfq_order.ids[i] == 1;
+    munit_assert_int(num_provider_1, ==, 3);
+
+    margo_finalize(ctx->mid);
+    return MUNIT_OK;
+}
+
+/* check that RPCs moved to another wfq_wait pool keep their provider keys */
+static MunitResult wfq_pool_share_after_move(const MunitParameter params[],
+                                             void*                data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    hg_handle_t handles[8];
+    margo_request reqs[8];
+    ABT_thread moved[8];
+    size_t num_moved = 0;
+    hg_addr_t addr;
+    hg_return_t hret;
+
+    wfq_order.count = 0;
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    struct margo_pool_info from_info = {0}, to_info = {0};
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"wfq_from\",\"kind\":\"wfq_wait\"}", &from_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"wfq_to\",\"kind\":\"wfq_wait\","
+        "\"weights\":{\"1\":3,\"2\":1}}", &to_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    hg_id_t rpc_id = MARGO_REGISTER_PROVIDER(ctx->mid, "wfq_rpc", void, void,
+        wfq_rpc_ult, 1, from_info.pool);
+    MARGO_REGISTER_PROVIDER(ctx->mid, "wfq_rpc", void, void,
+        wfq_rpc_ult, 2, from_info.pool);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 8; ++i) {
+        hret = margo_create(ctx->mid, addr, rpc_id, &handles[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        hret = margo_provider_iforward(1 + i % 2, handles[i], NULL, &reqs[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+    }
+
+    size_t pool_size = 0;
+    while(pool_size < 8) {
+        margo_thread_sleep(ctx->mid, 10);
+        ABT_pool_get_size(from_info.pool, &pool_size);
+    }
+
+    /* the units are re-created in the target pool without any hint, so
+     * without their keys they would all land in the same sub-queue */
+    munit_assert_int(ABT_pool_pop_threads(from_info.pool, moved, 8, &num_moved),
+                     ==, ABT_SUCCESS);
+    munit_assert_int(num_moved, ==, 8);
+    munit_assert_int(ABT_pool_push_threads(to_info.pool, moved, num_moved),
+                     ==, ABT_SUCCESS);
+
+    struct margo_xstream_info xstream_info = {0};
+    hret = margo_add_xstream_from_json(ctx->mid,
+        "{\"scheduler\":{\"type\":\"basic_wait\",\"pools\":[\"wfq_to\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 8; ++i) {
+        hret = margo_wait(reqs[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        margo_destroy(handles[i]);
+    }
+    margo_addr_free(ctx->mid, addr);
+
+    munit_assert_int(wfq_order.count, ==, 8);
+    int num_provider_1 = 0;
+    for(int i = 0; i < 4; ++i)
+        num_provider_1 += wfq_order.ids[i] == 1;
+    munit_assert_int(num_provider_1, ==, 3);
+
+    margo_finalize(ctx->mid);
+    return MUNIT_OK;
+}
+
+/* ids of the ULTs in the order in which an mlfq_wait pool ran them */
+static struct {
+    ABT_pool   pool;
+    ABT_thread short_ult;
+    char       ids[8];
+    int        count;
+} mlfq_order;
+
+static void mlfq_short_ult(void* args)
+{
+    (void)args;
+    mlfq_order.ids[mlfq_order.count++] = 'S';
+}
+
+static void mlfq_spawning_ult(void* args)
+{
+    (void)args;
+    mlfq_order.ids[mlfq_order.count++] = 'X';
+    ABT_thread_create(mlfq_order.pool, mlfq_short_ult, NULL,
+                      ABT_THREAD_ATTR_NULL, &mlfq_order.short_ult);
+}
+
+static void mlfq_yielding_ult(void* args)
+{
+    (void)args;
+    mlfq_order.ids[mlfq_order.count++] = 'B';
+    ABT_thread_yield();
+    mlfq_order.ids[mlfq_order.count++] = 'B';
+}
+
+/* check that a unit demoted by an mlfq_wait pool is overtaken by a unit
+ * pushed after it into a higher level */
+static MunitResult mlfq_pool_demotion(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    ABT_thread ults[2];
+    hg_return_t hret;
+
+    memset(&mlfq_order, 0, sizeof(mlfq_order));
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    /* no ES runs the pool yet, so the ULTs accumulate in it */
+    struct margo_pool_info pool_info = {0};
+    hret = margo_add_pool_from_json(ctx->mid,
+        "{\"name\":\"my_mlfq_pool\",\"kind\":\"mlfq_wait\","
+        "\"levels\":[{\"quantum\":8,\"demote_after\":1},{\"quantum\":1}],"
+        "\"boost_period_ms\":0}", &pool_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    mlfq_order.pool = pool_info.pool;
+
+    ABT_thread_create(pool_info.pool, mlfq_yielding_ult, NULL,
+                      ABT_THREAD_ATTR_NULL, &ults[0]);
+    ABT_thread_create(pool_info.pool, mlfq_spawning_ult, NULL,
+                      ABT_THREAD_ATTR_NULL, &ults[1]);
+
+    struct margo_xstream_info xstream_info = {0};
+    hret = margo_add_xstream_from_json(ctx->mid,
+        "{\"scheduler\":{\"type\":\"basic_wait\",\"pools\":[\"my_mlfq_pool\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for(int i = 0; i < 2; ++i) {
+        ABT_thread_join(ults[i]);
+        ABT_thread_free(&ults[i]);
+    }
+    ABT_thread_join(mlfq_order.short_ult);
+    ABT_thread_free(&mlfq_order.short_ult);
+
+    /* B yields and is demoted, so S (created by X afterwards) runs first,
+     * whereas a FIFO pool would have run "BXBS" */
+    munit_assert_int(mlfq_order.count, ==, 4);
+    munit_assert_memory_equal(4, mlfq_order.ids, "BXSB");
+
+    margo_finalize(ctx->mid);
+    return MUNIT_OK;
+}
+
 static char* pool_params[] = {
     "prio_wait",
+    "prio_wait_split",
     "earliest_first",
+    "edf_wait",
+    "wfq_wait",
+    "mlfq_wait",
+    "ws_wait",
     NULL
 };
 
@@ -151,6 +520,11 @@ static MunitParameterEnum rpc_pool_kind_params[] = {
 
 static MunitTest tests[] = {
     { "/rpc-pool-kind", rpc_pool_kind, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, rpc_pool_kind_params},
+    { "/edf-pool-order", edf_pool_order, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/edf-pool-order-after-move", edf_pool_order_after_move, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/wfq-pool-share", wfq_pool_share, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/wfq-pool-share-after-move", wfq_pool_share_after_move, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/mlfq-pool-demotion", mlfq_pool_demotion, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
     { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
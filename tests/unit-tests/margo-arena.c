@@ -0,0 +1,311 @@
+/*
+ * (C) 2026 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <stdio.h>
+#include <margo.h>
+#include "munit/munit.h"
+/* NOTE: this is testing internal capabilities in Margo; not exposed to
+ * end-users normally
+ */
+#include "../../src/mochi-arena.h"
+
+#define OBJECTS_PER_BLOCK 4
+
+struct test_context {
+    margo_instance_id mid;
+    mochi_arena_t     arena;
+};
+
+static void* test_context_setup(const MunitParameter params[], void* user_data)
+{
+    (void)params;
+    (void)user_data;
+    struct test_context* ctx = calloc(1, sizeof(*ctx));
+
+    /* margo initializes Argobots, which the arena relies on */
+    ctx->mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(ctx->mid);
+
+    ctx->arena = mochi_arena_create(64, OBJECTS_PER_BLOCK);
+    munit_assert_not_null(ctx->arena);
+
+    return ctx;
+}
+
+static void test_context_tear_down(void* fixture)
+{
+    struct test_context* ctx = (struct test_context*)fixture;
+    mochi_arena_destroy(ctx->arena);
+    margo_finalize(ctx->mid);
+    free(ctx);
+}
+
+static MunitResult test_arena_limit(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[2 * OBJECTS_PER_BLOCK];
+    mochi_arena_stats_t  stats;
+
+    mochi_arena_set_limit(ctx->arena, 2 * OBJECTS_PER_BLOCK, false);
+
+    for (int i = 0; i < 2 * OBJECTS_PER_BLOCK; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    /* no object may hide in a per-ES cache, so the limit is exact */
+    munit_assert_null(mochi_arena_get(ctx->arena));
+    munit_assert_null(mochi_arena_get_wait(ctx->arena));
+
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, 2 * OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.num_free, ==, 0);
+    munit_assert_size(stats.num_blocks, ==, 2);
+    munit_assert_size(stats.num_full, ==, 2);
+    munit_assert_size(stats.objects_per_block, ==, OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.max_objects, ==, 2 * OBJECTS_PER_BLOCK);
+
+    /* a released object can be obtained again */
+    mochi_arena_release(ctx->arena, objs[0]);
+    objs[0] = mochi_arena_get(ctx->arena);
+    munit_assert_not_null(objs[0]);
+
+    for (int i = 0; i < 2 * OBJECTS_PER_BLOCK; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, 0);
+    munit_assert_size(stats.num_free, ==, 2 * OBJECTS_PER_BLOCK);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_arena_limit_partial(const MunitParameter params[],
+                                            void*                data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[OBJECTS_PER_BLOCK + 1];
+    mochi_arena_stats_t  stats;
+
+    /* the limit is not a multiple of the number of objects per block */
+    mochi_arena_set_limit(ctx->arena, OBJECTS_PER_BLOCK + 1, false);
+
+    for (int i = 0; i < OBJECTS_PER_BLOCK + 1; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    munit_assert_null(mochi_arena_get(ctx->arena));
+
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, OBJECTS_PER_BLOCK + 1);
+    munit_assert_size(stats.num_blocks, ==, 2);
+    munit_assert_size(stats.num_full, ==, 1);
+    munit_assert_size(stats.max_objects, ==, OBJECTS_PER_BLOCK + 1);
+
+    for (int i = 0; i < OBJECTS_PER_BLOCK + 1; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+
+    return MUNIT_OK;
+}
+
+static void* granule_alloc(void* uargs, size_t size)
+{
+    (void)uargs;
+    return malloc(size);
+}
+
+static void granule_free(void* uargs, void* ptr, size_t size)
+{
+    (void)uargs;
+    (void)size;
+    free(ptr);
+}
+
+static MunitResult test_arena_limit_granularity(const MunitParameter params[],
+                                                void*                data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[OBJECTS_PER_BLOCK];
+    mochi_arena_stats_t  stats;
+
+    /* blocks filling a huge page hold thousands of objects, which must not
+     * loosen the limit */
+    mochi_arena_allocator_t allocator = {.alloc       = granule_alloc,
+                                         .free        = granule_free,
+                                         .uargs       = NULL,
+                                         .granularity = 2 * 1024 * 1024};
+    mochi_arena_set_allocator(ctx->arena, &allocator);
+    mochi_arena_set_limit(ctx->arena, OBJECTS_PER_BLOCK, false);
+
+    for (int i = 0; i < OBJECTS_PER_BLOCK; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    munit_assert_null(mochi_arena_get(ctx->arena));
+
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.objects_per_block, >, OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.num_blocks, ==, 1);
+    munit_assert_size(stats.num_live, ==, OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.max_objects, ==, OBJECTS_PER_BLOCK);
+
+    for (int i = 0; i < OBJECTS_PER_BLOCK; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_arena_trim(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[4 * OBJECTS_PER_BLOCK];
+    mochi_arena_stats_t  stats;
+
+    mochi_arena_set_limit(ctx->arena, 4 * OBJECTS_PER_BLOCK, false);
+
+    for (int i = 0; i < 4 * OBJECTS_PER_BLOCK; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    /* nothing to trim while every block has live objects */
+    munit_assert_size(mochi_arena_trim(ctx->arena), ==, 0);
+
+    for (int i = 0; i < 4 * OBJECTS_PER_BLOCK; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+
+    /* one free block is kept */
+    munit_assert_size(mochi_arena_trim(ctx->arena), ==, 3);
+    munit_assert_size(mochi_arena_trim(ctx->arena), ==, 0);
+
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_blocks, ==, 1);
+    munit_assert_size(stats.peak_num_blocks, ==, 4);
+    munit_assert_size(stats.num_trimmed_blocks, ==, 3);
+    munit_assert_size(stats.num_live, ==, 0);
+    munit_assert_size(stats.num_free, ==, OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.num_full, ==, 0);
+
+    /* the arena grows back up to its limit */
+    for (int i = 0; i < 4 * OBJECTS_PER_BLOCK; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    munit_assert_null(mochi_arena_get(ctx->arena));
+    for (int i = 0; i < 4 * OBJECTS_PER_BLOCK; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_arena_unlimited(const MunitParameter params[],
+                                        void*                data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[64];
+    mochi_arena_stats_t  stats;
+
+    for (int i = 0; i < 64; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, 64);
+    munit_assert_size(stats.max_objects, ==, 0);
+
+    for (int i = 0; i < 64; i++) mochi_arena_release(ctx->arena, objs[i]);
+    /* objects cached by the ES keep their blocks alive, the others go */
+    size_t num_trimmed = mochi_arena_trim(ctx->arena);
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, 0);
+    munit_assert_size(stats.num_trimmed_blocks, ==, num_trimmed);
+    munit_assert_size(stats.num_blocks + num_trimmed, ==,
+                      stats.peak_num_blocks);
+    munit_assert_size(stats.num_full, ==, 0);
+
+    return MUNIT_OK;
+}
+
+struct waiter_args {
+    mochi_arena_t arena;
+    void*         obj;
+};
+
+static void waiter_fn(void* arg)
+{
+    struct waiter_args* args = (struct waiter_args*)arg;
+    args->obj                = mochi_arena_get_wait(args->arena);
+}
+
+static MunitResult test_arena_wait(const MunitParameter params[], void* data)
+{
+    (void)params;
+    struct test_context* ctx = (struct test_context*)data;
+    void*                objs[OBJECTS_PER_BLOCK];
+    struct waiter_args   args = {.arena = ctx->arena, .obj = NULL};
+    mochi_arena_stats_t  stats;
+    ABT_pool             pool;
+    ABT_thread           waiter;
+    int                  ret;
+
+    mochi_arena_set_limit(ctx->arena, OBJECTS_PER_BLOCK, true);
+
+    for (int i = 0; i < OBJECTS_PER_BLOCK; i++) {
+        objs[i] = mochi_arena_get(ctx->arena);
+        munit_assert_not_null(objs[i]);
+    }
+    /* mochi_arena_get never waits */
+    munit_assert_null(mochi_arena_get(ctx->arena));
+
+    ret = margo_get_handler_pool(ctx->mid, &pool);
+    munit_assert_int(ret, ==, 0);
+    ret = ABT_thread_create(pool, waiter_fn, &args, ABT_THREAD_ATTR_NULL,
+                            &waiter);
+    munit_assert_int(ret, ==, ABT_SUCCESS);
+
+    /* let the waiter block on the full arena */
+    margo_thread_sleep(ctx->mid, 100);
+    munit_assert_null(args.obj);
+
+    mochi_arena_release(ctx->arena, objs[0]);
+    ABT_thread_join(waiter);
+    ABT_thread_free(&waiter);
+    munit_assert_ptr_equal(args.obj, objs[0]);
+
+    mochi_arena_get_stats(ctx->arena, &stats);
+    munit_assert_size(stats.num_live, ==, OBJECTS_PER_BLOCK);
+    munit_assert_size(stats.num_full, ==, 2);
+
+    objs[0] = args.obj;
+    for (int i = 0; i < OBJECTS_PER_BLOCK; i++)
+        mochi_arena_release(ctx->arena, objs[i]);
+
+    return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {(char*)"/limit", test_arena_limit, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/limit_partial", test_arena_limit_partial, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/limit_granularity", test_arena_limit_granularity,
+     test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/trim", test_arena_trim, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/unlimited", test_arena_unlimited, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char*)"/wait", test_arena_wait, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+static const MunitSuite test_suite = {(char*)"/margo/arena", test_suite_tests,
+                                      NULL, 1, MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)])
+{
+    return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -653,6 +653,154 @@ static MunitResult remove_xstream(const MunitParameter params[], void* data)
     return MUNIT_OK;
 }
 
+static int ult_order[10];
+static int ult_order_len = 0;
+
+static void record_ult(void* arg)
+{
+    ult_order[ult_order_len++] = (int)(intptr_t)arg;
+}
+
+static MunitResult rebalance_pools(const MunitParameter params[], void* data)
+{
+    (void)params;
+    (void)data;
+
+    margo_instance_id mid = margo_init("na+sm", MARGO_SERVER_MODE, 0, 0);
+    munit_assert_not_null(mid);
+
+    hg_return_t ret;
+    ABT_pool    handler_pool;
+    margo_get_handler_pool(mid, &handler_pool);
+
+    // two pools that are not run by any ES
+    struct margo_pool_info origin = {0}, target = {0};
+    ret = margo_add_pool_from_json(mid, "{\"name\":\"origin\"}", &origin);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+    ret = margo_add_pool_from_json(mid, "{\"name\":\"target\"}", &target);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+
+    ABT_thread ults[10];
+    for (intptr_t i = 0; i < 10; i++)
+        ABT_thread_create(origin.pool, record_ult, (void*)i,
+                          ABT_THREAD_ATTR_NULL, &ults[i]);
+
+    // move half of the ULTs
+    struct margo_rebalance_options options = MARGO_REBALANCE_OPTIONS_DEFAULT;
+    options.fraction       = 0.5;
+    options.batch_size     = 2;
+    options.preserve_order = true;
+    size_t num_moved       = 0;
+    ret = margo_rebalance_pools(mid, origin.pool, target.pool, &options,
+                                &num_moved);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+    munit_assert_int(num_moved, ==, 5);
+    size_t size = 0;
+    ABT_pool_get_size(origin.pool, &size);
+    munit_assert_int(size, ==, 5);
+    ABT_pool_get_size(target.pool, &size);
+    munit_assert_int(size, ==, 5);
+
+    // failing cases: invalid fraction, same pool
+    options.fraction = 0.0;
+    ret = margo_rebalance_pools(mid, origin.pool, target.pool, &options,
+                                &num_moved);
+    munit_assert_int(ret, ==, HG_INVALID_ARG);
+    ret = margo_rebalance_pools(mid, origin.pool, origin.pool, NULL,
+                                &num_moved);
+    munit_assert_int(ret, ==, HG_INVALID_ARG);
+
+    // drain both pools into the handler pool, the ULTs run in order
+    options.fraction = 1.0;
+    ret = margo_rebalance_pools(mid, target.pool, handler_pool, &options,
+                                &num_moved);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+    munit_assert_int(num_moved, ==, 5);
+    ret = margo_rebalance_pools(mid, origin.pool, handler_pool, &options,
+                                &num_moved);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+    munit_assert_int(num_moved, ==, 5);
+    for (int i = 0; i < 10; i++) ABT_thread_free(&ults[i]);
+    munit_assert_int(ult_order_len, ==, 10);
+    for (int i = 0; i < 10; i++) munit_assert_int(ult_order[i], ==, i);
+
+    margo_finalize(mid);
+    return MUNIT_OK;
+}
+
+static void busy_ult(void* arg)
+{
+    double duration = *(double*)arg;
+    double start    = ABT_get_wtime();
+    while (ABT_get_wtime() - start < duration) {}
+}
+
+static MunitResult autoscaler(const MunitParameter params[], void* data)
+{
+    (void)params;
+    (void)data;
+
+    const char* config = "{"
+        "\"argobots\":{\"pools\":[{\"name\":\"my_rpc_pool\"}]},"
+        "\"rpc_pool\":\"my_rpc_pool\","
+        "\"autoscaler\":{\"min_xstreams\":1,\"max_xstreams\":3,"
+        "\"target_latency_ms\":1,\"sample_interval_ms\":5}}";
+    struct margo_init_info info = {0};
+    info.json_config = config;
+    margo_instance_id mid = margo_init_ext("na+sm", MARGO_SERVER_MODE, &info);
+    munit_assert_not_null(mid);
+
+    hg_return_t ret;
+    struct margo_xstream_info xstream_info = {0};
+    struct margo_pool_info    pool_info    = {0};
+
+    // the autoscaler started an ES for the rpc pool, which had none
+    ret = margo_find_xstream(mid, "__autoscaled_my_rpc_pool_0__", &xstream_info);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+    ret = margo_find_pool(mid, "my_rpc_pool", &pool_info);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+
+    char* cfg = margo_get_config(mid);
+    munit_assert_not_null(strstr(cfg, "\"autoscaler\""));
+    free(cfg);
+
+    // keep the pool busy so that it grows to max_xstreams
+    double     duration = 0.5;
+    ABT_thread ults[8];
+    for (unsigned i = 0; i < 8; i++)
+        ABT_thread_create(pool_info.pool, busy_ult, &duration,
+                          ABT_THREAD_ATTR_NULL, &ults[i]);
+    double start = ABT_get_wtime();
+    while (margo_find_xstream(mid, "__autoscaled_my_rpc_pool_2__",
+                              &xstream_info) != HG_SUCCESS
+           && ABT_get_wtime() - start < 2.0)
+        margo_thread_sleep(mid, 5);
+    munit_assert_int(margo_find_xstream(mid, "__autoscaled_my_rpc_pool_2__",
+                                        &xstream_info), ==, HG_SUCCESS);
+    // it should never go above max_xstreams
+    ret = margo_find_xstream(mid, "__autoscaled_my_rpc_pool_3__", &xstream_info);
+    munit_assert_int(ret, !=, HG_SUCCESS);
+    for (unsigned i = 0; i < 8; i++) ABT_thread_free(&ults[i]);
+
+    // an ES it added may be removed by hand, which must not prevent it from
+    // removing the others (it may also have removed this one already)
+    margo_remove_xstream_by_name(mid, "__autoscaled_my_rpc_pool_2__");
+
+    // once idle, it shrinks back to min_xstreams
+    start = ABT_get_wtime();
+    while (margo_find_xstream(mid, "__autoscaled_my_rpc_pool_1__",
+                              &xstream_info) == HG_SUCCESS
+           && ABT_get_wtime() - start < 2.0)
+        margo_thread_sleep(mid, 5);
+    ret = margo_find_xstream(mid, "__autoscaled_my_rpc_pool_1__", &xstream_info);
+    munit_assert_int(ret, !=, HG_SUCCESS);
+    ret = margo_find_xstream(mid, "__autoscaled_my_rpc_pool_0__", &xstream_info);
+    munit_assert_int(ret, ==, HG_SUCCESS);
+
+    margo_finalize(mid);
+    return MUNIT_OK;
+}
+
 static MunitTest tests[] = {
     { "/add_pool_from_json", add_pool_from_json, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
     { "/add_pool_external", add_pool_external, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
@@ -660,6 +808,8 @@ static MunitTest tests[] = {
     { "/add_xstream_from_json", add_xstream_from_json, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
     { "/add_xstream_external", add_xstream_external, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
     { "/remove_xstream", remove_xstream, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/rebalance_pools", rebalance_pools, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
+    { "/autoscaler", autoscaler, test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE, NULL},
     { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -4,13 +4,17 @@
  * See COPYRIGHT in top-level directory.
  */
 #include <stdio.h>
+#include <json-c/json.h>
 #include <margo.h>
 #include <margo-hg-shim.h>
+#include <margo-multi.h>
 #include <mercury_proc_string.h>
 #include <mercury_macros.h>
 #include "helper-server.h"
 #include "munit/munit.h"
 #include "munit/munit-goto.h"
+/* NOTE: the handle cache counters are internal to Margo */
+#include "../../src/margo-handle-cache.h"
 
 #define P(__msg__) printf("%s\n", __msg__); fflush(stdout)
 
@@ -37,6 +41,28 @@ static void rpc_respond_timed_ult(hg_handle_t handle)
 }
 DEFINE_MARGO_RPC_HANDLER(rpc_respond_timed_ult)
 
+DECLARE_MARGO_RPC_HANDLER(crespond_ult)
+static void crespond_ult(hg_handle_t handle)
+{
+    margo_crespond(handle, NULL, NULL, NULL);
+    margo_destroy(handle);
+    return;
+}
+DEFINE_MARGO_RPC_HANDLER(crespond_ult)
+
+DECLARE_MARGO_RPC_HANDLER(get_deadline_ult)
+static void get_deadline_ult(hg_handle_t handle)
+{
+    double  remaining_ms;
+    int32_t out = -1;
+    if (margo_get_deadline(handle, &remaining_ms) == HG_SUCCESS)
+        out = (int32_t)remaining_ms;
+    margo_respond(handle, &out);
+    margo_destroy(handle);
+    return;
+}
+DEFINE_MARGO_RPC_HANDLER(get_deadline_ult)
+
 DECLARE_MARGO_RPC_HANDLER(get_name_ult)
 static void get_name_ult(hg_handle_t handle)
 {
@@ -64,16 +90,30 @@ static void sum_ult(hg_handle_t handle)
 }
 DEFINE_MARGO_RPC_HANDLER(sum_ult)
 
+DECLARE_MARGO_RPC_HANDLER(slow_rpc_ult)
+static void slow_rpc_ult(hg_handle_t handle)
+{
+    margo_thread_sleep(margo_hg_handle_get_instance(handle), 1000);
+    margo_respond(handle, NULL);
+    margo_destroy(handle);
+    return;
+}
+DEFINE_MARGO_RPC_HANDLER(slow_rpc_ult)
+
 
 static int svr_init_fn(margo_instance_id mid, void* arg)
 {
     (void)arg;
+    margo_enable_relay(mid);
     MARGO_REGISTER(mid, "rpc", void, void, rpc_ult);
     MARGO_REGISTER(mid, "rpc_respond_timed", void, void, rpc_respond_timed_ult);
     MARGO_REGISTER(mid, "sum", sum_in_t, int32_t, sum_ult);
     MARGO_REGISTER(mid, "null_rpc", void, void, NULL);
     MARGO_REGISTER_PROVIDER(mid, "provider_rpc", void, void, rpc_ult, 42, ABT_POOL_NULL);
     MARGO_REGISTER(mid, "get_name", void, hg_string_t, get_name_ult);
+    /* provider 1 is a slow replica of provider 2 */
+    MARGO_REGISTER_PROVIDER(mid, "hedged_rpc", void, void, slow_rpc_ult, 1, ABT_POOL_NULL);
+    MARGO_REGISTER_PROVIDER(mid, "hedged_rpc", void, void, rpc_ult, 2, ABT_POOL_NULL);
     return (0);
 }
 
@@ -91,12 +131,15 @@ static void* test_context_setup(const MunitParameter params[], void* user_data)
 
     const char* protocol         = munit_parameters_get(params, "protocol");
     const char* progress_pool    = munit_parameters_get(params, "progress_pool");
+    const char* progress_policy  = munit_parameters_get(params, "progress_policy");
     hg_size_t   remote_addr_size = 256;
+    if(!progress_policy) progress_policy = "spindown";
 
     char config[4096];
     const char* config_fmt = "{"
           "\"rpc_pool\":\"p\","
           "\"progress_pool\":\"p\","
+          "\"progress_policy\":\"%s\","
           "\"argobots\": {"
               "\"pools\": ["
                   "{ \"name\":\"p\", \"kind\":\"%s\" }"
@@ -108,7 +151,7 @@ static void* test_context_setup(const MunitParameter params[], void* user_data)
               "],"
           "}"
       "}";
-    sprintf(config, config_fmt, progress_pool);
+    sprintf(config, config_fmt, progress_policy, progress_pool);
 
     struct margo_init_info init_info = {0};
     init_info.json_config = config;
@@ -150,8 +193,6 @@ static void test_context_tear_down(void* fixture)
 static MunitResult test_forward(const MunitParameter params[],
                                 void*                data)
 {
-    (void)params;
-    (void)data;
     hg_return_t hret[5] = {0,0,0,0,0};
     hg_handle_t handle = HG_HANDLE_NULL;
     hg_addr_t   addr = HG_ADDR_NULL;
@@ -179,12 +220,309 @@ cleanup:
     munit_assert_int_goto(hret[2], ==, HG_SUCCESS, error);
     munit_assert_int_goto(hret[3], ==, HG_SUCCESS, error);
     munit_assert_int_goto(hret[4], ==, HG_SUCCESS, error);
+
+    // the configuration reports the progress policy and, if it is adaptive,
+    // its current decision
+    const char* progress_policy = munit_parameters_get(params, "progress_policy");
+    if(!progress_policy) return MUNIT_OK;
+    char* config_str = margo_get_config(ctx->mid);
+    struct json_object* config = json_tokener_parse(config_str);
+    free(config_str);
+    munit_assert_not_null_goto(config, error);
+    munit_assert_string_equal(
+        json_object_get_string(json_object_object_get(config, "progress_policy")),
+        progress_policy);
+    struct json_object* state = json_object_object_get(
+        json_object_object_get(config, "progress_policy_state"), "state");
+    if(strcmp(progress_policy, "adaptive") == 0) {
+        const char* s = json_object_get_string(state);
+        munit_assert_not_null(s);
+        munit_assert_true(strcmp(s, "spin") == 0 || strcmp(s, "poll") == 0
+                          || strcmp(s, "block") == 0);
+    } else {
+        munit_assert_null(state);
+    }
+    json_object_put(config);
     return MUNIT_OK;
 
 error:
     return MUNIT_FAIL;
 }
 
+static MunitResult test_self_forward_inline(const MunitParameter params[],
+                                            void*                data)
+{
+    (void)params;
+    struct test_context* ctx    = (struct test_context*)data;
+    hg_handle_t          handle = HG_HANDLE_NULL;
+    hg_addr_t            addr   = HG_ADDR_NULL;
+    hg_return_t          hret;
+    margo_inline_mode_t  mode;
+    margo_inline_mode_t  modes[]
+        = {MARGO_INLINE_NONE, MARGO_INLINE_TRIGGER, MARGO_INLINE_TASK};
+
+    hg_id_t rpc_id
+        = MARGO_REGISTER(ctx->mid, "crespond_rpc", void, void, crespond_ult);
+
+    hret = margo_registered_get_inline(ctx->mid, rpc_id, &mode);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    munit_assert_int(mode, ==, MARGO_INLINE_NONE);
+
+    hret = margo_registered_set_inline(ctx->mid, rpc_id,
+                                       (margo_inline_mode_t)42);
+    munit_assert_int(hret, ==, HG_INVALID_ARG);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    for (unsigned i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        hret = margo_registered_set_inline(ctx->mid, rpc_id, modes[i]);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        hret = margo_registered_get_inline(ctx->mid, rpc_id, &mode);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        munit_assert_int(mode, ==, modes[i]);
+
+        hret = margo_create(ctx->mid, addr, rpc_id, &handle);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        hret = margo_forward(handle, NULL);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+        hret = margo_destroy(handle);
+        munit_assert_int(hret, ==, HG_SUCCESS);
+    }
+
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_OK;
+}
+
+static MunitResult test_self_forward_busy(const MunitParameter params[],
+                                          void*                data)
+{
+    (void)params;
+    struct test_context*      ctx     = (struct test_context*)data;
+    hg_handle_t               handle1 = HG_HANDLE_NULL;
+    hg_handle_t               handle2 = HG_HANDLE_NULL;
+    hg_addr_t                 addr    = HG_ADDR_NULL;
+    margo_request             req     = MARGO_REQUEST_NULL;
+    struct margo_pool_info    pool_info;
+    struct margo_xstream_info xstream_info;
+    hg_return_t               hret;
+    unsigned                  max_depth;
+
+    hg_id_t rpc_id
+        = MARGO_REGISTER(ctx->mid, "crespond_rpc", void, void, crespond_ult);
+
+    hret = margo_registered_get_max_queue_depth(ctx->mid, rpc_id, &max_depth);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    munit_assert_uint(max_depth, ==, 0);
+
+    hret = margo_registered_set_max_queue_depth(ctx->mid, rpc_id, 1);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_registered_get_max_queue_depth(ctx->mid, rpc_id, &max_depth);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    munit_assert_uint(max_depth, ==, 1);
+
+    /* no execution stream runs this pool yet, so RPCs stay queued in it */
+    hret = margo_add_pool_from_json(
+        ctx->mid, "{\"name\":\"busy_pool\",\"kind\":\"fifo_wait\"}",
+        &pool_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_rpc_set_pool(ctx->mid, rpc_id, pool_info.pool);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    hret = margo_create(ctx->mid, addr, rpc_id, &handle1);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_iforward(handle1, NULL, &req);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    /* the second RPC exceeds the limit and is rejected */
+    hret = margo_create(ctx->mid, addr, rpc_id, &handle2);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_forward(handle2, NULL);
+    munit_assert_int(hret, ==, HG_BUSY);
+
+    /* the first one completes once its pool is run */
+    hret = margo_add_xstream_from_json(
+        ctx->mid, "{\"scheduler\":{\"pools\":[\"busy_pool\"]}}",
+        &xstream_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_wait(req);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    /* and further RPCs are accepted again */
+    hret = margo_forward(handle2, NULL);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    margo_destroy(handle1);
+    margo_destroy(handle2);
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_OK;
+}
+
+/* Pool that refuses every unit, so that dispatching an RPC to it fails */
+static ABT_unit_type reject_unit_get_type(ABT_unit unit)
+{
+    (void)unit;
+    return ABT_UNIT_TYPE_THREAD;
+}
+static ABT_thread reject_unit_get_thread(ABT_unit unit)
+{
+    (void)unit;
+    return ABT_THREAD_NULL;
+}
+static ABT_task reject_unit_get_task(ABT_unit unit)
+{
+    (void)unit;
+    return ABT_TASK_NULL;
+}
+static ABT_bool reject_unit_is_in_pool(ABT_unit unit)
+{
+    (void)unit;
+    return ABT_FALSE;
+}
+static ABT_unit reject_unit_create_from_thread(ABT_thread thread)
+{
+    (void)thread;
+    return ABT_UNIT_NULL;
+}
+static ABT_unit reject_unit_create_from_task(ABT_task task)
+{
+    (void)task;
+    return ABT_UNIT_NULL;
+}
+static void reject_unit_free(ABT_unit* unit) { (void)unit; }
+static int  reject_pool_init(ABT_pool pool, ABT_pool_config config)
+{
+    (void)pool;
+    (void)config;
+    return ABT_SUCCESS;
+}
+static size_t reject_pool_get_size(ABT_pool pool)
+{
+    (void)pool;
+    return 0;
+}
+static void reject_pool_push(ABT_pool pool, ABT_unit unit)
+{
+    (void)pool;
+    (void)unit;
+}
+static ABT_unit reject_pool_pop(ABT_pool pool)
+{
+    (void)pool;
+    return ABT_UNIT_NULL;
+}
+static int reject_pool_remove(ABT_pool pool, ABT_unit unit)
+{
+    (void)pool;
+    (void)unit;
+    return ABT_SUCCESS;
+}
+static int reject_pool_free(ABT_pool pool)
+{
+    (void)pool;
+    return ABT_SUCCESS;
+}
+
+static MunitResult test_self_forward_dispatch_error(const MunitParameter params[],
+                                                    void*                data)
+{
+    (void)params;
+    struct test_context*   ctx    = (struct test_context*)data;
+    hg_handle_t            handle = HG_HANDLE_NULL;
+    hg_addr_t              addr   = HG_ADDR_NULL;
+    ABT_pool               pool   = ABT_POOL_NULL;
+    struct margo_pool_info pool_info;
+    hg_return_t            hret;
+    ABT_pool_def           def = {
+        .access               = ABT_POOL_ACCESS_MPMC,
+        .u_get_type           = reject_unit_get_type,
+        .u_get_thread         = reject_unit_get_thread,
+        .u_get_task           = reject_unit_get_task,
+        .u_is_in_pool         = reject_unit_is_in_pool,
+        .u_create_from_thread = reject_unit_create_from_thread,
+        .u_create_from_task   = reject_unit_create_from_task,
+        .u_free               = reject_unit_free,
+        .p_init               = reject_pool_init,
+        .p_get_size           = reject_pool_get_size,
+        .p_push               = reject_pool_push,
+        .p_pop                = reject_pool_pop,
+        .p_remove             = reject_pool_remove,
+        .p_free               = reject_pool_free,
+    };
+
+    hg_id_t rpc_id
+        = MARGO_REGISTER(ctx->mid, "crespond_rpc", void, void, crespond_ult);
+    hret = margo_registered_set_max_queue_depth(ctx->mid, rpc_id, 1);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    munit_assert_int(ABT_pool_create(&def, ABT_POOL_CONFIG_NULL, &pool), ==,
+                     ABT_SUCCESS);
+    hret = margo_add_pool_external(ctx->mid, "reject_pool", pool, ABT_TRUE,
+                                   &pool_info);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_rpc_set_pool(ctx->mid, rpc_id, pool_info.pool);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_create(ctx->mid, addr, rpc_id, &handle);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    /* every RPC fails to be dispatched, but gives its queue slot back, so the
+     * ones after the first are not rejected with HG_BUSY */
+    for (int i = 0; i < 3; i++) {
+        hret = margo_forward_timed(handle, NULL, 2000.0);
+        munit_assert_int(hret, ==, HG_OTHER_ERROR);
+    }
+
+    margo_destroy(handle);
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_OK;
+}
+
+static MunitResult test_self_forward_deadline(const MunitParameter params[],
+                                              void*                data)
+{
+    (void)params;
+    struct test_context* ctx    = (struct test_context*)data;
+    hg_handle_t          handle = HG_HANDLE_NULL;
+    hg_addr_t            addr   = HG_ADDR_NULL;
+    hg_return_t          hret;
+    int32_t              remaining_ms;
+
+    hg_id_t rpc_id = MARGO_REGISTER(ctx->mid, "get_deadline_rpc", void,
+                                    int32_t, get_deadline_ult);
+
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_create(ctx->mid, addr, rpc_id, &handle);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+
+    /* no timeout, no deadline */
+    hret = margo_forward(handle, NULL);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_get_output(handle, &remaining_ms);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    munit_assert_int(remaining_ms, ==, -1);
+    margo_free_output(handle, &remaining_ms);
+
+    /* the handler sees what is left of the client's timeout */
+    hret = margo_forward_timed(handle, NULL, 30000.0);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    hret = margo_get_output(handle, &remaining_ms);
+    munit_assert_int(hret, ==, HG_SUCCESS);
+    munit_assert_int(remaining_ms, >, 0);
+    munit_assert_int(remaining_ms, <=, 30000);
+    margo_free_output(handle, &remaining_ms);
+
+    margo_destroy(handle);
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_OK;
+}
+
 static MunitResult test_respond_timed(const MunitParameter params[],
                                       void*                data)
 {
@@ -339,6 +677,240 @@ error:
     return MUNIT_FAIL;
 }
 
+static MunitResult test_forward_multi(const MunitParameter params[],
+                                      void*                data)
+{
+    (void)params;
+    hg_return_t           hret = HG_SUCCESS;
+    hg_addr_t             addr = HG_ADDR_NULL;
+    hg_addr_t             addrs[5];
+    margo_multi_request_t req  = MARGO_MULTI_REQUEST_NULL;
+    sum_in_t              in   = {42, 58};
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    hg_id_t rpc_id = MARGO_REGISTER(ctx->mid, "sum", sum_in_t, int32_t, NULL);
+
+    hret = margo_addr_lookup(ctx->mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(int i = 0; i < 5; i++) addrs[i] = addr;
+
+    // every destination gets the same input and sends its own output
+    hret = margo_forward_multi(ctx->mid, rpc_id, 5, addrs, NULL, &in, NULL, &req);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(size_t i = 0; i < 5; i++) {
+        munit_assert_int_goto(margo_multi_get_status(req, i), ==, HG_SUCCESS, error);
+        hg_handle_t h = margo_multi_get_handle(req, i);
+        munit_assert_not_null_goto(h, error);
+        int32_t out = 0;
+        hret = margo_get_output(h, &out);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_int_goto(out, ==, 100, error);
+        margo_free_output(h, &out);
+    }
+    hret = margo_multi_request_free(req);
+    req = MARGO_MULTI_REQUEST_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // relayed through a tree of fanout 2, only statuses come back
+    struct margo_forward_multi_options options = {
+        .timeout_ms = 10000.0, .relay_fanout = 2};
+    hret = margo_iforward_multi(ctx->mid, rpc_id, 5, addrs, NULL, &in, &options, &req);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    hret = margo_multi_wait(req);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(size_t i = 0; i < 5; i++) {
+        munit_assert_int_goto(margo_multi_get_status(req, i), ==, HG_SUCCESS, error);
+        munit_assert_null_goto(margo_multi_get_handle(req, i), error);
+    }
+    hret = margo_multi_request_free(req);
+    req = MARGO_MULTI_REQUEST_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // destinations with a provider id, sent directly and relayed (the relays
+    // forward to themselves with the provider id muxed in the RPC id)
+    uint16_t provider_ids[5] = {42, 42, 42, 42, 42};
+    hg_id_t provider_rpc_id
+        = MARGO_REGISTER(ctx->mid, "provider_rpc", void, void, NULL);
+    for(unsigned fanout = 0; fanout < 3; fanout += 2) {
+        options.relay_fanout = fanout;
+        hret = margo_forward_multi(ctx->mid, provider_rpc_id, 5, addrs,
+                                   provider_ids, NULL, &options, &req);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        for(size_t i = 0; i < 5; i++)
+            munit_assert_int_goto(margo_multi_get_status(req, i), ==, HG_SUCCESS, error);
+        hret = margo_multi_request_free(req);
+        req = MARGO_MULTI_REQUEST_NULL;
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+
+    // no provider 43 on the server, every destination fails
+    for(size_t i = 0; i < 5; i++) provider_ids[i] = 43;
+    options.timeout_ms = 2000.0;
+    for(unsigned fanout = 0; fanout < 3; fanout += 2) {
+        options.relay_fanout = fanout;
+        hret = margo_forward_multi(ctx->mid, provider_rpc_id, 5, addrs,
+                                   provider_ids, NULL, &options, &req);
+        munit_assert_int_goto(hret, !=, HG_SUCCESS, error);
+        for(size_t i = 0; i < 5; i++)
+            munit_assert_int_goto(margo_multi_get_status(req, i), !=, HG_SUCCESS, error);
+        margo_multi_request_free(req);
+        req = MARGO_MULTI_REQUEST_NULL;
+    }
+
+    // the client instance has not enabled relaying, so it refuses it
+    hret = margo_addr_free(ctx->mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    hret = margo_addr_self(ctx->mid, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(int i = 0; i < 5; i++) addrs[i] = addr;
+    options.relay_fanout = 2;
+    hret = margo_forward_multi(ctx->mid, rpc_id, 5, addrs, NULL, &in,
+                               &options, &req);
+    munit_assert_int_goto(hret, ==, HG_PERMISSION, error);
+    for(size_t i = 0; i < 5; i++)
+        munit_assert_int_goto(margo_multi_get_status(req, i), ==, HG_PERMISSION, error);
+    hret = margo_multi_request_free(req);
+    req = MARGO_MULTI_REQUEST_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    hret = margo_addr_free(ctx->mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    return MUNIT_OK;
+
+error:
+    if(req) margo_multi_request_free(req);
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_FAIL;
+}
+
+/* Reads one of the counters reported by the default monitor */
+static size_t handle_cache_stat(margo_instance_id mid, const char* name)
+{
+    struct json_object* stats = __margo_handle_cache_stats_to_json(mid);
+    size_t value = json_object_get_uint64(json_object_object_get(stats, name));
+    json_object_put(stats);
+    return value;
+}
+
+static MunitResult test_forward_hedged(const MunitParameter params[],
+                                       void*                data)
+{
+    (void)params;
+    hg_return_t   hret   = HG_SUCCESS;
+    hg_addr_t     addr   = HG_ADDR_NULL;
+    hg_addr_t     addrs[3];
+    hg_handle_t   handle = HG_HANDLE_NULL;
+    margo_hedge_t hedge  = MARGO_HEDGE_NULL;
+    sum_in_t      in     = {42, 58};
+    size_t        index  = 3;
+    double        delay  = 0.0;
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    hg_id_t rpc_id = MARGO_REGISTER(ctx->mid, "sum", sum_in_t, int32_t, NULL);
+
+    hret = margo_addr_lookup(ctx->mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(int i = 0; i < 3; i++) addrs[i] = addr;
+
+    // a long initial delay, the first replica answers before any hedging
+    struct margo_hedge_options options = {.initial_delay_ms = 10000.0};
+    hret = margo_hedge_create(ctx->mid, &options, &hedge);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    for(int i = 0; i < 10; i++) {
+        hret = margo_forward_hedged(hedge, rpc_id, 3, addrs, NULL, &in, 0,
+                                    &handle, &index);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_size_goto(index, ==, 0, error);
+        int32_t out = 0;
+        hret = margo_get_output(handle, &out);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_int_goto(out, ==, 100, error);
+        margo_free_output(handle, &out);
+        margo_destroy(handle);
+        handle = HG_HANDLE_NULL;
+    }
+
+    // the delay now comes from the latencies of the calls above
+    hret = margo_hedge_get_delay(hedge, addr, MARGO_DEFAULT_PROVIDER_ID, &delay);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_double_goto(delay, <, 10000.0, error);
+
+    hret = margo_hedge_destroy(hedge);
+    hedge = MARGO_HEDGE_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // first-of-N: all replicas are sent the RPC right away
+    options.initial_replicas = 3;
+    hret = margo_hedge_create(ctx->mid, &options, &hedge);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    hret = margo_forward_hedged(hedge, rpc_id, 3, addrs, NULL, &in, 10000.0,
+                                &handle, &index);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_size_goto(index, <, 3, error);
+    int32_t out = 0;
+    hret = margo_get_output(handle, &out);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_int_goto(out, ==, 100, error);
+    margo_free_output(handle, &out);
+    margo_destroy(handle);
+    handle = HG_HANDLE_NULL;
+
+    hret = margo_hedge_destroy(hedge);
+    hedge = MARGO_HEDGE_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // the first replica takes 1s, so the timer sends the RPC to the second
+    // one after 50ms, which wins; the first RPC is then canceled and its
+    // handle destroyed
+    uint16_t provider_ids[2] = {1, 2};
+    hg_id_t hedged_rpc_id
+        = MARGO_REGISTER(ctx->mid, "hedged_rpc", void, void, NULL);
+    options = (struct margo_hedge_options){.initial_delay_ms = 50.0};
+    hret = margo_hedge_create(ctx->mid, &options, &hedge);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    size_t in_use = handle_cache_stat(ctx->mid, "in_use");
+    double start  = ABT_get_wtime();
+    hret = margo_forward_hedged(hedge, hedged_rpc_id, 2, addrs, provider_ids,
+                                NULL, 0, &handle, &index);
+    double elapsed_ms = (ABT_get_wtime() - start) * 1000.0;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_size_goto(index, ==, 1, error);
+    munit_assert_double_goto(elapsed_ms, <, 900.0, error);
+    munit_assert_size_goto(handle_cache_stat(ctx->mid, "in_use"), ==,
+                           in_use + 1, error);
+    margo_destroy(handle);
+    handle = HG_HANDLE_NULL;
+    munit_assert_size_goto(handle_cache_stat(ctx->mid, "in_use"), ==, in_use,
+                           error);
+
+    // a single sample of the slow replica, its delay is still the initial one
+    hret = margo_hedge_get_delay(hedge, addr, 1, &delay);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_double_goto(delay, ==, 50.0, error);
+
+    hret = margo_hedge_destroy(hedge);
+    hedge = MARGO_HEDGE_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    hret = margo_addr_free(ctx->mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    return MUNIT_OK;
+
+error:
+    if(handle) margo_destroy(handle);
+    if(hedge) margo_hedge_destroy(hedge);
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_FAIL;
+}
+
 static MunitResult test_get_name(const MunitParameter params[],
                                  void*                data)
 {
@@ -442,6 +1014,361 @@ error:
     return MUNIT_FAIL;
 }
 
+static MunitResult test_completion_queue(const MunitParameter params[],
+                                         void*                data)
+{
+    (void)params;
+    hg_return_t   hret = HG_SUCCESS;
+    hg_addr_t     addr = HG_ADDR_NULL;
+    margo_cq_t    cq   = MARGO_CQ_NULL;
+    hg_handle_t   handles[16];
+    margo_request reqs[16];
+    margo_request completed[4];
+    void*         uargs[4];
+    size_t        indices[16];
+    int           seen[16] = {0};
+    size_t        count, total = 0, index;
+    memset(handles, 0, 16*sizeof(hg_handle_t));
+    memset(reqs, 0, 16*sizeof(margo_request));
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    hg_id_t rpc_id = MARGO_REGISTER(ctx->mid, "rpc", void, void, NULL);
+
+    hret = margo_addr_lookup(ctx->mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    for(int i=0; i < 16; i++) {
+        hret = margo_create(ctx->mid, addr, rpc_id, &handles[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+
+    // requests are retrieved from the completion queue as they complete
+    hret = margo_cq_create(ctx->mid, &cq);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(int i=0; i < 16; i++) {
+        hret = margo_iforward(handles[i], NULL, &reqs[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        hret = margo_cq_add(cq, reqs[i], (void*)(intptr_t)i);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+    hret = margo_cq_add(cq, reqs[0], NULL);
+    munit_assert_int_goto(hret, ==, HG_INVALID_ARG, error);
+    while(total < 16) {
+        hret = margo_cq_wait(cq, 4, completed, uargs, &count);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_int_goto(count, >, 0, error);
+        for(size_t j=0; j < count; j++) {
+            intptr_t i = (intptr_t)uargs[j];
+            munit_assert_ptr_equal_goto(completed[j], reqs[i], error);
+            munit_assert_int_goto(seen[i], ==, 0, error);
+            seen[i] = 1;
+            hret = margo_wait(reqs[i]);
+            reqs[i] = MARGO_REQUEST_NULL;
+            munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        }
+        total += count;
+    }
+    // the queue is empty and has no request left
+    hret = margo_cq_wait(cq, 4, completed, uargs, &count);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_int_goto(count, ==, 0, error);
+    hret = margo_cq_poll(cq, 4, completed, uargs, &count);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_int_goto(count, ==, 0, error);
+    hret = margo_cq_destroy(cq);
+    cq = MARGO_CQ_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // margo_wait_any, margo_wait_some, and margo_wait_all
+    for(int i=0; i < 16; i++) {
+        hret = margo_iforward(handles[i], NULL, &reqs[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+    hret = margo_wait_any(16, reqs, &index);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_size_goto(index, <, 16, error);
+    reqs[index] = MARGO_REQUEST_NULL;
+    hret = margo_wait_some(16, reqs, &count, indices, NULL);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_int_goto(count, >, 0, error);
+    for(size_t j=0; j < count; j++)
+        munit_assert_ptr_null_goto(reqs[indices[j]], error);
+    hret = margo_wait_all(16, reqs, NULL);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    hret = margo_wait_any(16, reqs, &index);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_size_goto(index, ==, 16, error);
+
+    // margo_wait_any and margo_wait_some on requests in a completion queue
+    // take them out of the queue
+    hret = margo_cq_create(ctx->mid, &cq);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    for(int i=0; i < 4; i++) {
+        hret = margo_iforward(handles[i], NULL, &reqs[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        hret = margo_cq_add(cq, reqs[i], (void*)(intptr_t)i);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+    hret = margo_wait_any(4, reqs, &index);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_size_goto(index, <, 4, error);
+    reqs[index] = MARGO_REQUEST_NULL;
+    total = 1;
+    while(total < 4) {
+        hret = margo_wait_some(4, reqs, &count, indices, NULL);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_int_goto(count, >, 0, error);
+        total += count;
+    }
+    munit_assert_size_goto(total, ==, 4, error);
+    hret = margo_cq_poll(cq, 4, completed, uargs, &count);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    munit_assert_int_goto(count, ==, 0, error);
+    hret = margo_cq_destroy(cq);
+    cq = MARGO_CQ_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    for(int i=0; i < 16; i++) {
+        hret = margo_destroy(handles[i]);
+        handles[i] = HG_HANDLE_NULL;
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+
+    hret = margo_addr_free(ctx->mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    return MUNIT_OK;
+
+error:
+    margo_addr_free(ctx->mid, addr);
+    return MUNIT_FAIL;
+}
+
+static MunitResult test_affine_handle_cache(const MunitParameter params[],
+                                            void*                data)
+{
+    (void)params;
+    hg_return_t hret   = HG_SUCCESS;
+    hg_addr_t   addr   = HG_ADDR_NULL;
+    hg_handle_t handle = HG_HANDLE_NULL;
+    hg_handle_t prev   = HG_HANDLE_NULL;
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    // client instance keeping one handle bound to its destination
+    const char* protocol = munit_parameters_get(params, "protocol");
+    struct margo_init_info init_info = {0};
+    init_info.json_config = "{\"handle_cache_affinity_size\":1}";
+    margo_instance_id mid
+        = margo_init_ext(protocol, MARGO_CLIENT_MODE, &init_info);
+    munit_assert_not_null(mid);
+
+    hg_id_t rpc_id = MARGO_REGISTER(mid, "rpc", void, void, NULL);
+    hg_id_t provider_rpc_id
+        = MARGO_REGISTER(mid, "provider_rpc", void, void, NULL);
+
+    hret = margo_addr_lookup(mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    // the same destination gets the same handle back
+    for(int i = 0; i < 4; i++) {
+        hret = margo_create(mid, addr, provider_rpc_id, &handle);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        if(i > 0) munit_assert_ptr_equal_goto(handle, prev, error);
+        hret = margo_provider_forward(42, handle, NULL);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        prev = handle;
+        hret = margo_destroy(handle);
+        handle = HG_HANDLE_NULL;
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+
+    // alternating between two RPCs evicts the parked handle every time,
+    // and a reused handle must be reset for its new RPC
+    for(int i = 0; i < 4; i++) {
+        hg_id_t id = i % 2 ? provider_rpc_id : rpc_id;
+        hret = margo_create(mid, addr, id, &handle);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        if(i % 2)
+            hret = margo_provider_forward(42, handle, NULL);
+        else
+            hret = margo_forward(handle, NULL);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        hret = margo_destroy(handle);
+        handle = HG_HANDLE_NULL;
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+
+    hret = margo_addr_free(mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    margo_finalize(mid);
+    return MUNIT_OK;
+
+error:
+    margo_destroy(handle);
+    margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    return MUNIT_FAIL;
+}
+
+static MunitResult test_progress_contexts(const MunitParameter params[],
+                                          void*                data)
+{
+    (void)params;
+    hg_return_t   hret = HG_SUCCESS;
+    hg_addr_t     addr = HG_ADDR_NULL;
+    hg_handle_t   handles[4] = {0};
+    margo_request reqs[4];
+    bool          used[2] = {false, false};
+    sum_in_t      in = {42, 58};
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    // client instance driving 2 Mercury contexts, its handles are spread
+    // across both of them
+    const char* protocol = munit_parameters_get(params, "protocol");
+    struct margo_init_info init_info = {0};
+    init_info.json_config = "{\"progress_contexts\":2}";
+    margo_instance_id mid
+        = margo_init_ext(protocol, MARGO_CLIENT_MODE, &init_info);
+    munit_assert_not_null(mid);
+
+    hg_id_t rpc_id = MARGO_REGISTER(mid, "sum", sum_in_t, int32_t, NULL);
+
+    hret = margo_addr_lookup(mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    for(int i = 0; i < 4; i++) {
+        hret = margo_create(mid, addr, rpc_id, &handles[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        uint8_t context_id = margo_get_info(handles[i])->context_id;
+        munit_assert_int_goto(context_id, <, 2, error);
+        used[context_id] = true;
+        hret = margo_iforward(handles[i], &in, &reqs[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+    munit_assert_true_goto(used[0] && used[1], error);
+
+    for(int i = 0; i < 4; i++) {
+        hret = margo_wait(reqs[i]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        int32_t out = 0;
+        hret = margo_get_output(handles[i], &out);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        munit_assert_int_goto(out, ==, 100, error);
+        margo_free_output(handles[i], &out);
+        margo_destroy(handles[i]);
+        handles[i] = HG_HANDLE_NULL;
+    }
+
+    hret = margo_addr_free(mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    margo_finalize(mid);
+    return MUNIT_OK;
+
+error:
+    for(int i = 0; i < 4; i++)
+        if(handles[i]) margo_destroy(handles[i]);
+    margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    return MUNIT_FAIL;
+}
+
+static MunitResult test_tuned_handle_cache(const MunitParameter params[],
+                                           void*                data)
+{
+    (void)params;
+    hg_return_t hret = HG_SUCCESS;
+    hg_addr_t   addr = HG_ADDR_NULL;
+    hg_handle_t handles[6];
+    size_t      num_handles = 0;
+
+    struct test_context* ctx = (struct test_context*)data;
+
+    // client instance whose cache starts with 2 handles, grows by 2 after
+    // 2 misses and is checked for shrinking every 50ms
+    const char* protocol = munit_parameters_get(params, "protocol");
+    struct margo_init_info init_info = {0};
+    init_info.json_config
+        = "{\"handle_cache_size\":2,\"handle_cache_tuning\":{"
+          "\"max_size\":8,\"grow_batch\":2,\"miss_threshold\":2,"
+          "\"shrink_interval_ms\":50}}";
+    margo_instance_id mid
+        = margo_init_ext(protocol, MARGO_CLIENT_MODE, &init_info);
+    munit_assert_not_null(mid);
+
+    hg_id_t rpc_id = MARGO_REGISTER(mid, "rpc", void, void, NULL);
+
+    hret = margo_addr_lookup(mid, ctx->remote_addr, &addr);
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    size_t hits   = handle_cache_stat(mid, "num_hits");
+    size_t misses = handle_cache_stat(mid, "num_misses");
+    munit_assert_size_goto(handle_cache_stat(mid, "size"), ==, 2, error);
+
+    // 2 hits empty the cache, the next 2 calls miss it and make it grow
+    for(int i = 0; i < 4; i++) {
+        hret = margo_create(mid, addr, rpc_id, &handles[num_handles]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        num_handles++;
+    }
+    munit_assert_size_goto(handle_cache_stat(mid, "num_hits"), ==, hits + 2,
+                           error);
+    munit_assert_size_goto(handle_cache_stat(mid, "num_misses"), ==,
+                           misses + 2, error);
+    munit_assert_size_goto(handle_cache_stat(mid, "in_use"), ==, 4, error);
+
+    // the cache grows in the background
+    for(int i = 0; i < 100 && handle_cache_stat(mid, "size") < 4; i++)
+        margo_thread_sleep(mid, 10);
+    munit_assert_size_goto(handle_cache_stat(mid, "size"), ==, 4, error);
+    munit_assert_size_goto(handle_cache_stat(mid, "num_grown"), ==, 2, error);
+
+    // the new handles are hits
+    for(int i = 0; i < 2; i++) {
+        hret = margo_create(mid, addr, rpc_id, &handles[num_handles]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+        num_handles++;
+    }
+    munit_assert_size_goto(handle_cache_stat(mid, "num_hits"), ==, hits + 4,
+                           error);
+    munit_assert_size_goto(handle_cache_stat(mid, "num_misses"), ==,
+                           misses + 2, error);
+    munit_assert_size_goto(handle_cache_stat(mid, "peak_in_use"), >=, 6,
+                           error);
+
+    while(num_handles) {
+        hret = margo_destroy(handles[--num_handles]);
+        munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+    }
+    munit_assert_size_goto(handle_cache_stat(mid, "in_use"), ==, 0, error);
+
+    // once idle, the cache shrinks back to its initial size
+    for(int i = 0; i < 200 && handle_cache_stat(mid, "size") > 2; i++)
+        margo_thread_sleep(mid, 10);
+    munit_assert_size_goto(handle_cache_stat(mid, "size"), ==, 2, error);
+    munit_assert_size_goto(handle_cache_stat(mid, "num_shrunk"), ==, 2, error);
+
+    hret = margo_addr_free(mid, addr);
+    addr = HG_ADDR_NULL;
+    munit_assert_int_goto(hret, ==, HG_SUCCESS, error);
+
+    margo_finalize(mid);
+    return MUNIT_OK;
+
+error:
+    while(num_handles) margo_destroy(handles[--num_handles]);
+    margo_addr_free(mid, addr);
+    margo_finalize(mid);
+    return MUNIT_FAIL;
+}
+
 static MunitResult test_forward_to_null(const MunitParameter params[],
                                         void*                data)
 {
@@ -726,7 +1653,7 @@ error:
 }
 
 static char* protocol_params[] = {"na+sm", NULL};
-static char* progress_pool_params[] = {"fifo_wait", "prio_wait", "earliest_first", NULL};
+static char* progress_pool_params[] = {"fifo_wait", "prio_wait", "prio_wait_split", "earliest_first", "edf_wait", "wfq_wait", "mlfq_wait", "ws_wait", NULL};
 static char* progress_when_needed_params[] = {"true", "false", NULL};
 
 static MunitParameterEnum test_params[]
@@ -735,6 +1662,15 @@ static MunitParameterEnum test_params[]
        {"progress_when_needed", progress_when_needed_params},
        {NULL, NULL}};
 
+static char* progress_policy_params[] = {"spindown", "adaptive", NULL};
+
+static MunitParameterEnum test_policy_params[]
+    = {{"protocol", protocol_params},
+       {"progress_pool", progress_pool_params},
+       {"progress_when_needed", progress_when_needed_params},
+       {"progress_policy", progress_policy_params},
+       {NULL, NULL}};
+
 static MunitParameterEnum test_params2[]
     = {{"protocol", protocol_params},
        {"progress_pool", progress_pool_params},
@@ -742,7 +1678,17 @@ static MunitParameterEnum test_params2[]
 
 static MunitTest test_suite_tests[] = {
     {(char*)"/forward", test_forward, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_policy_params},
+    {(char*)"/self_forward_inline", test_self_forward_inline, test_context_setup,
      test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
+    {(char*)"/self_forward_busy", test_self_forward_busy, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
+    {(char*)"/self_forward_dispatch_error", test_self_forward_dispatch_error,
+     test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE,
+     test_params},
+    {(char*)"/self_forward_deadline", test_self_forward_deadline,
+     test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE,
+     test_params},
     {(char*)"/respond_timed", test_respond_timed, test_context_setup,
      test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
     {(char*)"/forward_with_args", test_forward_with_args, test_context_setup,
@@ -763,6 +1709,18 @@ static MunitTest test_suite_tests[] = {
      test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
     {(char*)"/stress_handle_cache", test_stress_handle_cache, test_context_setup,
      test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
+    {(char*)"/completion_queue", test_completion_queue, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
+    {(char*)"/affine_handle_cache", test_affine_handle_cache, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params2},
+    {(char*)"/progress_contexts", test_progress_contexts, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params2},
+    {(char*)"/tuned_handle_cache", test_tuned_handle_cache, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params2},
+    {(char*)"/forward_multi", test_forward_multi, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
+    {(char*)"/forward_hedged", test_forward_hedged, test_context_setup,
+     test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
     {(char*)"/get_name", test_get_name, test_context_setup,
      test_context_tear_down, MUNIT_TEST_OPTION_NONE, test_params},
     {(char*)"/provider_cforward", test_provider_cforward, test_context_setup,
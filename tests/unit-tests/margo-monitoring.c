@@ -620,6 +620,10 @@ static void check_json_statistics_content(
                 ASSERT_JSON_HAS_KEY(target, addr_key, received_from, object);
                 ASSERT_JSON_HAS(received_from, handler, object);
                 ASSERT_JSON_HAS_STATS(handler, duration, expected_zeros);
+                ASSERT_JSON_HAS(handler, num_shed, int);
+                munit_assert_long(0, ==, json_object_get_uint64(num_shed));
+                ASSERT_JSON_HAS(handler, num_expired, int);
+                munit_assert_long(0, ==, json_object_get_uint64(num_expired));
                 ASSERT_JSON_HAS_DOUBLE_STATS(received_from, ult, relative_timestamp_from_handler_start, expected_zeros);
                 ASSERT_JSON_HAS_DOUBLE_STATS(received_from, irespond, relative_timestamp_from_ult_start, expected_zeros);
                 ASSERT_JSON_HAS_DOUBLE_STATS(received_from, respond_cb, relative_timestamp_from_irespond_start, expected_zeros);
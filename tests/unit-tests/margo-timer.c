@@ -340,6 +340,46 @@ static MunitResult test_margo_timer_destroy(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+static MunitResult test_margo_timer_many(const MunitParameter params[],
+                                         void*                data)
+{
+    (void)params;
+    (void)data;
+    int           ret;
+    margo_timer_t timers[64];
+
+    struct test_context* ctx = (struct test_context*)data;
+    ctx->flag = 0;
+
+    // Start timers with timeouts spread between 10ms and 640ms,
+    // in reverse order of expiration
+    for (int i = 0; i < 64; i++) {
+        ret = margo_timer_create(ctx->mid, timer_cb, data, &timers[i]);
+        munit_assert_int(ret, ==, 0);
+        ret = margo_timer_start(timers[i], 10 * (64 - i));
+        munit_assert_int(ret, ==, 0);
+    }
+
+    // Cancel every other timer
+    for (int i = 0; i < 64; i += 2) {
+        ret = margo_timer_cancel(timers[i]);
+        munit_assert_int(ret, ==, 0);
+    }
+
+    // Sleep until after the last deadline
+    margo_thread_sleep(ctx->mid, 1000);
+
+    // Only the timers that weren't canceled should have fired
+    munit_assert_int(ctx->flag, ==, 32);
+
+    for (int i = 0; i < 64; i++) {
+        ret = margo_timer_destroy(timers[i]);
+        munit_assert_int(ret, ==, 0);
+    }
+
+    return MUNIT_OK;
+}
+
 static char* protocol_params[] = {"na+sm", NULL};
 
 static MunitParameterEnum test_params[]
@@ -359,6 +399,9 @@ static MunitTest test_suite_tests[] = {
     {(char*)"/margo_timer/destroy", test_margo_timer_destroy,
      test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE,
      test_params},
+    {(char*)"/margo_timer/many", test_margo_timer_many,
+     test_context_setup, test_context_tear_down, MUNIT_TEST_OPTION_NONE,
+     test_params},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 static const MunitSuite test_suite